@@ -0,0 +1,604 @@
+#include "Benchmark.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "Profiler.hpp"
+#include "Counters.hpp"
+#include "StartupTimeline.hpp"
+#include "Regression.hpp"
+
+typedef std::chrono::steady_clock BenchmarkClock;
+
+BenchmarkSettings DefaultBenchmarkSettings()
+{
+    BenchmarkSettings settings;
+    settings.frames = 0;
+    settings.warmupFrames = 30;
+    settings.timeStep = 1.0 / 60.0;
+    settings.budget = DefaultGLCallBudget();
+    settings.isGbufferComparison = false;
+    settings.isDepthPrepassComparison = false;
+    settings.isForwardComparison = false;
+    settings.isLightingResolutionComparison = false;
+    settings.isFramesInFlightComparison = false;
+    settings.isPipelined = false;
+    return settings;
+}
+
+const char* BenchmarkPassName(int pass)
+{
+    static const char* names[PASS_COUNT] = { "simulation", "geometry", "lighting", "swap", "frame" };
+    return names[pass];
+}
+
+FrameTimeStats CalculateFrameTimeStats(std::vector<double>& samples)
+{
+    FrameTimeStats stats = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    if (samples.empty())
+        return stats;
+
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < samples.size(); i++)
+        sum += samples[i];
+
+    // nearest rank percentiles
+    auto percentile = [&](double p) {
+        size_t rank = (size_t)std::ceil(p * samples.size());
+        return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+    };
+    stats.mean = sum / samples.size();
+    stats.p50 = percentile(0.50);
+    stats.p95 = percentile(0.95);
+    stats.p99 = percentile(0.99);
+    stats.max = samples.back();
+    return stats;
+}
+
+// driver strings go into reports as they are, so quotes, backslashes and control characters are escaped
+static void WriteJsonString(std::ostream& out, const char* text)
+{
+    out << '"';
+    for (const char* c = text ? text : ""; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            out << '\\' << *c;
+        else if ((unsigned char)*c < 0x20)
+            out << "\\u00" << "0123456789abcdef"[(*c >> 4) & 0xf] << "0123456789abcdef"[*c & 0xf];
+        else
+            out << *c;
+    }
+    out << '"';
+}
+
+// every report opens with the GPU it ran on and the frames per measurement
+static void WriteReportHeader(std::ostream& json, const BenchmarkSettings& settings)
+{
+    json << "{\n";
+    json << "  \"renderer\": ";
+    WriteJsonString(json, (const char*)glGetString(GL_RENDERER));
+    json << ",\n";
+    json << "  \"frames\": " << settings.frames << ",\n";
+}
+
+// nothing to do without --benchmark-output, what is e.g. "g-buffer comparison"
+static bool WriteReport(const std::string& path, const std::ostringstream& json, const char* what)
+{
+    if (path.empty())
+        return true;
+    std::ofstream file(path);
+    if (!file || !(file << json.str()))
+    {
+        std::cerr << "Failed to write " << what << " " << path << std::endl;
+        return false;
+    }
+    std::string name = what;
+    name[0] = (char)toupper(name[0]);
+    std::cout << name << " written to " << path << std::endl;
+    return true;
+}
+
+static double Milliseconds(BenchmarkClock::time_point from, BenchmarkClock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+static void WriteStats(std::ostream& out, const FrameTimeStats& stats)
+{
+    out << "{ \"mean\": " << stats.mean << ", \"p50\": " << stats.p50 << ", \"p95\": " << stats.p95
+        << ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max << " }";
+}
+
+void MeasureFrames(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings,
+    BenchmarkResult& result)
+{
+    std::vector<double> samples[PASS_COUNT];
+    for (int p = 0; p < PASS_COUNT; p++)
+        samples[p].reserve(settings.frames);
+    // GPU results arrive GPU_TIMER_FRAMES frames late, last frames are not in them
+    std::vector<double> gpuSamples[GPU_PASS_COUNT];
+    uint64_t gpuStatistics[GPU_PASS_COUNT][GPU_STAT_COUNT] = {};
+    GpuTimer& gpuTimer = renderer.gpuTimer;
+    // timer counts frames since start, earlier runs (regression cases, g-buffer layouts) must not leak in
+    const unsigned int firstGpuFrame = gpuTimer.frame + settings.warmupFrames;
+    unsigned int lastGpuFrame = 0;
+    uint64_t counterTotals[COUNTER_COUNT] = {};
+    memset(result.glCallTotals, 0, sizeof(result.glCallTotals));
+    memset(result.glCallClassMax, 0, sizeof(result.glCallClassMax));
+    result.overBudgetFrames = 0;
+
+    const unsigned int totalFrames = settings.warmupFrames + settings.frames;
+    for (unsigned int frame = 0; frame < totalFrames; frame++)
+    {
+        // fixed clock - every run animates the scene the same way
+        float time = (float)(frame * settings.timeStep);
+        BenchmarkClock::time_point marks[PASS_COUNT + 1];
+
+        PROFILE_ZONE("Frame");
+        marks[0] = BenchmarkClock::now();
+        {
+            PROFILE_ZONE("Simulation");
+            AnimateScene(scene, time);
+        }
+
+        marks[1] = BenchmarkClock::now();
+        BeginFrameSync(renderer.frameSync);
+        ApplyPendingResize(renderer);
+        GpuTimerBeginFrame(gpuTimer);
+        if (gpuTimer.latest.isValid && gpuTimer.latest.frame != lastGpuFrame && gpuTimer.latest.frame >= firstGpuFrame)
+        {
+            lastGpuFrame = gpuTimer.latest.frame;
+            for (int p = 0; p < GPU_PASS_COUNT; p++)
+            {
+                if (!gpuTimer.latest.isPassValid[p])
+                    continue;
+                gpuSamples[p].push_back(gpuTimer.latest.passMs[p]);
+                for (int stat = 0; stat < GPU_STAT_COUNT; stat++)
+                    gpuStatistics[p][stat] += gpuTimer.latest.statistics[p][stat];
+            }
+        }
+        ShadowPass(renderer, scene, state, time);
+        GeometryPass(renderer, scene, state, time);
+        if (!settings.isPipelined)
+            glFinish();
+
+        marks[2] = BenchmarkClock::now();
+        FogPass(renderer, scene, state, time);
+        LightingPass(renderer, scene, state, time);
+        PresentFrame(renderer, state);
+        GpuTimerEndFrame(gpuTimer);
+        if (renderer.capture.isActive)
+            CaptureReadback(renderer.capture, renderer.outputWidth, renderer.outputHeight);
+        EndFrameSync(renderer.frameSync);
+        if (!settings.isPipelined)
+            glFinish();
+
+        marks[3] = BenchmarkClock::now();
+        {
+            PROFILE_ZONE("Swap");
+            glfwSwapBuffers(window);
+        }
+        StartupFirstFrame();
+        {
+            PROFILE_ZONE("PollEvents");
+            glfwPollEvents();
+        }
+        marks[4] = BenchmarkClock::now();
+        CountersEndFrame((float)Milliseconds(marks[0], marks[4]));
+        GLCallsEndFrame();
+
+        if (frame < settings.warmupFrames)
+            continue;
+        // warmup frames are not steady state (first use of programs, query ring filling up)
+        if (settings.budget.isSet && !CheckGLCallBudget(settings.budget, frame))
+            result.overBudgetFrames++;
+        for (int f = 0; f < GL_FUNCTION_COUNT; f++)
+            result.glCallTotals[f] += glCallLastFrame[f];
+        for (int c = 0; c < GL_CALL_CLASS_COUNT; c++)
+            result.glCallClassMax[c] = std::max(result.glCallClassMax[c], glCallClassLastFrame[c]);
+        for (int i = 0; i < COUNTER_COUNT; i++)
+            counterTotals[i] += counterLastFrame[i];
+        for (int p = 0; p < PASS_FRAME; p++)
+            samples[p].push_back(Milliseconds(marks[p], marks[p + 1]));
+        samples[PASS_FRAME].push_back(Milliseconds(marks[0], marks[4]));
+    }
+
+    const double frames = std::max(1u, settings.frames);
+    for (int p = 0; p < PASS_COUNT; p++)
+        result.passes[p] = CalculateFrameTimeStats(samples[p]);
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        result.countersPerFrame[i] = counterTotals[i] / frames;
+    // lighting pass is issued in every mode, forward+ has no geometry pass
+    result.gpuFrames = (unsigned int)gpuSamples[GPU_PASS_LIGHTING].size();
+    for (int p = 0; p < GPU_PASS_COUNT; p++)
+    {
+        result.gpuPassFrames[p] = (unsigned int)gpuSamples[p].size();
+        result.gpuPasses[p] = CalculateFrameTimeStats(gpuSamples[p]);
+        for (int stat = 0; stat < GPU_STAT_COUNT; stat++)
+            result.gpuStatisticsPerFrame[p][stat] = result.gpuPassFrames[p] > 0 ? gpuStatistics[p][stat] / result.gpuPassFrames[p] : 0;
+    }
+}
+
+bool RunBenchmark(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings)
+{
+    BenchmarkResult result;
+    MeasureFrames(window, renderer, scene, state, settings, result);
+
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+
+    std::ostringstream json;
+    WriteReportHeader(json, settings);
+    json << "  \"resolution\": [" << width << ", " << height << "],\n";
+    json << "  \"renderScale\": " << renderer.renderScale << ",\n";
+    json << "  \"renderResolution\": [" << renderer.gBuffer.width << ", " << renderer.gBuffer.height << "],\n";
+    json << "  \"lightingMode\": \"" << LightingModeName(state.lightingMode) << "\",\n";
+    json << "  \"volumetricFog\": " << (state.isVolumetricFog ? "true" : "false") << ",\n";
+    json << "  \"shadows\": " << (state.isShadows ? (state.isShadowCache ? "\"cached\"" : "\"uncached\"") : "false") << ",\n";
+    if (state.isShadows && state.isShadowCache)
+        json << "  \"shadowCacheNote\": \"static depth is keyed on camera dependent tile matrices, redrawn on every frame the camera moves\",\n";
+    json << "  \"framesInFlight\": " << renderer.frameSync.framesInFlight << ",\n";
+    json << "  \"pipelined\": " << (settings.isPipelined ? "true" : "false") << ",\n";
+    json << "  \"shaderPermutations\": " << (renderer.shaders.isEnabled ? "true" : "false") << ",\n";
+    json << "  \"shaderCache\": { \"programs\": " << renderer.shaders.programs.size() << ", \"compiled\": " << renderer.shaders.compiledCount
+        << ", \"compileMs\": " << renderer.shaders.compileMs << ", \"loaded\": " << renderer.shaders.loadedCount
+        << ", \"loadMs\": " << renderer.shaders.loadMs << ", \"rejected\": " << renderer.shaders.rejectedCount << " },\n";
+    json << "  \"warmupFrames\": " << settings.warmupFrames << ",\n";
+    json << "  \"timeStep\": " << settings.timeStep << ",\n";
+    json << "  \"scene\": { \"cubes\": " << scene.cubeCount << ", \"spheres\": " << scene.sphereCount
+        << ", \"lights\": " << scene.lightCount << " },\n";
+    json << "  \"profilerOverheadNs\": " << ProfilerMeasureOverhead(100000) << ",\n";
+    json << "  \"unit\": \"ms\",\n";
+    json << "  \"passes\": {\n";
+    for (int p = 0; p < PASS_COUNT; p++)
+    {
+        json << "    \"" << BenchmarkPassName(p) << "\": ";
+        WriteStats(json, result.passes[p]);
+        json << (p + 1 < PASS_COUNT ? ",\n" : "\n");
+    }
+    json << "  },\n";
+
+    json << "  \"countersPerFrame\": { ";
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        json << "\"" << CounterName(i) << "\": " << (uint64_t)result.countersPerFrame[i] << (i + 1 < COUNTER_COUNT ? ", " : " },\n");
+
+    // traced GL calls, per class and every function that was called
+    uint64_t glCallClassTotals[GL_CALL_CLASS_COUNT] = {};
+    for (int f = 0; f < GL_FUNCTION_COUNT; f++)
+        glCallClassTotals[GLFunctionClass(f)] += result.glCallTotals[f];
+    const double frames = std::max(1u, settings.frames);
+    json << "  \"glCalls\": {\n";
+    for (int c = 0; c < GL_CALL_CLASS_COUNT; c++)
+    {
+        json << "    \"" << GLCallClassName(c) << "\": { \"mean\": " << glCallClassTotals[c] / frames
+            << ", \"max\": " << result.glCallClassMax[c];
+        if (settings.budget.limits[c] >= 0)
+            json << ", \"budget\": " << settings.budget.limits[c];
+        json << " },\n";
+    }
+    json << "    \"perFunction\": { ";
+    bool first = true;
+    for (int f = 0; f < GL_FUNCTION_COUNT; f++)
+        if (result.glCallTotals[f] > 0)
+        {
+            json << (first ? "" : ", ") << "\"" << GLFunctionName(f) << "\": " << result.glCallTotals[f] / frames;
+            first = false;
+        }
+    json << " },\n";
+    json << "    \"framesOverBudget\": " << result.overBudgetFrames << "\n";
+    json << "  },\n";
+
+    // GPU side, from timestamp queries (no glFinish influence)
+    static const char* statNames[GPU_STAT_COUNT] = { "vertices", "primitives", "fragments" };
+    json << "  \"gpu\": {\n";
+    json << "    \"frames\": " << result.gpuFrames << ",\n";
+    json << "    \"pipelineStatistics\": " << (renderer.gpuTimer.hasStatistics ? "true" : "false") << ",\n";
+    for (int p = 0; p < GPU_PASS_COUNT; p++)
+    {
+        json << "    \"" << GpuPassShortName(p) << "\": { \"frames\": " << result.gpuPassFrames[p] << ", \"time\": ";
+        WriteStats(json, result.gpuPasses[p]);
+        for (int stat = 0; stat < GPU_STAT_COUNT; stat++)
+            json << ", \"" << statNames[stat] << "PerFrame\": " << result.gpuStatisticsPerFrame[p][stat];
+        json << " }" << (p + 1 < GPU_PASS_COUNT ? ",\n" : "\n");
+    }
+    json << "  }\n";
+    json << "}\n";
+
+    if (result.overBudgetFrames > 0)
+        std::cerr << result.overBudgetFrames << " of " << settings.frames << " frames went over GL call budget" << std::endl;
+
+    if (settings.outputPath.empty())
+    {
+        std::cout << json.str();
+        return result.overBudgetFrames == 0;
+    }
+    return WriteReport(settings.outputPath, json, "benchmark report") && result.overBudgetFrames == 0;
+}
+
+bool RunGbufferComparison(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings)
+{
+    static const float scales[] = { 0.5f, 1.0f, 1.5f, 2.0f };
+    const int scaleCount = sizeof(scales) / sizeof(scales[0]);
+    const float originalScale = renderer.renderScale;
+    const int originalLayout = renderer.gbufferLayout;
+
+    std::ostringstream json;
+    WriteReportHeader(json, settings);
+    json << "  \"pipelineStatistics\": " << (renderer.gpuTimer.hasStatistics ? "true" : "false") << ",\n";
+    json << "  \"runs\": [\n";
+    std::cout << std::left << std::setw(10) << "layout" << std::setw(12) << "resolution" << std::right << std::setw(10) << "overdraw"
+        << std::setw(12) << "write B/px" << std::setw(12) << "read B/px" << std::setw(10) << "MB/frame"
+        << std::setw(12) << "geometry ms" << std::setw(12) << "lighting ms" << std::endl;
+
+    bool ok = true;
+    for (int layout = 0; layout < GBUFFER_LAYOUT_COUNT; layout++)
+        for (int s = 0; s < scaleCount; s++)
+        {
+            renderer.gbufferLayout = layout;
+            renderer.renderScale = scales[s];
+            ok = RecreateRenderTargets(renderer) && ok;
+            BenchmarkResult result;
+            MeasureFrames(window, renderer, scene, state, settings, result);
+
+            // fragments shaded in geometry pass per pixel, 1 when pipeline statistics are missing
+            const double pixels = (double)renderer.gBuffer.width * renderer.gBuffer.height;
+            const uint64_t fragments = result.gpuStatisticsPerFrame[GPU_PASS_GEOMETRY][GPU_STAT_FRAGMENTS];
+            const double overdraw = fragments > 0 ? fragments / pixels : 1.0;
+            const double written = GbufferBytesWritten(layout, overdraw);
+            const double read = GbufferBytesRead(layout, overdraw);
+            const double megabytes = (written + read) * pixels / (1024.0 * 1024.0);
+            const double geometryMs = result.gpuFrames > 0 ? result.gpuPasses[GPU_PASS_GEOMETRY].p50 : result.passes[PASS_GEOMETRY].p50;
+            const double lightingMs = result.gpuFrames > 0 ? result.gpuPasses[GPU_PASS_LIGHTING].p50 : result.passes[PASS_LIGHTING].p50;
+
+            std::ostringstream resolution;
+            resolution << renderer.gBuffer.width << "x" << renderer.gBuffer.height;
+            std::cout << std::left << std::setw(10) << GetGbufferLayoutInfo(layout).name << std::setw(12) << resolution.str()
+                << std::right << std::fixed << std::setprecision(2) << std::setw(10) << overdraw
+                << std::setw(12) << written << std::setw(12) << read << std::setw(10) << megabytes
+                << std::setprecision(3) << std::setw(12) << geometryMs << std::setw(12) << lightingMs << std::endl;
+            std::cout.unsetf(std::ios::fixed);
+
+            json << "    { \"layout\": \"" << GetGbufferLayoutInfo(layout).name << "\", \"renderScale\": " << scales[s]
+                << ", \"resolution\": [" << renderer.gBuffer.width << ", " << renderer.gBuffer.height << "]"
+                << ", \"overdraw\": " << overdraw << ", \"bytesWrittenPerPixel\": " << written << ", \"bytesReadPerPixel\": " << read
+                << ", \"megabytesPerFrame\": " << megabytes << ", \"geometryP50\": " << geometryMs << ", \"lightingP50\": " << lightingMs << " }"
+                << (layout + 1 < GBUFFER_LAYOUT_COUNT || s + 1 < scaleCount ? ",\n" : "\n");
+        }
+    json << "  ]\n";
+    json << "}\n";
+
+    renderer.gbufferLayout = originalLayout;
+    renderer.renderScale = originalScale;
+    ok = RecreateRenderTargets(renderer) && ok;
+
+    return WriteReport(settings.outputPath, json, "g-buffer comparison") && ok;
+}
+
+bool RunDepthPrepassComparison(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings)
+{
+    BenchmarkResult results[2];
+    for (int mode = 0; mode < 2; mode++)
+    {
+        state.isDepthPrepass = mode == 1;
+        MeasureFrames(window, renderer, scene, state, settings, results[mode]);
+    }
+
+    // GPU times when there are any, CPU pass times (closed with glFinish) otherwise
+    const bool hasGpu = results[0].gpuFrames > 0 && results[1].gpuFrames > 0;
+    double geometryMs[2], prepassMs[2];
+    for (int mode = 0; mode < 2; mode++)
+    {
+        geometryMs[mode] = hasGpu ? results[mode].gpuPasses[GPU_PASS_GEOMETRY].p50 : results[mode].passes[PASS_GEOMETRY].p50;
+        prepassMs[mode] = hasGpu ? results[mode].gpuPasses[GPU_PASS_DEPTH_PREPASS].p50 : 0.0;
+    }
+
+    static const char* modeNames[2] = { "off", "on" };
+    std::ostringstream json;
+    WriteReportHeader(json, settings);
+    json << "  \"scene\": { \"cubes\": " << scene.cubeCount << ", \"spheres\": " << scene.sphereCount << " },\n";
+    json << "  \"timeSource\": \"" << (hasGpu ? "gpu" : "cpu") << "\",\n";
+    std::cout << std::left << std::setw(10) << "prepass" << std::right << std::setw(12) << "triangles" << std::setw(14) << "fragments"
+        << std::setw(12) << "prepass ms" << std::setw(13) << "geometry ms" << std::setw(10) << "total ms" << std::endl;
+    for (int mode = 0; mode < 2; mode++)
+    {
+        const BenchmarkResult& result = results[mode];
+        const double triangles = result.countersPerFrame[COUNTER_TRIANGLES] + result.countersPerFrame[COUNTER_PREPASS_TRIANGLES];
+        // fragment shader invocations of g-buffer pass, needs pipeline statistics
+        const uint64_t fragments = result.gpuStatisticsPerFrame[GPU_PASS_GEOMETRY][GPU_STAT_FRAGMENTS];
+        std::cout << std::left << std::setw(10) << modeNames[mode] << std::right << std::fixed << std::setprecision(0)
+            << std::setw(12) << triangles << std::setw(14) << fragments << std::setprecision(3)
+            << std::setw(12) << prepassMs[mode] << std::setw(13) << geometryMs[mode] << std::setw(10) << prepassMs[mode] + geometryMs[mode] << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+        json << "  \"" << modeNames[mode] << "\": { \"trianglesPerFrame\": " << (uint64_t)triangles << ", \"gbufferFragmentsPerFrame\": " << fragments
+            << ", \"prepassP50\": " << prepassMs[mode] << ", \"geometryP50\": " << geometryMs[mode] << " },\n";
+    }
+
+    const double saved = (prepassMs[0] + geometryMs[0]) - (prepassMs[1] + geometryMs[1]);
+    const bool isPayingOff = saved > 0.0;
+    std::cout << "Depth pre-pass " << (isPayingOff ? "pays off" : "only adds vertex work") << " for this scene ("
+        << (isPayingOff ? saved : -saved) << " ms " << (isPayingOff ? "saved" : "lost") << " per frame)" << std::endl;
+    json << "  \"savedMs\": " << saved << ",\n";
+    json << "  \"paysOff\": " << (isPayingOff ? "true" : "false") << "\n";
+    json << "}\n";
+
+    return WriteReport(settings.outputPath, json, "depth pre-pass comparison");
+}
+
+// geometry + lighting pass (pre-pass, fog and upscale included), each closed with glFinish.
+// Not GPU timestamps - binning rasterizers (tilers, llvmpipe) run the forward pass at the next
+// flush, after its end timestamp.
+static double RenderMilliseconds(const BenchmarkResult& result)
+{
+    return result.passes[PASS_GEOMETRY].p50 + result.passes[PASS_LIGHTING].p50;
+}
+
+bool RunForwardComparison(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings)
+{
+    static const float fractions[] = { 0.25f, 1.0f };
+    static const float scales[] = { 0.5f, 1.0f, 2.0f };
+    const int fractionCount = sizeof(fractions) / sizeof(fractions[0]);
+    const int scaleCount = sizeof(scales) / sizeof(scales[0]);
+    const unsigned int cubeCount = scene.cubeCount;
+    const unsigned int lightCount = scene.lightCount;
+    const float originalScale = renderer.renderScale;
+    const int deferredMode = state.lightingMode == LIGHTING_FORWARD_PLUS ? LIGHTING_CLUSTERED : state.lightingMode;
+    const int modes[2] = { deferredMode, LIGHTING_FORWARD_PLUS };
+
+    std::ostringstream json;
+    WriteReportHeader(json, settings);
+    json << "  \"deferredMode\": \"" << LightingModeName(deferredMode) << "\",\n";
+    json << "  \"runs\": [\n";
+    std::cout << std::left << std::setw(9) << "objects" << std::setw(8) << "lights" << std::setw(12) << "resolution" << std::right
+        << std::setw(12) << "g-buffer MB" << std::setw(13) << "deferred ms" << std::setw(12) << "forward ms" << "  winner" << std::endl;
+
+    bool ok = true;
+    unsigned int forwardWins = 0, runs = 0;
+    for (int c = 0; c < fractionCount; c++)
+        for (int l = 0; l < fractionCount; l++)
+            for (int s = 0; s < scaleCount; s++)
+            {
+                scene.cubeCount = std::max(1u, (unsigned int)(cubeCount * fractions[c] + 0.5f));
+                scene.lightCount = std::max(1u, (unsigned int)(lightCount * fractions[l] + 0.5f));
+                renderer.renderScale = scales[s];
+                ok = RecreateRenderTargets(renderer) && ok;
+                BenchmarkResult results[2];
+                for (int mode = 0; mode < 2; mode++)
+                {
+                    state.lightingMode = modes[mode];
+                    MeasureFrames(window, renderer, scene, state, settings, results[mode]);
+                }
+
+                // g-buffer written and read by deferred run, forward+ has none
+                const double pixels = (double)renderer.gBuffer.width * renderer.gBuffer.height;
+                const uint64_t fragments = results[0].gpuStatisticsPerFrame[GPU_PASS_GEOMETRY][GPU_STAT_FRAGMENTS];
+                const double overdraw = fragments > 0 ? fragments / pixels : 1.0;
+                const double megabytes = (GbufferBytesWritten(renderer.gbufferLayout, overdraw) + GbufferBytesRead(renderer.gbufferLayout, overdraw))
+                    * pixels / (1024.0 * 1024.0);
+                const double deferredMs = RenderMilliseconds(results[0]);
+                const double forwardMs = RenderMilliseconds(results[1]);
+                const bool isForwardFaster = forwardMs < deferredMs;
+                forwardWins += isForwardFaster ? 1 : 0;
+                runs++;
+
+                std::ostringstream resolution;
+                resolution << renderer.gBuffer.width << "x" << renderer.gBuffer.height;
+                std::cout << std::left << std::setw(9) << scene.cubeCount << std::setw(8) << scene.lightCount << std::setw(12) << resolution.str()
+                    << std::right << std::fixed << std::setprecision(2) << std::setw(12) << megabytes << std::setprecision(3)
+                    << std::setw(13) << deferredMs << std::setw(12) << forwardMs << "  " << (isForwardFaster ? "forward+" : "deferred") << std::endl;
+                std::cout.unsetf(std::ios::fixed);
+
+                json << "    { \"cubes\": " << scene.cubeCount << ", \"lights\": " << scene.lightCount << ", \"renderScale\": " << scales[s]
+                    << ", \"resolution\": [" << renderer.gBuffer.width << ", " << renderer.gBuffer.height << "]"
+                    << ", \"gbufferMegabytesPerFrame\": " << megabytes << ", \"deferredMs\": " << deferredMs << ", \"forwardMs\": " << forwardMs
+                    << ", \"winner\": \"" << (isForwardFaster ? "forward" : "deferred") << "\" }"
+                    << (c + 1 < fractionCount || l + 1 < fractionCount || s + 1 < scaleCount ? ",\n" : "\n");
+            }
+    json << "  ],\n";
+    json << "  \"forwardWins\": " << forwardWins << "\n";
+    json << "}\n";
+    std::cout << "Forward+ wins " << forwardWins << " of " << runs << " configurations against " << LightingModeName(deferredMode) << " deferred lighting" << std::endl;
+
+    scene.cubeCount = cubeCount;
+    scene.lightCount = lightCount;
+    renderer.renderScale = originalScale;
+    ok = RecreateRenderTargets(renderer) && ok;
+
+    return WriteReport(settings.outputPath, json, "forward+ comparison") && ok;
+}
+
+bool RunLightingResolutionComparison(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings)
+{
+    // the modes that draw lighting as a full screen quad
+    state.lightingMode = state.lightingMode == LIGHTING_FULL_SCREEN ? LIGHTING_FULL_SCREEN : LIGHTING_CLUSTERED;
+    // same frame for every resolution, the one after the last measured
+    const float captureTime = (float)((settings.warmupFrames + settings.frames) * settings.timeStep);
+
+    std::ostringstream json;
+    WriteReportHeader(json, settings);
+    json << "  \"lightingMode\": \"" << LightingModeName(state.lightingMode) << "\",\n";
+    json << "  \"resolution\": [" << renderer.gBuffer.width << ", " << renderer.gBuffer.height << "],\n";
+    json << "  \"runs\": [\n";
+    std::cout << std::left << std::setw(14) << "lighting" << std::right << std::setw(14) << "shaded pixels" << std::setw(13) << "lighting ms"
+        << std::setw(9) << "GPU ms" << std::setw(11) << "PSNR dB" << std::endl;
+
+    Image reference;
+    for (int resolution = 0; resolution < LIGHTING_RESOLUTION_COUNT; resolution++)
+    {
+        state.lightingResolution = resolution;
+        BenchmarkResult result;
+        MeasureFrames(window, renderer, scene, state, settings, result);
+        Image image = CaptureFrame(window, renderer, scene, state, captureTime);
+        if (resolution == LIGHTING_RESOLUTION_FULL)
+            reference = image;
+        const double psnr = ImagePsnr(reference, image);
+        const bool isReduced = resolution != LIGHTING_RESOLUTION_FULL && renderer.reducedLighting.framebuffer != 0;
+        const unsigned int shadedPixels = isReduced ? renderer.reducedLighting.width * renderer.reducedLighting.height
+            : renderer.gBuffer.width * renderer.gBuffer.height;
+        // lighting + upsample, closed with glFinish
+        const double lightingMs = result.passes[PASS_LIGHTING].p50;
+        const bool hasGpuTime = result.gpuPassFrames[GPU_PASS_LIGHTING] > 0;
+        const double gpuMs = hasGpuTime ? result.gpuPasses[GPU_PASS_LIGHTING].p50 : 0.0;
+
+        std::cout << std::left << std::setw(14) << LightingResolutionName(resolution) << std::right << std::setw(14) << shadedPixels
+            << std::fixed << std::setprecision(3) << std::setw(13) << lightingMs << std::setw(9) << gpuMs
+            << std::setprecision(2) << std::setw(11) << psnr << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+
+        json << "    { \"lightingResolution\": \"" << LightingResolutionName(resolution) << "\", \"shadedPixels\": " << shadedPixels
+            << ", \"lightingMs\": " << lightingMs;
+        if (hasGpuTime)
+            json << ", \"gpuLightingMs\": " << gpuMs;
+        json << ", \"psnr\": " << psnr << " }" << (resolution + 1 < LIGHTING_RESOLUTION_COUNT ? ",\n" : "\n");
+    }
+    json << "  ]\n";
+    json << "}\n";
+
+    return WriteReport(settings.outputPath, json, "lighting resolution comparison");
+}
+
+bool RunFramesInFlightComparison(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings)
+{
+    BenchmarkSettings pipelined = settings;
+    pipelined.isPipelined = true;
+    const unsigned int originalFrames = renderer.frameSync.framesInFlight;
+
+    std::ostringstream json;
+    WriteReportHeader(json, settings);
+    json << "  \"lightingMode\": \"" << LightingModeName(state.lightingMode) << "\",\n";
+    json << "  \"runs\": [\n";
+    std::cout << std::left << std::setw(18) << "frames in flight" << std::right << std::setw(11) << "frame p50" << std::setw(11) << "frame p95"
+        << std::setw(8) << "FPS" << std::setw(11) << "stall ms" << std::setw(10) << "swap ms" << std::endl;
+
+    for (unsigned int framesInFlight = 1; framesInFlight <= MAX_FRAMES_IN_FLIGHT; framesInFlight++)
+    {
+        SetFramesInFlight(renderer.frameSync, framesInFlight);
+        BenchmarkResult result;
+        MeasureFrames(window, renderer, scene, state, pipelined, result);
+        const FrameTimeStats& frame = result.passes[PASS_FRAME];
+        const double fps = frame.mean > 0.0 ? 1000.0 / frame.mean : 0.0;
+        // fence waits per frame, part of frame time (geometry pass, where the frame starts writing)
+        const double stallMs = result.countersPerFrame[COUNTER_FRAME_STALL_US] / 1000.0;
+        const double swapMs = result.passes[PASS_SWAP].p50;
+
+        std::cout << std::left << std::setw(18) << framesInFlight << std::right << std::fixed << std::setprecision(3)
+            << std::setw(11) << frame.p50 << std::setw(11) << frame.p95 << std::setprecision(1) << std::setw(8) << fps
+            << std::setprecision(3) << std::setw(11) << stallMs << std::setw(10) << swapMs << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+
+        json << "    { \"framesInFlight\": " << framesInFlight << ", \"frame\": ";
+        WriteStats(json, result.passes[PASS_FRAME]);
+        json << ", \"fps\": " << fps << ", \"stallMsPerFrame\": " << stallMs << ", \"swapMs\": " << swapMs << " }"
+            << (framesInFlight < MAX_FRAMES_IN_FLIGHT ? ",\n" : "\n");
+    }
+    json << "  ]\n";
+    json << "}\n";
+    SetFramesInFlight(renderer.frameSync, originalFrames);
+
+    return WriteReport(settings.outputPath, json, "frames in flight comparison");
+}
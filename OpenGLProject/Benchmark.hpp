@@ -0,0 +1,94 @@
+#ifndef Benchmark_hpp
+#define Benchmark_hpp
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <string>
+#include <vector>
+#include "Renderer.hpp"
+#include "Scene.hpp"
+#include "GLCalls.hpp"
+#include "Counters.hpp"
+
+struct BenchmarkSettings
+{
+    unsigned int frames;
+    unsigned int warmupFrames;
+    double timeStep;        // simulated clock step, seconds per frame
+    std::string outputPath; // JSON report, empty = stdout
+    GLCallBudget budget;    // checked on every measured frame
+    bool isGbufferComparison; // run every g-buffer layout at several render scales instead
+    bool isDepthPrepassComparison; // run scene without and with depth pre-pass instead
+    bool isForwardComparison; // run deferred and forward+ over object / light counts and render scales instead
+    bool isLightingResolutionComparison; // run every LightingResolution, timing + PSNR against full resolution instead
+    bool isFramesInFlightComparison; // run pipelined with 1 to MAX_FRAMES_IN_FLIGHT frames in flight instead
+    bool isPipelined; // no glFinish after passes - pass times are CPU submit only, frames overlap the GPU
+};
+
+enum BenchmarkPass
+{
+    PASS_SIMULATION = 0,
+    PASS_GEOMETRY,
+    PASS_LIGHTING,
+    PASS_SWAP,
+    PASS_FRAME,
+    PASS_COUNT
+};
+
+struct FrameTimeStats
+{
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+};
+
+// Everything measured over settings.frames frames (after warmup)
+struct BenchmarkResult
+{
+    FrameTimeStats passes[PASS_COUNT];
+    double countersPerFrame[COUNTER_COUNT];
+    uint64_t glCallTotals[GL_FUNCTION_COUNT];
+    uint64_t glCallClassMax[GL_CALL_CLASS_COUNT];
+    unsigned int overBudgetFrames;
+    unsigned int gpuFrames;
+    unsigned int gpuPassFrames[GPU_PASS_COUNT]; // depth pre-pass only has them when it ran
+    FrameTimeStats gpuPasses[GPU_PASS_COUNT];
+    uint64_t gpuStatisticsPerFrame[GPU_PASS_COUNT][GPU_STAT_COUNT];
+};
+
+BenchmarkSettings DefaultBenchmarkSettings();
+
+// sorts samples in place, values in milliseconds
+FrameTimeStats CalculateFrameTimeStats(std::vector<double>& samples);
+const char* BenchmarkPassName(int pass);
+
+// Renders warmup + settings.frames frames with a fixed clock
+void MeasureFrames(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings,
+    BenchmarkResult& result);
+// MeasureFrames + JSON report.
+// Every pass is closed with glFinish so its time includes GPU work (unless isPipelined).
+// Returns false when writing report failed or a frame went over the GL call budget.
+bool RunBenchmark(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings);
+// MeasureFrames for every GbufferLayout x render scale 0.5, 1, 1.5, 2, prints table of
+// GPU pass times next to modelled g-buffer bytes (JSON to settings.outputPath when set).
+// Renderer gets its own layout / scale back afterwards.
+bool RunGbufferComparison(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings);
+// MeasureFrames without and with depth pre-pass. Pre-pass pays off when fragments it saves
+// in g-buffer pass cost more than the vertex work it adds, prints which one it was for this scene.
+bool RunDepthPrepassComparison(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings);
+// MeasureFrames of deferred lighting (state.lightingMode, clustered when that is forward+) and
+// forward+ for a quarter / all of the cubes x a quarter / all of the lights x render scale
+// 0.5, 1, 2. Prints geometry + lighting time of both (closed with glFinish) next to modelled
+// g-buffer traffic of deferred one, and which mode wins each configuration.
+bool RunForwardComparison(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings);
+// MeasureFrames for every LightingResolution (state.lightingMode, clustered unless it is full screen)
+// and PSNR of a frame at each against the full resolution one. Prints lighting pass time (upsample
+// included, closed with glFinish), shaded pixels and PSNR.
+bool RunLightingResolutionComparison(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings);
+// Pipelined MeasureFrames (no glFinish) with 1, 2 and 3 frames in flight. Prints frame time,
+// frames per second and how long the CPU waited for frame fences, renderer keeps its own
+// frames in flight afterwards.
+bool RunFramesInFlightComparison(GLFWwindow* window, Renderer& renderer, Scene& scene, RenderState state, const BenchmarkSettings& settings);
+
+#endif
@@ -0,0 +1,145 @@
+#include "Counters.hpp"
+#include "GLCalls.hpp"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+uint64_t counterValues[COUNTER_COUNT];
+uint64_t counterLastFrame[COUNTER_COUNT];
+float counterFrameTimes[COUNTER_HISTORY];
+unsigned int counterFrame = 0;
+
+const char* CounterName(int counter)
+{
+    static const char* names[COUNTER_COUNT] = {
+        "draw_calls", "triangles", "state_changes", "uniform_uploads", "bytes_streamed", "lights_evaluated", "objects_culled",
+        "prepass_triangles", "cluster_lights", "shadow_triangles",
+        "frame_stall_us"
+    };
+    return names[counter];
+}
+
+void CountersEndFrame(float frameMs)
+{
+    // glCallCounts still hold this frame, GLCallsEndFrame runs after
+    for (int i = 0; i < GL_FUNCTION_COUNT; i++)
+    {
+        const GLCallClass callClass = GLFunctionClass(i);
+        if (callClass == GL_CALL_STATE)
+            counterValues[COUNTER_STATE_CHANGES] += glCallCounts[i];
+        else if (callClass == GL_CALL_UNIFORM)
+            counterValues[COUNTER_UNIFORM_UPLOADS] += glCallCounts[i];
+    }
+    memcpy(counterLastFrame, counterValues, sizeof(counterValues));
+    memset(counterValues, 0, sizeof(counterValues));
+    counterFrameTimes[counterFrame % COUNTER_HISTORY] = frameMs;
+    counterFrame++;
+}
+
+float CountersAverageFrameTime(unsigned int frames)
+{
+    unsigned int count = std::min(std::min(frames, counterFrame), (unsigned int)COUNTER_HISTORY);
+    if (count == 0)
+        return 0.0f;
+    float sum = 0.0f;
+    for (unsigned int i = 1; i <= count; i++)
+        sum += counterFrameTimes[(counterFrame - i) % COUNTER_HISTORY];
+    return sum / count;
+}
+
+MetricsExporter CreateMetricsExporter(const std::string& path, double interval)
+{
+    MetricsExporter exporter;
+    exporter.path = path;
+    const std::string extension = ".prom";
+    exporter.isPrometheus = path.size() >= extension.size() &&
+        path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+    exporter.interval = interval;
+    exporter.lastExport = 0.0;
+    exporter.hasHeader = false;
+    return exporter;
+}
+
+static void WritePrometheus(const MetricsExporter& exporter, float frameMs, const GpuFrameTimings& gpu)
+{
+    // written to temp file and renamed, so scrapers never read half a file
+    // exported every interval, a failing path is reported once instead of every time
+    static bool isFailureReported = false;
+    std::string temp = exporter.path + ".tmp";
+    bool isWritten;
+    {
+        std::ofstream out(temp, std::ios::trunc);
+        for (int i = 0; i < COUNTER_COUNT; i++)
+        {
+            out << "# TYPE render_" << CounterName(i) << " gauge\n";
+            out << "render_" << CounterName(i) << " " << counterLastFrame[i] << "\n";
+        }
+        out << "# TYPE render_frame_ms gauge\nrender_frame_ms " << frameMs << "\n";
+        out << "# TYPE render_frames_total counter\nrender_frames_total " << counterFrame << "\n";
+        if (gpu.isValid)
+        {
+            out << "# TYPE render_gpu_pass_ms gauge\n";
+            for (int p = 0; p < GPU_PASS_COUNT; p++)
+                out << "render_gpu_pass_ms{pass=\"" << GpuPassShortName(p) << "\"} " << gpu.passMs[p] << "\n";
+        }
+        out.close();
+        isWritten = !out.fail();
+    }
+    if (isWritten)
+    {
+#ifdef _WIN32
+        isWritten = MoveFileExA(temp.c_str(), exporter.path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        isWritten = std::rename(temp.c_str(), exporter.path.c_str()) == 0;
+#endif
+    }
+    if (!isWritten)
+    {
+        std::remove(temp.c_str());
+        if (!isFailureReported)
+            std::cerr << "Failed to write metrics to " << exporter.path << std::endl;
+        isFailureReported = true;
+    }
+}
+
+static void WriteCsv(MetricsExporter& exporter, double now, float frameMs, const GpuFrameTimings& gpu)
+{
+    std::ofstream out(exporter.path, exporter.hasHeader ? std::ios::app : std::ios::trunc);
+    if (!exporter.hasHeader)
+    {
+        out << "time,frame,frame_ms";
+        for (int i = 0; i < COUNTER_COUNT; i++)
+            out << "," << CounterName(i);
+        for (int p = 0; p < GPU_PASS_COUNT; p++)
+            out << ",gpu_" << GpuPassShortName(p) << "_ms";
+        out << "\n";
+        exporter.hasHeader = true;
+    }
+    out << now << "," << counterFrame << "," << frameMs;
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        out << "," << counterLastFrame[i];
+    // empty cells until first GPU results arrive, keeps columns stable
+    for (int p = 0; p < GPU_PASS_COUNT; p++)
+        out << "," << (gpu.isValid ? std::to_string(gpu.passMs[p]) : "");
+    out << "\n";
+}
+
+void PollMetricsExporter(MetricsExporter& exporter, double now, const GpuFrameTimings& gpu)
+{
+    if (exporter.path.empty() || now - exporter.lastExport < exporter.interval)
+        return;
+    exporter.lastExport = now;
+
+    float frameMs = CountersAverageFrameTime(60);
+    if (exporter.isPrometheus)
+        WritePrometheus(exporter, frameMs, gpu);
+    else
+        WriteCsv(exporter, now, frameMs, gpu);
+}
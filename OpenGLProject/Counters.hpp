@@ -0,0 +1,62 @@
+#ifndef Counters_hpp
+#define Counters_hpp
+#include <cstdint>
+#include <string>
+#include "GpuTimer.hpp"
+
+// Global per frame render counters.
+// Passes add to current frame with CountersAdd, CountersEndFrame moves
+// totals to counterLastFrame (what overlay / exporters show) and clears them.
+// State changes and uniform uploads are not added by passes, CountersEndFrame takes them from
+// the GL call counts of the frame (GLTrace.hpp, state and uniform classes), so they stay exact
+// when a pass changes. They read 0 with GL_CALLS_DISABLED.
+
+enum RenderCounter
+{
+    COUNTER_DRAW_CALLS = 0,
+    COUNTER_TRIANGLES,
+    COUNTER_STATE_CHANGES, // GL_CALL_STATE calls
+    COUNTER_UNIFORM_UPLOADS, // GL_CALL_UNIFORM calls
+    COUNTER_BYTES_STREAMED,
+    COUNTER_LIGHTS_EVALUATED, // light * pixel evaluations
+    COUNTER_OBJECTS_CULLED,
+    COUNTER_PREPASS_TRIANGLES, // extra vertex work of depth pre-pass
+    COUNTER_CLUSTER_LIGHTS, // light / cluster pairs of clustered lighting
+    COUNTER_SHADOW_TRIANGLES, // drawn into the shadow atlas, static casters only when their depth is redrawn
+    COUNTER_FRAME_STALL_US, // CPU waited for the GPU to free a frame in flight resource set (FrameSync)
+    COUNTER_COUNT
+};
+
+#define COUNTER_HISTORY 128 // frame times kept for overlay graph
+
+extern uint64_t counterValues[COUNTER_COUNT];
+extern uint64_t counterLastFrame[COUNTER_COUNT];
+extern float counterFrameTimes[COUNTER_HISTORY];
+extern unsigned int counterFrame;
+
+inline void CountersAdd(RenderCounter counter, uint64_t value)
+{
+    counterValues[counter] += value;
+}
+
+const char* CounterName(int counter);
+// frameMs - CPU time of finished frame, goes to history. Call before GLCallsEndFrame.
+void CountersEndFrame(float frameMs);
+float CountersAverageFrameTime(unsigned int frames);
+
+// Periodic export for dashboards, format from extension:
+// *.prom - Prometheus text format (file rewritten each time), anything else - CSV (row appended)
+struct MetricsExporter
+{
+    std::string path;
+    bool isPrometheus;
+    double interval;
+    double lastExport;
+    bool hasHeader;
+};
+
+MetricsExporter CreateMetricsExporter(const std::string& path, double interval);
+// GPU pass times are written only when gpu.isValid
+void PollMetricsExporter(MetricsExporter& exporter, double now, const GpuFrameTimings& gpu);
+
+#endif
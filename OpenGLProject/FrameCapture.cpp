@@ -0,0 +1,446 @@
+#include "FrameCapture.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ImageIO.hpp"
+#include "Profiler.hpp"
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#include "GLTrace.hpp"
+
+typedef std::chrono::steady_clock CaptureClock;
+
+// RGBA as read, bottom row first
+struct CaptureJob
+{
+    uint64_t index;
+    Image image;
+};
+
+struct CaptureEncoders
+{
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<CaptureJob> jobs;
+    bool isStopping;
+    std::ofstream video;
+    // Y4M - frames converted out of order wait for their turn, one thread writes at a time
+    std::map<uint64_t, std::vector<unsigned char> > converted;
+    uint64_t nextWrite;
+    bool isWriting;
+
+    uint64_t encodedFrames;
+    uint64_t failedFrames;
+    uint64_t bytesWritten;
+    // summed over threads
+    double encodeMs;
+};
+
+CaptureSettings DefaultCaptureSettings()
+{
+    CaptureSettings settings;
+    settings.fps = 60;
+    settings.threads = 0;
+    return settings;
+}
+
+static bool IsVideoPath(const std::string& path)
+{
+    return path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+}
+
+// full range BT.601 (C420jpeg), chroma of every 2x2 block averaged, rows flipped to top first
+static std::vector<unsigned char> ConvertToI420(const Image& image)
+{
+    const int width = image.width;
+    const int height = image.height;
+    const int chromaWidth = (width + 1) / 2;
+    const int chromaHeight = (height + 1) / 2;
+    std::vector<unsigned char> frame((size_t)width * height + 2 * (size_t)chromaWidth * chromaHeight);
+    unsigned char* yPlane = frame.data();
+    unsigned char* cbPlane = yPlane + (size_t)width * height;
+    unsigned char* crPlane = cbPlane + (size_t)chromaWidth * chromaHeight;
+
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char* row = &image.pixels[(size_t)(height - 1 - y) * width * 4];
+        for (int x = 0; x < width; x++)
+        {
+            const float r = row[x * 4], g = row[x * 4 + 1], b = row[x * 4 + 2];
+            yPlane[(size_t)y * width + x] = (unsigned char)std::min(255.0f, 0.299f * r + 0.587f * g + 0.114f * b + 0.5f);
+        }
+    }
+    for (int cy = 0; cy < chromaHeight; cy++)
+        for (int cx = 0; cx < chromaWidth; cx++)
+        {
+            float r = 0.0f, g = 0.0f, b = 0.0f;
+            int count = 0;
+            for (int y = cy * 2; y < std::min(cy * 2 + 2, height); y++)
+                for (int x = cx * 2; x < std::min(cx * 2 + 2, width); x++)
+                {
+                    const unsigned char* pixel = &image.pixels[((size_t)(height - 1 - y) * width + x) * 4];
+                    r += pixel[0];
+                    g += pixel[1];
+                    b += pixel[2];
+                    count++;
+                }
+            r /= count;
+            g /= count;
+            b /= count;
+            const float cb = 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b;
+            const float cr = 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b;
+            cbPlane[(size_t)cy * chromaWidth + cx] = (unsigned char)std::min(std::max(cb + 0.5f, 0.0f), 255.0f);
+            crPlane[(size_t)cy * chromaWidth + cx] = (unsigned char)std::min(std::max(cr + 0.5f, 0.0f), 255.0f);
+        }
+    return frame;
+}
+
+// Y4M - queue the converted frame, whoever finds the next one in order writes until there is a gap.
+// Frames are counted written / failed here, by the thread that wrote them.
+static void WriteVideoFrame(CaptureEncoders& encoders, uint64_t index, std::vector<unsigned char>& frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(encoders.mutex);
+        encoders.converted[index].swap(frame);
+        if (encoders.isWriting)
+            return;
+        encoders.isWriting = true;
+    }
+    while (true)
+    {
+        std::vector<unsigned char> next;
+        {
+            std::lock_guard<std::mutex> lock(encoders.mutex);
+            auto found = encoders.converted.find(encoders.nextWrite);
+            if (found == encoders.converted.end())
+            {
+                encoders.isWriting = false;
+                return;
+            }
+            next.swap(found->second);
+            encoders.converted.erase(found);
+            encoders.nextWrite++;
+        }
+        encoders.video << "FRAME\n";
+        encoders.video.write((const char*)next.data(), next.size());
+        // a failed write (disk full...) leaves the stream failed, every later frame counts as failed too
+        const bool isWritten = static_cast<bool>(encoders.video);
+        std::lock_guard<std::mutex> lock(encoders.mutex);
+        if (isWritten)
+        {
+            encoders.encodedFrames++;
+            encoders.bytesWritten += 6 + next.size();
+        }
+        else
+            encoders.failedFrames++;
+    }
+}
+
+static void EncoderLoop(FrameCapture* capture)
+{
+    ProfilerSetThreadName("Capture");
+    CaptureEncoders& encoders = *capture->encoders;
+    while (true)
+    {
+        CaptureJob job;
+        {
+            std::unique_lock<std::mutex> lock(encoders.mutex);
+            encoders.wake.wait(lock, [&] { return encoders.isStopping || !encoders.jobs.empty(); });
+            // stop only once the queue is drained
+            if (encoders.jobs.empty())
+                return;
+            job = std::move(encoders.jobs.front());
+            encoders.jobs.pop_front();
+        }
+
+        auto start = CaptureClock::now();
+        size_t bytes = 0;
+        bool ok = true;
+        if (capture->format == CAPTURE_PNG)
+        {
+            PROFILE_ZONE("EncodePng");
+            Image rgb = ToRgb(job.image);
+            FlipRows(rgb);
+            std::vector<unsigned char> png = EncodePng(rgb);
+            char name[32];
+            snprintf(name, sizeof(name), "/frame_%06llu.png", (unsigned long long)job.index);
+            std::ofstream file(capture->path + name, std::ios::binary);
+            ok = file && file.write((const char*)png.data(), png.size());
+            bytes = png.size();
+        }
+        else
+        {
+            PROFILE_ZONE("EncodeY4m");
+            std::vector<unsigned char> frame = ConvertToI420(job.image);
+            WriteVideoFrame(encoders, job.index, frame);
+        }
+        const double ms = std::chrono::duration<double, std::milli>(CaptureClock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(encoders.mutex);
+        encoders.encodeMs += ms;
+        if (capture->format != CAPTURE_PNG)
+            continue;
+        encoders.bytesWritten += ok ? bytes : 0;
+        if (ok)
+            encoders.encodedFrames++;
+        else
+            encoders.failedFrames++;
+    }
+}
+
+bool StartFrameCapture(FrameCapture& capture, const CaptureSettings& settings)
+{
+    capture.isActive = false;
+    capture.format = IsVideoPath(settings.path) ? CAPTURE_Y4M : CAPTURE_PNG;
+    capture.path = settings.path;
+    capture.fps = settings.fps;
+    capture.encoders = new CaptureEncoders;
+    CaptureEncoders& encoders = *capture.encoders;
+    if (capture.format == CAPTURE_Y4M)
+    {
+        encoders.video.open(settings.path, std::ios::binary | std::ios::trunc);
+        if (!encoders.video)
+        {
+            std::cerr << "Failed to open capture video " << settings.path << std::endl;
+            delete capture.encoders;
+            capture.encoders = nullptr;
+            return false;
+        }
+    }
+    else
+    {
+#ifdef _WIN32
+        const int result = _mkdir(settings.path.c_str());
+#else
+        const int result = mkdir(settings.path.c_str(), 0755);
+#endif
+        // an existing directory is reused, frames are overwritten
+        if (result != 0 && errno != EEXIST)
+        {
+            std::cerr << "Failed to create capture directory " << settings.path << std::endl;
+            delete capture.encoders;
+            capture.encoders = nullptr;
+            return false;
+        }
+    }
+
+    for (unsigned int i = 0; i < CAPTURE_PBO_COUNT; i++)
+    {
+        // storage follows the window size on first use
+        ReadbackBuffer& readback = capture.readbacks[i];
+        glGenBuffers(1, &readback.buffer);
+        readback.capacity = 0;
+        readback.fence = nullptr;
+        readback.width = 0;
+        readback.height = 0;
+        readback.frame = 0;
+        readback.isPending = false;
+    }
+    capture.next = 0;
+    capture.frame = 0;
+    capture.submitted = 0;
+    capture.videoWidth = 0;
+    capture.videoHeight = 0;
+    capture.droppedReadback = 0;
+    capture.droppedQueue = 0;
+    capture.droppedSize = 0;
+    capture.renderThreadMs = 0.0;
+    capture.maxRenderThreadMs = 0.0;
+
+    encoders.isStopping = false;
+    encoders.nextWrite = 0;
+    encoders.isWriting = false;
+    encoders.encodedFrames = 0;
+    encoders.failedFrames = 0;
+    encoders.bytesWritten = 0;
+    encoders.encodeMs = 0.0;
+    unsigned int threads = settings.threads != 0 ? settings.threads : std::max(1u, std::thread::hardware_concurrency() / 2);
+    for (unsigned int i = 0; i < threads; i++)
+        encoders.threads.push_back(std::thread(EncoderLoop, &capture));
+
+    capture.start = CaptureClock::now();
+    capture.isActive = true;
+    return true;
+}
+
+// maps a finished readback and queues a copy of it, waits for the fence only when flushing
+static void SubmitReadback(FrameCapture& capture, ReadbackBuffer& readback, bool isFlushing)
+{
+    CaptureEncoders& encoders = *capture.encoders;
+    if (isFlushing)
+        glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+    readback.isPending = false;
+
+    if (capture.format == CAPTURE_Y4M)
+    {
+        if (capture.videoWidth == 0)
+        {
+            // no frame is queued yet, writers have not touched the file
+            capture.videoWidth = readback.width;
+            capture.videoHeight = readback.height;
+            encoders.video << "YUV4MPEG2 W" << readback.width << " H" << readback.height << " F" << capture.fps
+                           << ":1 Ip A1:1 C420jpeg\n";
+        }
+        else if (readback.width != capture.videoWidth || readback.height != capture.videoHeight)
+        {
+            capture.droppedSize++;
+            return;
+        }
+    }
+    {
+        // only this thread adds jobs, the queue can only shrink until the copy is pushed
+        std::lock_guard<std::mutex> lock(encoders.mutex);
+        if (!isFlushing && encoders.jobs.size() >= CAPTURE_MAX_QUEUED)
+        {
+            capture.droppedQueue++;
+            return;
+        }
+    }
+
+    CaptureJob job;
+    job.index = capture.submitted;
+    job.image.width = readback.width;
+    job.image.height = readback.height;
+    job.image.channels = 4;
+    const size_t size = (size_t)readback.width * readback.height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    const unsigned char* mapped = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (mapped)
+    {
+        job.image.pixels.assign(mapped, mapped + size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!mapped)
+    {
+        capture.droppedReadback++;
+        return;
+    }
+
+    capture.submitted++;
+    {
+        std::lock_guard<std::mutex> lock(encoders.mutex);
+        encoders.jobs.push_back(std::move(job));
+    }
+    encoders.wake.notify_one();
+}
+
+// oldest first, stops at the first one not ready so frames reach the encoders in order
+static void SubmitReadbacks(FrameCapture& capture, bool isFlushing)
+{
+    for (unsigned int i = 0; i < CAPTURE_PBO_COUNT; i++)
+    {
+        ReadbackBuffer& readback = capture.readbacks[(capture.next + i) % CAPTURE_PBO_COUNT];
+        if (!readback.isPending)
+            continue;
+        if (!isFlushing)
+        {
+            if (capture.frame < readback.frame + CAPTURE_MAP_DELAY)
+                return;
+            GLint status = GL_UNSIGNALED;
+            glGetSynciv(readback.fence, GL_SYNC_STATUS, 1, nullptr, &status);
+            if (status != GL_SIGNALED)
+                return;
+        }
+        SubmitReadback(capture, readback, isFlushing);
+    }
+}
+
+void CaptureReadback(FrameCapture& capture, int width, int height)
+{
+    PROFILE_ZONE("CaptureReadback");
+    auto start = CaptureClock::now();
+    SubmitReadbacks(capture, false);
+
+    ReadbackBuffer& readback = capture.readbacks[capture.next];
+    if (readback.isPending || width <= 0 || height <= 0)
+        capture.droppedReadback++;
+    else
+    {
+        const size_t size = (size_t)width * height * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        if (size > readback.capacity)
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+            readback.capacity = size;
+        }
+        // RGBA rows are 4 byte aligned whatever GL_PACK_ALIGNMENT is
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glReadBuffer(GL_BACK);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        readback.width = width;
+        readback.height = height;
+        readback.frame = capture.frame;
+        readback.isPending = true;
+        capture.next = (capture.next + 1) % CAPTURE_PBO_COUNT;
+    }
+    capture.frame++;
+
+    const double ms = std::chrono::duration<double, std::milli>(CaptureClock::now() - start).count();
+    capture.renderThreadMs += ms;
+    capture.maxRenderThreadMs = std::max(capture.maxRenderThreadMs, ms);
+}
+
+void StopFrameCapture(FrameCapture& capture, std::ostream& out)
+{
+    if (!capture.isActive)
+        return;
+    capture.isActive = false;
+    CaptureEncoders& encoders = *capture.encoders;
+    SubmitReadbacks(capture, true);
+    {
+        std::lock_guard<std::mutex> lock(encoders.mutex);
+        encoders.isStopping = true;
+    }
+    encoders.wake.notify_all();
+    for (size_t i = 0; i < encoders.threads.size(); i++)
+        encoders.threads[i].join();
+    if (capture.format == CAPTURE_Y4M)
+    {
+        // last frames are still buffered, close flushes them
+        encoders.video.close();
+        if (!encoders.video)
+            std::cerr << "Failed to write capture video " << capture.path << std::endl;
+    }
+    for (unsigned int i = 0; i < CAPTURE_PBO_COUNT; i++)
+        glDeleteBuffers(1, &capture.readbacks[i].buffer);
+
+    const double seconds = std::chrono::duration<double>(CaptureClock::now() - capture.start).count();
+    const uint64_t dropped = capture.droppedReadback + capture.droppedQueue + capture.droppedSize;
+    out << std::fixed << std::setprecision(2) << "Frame capture: " << capture.path << ", "
+        << (capture.format == CAPTURE_Y4M ? "Y4M" : "PNG") << ", " << encoders.threads.size() << " encoder threads\n";
+    out << "  " << capture.frame << " frames, " << encoders.encodedFrames << " written, " << dropped << " dropped ("
+        << capture.droppedReadback << " readback busy, " << capture.droppedQueue << " encoders behind, "
+        << capture.droppedSize << " size changed)";
+    if (encoders.failedFrames > 0)
+        out << ", " << encoders.failedFrames << " failed to write";
+    out << "\n";
+    if (capture.frame > 0)
+        out << "  render thread " << capture.renderThreadMs / capture.frame << " ms per frame, max "
+            << capture.maxRenderThreadMs << " ms\n";
+    if (encoders.encodedFrames > 0 && seconds > 0.0)
+        out << "  encode " << encoders.encodeMs / encoders.encodedFrames << " ms per frame, "
+            << encoders.encodedFrames / seconds << " frames/s, "
+            << encoders.bytesWritten / (1024.0 * 1024.0) / seconds << " MB/s over " << seconds << " s\n";
+    out.flush();
+
+    delete capture.encoders;
+    capture.encoders = nullptr;
+}
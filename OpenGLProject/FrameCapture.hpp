@@ -0,0 +1,88 @@
+#ifndef FrameCapture_hpp
+#define FrameCapture_hpp
+#include <GL/glew.h>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Recording of presented frames for QA / offline review without stalling the render loop.
+// After the frame is drawn its back buffer is read into the next pixel buffer object of a
+// ring (glReadPixels into a PBO only queues the copy). A PBO is mapped CAPTURE_MAP_DELAY frames
+// later at the earliest and only once its fence is signaled, the pixels are copied out and
+// handed to encoder threads that write PNG files or a raw Y4M (4:2:0) video in parallel.
+// Nothing on the render thread waits: a frame that finds every PBO still busy, or the encoder
+// queue full, is dropped and counted instead.
+#define CAPTURE_PBO_COUNT 4
+#define CAPTURE_MAP_DELAY 2
+// frames waiting for an encoder, about 2 MB each at 800x600
+#define CAPTURE_MAX_QUEUED 32
+
+enum CaptureFormat
+{
+    CAPTURE_PNG = 0, // one file per frame, frame_000000.png ... in a directory
+    CAPTURE_Y4M      // one video file, frames written in order
+};
+
+struct CaptureSettings
+{
+    // *.y4m - video file, anything else - directory for PNG frames, empty = no capture
+    std::string path;
+    // frame rate in Y4M header
+    unsigned int fps;
+    // encoder threads, 0 = half the cores
+    unsigned int threads;
+};
+
+struct ReadbackBuffer
+{
+    unsigned int buffer;
+    size_t capacity;
+    GLsync fence;
+    int width;
+    int height;
+    // FrameCapture::frame it was issued in
+    uint64_t frame;
+    bool isPending;
+};
+
+// job queue and encoder threads, allocated by StartFrameCapture (like LightClusters::pool)
+struct CaptureEncoders;
+
+struct FrameCapture
+{
+    bool isActive;
+    int format;
+    std::string path;
+    unsigned int fps;
+    ReadbackBuffer readbacks[CAPTURE_PBO_COUNT];
+    // PBO the next readback goes into, the oldest pending one follows it
+    unsigned int next;
+    // frames offered to CaptureReadback
+    uint64_t frame;
+    // frames handed to encoders, their job index
+    uint64_t submitted;
+    // Y4M stream size, taken from the first frame
+    int videoWidth;
+    int videoHeight;
+    CaptureEncoders* encoders;
+
+    uint64_t droppedReadback; // every PBO still busy
+    uint64_t droppedQueue;    // encoders behind
+    uint64_t droppedSize;     // Y4M, window size changed
+    // readback + map + copy on the render thread
+    double renderThreadMs;
+    double maxRenderThreadMs;
+    std::chrono::steady_clock::time_point start;
+};
+
+CaptureSettings DefaultCaptureSettings();
+// opens output and starts encoder threads, capture stays inactive on failure
+bool StartFrameCapture(FrameCapture& capture, const CaptureSettings& settings);
+// After the frame is drawn to the window back buffer (before swap): hands finished readbacks
+// to the encoders and starts a readback of this frame.
+void CaptureReadback(FrameCapture& capture, int width, int height);
+// Waits for pending readbacks and every queued frame to be written, prints throughput
+void StopFrameCapture(FrameCapture& capture, std::ostream& out);
+
+#endif
@@ -0,0 +1,274 @@
+#include "FramePacing.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include "Benchmark.hpp"
+#include "Profiler.hpp"
+#include "GLTrace.hpp"
+
+// low latency wait ends this much earlier than the prediction asks for
+#define PACING_MARGIN 0.0005
+// shorter waits spin, glfwWaitEventsTimeout / OS timers overshoot by about a millisecond
+#define PACING_SPIN 0.002
+
+// key callback has no user data of its own, window user pointer is the renderer
+static FramePacer* keyPacer = nullptr;
+
+const char* VsyncModeName(int mode)
+{
+    static const char* names[VSYNC_COUNT] = { "driver", "off", "on", "adaptive" };
+    return names[mode];
+}
+
+bool ParseVsyncMode(const std::string& name, int& mode)
+{
+    for (int i = 0; i < VSYNC_COUNT; i++)
+        if (name == VsyncModeName(i))
+        {
+            mode = i;
+            return true;
+        }
+    return false;
+}
+
+PacingSettings DefaultPacingSettings()
+{
+    PacingSettings settings;
+    settings.vsync = VSYNC_DRIVER;
+    settings.fpsLimit = 0.0;
+    settings.isLowLatency = false;
+    return settings;
+}
+
+void ApplyVsync(GLFWwindow* /*window*/, int mode)
+{
+    if (mode == VSYNC_DRIVER)
+        return;
+    int interval = mode == VSYNC_ON ? 1 : 0;
+    if (mode == VSYNC_ADAPTIVE)
+    {
+        if (glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+            interval = -1;
+        else
+        {
+            std::cerr << "Adaptive vsync not supported (EXT_swap_control_tear), using vsync on" << std::endl;
+            interval = 1;
+        }
+    }
+    glfwSwapInterval(interval);
+}
+
+static void OnKey(GLFWwindow* /*window*/, int key, int /*scancode*/, int action, int /*mods*/)
+{
+    if (!keyPacer || key < 0 || key > GLFW_KEY_LAST || action == GLFW_REPEAT)
+        return;
+    if (action == GLFW_PRESS)
+    {
+        keyPacer->keys[key] = true;
+        keyPacer->pressed[key] = true;
+    }
+    else
+        keyPacer->keys[key] = false;
+    if (keyPacer->pendingInput < 0.0)
+        keyPacer->pendingInput = glfwGetTime();
+}
+
+void SetUpFramePacer(FramePacer& pacer, GLFWwindow* window, const PacingSettings& settings)
+{
+    pacer.settings = settings;
+    pacer.period = 0.0;
+    if (settings.fpsLimit > 0.0)
+        pacer.period = 1.0 / settings.fpsLimit;
+    else if (settings.isLowLatency && (settings.vsync == VSYNC_ON || settings.vsync == VSYNC_ADAPTIVE))
+    {
+        // low latency with vsync aims at the refresh, window monitor only in full screen
+        GLFWmonitor* monitor = glfwGetWindowMonitor(window);
+        if (!monitor)
+            monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+        pacer.period = 1.0 / (mode && mode->refreshRate > 0 ? mode->refreshRate : 60);
+    }
+    pacer.deadline = 0.0;
+    pacer.predictedFrame = 0.0;
+    std::fill(pacer.keys, pacer.keys + GLFW_KEY_LAST + 1, false);
+    std::fill(pacer.pressed, pacer.pressed + GLFW_KEY_LAST + 1, false);
+    std::fill(pacer.frameKeys, pacer.frameKeys + GLFW_KEY_LAST + 1, false);
+    pacer.pendingInput = -1.0;
+    pacer.frameInput = -1.0;
+    pacer.sampleTime = glfwGetTime();
+    pacer.lastWait = 0.0;
+    pacer.start = pacer.sampleTime;
+    pacer.frames.assign(PACING_HISTORY, FrameLatency());
+    pacer.frameCount = 0;
+    if (!settings.latencyLogPath.empty())
+    {
+        pacer.latencyLog.open(settings.latencyLogPath, std::ios::trunc);
+        if (!pacer.latencyLog)
+            std::cerr << "Failed to write latency log " << settings.latencyLogPath << std::endl;
+        else
+            pacer.latencyLog << "frame,input_ms,sample_ms,present_ms,input_to_present_ms,sample_to_present_ms,wait_ms\n";
+    }
+
+    keyPacer = &pacer;
+    glfwSetKeyCallback(window, OnKey);
+}
+
+static void WriteLatencyRow(FramePacer& pacer, const FrameLatency& frame)
+{
+    std::ofstream& out = pacer.latencyLog;
+    out << pacer.frameCount << ",";
+    if (frame.input >= 0.0)
+        out << (frame.input - pacer.start) * 1000.0;
+    out << "," << (frame.sample - pacer.start) * 1000.0 << "," << (frame.present - pacer.start) * 1000.0 << ",";
+    if (frame.input >= 0.0)
+        out << (frame.present - frame.input) * 1000.0;
+    out << "," << (frame.present - frame.sample) * 1000.0 << "," << frame.wait * 1000.0 << "\n";
+}
+
+void RecordPresent(FramePacer& pacer)
+{
+    if (pacer.settings.isLowLatency)
+    {
+        // nothing queued behind this frame, next one starts from an idle GPU
+        PROFILE_ZONE("DrainGPU");
+        glFinish();
+    }
+    double now = glfwGetTime();
+    FrameLatency frame;
+    frame.input = pacer.frameInput;
+    frame.sample = pacer.sampleTime;
+    frame.present = now;
+    frame.wait = pacer.lastWait;
+    if (pacer.latencyLog.is_open())
+        WriteLatencyRow(pacer, frame);
+    pacer.frames[pacer.frameCount % PACING_HISTORY] = frame;
+    pacer.frameCount++;
+    pacer.lastWait = 0.0;
+
+    // rises with a slow frame at once, falls back slowly
+    double sampleToPresent = now - pacer.sampleTime;
+    pacer.predictedFrame = std::max(sampleToPresent, pacer.predictedFrame * 0.9 + sampleToPresent * 0.1);
+    if (pacer.settings.isLowLatency && pacer.period > 0.0)
+    {
+        pacer.deadline += pacer.period;
+        if (pacer.deadline < now)
+            pacer.deadline = now + pacer.period;
+    }
+}
+
+void SampleInput(FramePacer& pacer)
+{
+    {
+        PROFILE_ZONE("PollEvents");
+        glfwPollEvents();
+    }
+    pacer.sampleTime = glfwGetTime();
+    for (int i = 0; i <= GLFW_KEY_LAST; i++)
+    {
+        pacer.frameKeys[i] = pacer.keys[i] || pacer.pressed[i];
+        pacer.pressed[i] = false;
+    }
+    pacer.frameInput = pacer.pendingInput;
+    pacer.pendingInput = -1.0;
+}
+
+void WaitForFrame(FramePacer& pacer, bool isBeforeSample)
+{
+    if (isBeforeSample != pacer.settings.isLowLatency || pacer.period <= 0.0)
+        return;
+
+    double start = glfwGetTime();
+    double target;
+    if (pacer.settings.isLowLatency)
+    {
+        // first frame has no deadline yet
+        if (pacer.deadline <= 0.0)
+            return;
+        target = pacer.deadline - std::min(pacer.predictedFrame + PACING_MARGIN, pacer.period);
+    }
+    else
+    {
+        // more than a frame behind (hitch, window drag) - start again from now instead of catching up
+        if (start > pacer.deadline + pacer.period)
+            pacer.deadline = start;
+        target = pacer.deadline;
+        pacer.deadline += pacer.period;
+    }
+
+    PROFILE_ZONE("FrameLimiter");
+    double now = start;
+    while (now < target)
+    {
+        // events that arrive while waiting are delivered (and stamped) right away
+        if (target - now > PACING_SPIN)
+            glfwWaitEventsTimeout(target - now - PACING_SPIN * 0.5);
+        else
+            std::this_thread::yield();
+        now = glfwGetTime();
+    }
+    pacer.lastWait += now - start;
+}
+
+bool IsKeyDown(const FramePacer& pacer, int key)
+{
+    return pacer.frameKeys[key];
+}
+
+void PrintFramePacing(const FramePacer& pacer, std::ostream& out)
+{
+    if (pacer.frameCount == 0)
+        return;
+    // oldest kept frame first
+    const uint64_t kept = std::min(pacer.frameCount, (uint64_t)PACING_HISTORY);
+    std::vector<double> input, sample, interval, wait;
+    for (uint64_t i = pacer.frameCount - kept; i < pacer.frameCount; i++)
+    {
+        const FrameLatency& frame = pacer.frames[i % PACING_HISTORY];
+        if (frame.input >= 0.0)
+            input.push_back((frame.present - frame.input) * 1000.0);
+        sample.push_back((frame.present - frame.sample) * 1000.0);
+        wait.push_back(frame.wait * 1000.0);
+        if (i > pacer.frameCount - kept)
+            interval.push_back((frame.present - pacer.frames[(i - 1) % PACING_HISTORY].present) * 1000.0);
+    }
+    auto print = [&](const char* name, std::vector<double>& samples)
+    {
+        FrameTimeStats stats = CalculateFrameTimeStats(samples);
+        out << "  " << name << " p50 " << stats.p50 << " p95 " << stats.p95 << " p99 " << stats.p99 << " max " << stats.max << " ms\n";
+    };
+
+    out << std::fixed << std::setprecision(2) << "Frame pacing: vsync " << VsyncModeName(pacer.settings.vsync) << ", limit ";
+    if (pacer.settings.fpsLimit > 0.0)
+        out << std::setprecision(0) << pacer.settings.fpsLimit << std::setprecision(2) << " fps";
+    else
+        out << "none";
+    out << (pacer.settings.isLowLatency ? ", low latency, " : ", ") << pacer.frameCount << " frames";
+    if (kept < pacer.frameCount)
+        out << " (percentiles of the last " << kept << ")";
+    out << "\n";
+    size_t inputFrames = input.size();
+    if (inputFrames > 0)
+    {
+        out << "  " << inputFrames << " frames reacted to key events\n";
+        print("input -> present  ", input);
+    }
+    print("sample -> present ", sample);
+    print("present interval  ", interval);
+    print("limiter wait      ", wait);
+    out.flush();
+}
+
+bool CloseLatencyLog(FramePacer& pacer)
+{
+    if (!pacer.latencyLog.is_open())
+        return true;
+    pacer.latencyLog.close();
+    if (!pacer.latencyLog)
+    {
+        std::cerr << "Failed to write latency log " << pacer.settings.latencyLogPath << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,107 @@
+#ifndef FramePacing_hpp
+#define FramePacing_hpp
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <ostream>
+
+// Frame pacing of the interactive loop: swap interval, frame limiter and input latency.
+// Keys come from GLFW key callback with glfwGetTime timestamps instead of glfwGetKey polling.
+// GLFW has no OS event times, an event is stamped when it is delivered - loop delivers events
+// while limiter waits (glfwWaitEventsTimeout) and once more before swap, so only events that
+// arrive during swap (vsync block) are stamped late.
+//
+// Loop order: frame (simulation, render, swap), then input sampling (glfwPollEvents + key
+// actions), limiter wait either after sampling (default, input waits with the frame) or
+// before it (--low-latency, wait ends predicted frame time before the present deadline).
+
+// frames kept for the exit summary, about a minute at 60 fps - the latency log gets every frame
+#define PACING_HISTORY 4096
+
+enum VsyncMode
+{
+    VSYNC_DRIVER = 0, // swap interval not set, driver / control panel default
+    VSYNC_OFF,
+    VSYNC_ON,
+    VSYNC_ADAPTIVE, // late frames tear instead of waiting a whole refresh (EXT_swap_control_tear)
+    VSYNC_COUNT
+};
+
+const char* VsyncModeName(int mode);
+bool ParseVsyncMode(const std::string& name, int& mode);
+
+struct PacingSettings
+{
+    int vsync;
+    // frames per second, 0 = no limit
+    double fpsLimit;
+    // wait before input sampling instead of after it, GPU is drained after every swap
+    bool isLowLatency;
+    // per frame CSV, rows written as frames are presented, empty = summary only
+    std::string latencyLogPath;
+};
+
+// one presented frame, glfwGetTime seconds
+struct FrameLatency
+{
+    // oldest key event the frame reacted to, < 0 - none
+    double input;
+    double sample;
+    double present;
+    // limiter wait that belongs to this frame
+    double wait;
+};
+
+struct FramePacer
+{
+    PacingSettings settings;
+    // seconds between frames (limit, or refresh rate for --low-latency with vsync), 0 = no pacing
+    double period;
+    // end of next limiter wait (default) / present the wait aims for (low latency)
+    double deadline;
+    // sample -> present of recent frames, low latency wait ends this long before deadline
+    double predictedFrame;
+
+    // callback side, state as delivered; pressed - went down since last sample (press + release in between counts)
+    bool keys[GLFW_KEY_LAST + 1];
+    bool pressed[GLFW_KEY_LAST + 1];
+    double pendingInput;
+    // sampled for current frame, what IsKeyDown answers
+    bool frameKeys[GLFW_KEY_LAST + 1];
+    double frameInput;
+    double sampleTime;
+    double lastWait;
+
+    // glfwGetTime when set up, before the first frame - latency log times count from it
+    double start;
+    // ring of the last PACING_HISTORY frames, next one goes to frameCount % PACING_HISTORY
+    std::vector<FrameLatency> frames;
+    uint64_t frameCount;
+    std::ofstream latencyLog;
+};
+
+PacingSettings DefaultPacingSettings();
+// Applies swap interval (context must be current), adaptive falls back to on when not supported.
+// Benchmark / regression runs take it too, limiter and latency mode are for the interactive loop.
+void ApplyVsync(GLFWwindow* window, int mode);
+// key callback of window (one pacer per process), opens latency log
+void SetUpFramePacer(FramePacer& pacer, GLFWwindow* window, const PacingSettings& settings);
+
+// after swap, drains GPU in low latency mode, records the frame (+ latency log row)
+void RecordPresent(FramePacer& pacer);
+// glfwPollEvents, key state for the frame
+void SampleInput(FramePacer& pacer);
+// Limiter, call after RecordPresent and again after SampleInput - waits only in the call that matches the mode
+void WaitForFrame(FramePacer& pacer, bool isBeforeSample);
+bool IsKeyDown(const FramePacer& pacer, int key);
+
+// input -> present, sample -> present, present interval and wait percentiles of the kept frames
+void PrintFramePacing(const FramePacer& pacer, std::ostream& out);
+// Flushes and closes latency log (one row per frame, milliseconds since SetUpFramePacer),
+// false when a write failed. Nothing to do without --latency-log.
+bool CloseLatencyLog(FramePacer& pacer);
+
+#endif
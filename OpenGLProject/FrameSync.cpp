@@ -0,0 +1,137 @@
+#include "FrameSync.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "Profiler.hpp"
+#include "Counters.hpp"
+#include "GLTrace.hpp"
+
+// glClientWaitSync timeout, waits again when it runs out (GPU reset / very slow frame)
+#define FRAME_SYNC_TIMEOUT_NS 100000000ull
+
+void SetUpFrameSync(FrameSync& sync, unsigned int framesInFlight)
+{
+    sync.framesInFlight = std::min(std::max(framesInFlight, 1u), (unsigned int)MAX_FRAMES_IN_FLIGHT);
+    sync.frame = 0;
+    for (unsigned int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        sync.fences[i] = nullptr;
+    sync.lastStallMs = 0.0;
+    sync.frames = 0;
+    sync.stalledFrames = 0;
+    sync.totalStallMs = 0.0;
+    sync.maxStallMs = 0.0;
+}
+
+void DestroyFrameSync(FrameSync& sync)
+{
+    for (unsigned int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        if (sync.fences[i])
+            glDeleteSync(sync.fences[i]);
+    SetUpFrameSync(sync, sync.framesInFlight);
+}
+
+void SetFramesInFlight(FrameSync& sync, unsigned int framesInFlight)
+{
+    // sets above the new count are not waited for any more, everything has to be idle
+    for (unsigned int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        if (sync.fences[i])
+            glClientWaitSync(sync.fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    DestroyFrameSync(sync);
+    SetUpFrameSync(sync, framesInFlight);
+}
+
+void BeginFrameSync(FrameSync& sync)
+{
+    sync.lastStallMs = 0.0;
+    GLsync fence = sync.fences[sync.frame];
+    if (!fence)
+        return;
+
+    GLint status = GL_UNSIGNALED;
+    glGetSynciv(fence, GL_SYNC_STATUS, 1, nullptr, &status);
+    if (status != GL_SIGNALED)
+    {
+        PROFILE_ZONE("FrameSyncWait");
+        auto start = std::chrono::steady_clock::now();
+        GLenum result;
+        do
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FRAME_SYNC_TIMEOUT_NS);
+        while (result == GL_TIMEOUT_EXPIRED);
+        sync.lastStallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        sync.stalledFrames++;
+        sync.totalStallMs += sync.lastStallMs;
+        sync.maxStallMs = std::max(sync.maxStallMs, sync.lastStallMs);
+        CountersAdd(COUNTER_FRAME_STALL_US, (uint64_t)(sync.lastStallMs * 1000.0));
+    }
+    glDeleteSync(fence);
+    sync.fences[sync.frame] = nullptr;
+}
+
+void EndFrameSync(FrameSync& sync)
+{
+    sync.fences[sync.frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    sync.frame = (sync.frame + 1) % sync.framesInFlight;
+    sync.frames++;
+}
+
+void SetUpStreamBuffer(StreamBuffer& stream, GLenum target, GLenum textureFormat, size_t size)
+{
+    stream.target = target;
+    stream.current = 0;
+    glGenBuffers(MAX_FRAMES_IN_FLIGHT, stream.buffers);
+    for (unsigned int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        glBindBuffer(target, stream.buffers[i]);
+        glBufferData(target, size, nullptr, GL_STREAM_DRAW);
+        stream.capacity[i] = size;
+        stream.textures[i] = 0;
+    }
+    glBindBuffer(target, 0);
+    if (textureFormat == 0)
+        return;
+
+    glGenTextures(MAX_FRAMES_IN_FLIGHT, stream.textures);
+    for (unsigned int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        glBindTexture(GL_TEXTURE_BUFFER, stream.textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, textureFormat, stream.buffers[i]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void DestroyStreamBuffer(StreamBuffer& stream)
+{
+    glDeleteBuffers(MAX_FRAMES_IN_FLIGHT, stream.buffers);
+    if (stream.textures[0] != 0)
+        glDeleteTextures(MAX_FRAMES_IN_FLIGHT, stream.textures);
+    for (unsigned int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        stream.buffers[i] = 0;
+        stream.textures[i] = 0;
+    }
+}
+
+void UploadStreamBuffer(StreamBuffer& stream, unsigned int frame, const void* data, size_t bytes)
+{
+    stream.current = frame;
+    glBindBuffer(stream.target, stream.buffers[frame]);
+    if (bytes > stream.capacity[frame])
+    {
+        // new storage, texture buffer view follows the buffer name
+        stream.capacity[frame] = bytes * 2;
+        glBufferData(stream.target, stream.capacity[frame], nullptr, GL_STREAM_DRAW);
+    }
+    if (bytes == 0)
+        return;
+
+    void* mapped = glMapBufferRange(stream.target, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (mapped)
+    {
+        memcpy(mapped, data, bytes);
+        // false - contents lost (display mode change), next frame writes them again anyway
+        glUnmapBuffer(stream.target);
+    }
+    else
+        glBufferSubData(stream.target, 0, bytes, data);
+    CountersAdd(COUNTER_BYTES_STREAMED, bytes);
+}
@@ -0,0 +1,67 @@
+#ifndef FrameSync_hpp
+#define FrameSync_hpp
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+
+// CPU / GPU pipelining. The CPU records up to framesInFlight frames the GPU has not finished:
+// every frame ends with a fence, and a frame waits for the fence of the frame framesInFlight
+// back before it writes anything that frame may still read.
+// Data streamed every frame (light clusters, visibility objects, overlay vertices) lives in a
+// StreamBuffer - one buffer per frame in flight, GL 3.3 texture buffers can not point into a
+// range of a bigger one. A set is written with an unsynchronized map, the fence wait already
+// made sure the GPU is done with it, so the driver neither orphans nor blocks.
+#define MAX_FRAMES_IN_FLIGHT 3
+// CPU records the next frame while the GPU runs this one
+#define DEFAULT_FRAMES_IN_FLIGHT 2
+
+struct FrameSync
+{
+    // 1 - CPU waits for the previous frame, no overlap
+    unsigned int framesInFlight;
+    // resource set of the frame being recorded, 0 .. framesInFlight - 1
+    unsigned int frame;
+    GLsync fences[MAX_FRAMES_IN_FLIGHT];
+
+    // BeginFrameSync waits, also in COUNTER_FRAME_STALL_US
+    double lastStallMs;
+    uint64_t frames;
+    uint64_t stalledFrames;
+    double totalStallMs;
+    double maxStallMs;
+};
+
+struct StreamBuffer
+{
+    GLenum target;
+    unsigned int buffers[MAX_FRAMES_IN_FLIGHT];
+    // texture buffer view of each buffer, 0 for other targets
+    unsigned int textures[MAX_FRAMES_IN_FLIGHT];
+    size_t capacity[MAX_FRAMES_IN_FLIGHT];
+    // set written by last upload, what draws bind
+    unsigned int current;
+};
+
+// framesInFlight is clamped to 1 .. MAX_FRAMES_IN_FLIGHT
+void SetUpFrameSync(FrameSync& sync, unsigned int framesInFlight);
+void DestroyFrameSync(FrameSync& sync);
+// waits for every frame in flight first, stats start again
+void SetFramesInFlight(FrameSync& sync, unsigned int framesInFlight);
+// Start of a frame, before anything is streamed. Fence of the frame that used this set is
+// polled first (query class call), glClientWaitSync only when the GPU is behind.
+void BeginFrameSync(FrameSync& sync);
+// after the last command of the frame, moves to the next set
+void EndFrameSync(FrameSync& sync);
+
+// textureFormat 0 - plain buffer (vertices), otherwise texture buffer view of that format
+void SetUpStreamBuffer(StreamBuffer& stream, GLenum target, GLenum textureFormat, size_t size);
+void DestroyStreamBuffer(StreamBuffer& stream);
+// copies data into the buffer of set frame (FrameSync::frame), grows it when too small; leaves it bound
+void UploadStreamBuffer(StreamBuffer& stream, unsigned int frame, const void* data, size_t bytes);
+
+inline unsigned int StreamTexture(const StreamBuffer& stream)
+{
+    return stream.textures[stream.current];
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include "GLCalls.hpp"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+uint64_t glCallCounts[GL_FUNCTION_COUNT];
+uint64_t glCallLastFrame[GL_FUNCTION_COUNT];
+uint64_t glCallClassLastFrame[GL_CALL_CLASS_COUNT];
+
+#define GL_FUNCTION_NAME(name, callClass, result, params, args) "gl" #name,
+static const char* functionNames[GL_FUNCTION_COUNT] = { GL_TRACED_FUNCTIONS(GL_FUNCTION_NAME) };
+#undef GL_FUNCTION_NAME
+
+#define GL_FUNCTION_CLASS(name, callClass, result, params, args) callClass,
+static const GLCallClass functionClasses[GL_FUNCTION_COUNT] = { GL_TRACED_FUNCTIONS(GL_FUNCTION_CLASS) };
+#undef GL_FUNCTION_CLASS
+
+const char* GLFunctionName(int function)
+{
+    return functionNames[function];
+}
+
+GLCallClass GLFunctionClass(int function)
+{
+    return functionClasses[function];
+}
+
+const char* GLCallClassName(int callClass)
+{
+    static const char* names[GL_CALL_CLASS_COUNT] = { "draw", "state", "uniform", "upload", "resource", "query", "sync", "other" };
+    return names[callClass];
+}
+
+void GLCallsEndFrame()
+{
+    memcpy(glCallLastFrame, glCallCounts, sizeof(glCallCounts));
+    memset(glCallCounts, 0, sizeof(glCallCounts));
+    memset(glCallClassLastFrame, 0, sizeof(glCallClassLastFrame));
+    for (int i = 0; i < GL_FUNCTION_COUNT; i++)
+        glCallClassLastFrame[functionClasses[i]] += glCallLastFrame[i];
+}
+
+GLCallBudget DefaultGLCallBudget()
+{
+    GLCallBudget budget;
+    budget.isSet = false;
+    for (int i = 0; i < GL_CALL_CLASS_COUNT; i++)
+        budget.limits[i] = -1;
+    return budget;
+}
+
+bool ParseGLCallBudget(const std::string& text, GLCallBudget& budget)
+{
+    std::istringstream stream(text);
+    std::string entry;
+    while (std::getline(stream, entry, ','))
+    {
+        size_t split = entry.find('=');
+        if (split == std::string::npos)
+            return false;
+        std::string name = entry.substr(0, split);
+        std::istringstream value(entry.substr(split + 1));
+        int64_t limit;
+        if (!(value >> limit) || !value.eof() || limit < 0)
+            return false;
+
+        int callClass = 0;
+        while (callClass < GL_CALL_CLASS_COUNT && name != GLCallClassName(callClass))
+            callClass++;
+        if (callClass == GL_CALL_CLASS_COUNT)
+            return false;
+        budget.limits[callClass] = limit;
+        budget.isSet = true;
+    }
+    return budget.isSet;
+}
+
+bool CheckGLCallBudget(const GLCallBudget& budget, unsigned int frame)
+{
+    bool fits = true;
+    for (int c = 0; c < GL_CALL_CLASS_COUNT; c++)
+    {
+        if (budget.limits[c] < 0 || (int64_t)glCallClassLastFrame[c] <= budget.limits[c])
+            continue;
+        fits = false;
+        std::cerr << "Frame " << frame << ": " << glCallClassLastFrame[c] << " " << GLCallClassName(c)
+            << " calls, budget " << budget.limits[c] << " (";
+        // name the offenders
+        bool first = true;
+        for (int f = 0; f < GL_FUNCTION_COUNT; f++)
+            if (functionClasses[f] == c && glCallLastFrame[f] > 0)
+            {
+                std::cerr << (first ? "" : ", ") << functionNames[f] << " x" << glCallLastFrame[f];
+                first = false;
+            }
+        std::cerr << ")" << std::endl;
+    }
+    return fits;
+}
@@ -0,0 +1,155 @@
+#ifndef GLCalls_hpp
+#define GLCalls_hpp
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+
+// Per frame GL call counts, filled by the wrappers in GLTrace.hpp.
+// Every traced function has a class, so steady state frames can be checked
+// against a budget (--budget, see Benchmark).
+
+enum GLCallClass
+{
+    GL_CALL_DRAW = 0,
+    GL_CALL_STATE,    // binds, enables, blend...
+    GL_CALL_UNIFORM,
+    GL_CALL_UPLOAD,   // buffer / texture data
+    GL_CALL_RESOURCE, // create, delete, object set up
+    GL_CALL_QUERY,    // timer queries, results are read only when available
+    GL_CALL_SYNC,     // anything that may wait for the driver / GPU (glGet*, glFinish...)
+    GL_CALL_OTHER,
+    GL_CALL_CLASS_COUNT
+};
+
+// X(name, class, return type, parameters, arguments)
+#define GL_TRACED_FUNCTIONS(X) \
+    X(DrawArrays, GL_CALL_DRAW, void, (GLenum mode, GLint first, GLsizei count), (mode, first, count)) \
+    X(DrawElements, GL_CALL_DRAW, void, (GLenum mode, GLsizei count, GLenum type, const void* indices), (mode, count, type, indices)) \
+    X(BlitFramebuffer, GL_CALL_DRAW, void, (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter), (srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter)) \
+    X(Clear, GL_CALL_OTHER, void, (GLbitfield mask), (mask)) \
+    X(ClearBufferuiv, GL_CALL_OTHER, void, (GLenum buffer, GLint drawbuffer, const GLuint* value), (buffer, drawbuffer, value)) \
+    X(UseProgram, GL_CALL_STATE, void, (GLuint program), (program)) \
+    X(BindVertexArray, GL_CALL_STATE, void, (GLuint array), (array)) \
+    X(BindBuffer, GL_CALL_STATE, void, (GLenum target, GLuint buffer), (target, buffer)) \
+    X(BindTexture, GL_CALL_STATE, void, (GLenum target, GLuint texture), (target, texture)) \
+    X(ActiveTexture, GL_CALL_STATE, void, (GLenum texture), (texture)) \
+    X(BindFramebuffer, GL_CALL_STATE, void, (GLenum target, GLuint framebuffer), (target, framebuffer)) \
+    X(BindRenderbuffer, GL_CALL_STATE, void, (GLenum target, GLuint renderbuffer), (target, renderbuffer)) \
+    X(Enable, GL_CALL_STATE, void, (GLenum cap), (cap)) \
+    X(Disable, GL_CALL_STATE, void, (GLenum cap), (cap)) \
+    X(BlendFunc, GL_CALL_STATE, void, (GLenum sfactor, GLenum dfactor), (sfactor, dfactor)) \
+    X(ColorMask, GL_CALL_STATE, void, (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha), (red, green, blue, alpha)) \
+    X(DepthFunc, GL_CALL_STATE, void, (GLenum func), (func)) \
+    X(DepthMask, GL_CALL_STATE, void, (GLboolean flag), (flag)) \
+    X(StencilFunc, GL_CALL_STATE, void, (GLenum func, GLint ref, GLuint mask), (func, ref, mask)) \
+    X(StencilOpSeparate, GL_CALL_STATE, void, (GLenum face, GLenum sfail, GLenum dpfail, GLenum dppass), (face, sfail, dpfail, dppass)) \
+    X(Scissor, GL_CALL_STATE, void, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height)) \
+    X(CullFace, GL_CALL_STATE, void, (GLenum mode), (mode)) \
+    X(PolygonOffset, GL_CALL_STATE, void, (GLfloat factor, GLfloat units), (factor, units)) \
+    X(PixelStorei, GL_CALL_STATE, void, (GLenum pname, GLint param), (pname, param)) \
+    X(DrawBuffers, GL_CALL_STATE, void, (GLsizei n, const GLenum* bufs), (n, bufs)) \
+    X(DrawBuffer, GL_CALL_STATE, void, (GLenum buf), (buf)) \
+    X(ReadBuffer, GL_CALL_STATE, void, (GLenum src), (src)) \
+    X(Viewport, GL_CALL_STATE, void, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height)) \
+    X(Uniform1i, GL_CALL_UNIFORM, void, (GLint location, GLint v0), (location, v0)) \
+    X(Uniform1f, GL_CALL_UNIFORM, void, (GLint location, GLfloat v0), (location, v0)) \
+    X(Uniform2f, GL_CALL_UNIFORM, void, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1)) \
+    X(Uniform3i, GL_CALL_UNIFORM, void, (GLint location, GLint v0, GLint v1, GLint v2), (location, v0, v1, v2)) \
+    X(Uniform1fv, GL_CALL_UNIFORM, void, (GLint location, GLsizei count, const GLfloat* value), (location, count, value)) \
+    X(Uniform1iv, GL_CALL_UNIFORM, void, (GLint location, GLsizei count, const GLint* value), (location, count, value)) \
+    X(Uniform3fv, GL_CALL_UNIFORM, void, (GLint location, GLsizei count, const GLfloat* value), (location, count, value)) \
+    X(Uniform4fv, GL_CALL_UNIFORM, void, (GLint location, GLsizei count, const GLfloat* value), (location, count, value)) \
+    X(UniformMatrix4fv, GL_CALL_UNIFORM, void, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value)) \
+    X(BufferData, GL_CALL_UPLOAD, void, (GLenum target, GLsizeiptr size, const void* data, GLenum usage), (target, size, data, usage)) \
+    X(BufferSubData, GL_CALL_UPLOAD, void, (GLenum target, GLintptr offset, GLsizeiptr size, const void* data), (target, offset, size, data)) \
+    X(MapBufferRange, GL_CALL_UPLOAD, void*, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), (target, offset, length, access)) \
+    X(UnmapBuffer, GL_CALL_UPLOAD, GLboolean, (GLenum target), (target)) \
+    X(TexImage2D, GL_CALL_UPLOAD, void, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels), (target, level, internalformat, width, height, border, format, type, pixels)) \
+    X(TexImage3D, GL_CALL_UPLOAD, void, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels), (target, level, internalformat, width, height, depth, border, format, type, pixels)) \
+    X(TexParameteri, GL_CALL_RESOURCE, void, (GLenum target, GLenum pname, GLint param), (target, pname, param)) \
+    X(TexBuffer, GL_CALL_RESOURCE, void, (GLenum target, GLenum internalformat, GLuint buffer), (target, internalformat, buffer)) \
+    X(GenBuffers, GL_CALL_RESOURCE, void, (GLsizei n, GLuint* buffers), (n, buffers)) \
+    X(GenVertexArrays, GL_CALL_RESOURCE, void, (GLsizei n, GLuint* arrays), (n, arrays)) \
+    X(GenTextures, GL_CALL_RESOURCE, void, (GLsizei n, GLuint* textures), (n, textures)) \
+    X(GenFramebuffers, GL_CALL_RESOURCE, void, (GLsizei n, GLuint* framebuffers), (n, framebuffers)) \
+    X(GenRenderbuffers, GL_CALL_RESOURCE, void, (GLsizei n, GLuint* renderbuffers), (n, renderbuffers)) \
+    X(GenQueries, GL_CALL_RESOURCE, void, (GLsizei n, GLuint* ids), (n, ids)) \
+    X(DeleteBuffers, GL_CALL_RESOURCE, void, (GLsizei n, const GLuint* buffers), (n, buffers)) \
+    X(DeleteVertexArrays, GL_CALL_RESOURCE, void, (GLsizei n, const GLuint* arrays), (n, arrays)) \
+    X(DeleteTextures, GL_CALL_RESOURCE, void, (GLsizei n, const GLuint* textures), (n, textures)) \
+    X(DeleteFramebuffers, GL_CALL_RESOURCE, void, (GLsizei n, const GLuint* framebuffers), (n, framebuffers)) \
+    X(DeleteRenderbuffers, GL_CALL_RESOURCE, void, (GLsizei n, const GLuint* renderbuffers), (n, renderbuffers)) \
+    X(DeleteQueries, GL_CALL_RESOURCE, void, (GLsizei n, const GLuint* ids), (n, ids)) \
+    X(DeleteSync, GL_CALL_RESOURCE, void, (GLsync sync), (sync)) \
+    X(DeleteProgram, GL_CALL_RESOURCE, void, (GLuint program), (program)) \
+    X(DeleteShader, GL_CALL_RESOURCE, void, (GLuint shader), (shader)) \
+    X(CreateShader, GL_CALL_RESOURCE, GLuint, (GLenum type), (type)) \
+    X(CreateProgram, GL_CALL_RESOURCE, GLuint, (), ()) \
+    X(ShaderSource, GL_CALL_RESOURCE, void, (GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length), (shader, count, string, length)) \
+    X(CompileShader, GL_CALL_RESOURCE, void, (GLuint shader), (shader)) \
+    X(AttachShader, GL_CALL_RESOURCE, void, (GLuint program, GLuint shader), (program, shader)) \
+    X(LinkProgram, GL_CALL_RESOURCE, void, (GLuint program), (program)) \
+    X(ProgramParameteri, GL_CALL_RESOURCE, void, (GLuint program, GLenum pname, GLint value), (program, pname, value)) \
+    X(ProgramBinary, GL_CALL_RESOURCE, void, (GLuint program, GLenum binaryFormat, const void* binary, GLsizei length), (program, binaryFormat, binary, length)) \
+    X(MaxShaderCompilerThreadsKHR, GL_CALL_OTHER, void, (GLuint count), (count)) \
+    X(MaxShaderCompilerThreadsARB, GL_CALL_OTHER, void, (GLuint count), (count)) \
+    X(VertexAttribPointer, GL_CALL_RESOURCE, void, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer), (index, size, type, normalized, stride, pointer)) \
+    X(EnableVertexAttribArray, GL_CALL_RESOURCE, void, (GLuint index), (index)) \
+    X(FramebufferTexture2D, GL_CALL_RESOURCE, void, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level), (target, attachment, textarget, texture, level)) \
+    X(FramebufferTextureLayer, GL_CALL_RESOURCE, void, (GLenum target, GLenum attachment, GLuint texture, GLint level, GLint layer), (target, attachment, texture, level, layer)) \
+    X(FramebufferRenderbuffer, GL_CALL_RESOURCE, void, (GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer), (target, attachment, renderbuffertarget, renderbuffer)) \
+    X(RenderbufferStorage, GL_CALL_RESOURCE, void, (GLenum target, GLenum internalformat, GLsizei width, GLsizei height), (target, internalformat, width, height)) \
+    X(BeginQuery, GL_CALL_QUERY, void, (GLenum target, GLuint id), (target, id)) \
+    X(EndQuery, GL_CALL_QUERY, void, (GLenum target), (target)) \
+    X(QueryCounter, GL_CALL_QUERY, void, (GLuint id, GLenum target), (id, target)) \
+    X(GetQueryObjectuiv, GL_CALL_QUERY, void, (GLuint id, GLenum pname, GLuint* params), (id, pname, params)) \
+    X(GetQueryObjectui64v, GL_CALL_QUERY, void, (GLuint id, GLenum pname, GLuint64* params), (id, pname, params)) \
+    X(FenceSync, GL_CALL_QUERY, GLsync, (GLenum condition, GLbitfield flags), (condition, flags)) \
+    X(GetSynciv, GL_CALL_QUERY, void, (GLsync sync, GLenum pname, GLsizei bufSize, GLsizei* length, GLint* values), (sync, pname, bufSize, length, values)) \
+    X(GetUniformLocation, GL_CALL_SYNC, GLint, (GLuint program, const GLchar* name), (program, name)) \
+    X(CheckFramebufferStatus, GL_CALL_SYNC, GLenum, (GLenum target), (target)) \
+    X(GetShaderiv, GL_CALL_SYNC, void, (GLuint shader, GLenum pname, GLint* params), (shader, pname, params)) \
+    X(GetShaderInfoLog, GL_CALL_SYNC, void, (GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog), (shader, bufSize, length, infoLog)) \
+    X(GetProgramiv, GL_CALL_SYNC, void, (GLuint program, GLenum pname, GLint* params), (program, pname, params)) \
+    X(GetProgramInfoLog, GL_CALL_SYNC, void, (GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog), (program, bufSize, length, infoLog)) \
+    X(GetProgramBinary, GL_CALL_SYNC, void, (GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary), (program, bufSize, length, binaryFormat, binary)) \
+    X(GetQueryiv, GL_CALL_SYNC, void, (GLenum target, GLenum pname, GLint* params), (target, pname, params)) \
+    X(GetIntegerv, GL_CALL_SYNC, void, (GLenum pname, GLint* data), (pname, data)) \
+    X(GetInteger64v, GL_CALL_SYNC, void, (GLenum pname, GLint64* data), (pname, data)) \
+    X(GetString, GL_CALL_SYNC, const GLubyte*, (GLenum name), (name)) \
+    X(GetError, GL_CALL_SYNC, GLenum, (), ()) \
+    X(ReadPixels, GL_CALL_SYNC, void, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels), (x, y, width, height, format, type, pixels)) \
+    X(Finish, GL_CALL_SYNC, void, (), ()) \
+    X(ClientWaitSync, GL_CALL_SYNC, GLenum, (GLsync sync, GLbitfield flags, GLuint64 timeout), (sync, flags, timeout))
+
+#define GL_FUNCTION_ENUM(name, callClass, result, params, args) GL_FUNCTION_##name,
+enum GLFunction
+{
+    GL_TRACED_FUNCTIONS(GL_FUNCTION_ENUM)
+    GL_FUNCTION_COUNT
+};
+#undef GL_FUNCTION_ENUM
+
+extern uint64_t glCallCounts[GL_FUNCTION_COUNT];          // current frame
+extern uint64_t glCallLastFrame[GL_FUNCTION_COUNT];       // last finished frame
+extern uint64_t glCallClassLastFrame[GL_CALL_CLASS_COUNT];
+
+const char* GLFunctionName(int function);
+GLCallClass GLFunctionClass(int function);
+const char* GLCallClassName(int callClass);
+void GLCallsEndFrame();
+
+// Per frame limits for call classes, -1 = no limit.
+// Text form: "draw=120,sync=0" (class names from GLCallClassName)
+struct GLCallBudget
+{
+    bool isSet;
+    int64_t limits[GL_CALL_CLASS_COUNT];
+};
+
+GLCallBudget DefaultGLCallBudget();
+bool ParseGLCallBudget(const std::string& text, GLCallBudget& budget);
+// true when last finished frame fits in budget, otherwise prints what went over
+bool CheckGLCallBudget(const GLCallBudget& budget, unsigned int frame);
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef GLTrace_hpp
+#define GLTrace_hpp
+#include <GL/glew.h>
+#include "GLCalls.hpp"
+
+// GL call interception.
+// Include as the last header of a .cpp - every GL function from GL_TRACED_FUNCTIONS
+// is redirected to a wrapper that counts the call before calling the real entry point.
+// Functions missing from the list are not counted, add them when they are used.
+// Not included in Benchmark.cpp on purpose, its glFinish calls are measurement, not rendering.
+// Defining GL_CALLS_DISABLED turns the redirection off.
+
+#ifndef GL_CALLS_DISABLED
+#define GL_TRACED_WRAPPER(name, callClass, result, params, args) \
+    inline result GLTraced##name params \
+    { \
+        glCallCounts[GL_FUNCTION_##name]++; \
+        return gl##name args; \
+    }
+GL_TRACED_FUNCTIONS(GL_TRACED_WRAPPER)
+#undef GL_TRACED_WRAPPER
+
+// real entry points are called by the wrappers above, everything below goes through them
+#undef glDrawArrays
+#define glDrawArrays GLTracedDrawArrays
+#undef glDrawElements
+#define glDrawElements GLTracedDrawElements
+#undef glBlitFramebuffer
+#define glBlitFramebuffer GLTracedBlitFramebuffer
+#undef glClear
+#define glClear GLTracedClear
+#undef glClearBufferuiv
+#define glClearBufferuiv GLTracedClearBufferuiv
+#undef glUseProgram
+#define glUseProgram GLTracedUseProgram
+#undef glBindVertexArray
+#define glBindVertexArray GLTracedBindVertexArray
+#undef glBindBuffer
+#define glBindBuffer GLTracedBindBuffer
+#undef glBindTexture
+#define glBindTexture GLTracedBindTexture
+#undef glActiveTexture
+#define glActiveTexture GLTracedActiveTexture
+#undef glBindFramebuffer
+#define glBindFramebuffer GLTracedBindFramebuffer
+#undef glBindRenderbuffer
+#define glBindRenderbuffer GLTracedBindRenderbuffer
+#undef glEnable
+#define glEnable GLTracedEnable
+#undef glDisable
+#define glDisable GLTracedDisable
+#undef glBlendFunc
+#define glBlendFunc GLTracedBlendFunc
+#undef glColorMask
+#define glColorMask GLTracedColorMask
+#undef glDepthFunc
+#define glDepthFunc GLTracedDepthFunc
+#undef glDepthMask
+#define glDepthMask GLTracedDepthMask
+#undef glStencilFunc
+#define glStencilFunc GLTracedStencilFunc
+#undef glStencilOpSeparate
+#define glStencilOpSeparate GLTracedStencilOpSeparate
+#undef glScissor
+#define glScissor GLTracedScissor
+#undef glCullFace
+#define glCullFace GLTracedCullFace
+#undef glPolygonOffset
+#define glPolygonOffset GLTracedPolygonOffset
+#undef glPixelStorei
+#define glPixelStorei GLTracedPixelStorei
+#undef glDrawBuffers
+#define glDrawBuffers GLTracedDrawBuffers
+#undef glDrawBuffer
+#define glDrawBuffer GLTracedDrawBuffer
+#undef glReadBuffer
+#define glReadBuffer GLTracedReadBuffer
+#undef glViewport
+#define glViewport GLTracedViewport
+#undef glUniform1i
+#define glUniform1i GLTracedUniform1i
+#undef glUniform1f
+#define glUniform1f GLTracedUniform1f
+#undef glUniform2f
+#define glUniform2f GLTracedUniform2f
+#undef glUniform3i
+#define glUniform3i GLTracedUniform3i
+#undef glUniform1fv
+#define glUniform1fv GLTracedUniform1fv
+#undef glUniform1iv
+#define glUniform1iv GLTracedUniform1iv
+#undef glUniform3fv
+#define glUniform3fv GLTracedUniform3fv
+#undef glUniform4fv
+#define glUniform4fv GLTracedUniform4fv
+#undef glUniformMatrix4fv
+#define glUniformMatrix4fv GLTracedUniformMatrix4fv
+#undef glBufferData
+#define glBufferData GLTracedBufferData
+#undef glBufferSubData
+#define glBufferSubData GLTracedBufferSubData
+#undef glMapBufferRange
+#define glMapBufferRange GLTracedMapBufferRange
+#undef glUnmapBuffer
+#define glUnmapBuffer GLTracedUnmapBuffer
+#undef glTexImage2D
+#define glTexImage2D GLTracedTexImage2D
+#undef glTexImage3D
+#define glTexImage3D GLTracedTexImage3D
+#undef glTexParameteri
+#define glTexParameteri GLTracedTexParameteri
+#undef glTexBuffer
+#define glTexBuffer GLTracedTexBuffer
+#undef glGenBuffers
+#define glGenBuffers GLTracedGenBuffers
+#undef glGenVertexArrays
+#define glGenVertexArrays GLTracedGenVertexArrays
+#undef glGenTextures
+#define glGenTextures GLTracedGenTextures
+#undef glGenFramebuffers
+#define glGenFramebuffers GLTracedGenFramebuffers
+#undef glGenRenderbuffers
+#define glGenRenderbuffers GLTracedGenRenderbuffers
+#undef glGenQueries
+#define glGenQueries GLTracedGenQueries
+#undef glDeleteBuffers
+#define glDeleteBuffers GLTracedDeleteBuffers
+#undef glDeleteVertexArrays
+#define glDeleteVertexArrays GLTracedDeleteVertexArrays
+#undef glDeleteTextures
+#define glDeleteTextures GLTracedDeleteTextures
+#undef glDeleteFramebuffers
+#define glDeleteFramebuffers GLTracedDeleteFramebuffers
+#undef glDeleteRenderbuffers
+#define glDeleteRenderbuffers GLTracedDeleteRenderbuffers
+#undef glDeleteQueries
+#define glDeleteQueries GLTracedDeleteQueries
+#undef glDeleteSync
+#define glDeleteSync GLTracedDeleteSync
+#undef glDeleteProgram
+#define glDeleteProgram GLTracedDeleteProgram
+#undef glDeleteShader
+#define glDeleteShader GLTracedDeleteShader
+#undef glCreateShader
+#define glCreateShader GLTracedCreateShader
+#undef glCreateProgram
+#define glCreateProgram GLTracedCreateProgram
+#undef glShaderSource
+#define glShaderSource GLTracedShaderSource
+#undef glCompileShader
+#define glCompileShader GLTracedCompileShader
+#undef glAttachShader
+#define glAttachShader GLTracedAttachShader
+#undef glLinkProgram
+#define glLinkProgram GLTracedLinkProgram
+#undef glProgramParameteri
+#define glProgramParameteri GLTracedProgramParameteri
+#undef glProgramBinary
+#define glProgramBinary GLTracedProgramBinary
+#undef glMaxShaderCompilerThreadsKHR
+#define glMaxShaderCompilerThreadsKHR GLTracedMaxShaderCompilerThreadsKHR
+#undef glMaxShaderCompilerThreadsARB
+#define glMaxShaderCompilerThreadsARB GLTracedMaxShaderCompilerThreadsARB
+#undef glVertexAttribPointer
+#define glVertexAttribPointer GLTracedVertexAttribPointer
+#undef glEnableVertexAttribArray
+#define glEnableVertexAttribArray GLTracedEnableVertexAttribArray
+#undef glFramebufferTexture2D
+#define glFramebufferTexture2D GLTracedFramebufferTexture2D
+#undef glFramebufferTextureLayer
+#define glFramebufferTextureLayer GLTracedFramebufferTextureLayer
+#undef glFramebufferRenderbuffer
+#define glFramebufferRenderbuffer GLTracedFramebufferRenderbuffer
+#undef glRenderbufferStorage
+#define glRenderbufferStorage GLTracedRenderbufferStorage
+#undef glBeginQuery
+#define glBeginQuery GLTracedBeginQuery
+#undef glEndQuery
+#define glEndQuery GLTracedEndQuery
+#undef glQueryCounter
+#define glQueryCounter GLTracedQueryCounter
+#undef glGetQueryObjectuiv
+#define glGetQueryObjectuiv GLTracedGetQueryObjectuiv
+#undef glGetQueryObjectui64v
+#define glGetQueryObjectui64v GLTracedGetQueryObjectui64v
+#undef glFenceSync
+#define glFenceSync GLTracedFenceSync
+#undef glGetSynciv
+#define glGetSynciv GLTracedGetSynciv
+#undef glGetUniformLocation
+#define glGetUniformLocation GLTracedGetUniformLocation
+#undef glCheckFramebufferStatus
+#define glCheckFramebufferStatus GLTracedCheckFramebufferStatus
+#undef glGetShaderiv
+#define glGetShaderiv GLTracedGetShaderiv
+#undef glGetShaderInfoLog
+#define glGetShaderInfoLog GLTracedGetShaderInfoLog
+#undef glGetProgramiv
+#define glGetProgramiv GLTracedGetProgramiv
+#undef glGetProgramInfoLog
+#define glGetProgramInfoLog GLTracedGetProgramInfoLog
+#undef glGetProgramBinary
+#define glGetProgramBinary GLTracedGetProgramBinary
+#undef glGetQueryiv
+#define glGetQueryiv GLTracedGetQueryiv
+#undef glGetIntegerv
+#define glGetIntegerv GLTracedGetIntegerv
+#undef glGetInteger64v
+#define glGetInteger64v GLTracedGetInteger64v
+#undef glGetString
+#define glGetString GLTracedGetString
+#undef glGetError
+#define glGetError GLTracedGetError
+#undef glReadPixels
+#define glReadPixels GLTracedReadPixels
+#undef glFinish
+#define glFinish GLTracedFinish
+#undef glClientWaitSync
+#define glClientWaitSync GLTracedClientWaitSync
+#endif
+
+#endif
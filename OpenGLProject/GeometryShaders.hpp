@@ -9,43 +9,139 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
-out vec3 FragPos;
 out vec3 Normal;
 
+// depthVS computes position the same way, GL_EQUAL after depth pre-pass relies on it
+invariant gl_Position;
+
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    // view space normal, view is a rotation + translation (lookAt) so mat3(view) is enough
+    Normal = mat3(view) * mat3(transpose(inverse(model))) * aNormal;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
 )";
 
 // Fragment shader for the geometry pass
 const char* geometryFS = R"(
 #version 330 core
-layout(location = 0) out vec3 gPosition;
-layout(location = 1) out vec3 gNormal;
-layout(location = 2) out vec3 gAlbedo;
+layout(location = 0) out vec4 gNormal;
+layout(location = 1) out vec4 gAlbedo;
 
-in vec3 FragPos;
 in vec3 Normal;
 
 uniform bool isFog;
 uniform bool isDayLight;
 uniform float fogDensity;
 uniform vec3 objColor;
+uniform int material;
+#ifdef PERMUTATION
+const bool isOctahedral = OCTAHEDRAL;
+#else
+uniform bool isOctahedral;
+#endif
+
+// unit vector -> square [-1, 1], keeps precision in 2 channels
+vec2 OctahedralEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0)
+        e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
+
+void main()
+{
+    vec3 normal = normalize(Normal);
+    if (isOctahedral)
+        gNormal = vec4(OctahedralEncode(normal) * 0.5 + 0.5, 0.0, 0.0);
+    else
+        gNormal = vec4(normal, 0.0);
+    // material id goes to alpha, up to 256 entries
+    gAlbedo = vec4(objColor, float(material) / 255.0);
+}
+)";
+
+// Forward+ vertex shader, fragment part is lightingCommonFS + clusterCommonFS + forwardMainFS
+const char* forwardVS = R"(
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+
+uniform mat4 model;
 uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 Normal;
+// view space, lighting works there like in the deferred passes
+out vec3 FragPos;
+
+// drawn with GL_EQUAL against depth pre-pass
+invariant gl_Position;
+
+void main()
+{
+    Normal = mat3(view) * mat3(transpose(inverse(model))) * aNormal;
+    FragPos = vec3(view * model * vec4(aPos, 1.0));
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
+)";
+
+// Visibility buffer - object index from objectId uniform, its model view matrix from objectData
+// (VISIBILITY_OBJECT_TEXELS texels per object, first 4 are the matrix columns)
+const char* visibilityVS = R"(
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+uniform samplerBuffer objectData;
+uniform int objectId;
+uniform mat4 projection;
+
+void main()
+{
+    int base = objectId * 8;
+    mat4 modelView = mat4(texelFetch(objectData, base), texelFetch(objectData, base + 1),
+        texelFetch(objectData, base + 2), texelFetch(objectData, base + 3));
+    gl_Position = projection * modelView * vec4(aPos, 1.0);
+}
+)";
 
+// (object + 1) << VISIBILITY_TRIANGLE_BITS | triangle, 0 stays "nothing drawn"
+const char* visibilityFS = R"(
+#version 330 core
+layout(location = 0) out uint visibilityId;
 
+uniform int objectId;
 
 void main()
 {
-    gPosition = FragPos;
-    gNormal = normalize(Normal);
-    gAlbedo = objColor;
+    visibilityId = (uint(objectId + 1) << 12u) | uint(gl_PrimitiveID);
+}
+)";
 
+// Depth pre-pass - position only, no color output
+const char* depthVS = R"(
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
 )";
 
+const char* depthFS = R"(
+#version 330 core
+void main()
+{
+}
+)";
 
 #endif
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "GpuTimer.hpp"
+#include <cstring>
+#include <iostream>
+#include "Profiler.hpp"
+#include "GLTrace.hpp"
+
+static const GLenum statisticTargets[GPU_STAT_COUNT] = {
+    GL_VERTICES_SUBMITTED_ARB, GL_PRIMITIVES_SUBMITTED_ARB, GL_FRAGMENT_SHADER_INVOCATIONS_ARB
+};
+
+const char* GpuPassName(int pass)
+{
+    static const char* names[GPU_PASS_COUNT] = { "GPU DepthPrepass", "GPU GeometryPass", "GPU FogVolume", "GPU Shadows", "GPU LightingPass" };
+    return names[pass];
+}
+
+const char* GpuPassShortName(int pass)
+{
+    static const char* names[GPU_PASS_COUNT] = { "depth_prepass", "geometry", "fog_volume", "shadows", "lighting" };
+    return names[pass];
+}
+
+static void CalibrateGpuClock(GpuTimer& timer)
+{
+    // one synchronous read at start up, maps GPU timestamps onto profiler timeline
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    timer.gpuToCpuOffset = ProfilerNow() - (int64_t)gpuNow;
+}
+
+bool InitGpuTimer(GpuTimer& timer)
+{
+    memset(&timer, 0, sizeof(timer));
+    GLint bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+    if (bits == 0)
+    {
+        std::cerr << "GL_TIMESTAMP queries not supported, GPU timing disabled" << std::endl;
+        return false;
+    }
+
+    timer.hasStatistics = GLEW_ARB_pipeline_statistics_query != 0;
+    glGenQueries(GPU_TIMER_FRAMES * GPU_PASS_COUNT * 2, &timer.timestamps[0][0][0]);
+    if (timer.hasStatistics)
+        glGenQueries(GPU_TIMER_FRAMES * GPU_PASS_COUNT * GPU_STAT_COUNT, &timer.statistics[0][0][0]);
+
+    CalibrateGpuClock(timer);
+    timer.track = ProfilerCreateTrack("GPU");
+    timer.isEnabled = true;
+    return true;
+}
+
+void DestroyGpuTimer(GpuTimer& timer)
+{
+    if (!timer.isEnabled)
+        return;
+    glDeleteQueries(GPU_TIMER_FRAMES * GPU_PASS_COUNT * 2, &timer.timestamps[0][0][0]);
+    if (timer.hasStatistics)
+        glDeleteQueries(GPU_TIMER_FRAMES * GPU_PASS_COUNT * GPU_STAT_COUNT, &timer.statistics[0][0][0]);
+    timer.isEnabled = false;
+}
+
+static bool IsSlotAvailable(GpuTimer& timer, unsigned int slot)
+{
+    // queries finish in order, checking the last one is enough
+    for (int pass = GPU_PASS_COUNT - 1; pass >= 0; pass--)
+    {
+        if (!timer.isPassIssued[slot][pass])
+            continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(timer.timestamps[slot][pass][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        return available != 0;
+    }
+    return true;
+}
+
+static void ReadSlot(GpuTimer& timer, unsigned int slot)
+{
+    GpuFrameTimings timings;
+    memset(&timings, 0, sizeof(timings));
+    timings.isValid = true;
+    timings.frame = timer.frameOfSlot[slot];
+
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++)
+    {
+        if (!timer.isPassIssued[slot][pass])
+            continue;
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(timer.timestamps[slot][pass][0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(timer.timestamps[slot][pass][1], GL_QUERY_RESULT, &end);
+        timings.isPassValid[pass] = true;
+        timings.passMs[pass] = (double)(end - start) / 1.0e6;
+        ProfilerRecordExternal(timer.track, GpuPassName(pass),
+            (int64_t)start + timer.gpuToCpuOffset, (int64_t)end + timer.gpuToCpuOffset);
+
+        if (timer.hasStatistics)
+            for (int stat = 0; stat < GPU_STAT_COUNT; stat++)
+            {
+                GLuint64 value = 0;
+                glGetQueryObjectui64v(timer.statistics[slot][pass][stat], GL_QUERY_RESULT, &value);
+                timings.statistics[pass][stat] = value;
+            }
+    }
+    timer.latest = timings;
+}
+
+void GpuTimerBeginFrame(GpuTimer& timer)
+{
+    if (!timer.isEnabled)
+        return;
+    unsigned int slot = timer.frame % GPU_TIMER_FRAMES;
+    if (timer.isPending[slot])
+    {
+        if (IsSlotAvailable(timer, slot))
+            ReadSlot(timer, slot);
+        else
+            timer.droppedFrames++; // GPU is more than GPU_TIMER_FRAMES behind, never wait for it
+        timer.isPending[slot] = false;
+    }
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++)
+        timer.isPassIssued[slot][pass] = false;
+    timer.frameOfSlot[slot] = timer.frame;
+}
+
+void GpuTimerBeginPass(GpuTimer& timer, int pass)
+{
+    if (!timer.isEnabled)
+        return;
+    unsigned int slot = timer.frame % GPU_TIMER_FRAMES;
+    glQueryCounter(timer.timestamps[slot][pass][0], GL_TIMESTAMP);
+    if (timer.hasStatistics)
+        for (int stat = 0; stat < GPU_STAT_COUNT; stat++)
+            glBeginQuery(statisticTargets[stat], timer.statistics[slot][pass][stat]);
+}
+
+void GpuTimerEndPass(GpuTimer& timer, int pass)
+{
+    if (!timer.isEnabled)
+        return;
+    unsigned int slot = timer.frame % GPU_TIMER_FRAMES;
+    if (timer.hasStatistics)
+        for (int stat = 0; stat < GPU_STAT_COUNT; stat++)
+            glEndQuery(statisticTargets[stat]);
+    glQueryCounter(timer.timestamps[slot][pass][1], GL_TIMESTAMP);
+    timer.isPassIssued[slot][pass] = true;
+}
+
+void GpuTimerEndFrame(GpuTimer& timer)
+{
+    if (!timer.isEnabled)
+        return;
+    timer.isPending[timer.frame % GPU_TIMER_FRAMES] = true;
+    timer.frame++;
+}
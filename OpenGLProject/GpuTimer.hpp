@@ -0,0 +1,71 @@
+#ifndef GpuTimer_hpp
+#define GpuTimer_hpp
+#include <GL/glew.h>
+#include <cstdint>
+
+// GPU pass timing with GL_TIMESTAMP queries and (when ARB_pipeline_statistics_query
+// is there) vertex / primitive / fragment counts per pass.
+// Queries live in a ring of GPU_TIMER_FRAMES frames and are read back only when
+// their slot comes around again, so reading them never waits for the GPU.
+// Finished passes are also written to the profiler as a "GPU" track.
+
+#define GPU_TIMER_FRAMES 4
+
+enum GpuPass
+{
+    GPU_PASS_DEPTH_PREPASS = 0, // only issued when pre-pass is on
+    GPU_PASS_GEOMETRY,
+    GPU_PASS_FOG_VOLUME,        // only issued with volumetric fog
+    GPU_PASS_SHADOWS,           // only issued with shadows on
+    GPU_PASS_LIGHTING,
+    GPU_PASS_COUNT
+};
+
+enum GpuStatistic
+{
+    GPU_STAT_VERTICES = 0,
+    GPU_STAT_PRIMITIVES,
+    GPU_STAT_FRAGMENTS,
+    GPU_STAT_COUNT
+};
+
+struct GpuFrameTimings
+{
+    bool isValid;
+    unsigned int frame;
+    bool isPassValid[GPU_PASS_COUNT];
+    double passMs[GPU_PASS_COUNT];
+    uint64_t statistics[GPU_PASS_COUNT][GPU_STAT_COUNT];
+};
+
+struct GpuTimer
+{
+    bool isEnabled;
+    bool hasStatistics;
+    GLuint timestamps[GPU_TIMER_FRAMES][GPU_PASS_COUNT][2];
+    GLuint statistics[GPU_TIMER_FRAMES][GPU_PASS_COUNT][GPU_STAT_COUNT];
+    bool isPassIssued[GPU_TIMER_FRAMES][GPU_PASS_COUNT];
+    bool isPending[GPU_TIMER_FRAMES];
+    unsigned int frameOfSlot[GPU_TIMER_FRAMES];
+    unsigned int frame;
+    // GPU timestamp -> ProfilerNow clock
+    int64_t gpuToCpuOffset;
+    uint32_t track;
+    unsigned int droppedFrames;
+    GpuFrameTimings latest;
+};
+
+const char* GpuPassName(int pass);
+// lower case name for reports, "geometry", ...
+const char* GpuPassShortName(int pass);
+
+bool InitGpuTimer(GpuTimer& timer);
+void DestroyGpuTimer(GpuTimer& timer);
+
+// Reads back results of the frame that used this slot GPU_TIMER_FRAMES frames ago
+void GpuTimerBeginFrame(GpuTimer& timer);
+void GpuTimerBeginPass(GpuTimer& timer, int pass);
+void GpuTimerEndPass(GpuTimer& timer, int pass);
+void GpuTimerEndFrame(GpuTimer& timer);
+
+#endif
@@ -0,0 +1,458 @@
+#include "ImageIO.hpp"
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+
+static const unsigned char pngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+static uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+{
+    static uint32_t table[256];
+    static bool hasTable = false;
+    if (!hasTable)
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        hasTable = true;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t Adler32(const unsigned char* data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+static void PutUint32(std::vector<unsigned char>& out, uint32_t value)
+{
+    out.push_back((unsigned char)(value >> 24));
+    out.push_back((unsigned char)(value >> 16));
+    out.push_back((unsigned char)(value >> 8));
+    out.push_back((unsigned char)value);
+}
+
+static uint32_t GetUint32(const unsigned char* data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+static void PutChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+{
+    PutUint32(out, (uint32_t)data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    PutUint32(out, Crc32(&out[start], out.size() - start));
+}
+
+std::vector<unsigned char> EncodePng(const Image& image)
+{
+    static const unsigned char colorTypes[5] = { 0, 0, 4, 2, 6 };
+    const size_t rowSize = (size_t)image.width * image.channels;
+
+    // filter type 0 (none) in front of every row
+    std::vector<unsigned char> raw;
+    raw.reserve((rowSize + 1) * image.height);
+    for (int y = 0; y < image.height; y++)
+    {
+        raw.push_back(0);
+        const unsigned char* row = &image.pixels[y * rowSize];
+        raw.insert(raw.end(), row, row + rowSize);
+    }
+
+    // zlib stream made of stored blocks
+    std::vector<unsigned char> zlib;
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    size_t offset = 0;
+    do
+    {
+        size_t size = std::min(raw.size() - offset, (size_t)65535);
+        bool isLast = offset + size == raw.size();
+        zlib.push_back(isLast ? 1 : 0);
+        zlib.push_back((unsigned char)size);
+        zlib.push_back((unsigned char)(size >> 8));
+        zlib.push_back((unsigned char)~size);
+        zlib.push_back((unsigned char)(~size >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+    } while (offset < raw.size());
+    PutUint32(zlib, Adler32(raw.data(), raw.size()));
+
+    std::vector<unsigned char> header;
+    PutUint32(header, image.width);
+    PutUint32(header, image.height);
+    header.push_back(8); // bit depth
+    header.push_back(colorTypes[image.channels]);
+    header.push_back(0); // compression
+    header.push_back(0); // filter
+    header.push_back(0); // no interlace
+
+    std::vector<unsigned char> png(pngSignature, pngSignature + 8);
+    PutChunk(png, "IHDR", header);
+    PutChunk(png, "IDAT", zlib);
+    PutChunk(png, "IEND", std::vector<unsigned char>());
+    return png;
+}
+
+bool WritePng(const std::string& path, const Image& image)
+{
+    if (image.channels < 1 || image.channels > 4 || image.pixels.size() != (size_t)image.width * image.height * image.channels)
+    {
+        std::cerr << "Invalid image for " << path << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> png = EncodePng(image);
+    std::ofstream file(path, std::ios::binary);
+    if (!file || !file.write((const char*)png.data(), png.size()))
+    {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Inflate (RFC 1951), small and slow, enough for golden images
+struct BitReader
+{
+    const unsigned char* data;
+    size_t size;
+    size_t position;
+    uint32_t bitBuffer;
+    int bitCount;
+    bool isOverrun;
+};
+
+static int GetBits(BitReader& reader, int count)
+{
+    uint32_t value = reader.bitBuffer;
+    while (reader.bitCount < count)
+    {
+        if (reader.position >= reader.size)
+        {
+            reader.isOverrun = true;
+            return 0;
+        }
+        value |= (uint32_t)reader.data[reader.position++] << reader.bitCount;
+        reader.bitCount += 8;
+    }
+    reader.bitBuffer = value >> count;
+    reader.bitCount -= count;
+    return (int)(value & ((1u << count) - 1));
+}
+
+struct Huffman
+{
+    short counts[16];   // codes of each length
+    short symbols[288]; // symbols ordered by code
+};
+
+static void BuildHuffman(Huffman& huffman, const short* lengths, int count)
+{
+    memset(huffman.counts, 0, sizeof(huffman.counts));
+    for (int i = 0; i < count; i++)
+        huffman.counts[lengths[i]]++;
+    huffman.counts[0] = 0;
+    short offsets[16];
+    offsets[1] = 0;
+    for (int length = 1; length < 15; length++)
+        offsets[length + 1] = offsets[length] + huffman.counts[length];
+    for (int i = 0; i < count; i++)
+        if (lengths[i] != 0)
+            huffman.symbols[offsets[lengths[i]]++] = (short)i;
+}
+
+static int DecodeSymbol(BitReader& reader, const Huffman& huffman)
+{
+    // canonical codes, read one bit at a time
+    int code = 0, first = 0, index = 0;
+    for (int length = 1; length < 16; length++)
+    {
+        code |= GetBits(reader, 1);
+        int count = huffman.counts[length];
+        if (code - count < first)
+            return huffman.symbols[index + (code - first)];
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+        if (reader.isOverrun)
+            return -1;
+    }
+    return -1;
+}
+
+static bool InflateCodes(BitReader& reader, std::vector<unsigned char>& out, const Huffman& lengthCodes, const Huffman& distanceCodes)
+{
+    static const short lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const short lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const short distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const short distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    for (;;)
+    {
+        int symbol = DecodeSymbol(reader, lengthCodes);
+        if (symbol < 0 || reader.isOverrun)
+            return false;
+        if (symbol < 256)
+            out.push_back((unsigned char)symbol);
+        else if (symbol == 256)
+            return true;
+        else
+        {
+            symbol -= 257;
+            if (symbol >= 29)
+                return false;
+            int length = lengthBase[symbol] + GetBits(reader, lengthExtra[symbol]);
+            int distanceSymbol = DecodeSymbol(reader, distanceCodes);
+            if (distanceSymbol < 0 || distanceSymbol >= 30)
+                return false;
+            size_t distance = distanceBase[distanceSymbol] + GetBits(reader, distanceExtra[distanceSymbol]);
+            if (distance > out.size())
+                return false;
+            size_t from = out.size() - distance;
+            for (int i = 0; i < length; i++)
+                out.push_back(out[from + i]);
+        }
+    }
+}
+
+static bool Inflate(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+{
+    BitReader reader = { data, size, 0, 0, 0, false };
+    int isLast;
+    do
+    {
+        isLast = GetBits(reader, 1);
+        int type = GetBits(reader, 2);
+        if (type == 0)
+        {
+            // stored block, starts at byte boundary
+            reader.bitBuffer = 0;
+            reader.bitCount = 0;
+            if (reader.position + 4 > size)
+                return false;
+            size_t length = reader.data[reader.position] | (reader.data[reader.position + 1] << 8);
+            reader.position += 4;
+            if (reader.position + length > size)
+                return false;
+            out.insert(out.end(), data + reader.position, data + reader.position + length);
+            reader.position += length;
+        }
+        else if (type == 1)
+        {
+            static Huffman fixedLengths, fixedDistances;
+            static bool hasFixed = false;
+            if (!hasFixed)
+            {
+                short lengths[288];
+                for (int i = 0; i < 288; i++)
+                    lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+                BuildHuffman(fixedLengths, lengths, 288);
+                for (int i = 0; i < 30; i++)
+                    lengths[i] = 5;
+                BuildHuffman(fixedDistances, lengths, 30);
+                hasFixed = true;
+            }
+            if (!InflateCodes(reader, out, fixedLengths, fixedDistances))
+                return false;
+        }
+        else if (type == 2)
+        {
+            static const int order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+            int lengthCount = GetBits(reader, 5) + 257;
+            int distanceCount = GetBits(reader, 5) + 1;
+            int codeCount = GetBits(reader, 4) + 4;
+            short lengths[320] = {};
+            for (int i = 0; i < codeCount; i++)
+                lengths[order[i]] = (short)GetBits(reader, 3);
+            Huffman codeLengths;
+            BuildHuffman(codeLengths, lengths, 19);
+
+            int index = 0;
+            while (index < lengthCount + distanceCount)
+            {
+                int symbol = DecodeSymbol(reader, codeLengths);
+                if (symbol < 0)
+                    return false;
+                if (symbol < 16)
+                {
+                    lengths[index++] = (short)symbol;
+                    continue;
+                }
+                short repeated = 0;
+                int repeat;
+                if (symbol == 16)
+                {
+                    if (index == 0)
+                        return false;
+                    repeated = lengths[index - 1];
+                    repeat = 3 + GetBits(reader, 2);
+                }
+                else if (symbol == 17)
+                    repeat = 3 + GetBits(reader, 3);
+                else
+                    repeat = 11 + GetBits(reader, 7);
+                if (index + repeat > lengthCount + distanceCount)
+                    return false;
+                while (repeat--)
+                    lengths[index++] = repeated;
+            }
+            Huffman lengthCodes, distanceCodes;
+            BuildHuffman(lengthCodes, lengths, lengthCount);
+            BuildHuffman(distanceCodes, lengths + lengthCount, distanceCount);
+            if (!InflateCodes(reader, out, lengthCodes, distanceCodes))
+                return false;
+        }
+        else
+            return false;
+        if (reader.isOverrun)
+            return false;
+    } while (!isLast);
+    return true;
+}
+
+static int Paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+}
+
+bool ReadPng(const std::string& path, Image& image)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> png((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (png.size() < 8 || memcmp(png.data(), pngSignature, 8) != 0)
+    {
+        std::cerr << path << " is not a PNG file" << std::endl;
+        return false;
+    }
+
+    std::vector<unsigned char> zlib;
+    int bitDepth = 0, colorType = 0, interlace = 0;
+    image.width = image.height = 0;
+    size_t offset = 8;
+    while (offset + 12 <= png.size())
+    {
+        uint32_t length = GetUint32(&png[offset]);
+        if (offset + 12 + length > png.size())
+            break;
+        const unsigned char* type = &png[offset + 4];
+        const unsigned char* data = &png[offset + 8];
+        if (memcmp(type, "IHDR", 4) == 0 && length >= 13)
+        {
+            image.width = (int)GetUint32(data);
+            image.height = (int)GetUint32(data + 4);
+            bitDepth = data[8];
+            colorType = data[9];
+            interlace = data[12];
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+            zlib.insert(zlib.end(), data, data + length);
+        else if (memcmp(type, "IEND", 4) == 0)
+            break;
+        offset += 12 + length;
+    }
+
+    switch (colorType)
+    {
+    case 0: image.channels = 1; break;
+    case 4: image.channels = 2; break;
+    case 2: image.channels = 3; break;
+    case 6: image.channels = 4; break;
+    default: image.channels = 0; break;
+    }
+    if (bitDepth != 8 || interlace != 0 || image.channels == 0 || image.width <= 0 || image.height <= 0)
+    {
+        std::cerr << path << ": only 8 bit, non interlaced gray / RGB / RGBA PNG files are supported" << std::endl;
+        return false;
+    }
+
+    std::vector<unsigned char> raw;
+    if (zlib.size() < 6 || (zlib[0] & 0x0F) != 8 || !Inflate(zlib.data() + 2, zlib.size() - 2, raw))
+    {
+        std::cerr << path << ": corrupted image data" << std::endl;
+        return false;
+    }
+    const size_t rowSize = (size_t)image.width * image.channels;
+    if (raw.size() < (rowSize + 1) * image.height)
+    {
+        std::cerr << path << ": image data too short" << std::endl;
+        return false;
+    }
+
+    // undo per row filters
+    const int bpp = image.channels;
+    image.pixels.assign(rowSize * image.height, 0);
+    for (int y = 0; y < image.height; y++)
+    {
+        int filter = raw[y * (rowSize + 1)];
+        const unsigned char* in = &raw[y * (rowSize + 1) + 1];
+        unsigned char* row = &image.pixels[y * rowSize];
+        const unsigned char* previous = y > 0 ? row - rowSize : nullptr;
+        for (size_t x = 0; x < rowSize; x++)
+        {
+            int a = x >= (size_t)bpp ? row[x - bpp] : 0;
+            int b = previous ? previous[x] : 0;
+            int c = previous && x >= (size_t)bpp ? previous[x - bpp] : 0;
+            int predictor = 0;
+            switch (filter)
+            {
+            case 1: predictor = a; break;
+            case 2: predictor = b; break;
+            case 3: predictor = (a + b) / 2; break;
+            case 4: predictor = Paeth(a, b, c); break;
+            default: break;
+            }
+            row[x] = (unsigned char)(in[x] + predictor);
+        }
+    }
+    return true;
+}
+
+void FlipRows(Image& image)
+{
+    const size_t rowSize = (size_t)image.width * image.channels;
+    for (int y = 0; y < image.height / 2; y++)
+        std::swap_ranges(image.pixels.begin() + y * rowSize, image.pixels.begin() + (y + 1) * rowSize,
+            image.pixels.begin() + (image.height - 1 - y) * rowSize);
+}
+
+Image ToRgb(const Image& image)
+{
+    if (image.channels == 3)
+        return image;
+    Image rgb;
+    rgb.width = image.width;
+    rgb.height = image.height;
+    rgb.channels = 3;
+    rgb.pixels.resize((size_t)image.width * image.height * 3);
+    for (size_t i = 0; i < (size_t)image.width * image.height; i++)
+        for (int c = 0; c < 3; c++)
+            rgb.pixels[i * 3 + c] = image.pixels[i * image.channels + (image.channels < 3 ? 0 : c)];
+    return rgb;
+}
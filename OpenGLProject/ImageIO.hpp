@@ -0,0 +1,28 @@
+#ifndef ImageIO_hpp
+#define ImageIO_hpp
+#include <string>
+#include <vector>
+
+// 8 bit images, rows stored top to bottom
+struct Image
+{
+    int width;
+    int height;
+    int channels; // 1 gray, 2 gray + alpha, 3 RGB, 4 RGBA
+    std::vector<unsigned char> pixels;
+};
+
+// PNG without external libraries.
+// Writer uses uncompressed (stored) deflate blocks - big files, but no encoder to maintain.
+// Reader handles any 8 bit non interlaced PNG (stored, fixed and dynamic Huffman blocks).
+bool WritePng(const std::string& path, const Image& image);
+bool ReadPng(const std::string& path, Image& image);
+// PNG bytes in memory, for writers that do file output themselves
+std::vector<unsigned char> EncodePng(const Image& image);
+
+// GL reads bottom row first
+void FlipRows(Image& image);
+// any channel count -> RGB (alpha dropped)
+Image ToRgb(const Image& image);
+
+#endif
@@ -0,0 +1,368 @@
+#include "LightClusters.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include "ShaderSetUp.hpp"
+#include "Profiler.hpp"
+#include "Counters.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LIGHT_CLUSTERS_SSE
+#endif
+
+#include "GLTrace.hpp"
+
+bool SetUpLightClusters(LightClusters& clusters, unsigned int threads)
+{
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    clusters.maxTexels = (unsigned int)std::max(maxTexels, 65536);
+
+    SetUpStreamBuffer(clusters.lightBuffer, GL_TEXTURE_BUFFER, GL_RGBA32F, 1024 * CLUSTER_LIGHT_TEXELS * sizeof(glm::vec4));
+    SetUpStreamBuffer(clusters.gridBuffer, GL_TEXTURE_BUFFER, GL_RG32UI, CLUSTER_COUNT * 2 * sizeof(unsigned int));
+    SetUpStreamBuffer(clusters.indexBuffer, GL_TEXTURE_BUFFER, GL_R32UI, 16 * 1024 * sizeof(unsigned int));
+
+    clusters.boundsProjection = glm::mat4(0.0f);
+    clusters.nearPlane = 0.0f;
+    clusters.farPlane = 0.0f;
+    clusters.bounds.resize(CLUSTER_COUNT);
+    clusters.rowBounds.resize(CLUSTER_TILES_Y * CLUSTER_SLICES);
+    clusters.clusterWorker.assign(CLUSTER_COUNT, 0);
+    clusters.clusterStart.assign(CLUSTER_COUNT, 0);
+    clusters.grid.assign(CLUSTER_COUNT * 2, 0);
+    clusters.maxClusterLights = 0;
+    clusters.isTruncated = false;
+
+    clusters.pool = new WorkerPool();
+    SetLightClusterThreads(clusters, threads);
+    return true;
+}
+
+void DestroyLightClusters(LightClusters& clusters)
+{
+    StopWorkerPool(*clusters.pool);
+    delete clusters.pool;
+    clusters.pool = nullptr;
+    DestroyStreamBuffer(clusters.lightBuffer);
+    DestroyStreamBuffer(clusters.gridBuffer);
+    DestroyStreamBuffer(clusters.indexBuffer);
+}
+
+void SetLightClusterThreads(LightClusters& clusters, unsigned int threads)
+{
+    StopWorkerPool(*clusters.pool);
+    StartWorkerPool(*clusters.pool, threads);
+    clusters.workers.resize(WorkerCount(*clusters.pool));
+}
+
+ClusterUniforms GetClusterUniforms(GLuint shaderProgram)
+{
+    ClusterUniforms uniforms;
+    uniforms.clusterDepth = glGetUniformLocation(shaderProgram, "clusterDepth");
+    uniforms.isClusterHeatmap = glGetUniformLocation(shaderProgram, "isClusterHeatmap");
+
+    glUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "lightData"), CLUSTER_LIGHT_UNIT);
+    glUniform1i(glGetUniformLocation(shaderProgram, "clusterGrid"), CLUSTER_GRID_UNIT);
+    glUniform1i(glGetUniformLocation(shaderProgram, "clusterIndices"), CLUSTER_INDEX_UNIT);
+    return uniforms;
+}
+
+static float SliceDepth(const LightClusters& clusters, int slice)
+{
+    // positive distance, slices grow exponentially so they look the same size in perspective
+    return clusters.nearPlane * powf(clusters.farPlane / clusters.nearPlane, (float)slice / CLUSTER_SLICES);
+}
+
+static void UpdateClusterBounds(LightClusters& clusters, const glm::mat4& projection)
+{
+    if (projection == clusters.boundsProjection)
+        return;
+    PROFILE_ZONE("ClusterBounds");
+    clusters.boundsProjection = projection;
+    // glm::perspective, depth -1..1
+    clusters.nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    clusters.farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+
+    for (int slice = 0; slice < CLUSTER_SLICES; slice++)
+    {
+        const float depths[2] = { SliceDepth(clusters, slice), SliceDepth(clusters, slice + 1) };
+        for (int tileY = 0; tileY < CLUSTER_TILES_Y; tileY++)
+            for (int tileX = 0; tileX < CLUSTER_TILES_X; tileX++)
+            {
+                ClusterBounds& bounds = clusters.bounds[tileX + CLUSTER_TILES_X * (tileY + CLUSTER_TILES_Y * slice)];
+                bounds.min = glm::vec3(1e30f);
+                bounds.max = glm::vec3(-1e30f);
+                for (int corner = 0; corner < 8; corner++)
+                {
+                    float ndcX = -1.0f + 2.0f * (tileX + (corner & 1)) / CLUSTER_TILES_X;
+                    float ndcY = -1.0f + 2.0f * (tileY + ((corner >> 1) & 1)) / CLUSTER_TILES_Y;
+                    float depth = depths[corner >> 2];
+                    glm::vec3 point(ndcX * depth / projection[0][0], ndcY * depth / projection[1][1], -depth);
+                    bounds.min = glm::min(bounds.min, point);
+                    bounds.max = glm::max(bounds.max, point);
+                }
+                bounds.center = (bounds.min + bounds.max) * 0.5f;
+                bounds.radius = glm::length(bounds.max - bounds.min) * 0.5f;
+            }
+        for (int tileY = 0; tileY < CLUSTER_TILES_Y; tileY++)
+        {
+            const int firstCluster = CLUSTER_TILES_X * (tileY + CLUSTER_TILES_Y * slice);
+            ClusterBounds& row = clusters.rowBounds[tileY + CLUSTER_TILES_Y * slice];
+            row = clusters.bounds[firstCluster];
+            for (int tileX = 1; tileX < CLUSTER_TILES_X; tileX++)
+            {
+                row.min = glm::min(row.min, clusters.bounds[firstCluster + tileX].min);
+                row.max = glm::max(row.max, clusters.bounds[firstCluster + tileX].max);
+            }
+        }
+    }
+}
+
+static void PrepareClusterLights(LightClusters& clusters, const Light* lights, unsigned int lightCount, const glm::mat4& view, float cutoff, const int* lightShadows)
+{
+    PROFILE_ZONE("ClusterLightsPrepare");
+    clusters.lights.clear();
+    clusters.lightData.clear();
+    clusters.isTruncated = false;
+    const unsigned int maxLights = clusters.maxTexels / CLUSTER_LIGHT_TEXELS;
+    const float spotTan = tanf(acosf(SPOT_LIGHT_CUT_OFF));
+    for (unsigned int i = 0; i < lightCount; i++)
+    {
+        const Light& light = lights[i];
+        if (light.type == 1)
+            continue;
+        float range = LightRange(light, cutoff);
+        if (range <= 0.0f)
+            continue;
+        if (clusters.lights.size() >= maxLights)
+        {
+            clusters.isTruncated = true;
+            break;
+        }
+
+        ClusterLight clusterLight;
+        clusterLight.apex = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        // same as LightingPassCube - direction goes through view * vec4(direction, 1.0)
+        glm::vec3 direction = glm::vec3(view * glm::vec4(light.direction, 1.0f));
+        clusterLight.isCone = light.type == 2;
+        clusterLight.range = range;
+        clusterLight.center = clusterLight.apex;
+        clusterLight.radius = range;
+        if (clusterLight.isCone)
+        {
+            clusterLight.axis = glm::normalize(direction);
+            clusterLight.center = clusterLight.apex + clusterLight.axis * (range * 0.5f);
+            clusterLight.radius = range * sqrtf(0.25f + spotTan * spotTan);
+        }
+        clusters.lights.push_back(clusterLight);
+        clusters.lightData.push_back(glm::vec4(clusterLight.apex, (float)light.type));
+        clusters.lightData.push_back(glm::vec4(light.color, 0.0f));
+        clusters.lightData.push_back(glm::vec4(direction, lightShadows ? (float)lightShadows[i] : 0.0f));
+    }
+}
+
+static bool ConeOverlapsSphere(const ClusterLight& light, const glm::vec3& center, float radius)
+{
+    glm::vec3 v = center - light.apex;
+    float lengthSq = glm::dot(v, v);
+    float along = glm::dot(v, light.axis);
+    // distance of sphere center from cone surface
+    float closest = SPOT_LIGHT_CUT_OFF * sqrtf(std::max(lengthSq - along * along, 0.0f)) - along * sqrtf(1.0f - SPOT_LIGHT_CUT_OFF * SPOT_LIGHT_CUT_OFF);
+    return closest <= radius && along <= radius + light.range && along >= -radius;
+}
+
+static void ClearCandidates(ClusterCandidates& candidates)
+{
+    candidates.x.clear();
+    candidates.y.clear();
+    candidates.z.clear();
+    candidates.radiusSq.clear();
+    candidates.lights.clear();
+}
+
+static void PushCandidate(ClusterCandidates& candidates, float x, float y, float z, float radiusSq, unsigned int light)
+{
+    candidates.x.push_back(x);
+    candidates.y.push_back(y);
+    candidates.z.push_back(z);
+    candidates.radiusSq.push_back(radiusSq);
+    candidates.lights.push_back(light);
+}
+
+static void PadCandidates(ClusterCandidates& candidates)
+{
+    // padding never overlaps anything
+    while (candidates.x.size() % 4 != 0)
+        PushCandidate(candidates, 0.0f, 0.0f, 0.0f, -1.0f, 0);
+}
+
+// bit i set when sphere first + i overlaps box
+static unsigned int SpheresOverlapBox4(const ClusterCandidates& candidates, unsigned int first, const ClusterBounds& bounds)
+{
+#ifdef LIGHT_CLUSTERS_SSE
+    const __m128 zero = _mm_setzero_ps();
+    __m128 x = _mm_loadu_ps(&candidates.x[first]);
+    __m128 y = _mm_loadu_ps(&candidates.y[first]);
+    __m128 z = _mm_loadu_ps(&candidates.z[first]);
+    // distance from box per axis, 0 inside
+    __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(bounds.min.x), x), zero), _mm_max_ps(_mm_sub_ps(x, _mm_set1_ps(bounds.max.x)), zero));
+    __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(bounds.min.y), y), zero), _mm_max_ps(_mm_sub_ps(y, _mm_set1_ps(bounds.max.y)), zero));
+    __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(bounds.min.z), z), zero), _mm_max_ps(_mm_sub_ps(z, _mm_set1_ps(bounds.max.z)), zero));
+    __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    return (unsigned int)_mm_movemask_ps(_mm_cmple_ps(distanceSq, _mm_loadu_ps(&candidates.radiusSq[first])));
+#else
+    unsigned int mask = 0;
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        glm::vec3 center(candidates.x[first + i], candidates.y[first + i], candidates.z[first + i]);
+        glm::vec3 d = glm::max(bounds.min - center, 0.0f) + glm::max(center - bounds.max, 0.0f);
+        if (glm::dot(d, d) <= candidates.radiusSq[first + i])
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+static void AssignSlice(LightClusters& clusters, unsigned int workerIndex, int slice)
+{
+    ClusterWorker& worker = clusters.workers[workerIndex];
+    ClusterCandidates& sliceLights = worker.slice;
+    ClusterCandidates& rowLights = worker.row;
+
+    // lights whose sphere reaches depth range of the slice
+    ClearCandidates(sliceLights);
+    const float sliceNear = SliceDepth(clusters, slice);
+    const float sliceFar = SliceDepth(clusters, slice + 1);
+    for (unsigned int i = 0; i < clusters.lights.size(); i++)
+    {
+        const ClusterLight& light = clusters.lights[i];
+        if (light.center.z - light.radius > -sliceNear || light.center.z + light.radius < -sliceFar)
+            continue;
+        PushCandidate(sliceLights, light.center.x, light.center.y, light.center.z, light.radius * light.radius, i);
+    }
+    PadCandidates(sliceLights);
+
+    for (int tileY = 0; tileY < CLUSTER_TILES_Y; tileY++)
+    {
+        ClearCandidates(rowLights);
+        const ClusterBounds& rowBounds = clusters.rowBounds[tileY + CLUSTER_TILES_Y * slice];
+        for (unsigned int first = 0; first < sliceLights.x.size(); first += 4)
+        {
+            unsigned int mask = SpheresOverlapBox4(sliceLights, first, rowBounds);
+            for (unsigned int i = first; mask != 0; i++, mask >>= 1)
+                if (mask & 1)
+                    PushCandidate(rowLights, sliceLights.x[i], sliceLights.y[i], sliceLights.z[i], sliceLights.radiusSq[i], sliceLights.lights[i]);
+        }
+        PadCandidates(rowLights);
+
+        const int firstCluster = CLUSTER_TILES_X * (tileY + CLUSTER_TILES_Y * slice);
+        for (int cluster = firstCluster; cluster < firstCluster + CLUSTER_TILES_X; cluster++)
+        {
+            const ClusterBounds& bounds = clusters.bounds[cluster];
+            clusters.clusterWorker[cluster] = workerIndex;
+            clusters.clusterStart[cluster] = (unsigned int)worker.indices.size();
+            for (unsigned int first = 0; first < rowLights.x.size(); first += 4)
+            {
+                unsigned int mask = SpheresOverlapBox4(rowLights, first, bounds);
+                for (unsigned int i = first; mask != 0; i++, mask >>= 1)
+                {
+                    if (!(mask & 1))
+                        continue;
+                    const ClusterLight& light = clusters.lights[rowLights.lights[i]];
+                    if (light.isCone && !ConeOverlapsSphere(light, bounds.center, bounds.radius))
+                        continue;
+                    worker.indices.push_back(rowLights.lights[i]);
+                }
+            }
+            clusters.grid[cluster * 2 + 1] = (unsigned int)worker.indices.size() - clusters.clusterStart[cluster];
+        }
+    }
+}
+
+void AssignLightClusters(LightClusters& clusters, const Light* lights, unsigned int lightCount, const glm::mat4& view, const glm::mat4& projection, float cutoff,
+    const int* lightShadows)
+{
+    PROFILE_ZONE("ClusterLights");
+    UpdateClusterBounds(clusters, projection);
+    PrepareClusterLights(clusters, lights, lightCount, view, cutoff, lightShadows);
+
+    for (size_t i = 0; i < clusters.workers.size(); i++)
+        clusters.workers[i].indices.clear();
+    // slices handed out one by one, near ones are usually fuller
+    std::atomic<int> nextSlice(0);
+    RunOnWorkers(*clusters.pool, [&](unsigned int worker)
+    {
+        PROFILE_ZONE("ClusterSlices");
+        for (int slice = nextSlice++; slice < CLUSTER_SLICES; slice = nextSlice++)
+            AssignSlice(clusters, worker, slice);
+    });
+
+    // merge in cluster order, result is the same for any thread count
+    clusters.indices.clear();
+    clusters.maxClusterLights = 0;
+    for (int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+    {
+        const std::vector<unsigned int>& source = clusters.workers[clusters.clusterWorker[cluster]].indices;
+        unsigned int count = clusters.grid[cluster * 2 + 1];
+        if (clusters.indices.size() + count > clusters.maxTexels)
+        {
+            count = clusters.maxTexels - (unsigned int)clusters.indices.size();
+            clusters.isTruncated = true;
+        }
+        clusters.grid[cluster * 2] = (unsigned int)clusters.indices.size();
+        clusters.grid[cluster * 2 + 1] = count;
+        clusters.indices.insert(clusters.indices.end(), source.begin() + clusters.clusterStart[cluster], source.begin() + clusters.clusterStart[cluster] + count);
+        clusters.maxClusterLights = std::max(clusters.maxClusterLights, count);
+    }
+    CountersAdd(COUNTER_CLUSTER_LIGHTS, clusters.indices.size());
+
+    static bool isTruncationReported = false;
+    if (clusters.isTruncated && !isTruncationReported)
+    {
+        std::cerr << "Light clusters: more lights than texture buffer can hold (" << clusters.maxTexels << " texels), rest is dropped" << std::endl;
+        isTruncationReported = true;
+    }
+}
+
+void UploadLightClusters(LightClusters& clusters, unsigned int frame)
+{
+    PROFILE_ZONE("ClusterUpload");
+    UploadStreamBuffer(clusters.lightBuffer, frame, clusters.lightData.data(), clusters.lightData.size() * sizeof(glm::vec4));
+    UploadStreamBuffer(clusters.gridBuffer, frame, clusters.grid.data(), clusters.grid.size() * sizeof(unsigned int));
+    UploadStreamBuffer(clusters.indexBuffer, frame, clusters.indices.data(), clusters.indices.size() * sizeof(unsigned int));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void BindLightClusters(const LightClusters& clusters, GLuint shaderProgram, const ClusterUniforms& uniforms, bool isHeatmap)
+{
+    glUseProgram(shaderProgram);
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_LIGHT_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, StreamTexture(clusters.lightBuffer));
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_GRID_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, StreamTexture(clusters.gridBuffer));
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_INDEX_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, StreamTexture(clusters.indexBuffer));
+
+    // slice = log(distance) * x - y, inverse of SliceDepth
+    const float logRatio = logf(clusters.farPlane / clusters.nearPlane);
+    glUniform2f(uniforms.clusterDepth, CLUSTER_SLICES / logRatio, CLUSTER_SLICES * logf(clusters.nearPlane) / logRatio);
+    glUniform1i(uniforms.isClusterHeatmap, isHeatmap);
+    CountersAdd(COUNTER_BYTES_STREAMED, 2 * sizeof(float) + sizeof(int));
+}
+
+uint64_t ClusterLightEvaluations(const LightClusters& clusters, int width, int height)
+{
+    const uint64_t tilePixels = (uint64_t)((width + CLUSTER_TILES_X - 1) / CLUSTER_TILES_X) * ((height + CLUSTER_TILES_Y - 1) / CLUSTER_TILES_Y);
+    uint64_t evaluations = 0;
+    for (int tile = 0; tile < CLUSTER_TILES_X * CLUSTER_TILES_Y; tile++)
+    {
+        unsigned int fullest = 0;
+        for (int slice = 0; slice < CLUSTER_SLICES; slice++)
+            fullest = std::max(fullest, clusters.grid[(tile + slice * CLUSTER_TILES_X * CLUSTER_TILES_Y) * 2 + 1]);
+        evaluations += fullest * tilePixels;
+    }
+    return evaluations;
+}
@@ -0,0 +1,126 @@
+#ifndef LightClusters_hpp
+#define LightClusters_hpp
+#include <GL/glew.h>
+#include <glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "Objects.hpp"
+#include "WorkerPool.hpp"
+#include "FrameSync.hpp"
+
+// Clustered light culling - view frustum is cut into screen tiles x logarithmic depth slices,
+// point / spot lights are assigned to clusters on CPU every frame and lighting shader
+// loops only over lights of the cluster its pixel falls into.
+// Grid size has to match clusterTiles in clusteredMainFS.
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+#define CLUSTER_COUNT (CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES)
+// lightData texels per light: view space position + type, color, direction
+#define CLUSTER_LIGHT_TEXELS 3
+// texture units of cluster buffers, g-buffer takes 0 - 2
+#define CLUSTER_LIGHT_UNIT 3
+#define CLUSTER_GRID_UNIT 4
+#define CLUSTER_INDEX_UNIT 5
+
+// One point / spot light of the frame, view space
+struct ClusterLight
+{
+    // bounding sphere
+    glm::vec3 center;
+    float radius;
+    bool isCone;
+    glm::vec3 apex;
+    glm::vec3 axis;
+    float range;
+};
+
+struct ClusterBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+    // sphere around the box, for spot cone test
+    glm::vec3 center;
+    float radius;
+};
+
+// bounding spheres as structure of arrays padded to 4 for SSE
+struct ClusterCandidates
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radiusSq;
+    // index into LightClusters::lights
+    std::vector<unsigned int> lights;
+};
+
+// scratch of one worker thread
+struct ClusterWorker
+{
+    // lights touching current depth slice, then current tile row of it
+    ClusterCandidates slice;
+    ClusterCandidates row;
+    // light lists of clusters this worker did, merged in cluster order afterwards
+    std::vector<unsigned int> indices;
+};
+
+struct LightClusters
+{
+    // texture buffers read by clusteredMainFS, a set per frame in flight
+    StreamBuffer lightBuffer;  // RGBA32F, CLUSTER_LIGHT_TEXELS per light
+    StreamBuffer gridBuffer;   // RG32UI, offset + count per cluster
+    StreamBuffer indexBuffer;  // R32UI, indices into lightData
+    // GL_MAX_TEXTURE_BUFFER_SIZE, lights / indices over it are dropped
+    unsigned int maxTexels;
+
+    // rebuilt only when projection changes
+    glm::mat4 boundsProjection;
+    float nearPlane;
+    float farPlane;
+    std::vector<ClusterBounds> bounds;
+    // union of a tile row of one slice, lights are culled per row before per cluster
+    std::vector<ClusterBounds> rowBounds;
+
+    std::vector<ClusterLight> lights;
+    std::vector<glm::vec4> lightData;
+    WorkerPool* pool;
+    std::vector<ClusterWorker> workers;
+    std::vector<unsigned int> clusterWorker;
+    std::vector<unsigned int> clusterStart;
+    // offset, count per cluster
+    std::vector<unsigned int> grid;
+    std::vector<unsigned int> indices;
+
+    // last AssignLightClusters
+    unsigned int maxClusterLights;
+    bool isTruncated;
+};
+
+struct ClusterUniforms
+{
+    GLint clusterDepth;
+    GLint isClusterHeatmap;
+};
+
+// threads = 0 -> hardware concurrency
+bool SetUpLightClusters(LightClusters& clusters, unsigned int threads);
+void DestroyLightClusters(LightClusters& clusters);
+void SetLightClusterThreads(LightClusters& clusters, unsigned int threads);
+// also binds cluster samplers to CLUSTER_*_UNIT
+ClusterUniforms GetClusterUniforms(GLuint shaderProgram);
+
+// CPU part - bounding spheres / cones of lights reaching cutoff, then every depth slice is
+// one job on worker pool, 4 lights per SSE sphere / box test. Directional lights are skipped.
+// lightShadows - shadow atlas slot + 1 per light (ShadowAtlas), nullptr when nothing is shadowed.
+void AssignLightClusters(LightClusters& clusters, const Light* lights, unsigned int lightCount, const glm::mat4& view, const glm::mat4& projection, float cutoff,
+    const int* lightShadows = nullptr);
+// frame - resource set of the frame (FrameSync::frame)
+void UploadLightClusters(LightClusters& clusters, unsigned int frame);
+// binds buffers and sets cluster uniforms of shaderProgram (program gets bound)
+void BindLightClusters(const LightClusters& clusters, GLuint shaderProgram, const ClusterUniforms& uniforms, bool isHeatmap);
+// light * pixel evaluations of lighting pass, upper bound (pixel is in one slice of its tile,
+// the fullest one is counted)
+uint64_t ClusterLightEvaluations(const LightClusters& clusters, int width, int height);
+
+#endif
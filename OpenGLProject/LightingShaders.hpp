@@ -14,12 +14,29 @@ void main()
 }
 )";
 
-// Fragment shader for the lighting pass
-const char* lightingFS = R"(
+// Forward+ background, full screen quad on the far plane - with GL_EQUAL it only covers pixels
+// the depth pre-pass left cleared
+const char* backgroundVS = R"(
 #version 330 core
-out vec4 FragColor;
+layout(location = 0) in vec2 aPos;
 
-in vec2 TexCoords;
+out vec2 TexCoords;
+
+void main()
+{
+    TexCoords = aPos * 0.5 + 0.5;
+    gl_Position = vec4(aPos, 1.0, 1.0);
+}
+)";
+
+// Shared part of lighting fragment shaders (full screen pass, light volumes, clusters, forward+),
+// main comes from lightingMainFS, lightVolumeMainFS, clusteredMainFS, forwardMainFS, backgroundMainFS
+// or fogVolumeMainFS.
+// ShaderCache puts #defines of a permutation (PERMUTATION, FOG ...) right after #version.
+const char* lightingCommonFS = R"(
+#version 330 core
+// fog volume pass writes a second target
+layout(location = 0) out vec4 FragColor;
 
 struct Light {
     vec3 position;
@@ -29,24 +46,59 @@ struct Light {
     // type 0 = point light
     // type 1 = directional light
     // type 2 = spot light
+    // shadow atlas slot + 1, first cascade for directional light, 0 = no shadow
+    int shadow;
 };
 
 
-uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedo;
+uniform sampler2D gDepth;
 
-uniform Light lights[6];
+uniform Light lights[16];
+uniform int lightCount;
 
 uniform vec3 lightPos;
 uniform vec3 lightColor;
 uniform vec3 viewPos;
-uniform float specPower;
+#ifdef PERMUTATION
+// compiled in by ShaderCache.cpp, branches on them are dropped by the compiler
+const bool isFog = FOG;
+const bool isDayLight = DAY_LIGHT;
+const bool isOctahedral = OCTAHEDRAL;
+const bool isVolumetricFog = VOLUMETRIC_FOG;
+#else
+#define SPECULAR_MODEL 0
 uniform bool isFog;
 uniform bool isDayLight;
+uniform bool isOctahedral;
+uniform bool isVolumetricFog;
+#endif
 uniform float fogDensity;
-uniform mat4 view;
-uniform bool isBlinn;
+// VolumetricFog.cpp, rgb scattered light and a transmittance from camera to the froxel
+uniform sampler3D fogVolume;
+// slice coordinate = log(distance) * x - y
+uniform vec2 fogVolumeDepth;
+uniform mat4 inverseProjection;
+uniform float materialSpecPower[8];
+uniform bool materialIsBlinn[8];
+// Shadow atlas (ShadowAtlas.hpp), SHADOW_SLOTS tiles. Matrices take view space position to
+// [0, 1] of the tile and light depth, tiles are atlas rectangles, texels world size of a texel
+// (at distance 1 for spot lights).
+uniform sampler2DShadow shadowAtlas;
+uniform mat4 shadowMatrices[16];
+uniform vec4 shadowTiles[16];
+uniform float shadowTexels[16];
+// view depth where each of SHADOW_CASCADES ends
+uniform vec3 cascadeEnds;
+
+// from material of current pixel, SPECULAR_MODEL 1 / 2 - every material in use is phong / blinn
+float specPower;
+#if SPECULAR_MODEL == 0
+bool isBlinn;
+#else
+const bool isBlinn = SPECULAR_MODEL == 2;
+#endif
 float CalculateDistance(vec3 lightPos, vec3 FragPos)
 {
 	return length(lightPos - FragPos);
@@ -78,6 +130,40 @@ vec3 CalculateSpecular(vec3 FragPos, vec3 Normal, Light light, vec3 lightDir)
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), specPower);
     return spec  * light.color;
 }
+// share of light that gets to position, 1 outside of the tile
+float ShadowTile(int slot, vec3 position)
+{
+    vec4 projected = shadowMatrices[slot] * vec4(position, 1.0);
+    vec3 coords = projected.xyz / projected.w;
+    if (any(lessThan(coords, vec3(0.0))) || any(greaterThan(coords, vec3(1.0))))
+        return 1.0;
+    // 4 bilinear compares half a texel apart (3x3 texels), never reading the next tile
+    vec4 tile = shadowTiles[slot];
+    vec2 texel = 1.0 / vec2(textureSize(shadowAtlas, 0));
+    vec2 center = tile.xy + coords.xy * tile.zw;
+    vec2 low = tile.xy + 0.5 * texel;
+    vec2 high = tile.xy + tile.zw - 0.5 * texel;
+    float lit = texture(shadowAtlas, vec3(clamp(center + vec2(-0.5, -0.5) * texel, low, high), coords.z));
+    lit += texture(shadowAtlas, vec3(clamp(center + vec2(0.5, -0.5) * texel, low, high), coords.z));
+    lit += texture(shadowAtlas, vec3(clamp(center + vec2(-0.5, 0.5) * texel, low, high), coords.z));
+    lit += texture(shadowAtlas, vec3(clamp(center + vec2(0.5, 0.5) * texel, low, high), coords.z));
+    return lit * 0.25;
+}
+// receiver is moved along its normal by about a texel, texels of spot maps grow with distance
+float SpotShadow(Light light, vec3 Normal, vec3 FragPos)
+{
+    int slot = light.shadow - 1;
+    float offset = 1.5 * shadowTexels[slot] * length(light.position - FragPos);
+    return ShadowTile(slot, FragPos + Normal * offset);
+}
+float DirectionalShadow(Light light, vec3 Normal, vec3 FragPos)
+{
+    float depth = -FragPos.z;
+    if (depth >= cascadeEnds.z)
+        return 1.0;
+    int slot = light.shadow - 1 + (depth < cascadeEnds.x ? 0 : depth < cascadeEnds.y ? 1 : 2);
+    return ShadowTile(slot, FragPos + Normal * 1.5 * shadowTexels[slot]);
+}
 vec3 CalculateAmbient(vec3 Albedo)
 {
     if (isDayLight)
@@ -105,6 +191,8 @@ vec3 CalculateAmbient(vec3 Albedo)
    
         vec3 specular = CalculateSpecular(FragPos, Normal, light, light.direction);
 
+        if (light.shadow > 0)
+            return (diffuse + specular) * DirectionalShadow(light, Normal, FragPos);
         return (diffuse + specular) ;
        
 	}
@@ -126,30 +214,107 @@ vec3 calculateSpotLight(Light light, vec3 Albedo, vec3 Normal, vec3 FragPos) {
         vec3 result = vec3(0.0);
 		if (theta > cutOff)
 			result = result + diffuse + specular;
+        // only lit fragments pay for the lookup
+        if (theta > cutOff && light.shadow > 0)
+            result = result * SpotShadow(light, Normal, FragPos);
 
         return result;
 	}
-vec3 calculateFog(vec3 objectColor,vec3 FragPos)
+vec4 SampleFogVolume(vec3 FragPos, vec2 texCoords)
 {
+    float slice = log(max(-FragPos.z, 1e-4)) * fogVolumeDepth.x - fogVolumeDepth.y;
+    return texture(fogVolume, vec3(texCoords, slice));
+}
+vec3 calculateFog(vec3 objectColor,vec3 FragPos, vec2 texCoords)
+{
+    if (isVolumetricFog)
+    {
+        vec4 fog = SampleFogVolume(FragPos, texCoords);
+        return fog.a * objectColor + fog.rgb;
+    }
     float fogDistance = length(FragPos);
 	float fogFactor = exp(- fogDensity  * fogDistance);
     vec3 fogColor = vec3(0.6, 0.6, 0.6);
     return fogFactor * objectColor + (1 - fogFactor) * fogColor;
 }
+// share of surface light that reaches the camera
+float FogTransmittance(vec3 FragPos, vec2 texCoords)
+{
+    if (isVolumetricFog)
+        return SampleFogVolume(FragPos, texCoords).a;
+    return exp(- fogDensity * length(FragPos));
+}
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+// Reduced resolution lighting (ReducedLighting.hpp) - step x, step y, checkerboard. Lighting
+// fragment at reduced texel t shades full resolution pixel ShadedPixel(t), upsampling reads it back.
+uniform ivec3 shadingGrid;
+uniform vec2 gbufferSize;
+ivec2 ShadedPixel(ivec2 texel)
+{
+    ivec2 pixel = shadingGrid.z != 0 ? ivec2(texel.x * 2 + (texel.y & 1), texel.y) : texel * shadingGrid.xy + shadingGrid.xy / 2;
+    return min(pixel, ivec2(gbufferSize) - 1);
+}
+vec2 ShadedTexCoords(vec2 texCoords)
+{
+    // full resolution (or never set)
+    if (shadingGrid.x <= 1 && shadingGrid.y <= 1 && shadingGrid.z == 0)
+        return texCoords;
+    return (vec2(ShadedPixel(ivec2(gl_FragCoord.xy))) + 0.5) / gbufferSize;
+}
+vec3 ReconstructPosition(vec2 texCoords)
+{
+    // view space position from depth buffer
+    float depth = texture(gDepth, texCoords).r;
+    vec4 position = inverseProjection * vec4(vec3(texCoords, depth) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
+void ReadGbuffer(vec2 texCoords, out vec3 FragPos, out vec3 Normal, out vec3 Albedo)
+{
+    FragPos = ReconstructPosition(texCoords);
+    Normal = texture(gNormal, texCoords).rgb;
+    if (isOctahedral)
+        Normal = OctahedralDecode(Normal.xy * 2.0 - 1.0);
+    vec4 AlbedoMaterial = texture(gAlbedo, texCoords);
+    Albedo = AlbedoMaterial.rgb;
+    int material = min(int(AlbedoMaterial.a * 255.0 + 0.5), 7);
+    specPower = materialSpecPower[material];
+#if SPECULAR_MODEL == 0
+    isBlinn = materialIsBlinn[material];
+#endif
+}
+)";
+
+// Full screen lighting pass - ambient, every light in lights[] and fog
+const char* lightingMainFS = R"(
+in vec2 TexCoords;
+
 void main()
 {
-    vec3 FragPos = texture(gPosition, TexCoords).rgb;
-    FragPos = vec3(view * vec4(FragPos, 1.0));
-    vec3 Normal = texture(gNormal, TexCoords).rgb;
-    Normal = mat3(transpose(inverse(view))) * Normal;
-    vec3 Albedo = texture(gAlbedo, TexCoords).rgb;
+    vec2 texCoords = ShadedTexCoords(TexCoords);
+    vec3 FragPos, Normal, Albedo;
+    ReadGbuffer(texCoords, FragPos, Normal, Albedo);
 
     // Ambient
     
     vec3 ambient = CalculateAmbient(Albedo);
 
-    vec3 lightsColors; 
-    for (int i = 0; i < 6; i++)
+    vec3 lightsColors = vec3(0.0);
+#ifdef PERMUTATION
+    // lights[] is sorted by type, constant loop counts and no type branch
+    for (int i = 0; i < POINT_LIGHTS; i++)
+        lightsColors = lightsColors + calculateLight(lights[i], Albedo, Normal, FragPos);
+    for (int i = POINT_LIGHTS; i < POINT_LIGHTS + SPOT_LIGHTS; i++)
+        lightsColors = lightsColors + calculateSpotLight(lights[i], Albedo, Normal, FragPos);
+    for (int i = POINT_LIGHTS + SPOT_LIGHTS; i < POINT_LIGHTS + SPOT_LIGHTS + DIRECTIONAL_LIGHTS; i++)
+        lightsColors = lightsColors + calculateDirectionalLight(lights[i], Albedo, Normal, FragPos);
+#else
+    for (int i = 0; i < lightCount; i++)
 	{
 		if (lights[i].type == 0)
 			lightsColors = lightsColors + calculateLight(lights[i], Albedo, Normal, FragPos);
@@ -158,11 +323,476 @@ void main()
 		else if (lights[i].type == 2)
 			lightsColors = lightsColors + calculateSpotLight(lights[i], Albedo, Normal, FragPos);
 	}
+#endif
     
 
     FragColor = vec4(ambient + lightsColors, 1.0);
 	if (isFog)
-		FragColor = vec4(calculateFog(FragColor.rgb, FragPos), 1.0);
+		FragColor = vec4(calculateFog(FragColor.rgb, FragPos, texCoords), 1.0);
+}
+)";
+
+// One point / spot light (lights[0]) drawn as sphere / cone, added on top of full screen pass.
+// Fog is linear in color, so transmittance * light here + fog(ambient + directional) there
+// sums up to the same result as the full screen pass.
+const char* lightVolumeMainFS = R"(
+uniform vec2 screenSize;
+
+void main()
+{
+    vec2 texCoords = gl_FragCoord.xy / screenSize;
+    vec3 FragPos, Normal, Albedo;
+    ReadGbuffer(texCoords, FragPos, Normal, Albedo);
+
+    vec3 color;
+    if (lights[0].type == 2)
+        color = calculateSpotLight(lights[0], Albedo, Normal, FragPos);
+    else
+        color = calculateLight(lights[0], Albedo, Normal, FragPos);
+	if (isFog)
+		color = FogTransmittance(FragPos, texCoords) * color;
+    FragColor = vec4(color, 1.0);
+}
+)";
+
+// Cluster lookup of clustered lighting and forward+ (LightClusters.cpp), goes between
+// lightingCommonFS and the main part
+const char* clusterCommonFS = R"(
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+// slice = log(distance) * x - y
+uniform vec2 clusterDepth;
+uniform bool isClusterHeatmap;
+
+// CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES
+const ivec3 clusterTiles = ivec3(16, 9, 24);
+
+Light FetchLight(int index)
+{
+    vec4 positionType = texelFetch(lightData, index * 3);
+    Light light;
+    light.position = positionType.xyz;
+    light.type = int(positionType.w);
+    light.color = texelFetch(lightData, index * 3 + 1).rgb;
+    vec4 directionShadow = texelFetch(lightData, index * 3 + 2);
+    light.direction = directionShadow.xyz;
+    light.shadow = int(directionShadow.w);
+    return light;
+}
+vec3 HeatmapColor(uint count)
+{
+    // blue -> green -> red at 16 lights, black for empty cluster
+    if (count == 0u)
+        return vec3(0.0);
+    float t = clamp(float(count) / 16.0, 0.0, 1.0);
+    return vec3(clamp(2.0 * t - 1.0, 0.0, 1.0), 1.0 - abs(2.0 * t - 1.0), clamp(1.0 - 2.0 * t, 0.0, 1.0));
+}
+// offset + count in clusterIndices of the cluster FragPos falls into, texCoords - [0, 1] on screen
+uvec2 ClusterRange(vec3 FragPos, vec2 texCoords)
+{
+    int slice = clamp(int(log(-FragPos.z) * clusterDepth.x - clusterDepth.y), 0, clusterTiles.z - 1);
+    ivec2 tile = min(ivec2(texCoords * vec2(clusterTiles.xy)), clusterTiles.xy - 1);
+    return texelFetch(clusterGrid, tile.x + clusterTiles.x * (tile.y + clusterTiles.y * slice)).rg;
+}
+vec3 ClusterLights(uvec2 range, vec3 Albedo, vec3 Normal, vec3 FragPos)
+{
+    vec3 color = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++)
+    {
+        Light light = FetchLight(int(texelFetch(clusterIndices, int(range.x + i)).r));
+#ifdef PERMUTATION
+        // SPOT_LIGHTS 0 - scene has none
+        if (SPOT_LIGHTS != 0 && light.type == 2)
+#else
+        if (light.type == 2)
+#endif
+            color = color + calculateSpotLight(light, Albedo, Normal, FragPos);
+        else
+            color = color + calculateLight(light, Albedo, Normal, FragPos);
+    }
+    return color;
+}
+vec3 DirectionalLights(vec3 Albedo, vec3 Normal, vec3 FragPos)
+{
+    vec3 color = vec3(0.0);
+#ifdef PERMUTATION
+    for (int i = 0; i < DIRECTIONAL_LIGHTS; i++)
+#else
+    if (isDayLight)
+        for (int i = 0; i < lightCount; i++)
+#endif
+            color = color + calculateDirectionalLight(lights[i], Albedo, Normal, FragPos);
+    return color;
+}
+)";
+
+// Clustered lighting - point / spot lights come from cluster of the pixel,
+// lights[] holds only directional ones (only with day light)
+const char* clusteredMainFS = R"(
+in vec2 TexCoords;
+
+void main()
+{
+    vec2 texCoords = ShadedTexCoords(TexCoords);
+    vec3 FragPos, Normal, Albedo;
+    ReadGbuffer(texCoords, FragPos, Normal, Albedo);
+
+    vec3 color = CalculateAmbient(Albedo) + DirectionalLights(Albedo, Normal, FragPos);
+    uvec2 range = ClusterRange(FragPos, texCoords);
+    color = color + ClusterLights(range, Albedo, Normal, FragPos);
+
+    FragColor = vec4(color, 1.0);
+	if (isFog)
+		FragColor = vec4(calculateFog(FragColor.rgb, FragPos, texCoords), 1.0);
+    if (isClusterHeatmap)
+        FragColor = vec4(mix(FragColor.rgb, HeatmapColor(range.y), 0.7), 1.0);
+}
+)";
+
+// Forward+ - objects are shaded as they are drawn (after depth pre-pass, GL_EQUAL so only
+// visible fragments run), same lights as clustered mode, material comes from uniforms
+// instead of the g-buffer
+const char* forwardMainFS = R"(
+in vec3 Normal;
+in vec3 FragPos;
+
+uniform vec3 objColor;
+uniform int material;
+uniform vec2 screenSize;
+
+void main()
+{
+    vec3 normal = normalize(Normal);
+    specPower = materialSpecPower[material];
+#if SPECULAR_MODEL == 0
+    isBlinn = materialIsBlinn[material];
+#endif
+    vec2 texCoords = gl_FragCoord.xy / screenSize;
+
+    vec3 color = CalculateAmbient(objColor) + DirectionalLights(objColor, normal, FragPos);
+    uvec2 range = ClusterRange(FragPos, texCoords);
+    color = color + ClusterLights(range, objColor, normal, FragPos);
+
+    FragColor = vec4(color, 1.0);
+	if (isFog)
+		FragColor = vec4(calculateFog(FragColor.rgb, FragPos, texCoords), 1.0);
+    if (isClusterHeatmap)
+        FragColor = vec4(mix(FragColor.rgb, HeatmapColor(range.y), 0.7), 1.0);
+}
+)";
+
+// Forward+ background - deferred modes run their full screen quad over empty g-buffer pixels too,
+// black albedo there leaves only the fog
+const char* backgroundMainFS = R"(
+in vec2 TexCoords;
+
+void main()
+{
+    // what ReconstructPosition gives for a cleared depth buffer
+    vec4 position = inverseProjection * vec4(TexCoords * 2.0 - 1.0, 1.0, 1.0);
+    vec3 FragPos = position.xyz / position.w;
+    FragColor = vec4(calculateFog(vec3(0.0), FragPos, TexCoords), 1.0);
+}
+)";
+
+// Visibility buffer resolve - attributes of the pixel come from the triangle in its id, then
+// shading is the clustered one. Texel layouts match VISIBILITY_TRIANGLE_TEXELS / VISIBILITY_OBJECT_TEXELS.
+const char* visibilityMainFS = R"(
+in vec2 TexCoords;
+
+uniform usampler2D visibilityIds;
+// per triangle: 3 positions, 3 normals, object space
+uniform samplerBuffer meshData;
+// per object: model view matrix, normal matrix, color + material
+uniform samplerBuffer objectData;
+uniform int firstSphere;
+uniform int sphereFirstTriangle;
+
+// VISIBILITY_TRIANGLE_BITS
+const uint triangleBits = 12u;
+
+void main()
+{
+    uint id = texelFetch(visibilityIds, ivec2(gl_FragCoord.xy), 0).r;
+    vec3 FragPos, Normal, Albedo;
+    int material = 0;
+    if (id == 0u)
+    {
+        // what a cleared g-buffer holds
+        FragPos = ReconstructPosition(TexCoords);
+        Normal = vec3(0.0);
+        Albedo = vec3(0.0);
+    }
+    else
+    {
+        int object = int(id >> triangleBits) - 1;
+        int triangle = int(id & ((1u << triangleBits) - 1u));
+        if (object >= firstSphere)
+            triangle += sphereFirstTriangle;
+        int base = object * 8;
+        mat4 modelView = mat4(texelFetch(objectData, base), texelFetch(objectData, base + 1),
+            texelFetch(objectData, base + 2), texelFetch(objectData, base + 3));
+        mat3 normalMatrix = mat3(texelFetch(objectData, base + 4).xyz, texelFetch(objectData, base + 5).xyz,
+            texelFetch(objectData, base + 6).xyz);
+        vec4 colorMaterial = texelFetch(objectData, base + 7);
+        Albedo = colorMaterial.rgb;
+        material = int(colorMaterial.a);
+
+        int vertex = triangle * 6;
+        vec3 p0 = vec3(modelView * texelFetch(meshData, vertex));
+        vec3 p1 = vec3(modelView * texelFetch(meshData, vertex + 1));
+        vec3 p2 = vec3(modelView * texelFetch(meshData, vertex + 2));
+        // ray from camera through pixel center against triangle plane (Moller - Trumbore),
+        // gives barycentrics and view space position without reading depth
+        vec4 farPoint = inverseProjection * vec4(TexCoords * 2.0 - 1.0, 1.0, 1.0);
+        vec3 ray = farPoint.xyz / farPoint.w;
+        vec3 edge1 = p1 - p0;
+        vec3 edge2 = p2 - p0;
+        vec3 p = cross(ray, edge2);
+        float inverseDet = 1.0 / dot(edge1, p);
+        vec3 s = -p0;
+        vec3 q = cross(s, edge1);
+        float u = dot(s, p) * inverseDet;
+        float v = dot(ray, q) * inverseDet;
+        FragPos = ray * (dot(edge2, q) * inverseDet);
+
+        vec3 normal = (1.0 - u - v) * texelFetch(meshData, vertex + 3).xyz + u * texelFetch(meshData, vertex + 4).xyz
+            + v * texelFetch(meshData, vertex + 5).xyz;
+        Normal = normalize(normalMatrix * normal);
+    }
+    specPower = materialSpecPower[material];
+#if SPECULAR_MODEL == 0
+    isBlinn = materialIsBlinn[material];
+#endif
+
+    vec3 color = CalculateAmbient(Albedo) + DirectionalLights(Albedo, Normal, FragPos);
+    uvec2 range = ClusterRange(FragPos, TexCoords);
+    color = color + ClusterLights(range, Albedo, Normal, FragPos);
+
+    FragColor = vec4(color, 1.0);
+	if (isFog)
+		FragColor = vec4(calculateFog(FragColor.rgb, FragPos, TexCoords), 1.0);
+    if (isClusterHeatmap)
+        FragColor = vec4(mix(FragColor.rgb, HeatmapColor(range.y), 0.7), 1.0);
+}
+)";
+
+// Reduced resolution lighting back to g-buffer size. Each pixel blends the lighting samples around
+// it (bilinear for half / quarter, 4 neighbours for checkerboard), weighted by how close depth,
+// normal and albedo of the pixel the sample shaded are to its own - samples from another surface
+// drop out, so edges stay sharp. Pixel shaded itself (checkerboard) is copied.
+const char* upsampleMainFS = R"(
+in vec2 TexCoords;
+
+// reduced resolution lighting output
+uniform sampler2D shadedColor;
+
+float LinearDepth(ivec2 pixel)
+{
+    // z / w of view space position does not depend on x, y - only two rows of inverseProjection
+    float depth = texelFetch(gDepth, pixel, 0).r * 2.0 - 1.0;
+    return -(inverseProjection[2].z * depth + inverseProjection[3].z) / (inverseProjection[2].w * depth + inverseProjection[3].w);
+}
+vec3 PixelNormal(ivec2 pixel)
+{
+    vec3 normal = texelFetch(gNormal, pixel, 0).rgb;
+    if (isOctahedral)
+        normal = OctahedralDecode(normal.xy * 2.0 - 1.0);
+    return normal;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 lastSample = textureSize(shadedColor, 0) - 1;
+    if (shadingGrid.z != 0 && ((pixel.x + pixel.y) & 1) == 0)
+    {
+        FragColor = texelFetch(shadedColor, ivec2(pixel.x / 2, pixel.y), 0);
+        return;
+    }
+
+    ivec2 texels[4];
+    float spatial[4];
+    if (shadingGrid.z != 0)
+    {
+        // left / right ones are in this row, up / down ones shaded this column
+        ivec2 neighbours[4] = ivec2[4](pixel - ivec2(1, 0), pixel + ivec2(1, 0), pixel - ivec2(0, 1), pixel + ivec2(0, 1));
+        for (int i = 0; i < 4; i++)
+        {
+            texels[i] = ivec2(neighbours[i].x / 2, neighbours[i].y);
+            spatial[i] = 0.25;
+        }
+    }
+    else
+    {
+        // sample s sits at s * step + step / 2
+        vec2 position = (vec2(pixel) - vec2(shadingGrid.xy / 2)) / vec2(shadingGrid.xy);
+        ivec2 base = ivec2(floor(position));
+        vec2 f = position - vec2(base);
+        texels[0] = base;
+        texels[1] = base + ivec2(1, 0);
+        texels[2] = base + ivec2(0, 1);
+        texels[3] = base + ivec2(1, 1);
+        spatial[0] = (1.0 - f.x) * (1.0 - f.y);
+        spatial[1] = f.x * (1.0 - f.y);
+        spatial[2] = (1.0 - f.x) * f.y;
+        spatial[3] = f.x * f.y;
+    }
+
+    float depth = LinearDepth(pixel);
+    // 2% of distance counts as the same surface
+    float depthScale = 1.0 / (0.02 * depth);
+    vec3 normal = PixelNormal(pixel);
+    // empty pixels have no normal
+    bool hasNormal = dot(normal, normal) > 0.5;
+    vec3 albedo = texelFetch(gAlbedo, pixel, 0).rgb;
+    vec4 color = vec4(0.0);
+    float total = 0.0;
+    // fallback when no sample is on this surface - the closest one in depth
+    vec4 closest = vec4(0.0);
+    float closestDistance = 1e30;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 texel = clamp(texels[i], ivec2(0), lastSample);
+        ivec2 shadedPixel = ShadedPixel(texel);
+        vec4 shaded = texelFetch(shadedColor, texel, 0);
+        float distance = abs(LinearDepth(shadedPixel) - depth);
+        float normalWeight = 1.0;
+        if (hasNormal)
+        {
+            // pow(cos, 16)
+            normalWeight = max(dot(normal, PixelNormal(shadedPixel)), 0.0);
+            normalWeight *= normalWeight;
+            normalWeight *= normalWeight;
+            normalWeight *= normalWeight;
+            normalWeight *= normalWeight;
+        }
+        vec3 albedoDifference = texelFetch(gAlbedo, shadedPixel, 0).rgb - albedo;
+        float weight = spatial[i] * normalWeight * exp(-distance * depthScale - dot(albedoDifference, albedoDifference) * 64.0);
+        color += shaded * weight;
+        total += weight;
+        if (distance < closestDistance)
+        {
+            closestDistance = distance;
+            closest = shaded;
+        }
+    }
+    FragColor = total > 1e-4 ? color / total : closest;
+}
+)";
+
+// Volumetric fog update, one full screen draw of FOG_FROXELS_X x FOG_FROXELS_Y per depth slice
+// (VolumetricFog.cpp). Light scattered in this slice is added onto the total of the slices in
+// front of it, from previousSlice, and the new total goes to the slice layer and Carry.
+const char* fogVolumeMainFS = R"(
+in vec2 TexCoords;
+layout(location = 1) out vec4 Carry;
+
+uniform sampler2D previousSlice;
+uniform int fogSlice;
+// near, far - slice centers are at near * (far / near) ^ ((slice + 0.5) / fogSlices)
+uniform vec2 fogDepthRange;
+uniform mat4 inverseView;
+uniform float fogTime;
+uniform bool isFogAnimated;
+
+// FOG_FROXELS_Z
+const float fogSlices = 64.0;
+// share of extinction that is scattering (rest is absorbed) and phase function anisotropy
+const float fogAlbedo = 0.5;
+const float fogAnisotropy = 0.3;
+// sky light, sun comes on top like any directional light
+const vec3 fogAmbientDay = vec3(0.3);
+const vec3 fogAmbientNight = vec3(0.05);
+
+float SliceDepth(float slice)
+{
+    return fogDepthRange.x * pow(fogDepthRange.y / fogDepthRange.x, slice / fogSlices);
+}
+// extinction per unit of distance, animated fog drifts through the scene in banks
+// (CalculateFogDensity with a phase that depends on position)
+float FogDensity(vec3 FragPos)
+{
+    if (!isFogAnimated)
+        return fogDensity;
+    vec3 world = (inverseView * vec4(FragPos, 1.0)).xyz;
+    float phase = dot(world, vec3(1.1, 0.4, 0.7));
+    return 0.5 * sin(fogTime * 0.3 + phase) + 0.5;
+}
+// Henyey-Greenstein, 1 for isotropic scattering, cosAngle between light travel and view ray
+float FogPhase(float cosAngle)
+{
+    float g = fogAnisotropy;
+    return (1.0 - g * g) / pow(1.0 + g * g - 2.0 * g * cosAngle, 1.5);
+}
+vec3 ScatterLight(Light light, vec3 FragPos, vec3 toCamera)
+{
+    vec3 lightDir = normalize(light.position - FragPos);
+    float att = attenuation(length(light.position - FragPos));
+    return light.color * att * FogPhase(dot(-lightDir, toCamera));
+}
+vec3 ScatterSpotLight(Light light, vec3 FragPos, vec3 toCamera)
+{
+    // same cone as calculateSpotLight
+    vec3 lightDir = normalize(light.position - FragPos);
+    float theta = dot(lightDir, normalize(-light.direction));
+    if (theta <= 0.91)
+        return vec3(0.0);
+    float intensity = clamp((theta - 0.82) / (0.91 - 0.82), 0.0, 1.0);
+    return ScatterLight(light, FragPos, toCamera) * intensity;
+}
+vec3 ScatterDirectionalLight(Light light, vec3 toCamera)
+{
+    // direction goes through view like a position (SetLightUniforms), zero when the camera sits
+    // on it - surface diffuse gets nothing then, normalize would fill the volume with NaN
+    float length2 = dot(light.direction, light.direction);
+    if (length2 < 1e-12)
+        return vec3(0.0);
+    return light.color * FogPhase(dot(-light.direction * inversesqrt(length2), toCamera));
+}
+
+void main()
+{
+    // view ray through froxel center, scaled to z = -1 so depth d is at ray * d
+    vec4 farPoint = inverseProjection * vec4(TexCoords * 2.0 - 1.0, 1.0, 1.0);
+    vec3 ray = farPoint.xyz / farPoint.w;
+    ray = ray / -ray.z;
+    float slice = float(fogSlice);
+    float start = fogSlice == 0 ? 0.0 : SliceDepth(slice - 0.5);
+    float end = SliceDepth(slice + 0.5);
+    vec3 FragPos = ray * (0.5 * (start + end));
+    vec3 toCamera = normalize(-FragPos);
+
+    vec3 light = isDayLight ? fogAmbientDay : fogAmbientNight;
+    vec3 scattered = vec3(0.0);
+#ifdef PERMUTATION
+    for (int i = 0; i < POINT_LIGHTS; i++)
+        scattered = scattered + ScatterLight(lights[i], FragPos, toCamera);
+    for (int i = POINT_LIGHTS; i < POINT_LIGHTS + SPOT_LIGHTS; i++)
+        scattered = scattered + ScatterSpotLight(lights[i], FragPos, toCamera);
+    for (int i = POINT_LIGHTS + SPOT_LIGHTS; i < POINT_LIGHTS + SPOT_LIGHTS + DIRECTIONAL_LIGHTS; i++)
+        scattered = scattered + ScatterDirectionalLight(lights[i], toCamera);
+#else
+    for (int i = 0; i < lightCount; i++)
+    {
+        if (lights[i].type == 0)
+            scattered = scattered + ScatterLight(lights[i], FragPos, toCamera);
+        else if (lights[i].type == 1 && isDayLight)
+            scattered = scattered + ScatterDirectionalLight(lights[i], toCamera);
+        else if (lights[i].type == 2)
+            scattered = scattered + ScatterSpotLight(lights[i], FragPos, toCamera);
+    }
+#endif
+    light = light + fogAlbedo * scattered;
+
+    // medium is taken as constant over the slice: light * (1 - transmittance) is what it
+    // scatters towards the camera, energy conserving for any slice thickness
+    float transmittance = exp(-FogDensity(FragPos) * (end - start) * length(ray));
+    vec4 previous = fogSlice == 0 ? vec4(0.0, 0.0, 0.0, 1.0) : texture(previousSlice, TexCoords);
+    vec4 total = vec4(previous.rgb + previous.a * light * (1.0 - transmittance), previous.a * transmittance);
+    FragColor = total;
+    Carry = total;
 }
 )";
 #endif
\ No newline at end of file
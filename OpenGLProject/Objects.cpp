@@ -1,4 +1,5 @@
 #include "Objects.hpp"
+#include "SceneGenerator.hpp"
 
 
 
@@ -66,6 +67,44 @@ void createSphere(std::vector<float>& vertices, std::vector<unsigned int>& indic
         }
     }
 }
+void createCone(std::vector<float>& vertices, std::vector<unsigned int>& indices, unsigned int sectors)
+{
+    vertices.clear();
+    indices.clear();
+
+    // 0 = apex, 1 = base center, then base ring
+    float apexAndCenter[12] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f,
+                                0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f };
+    vertices.insert(vertices.end(), apexAndCenter, apexAndCenter + 12);
+
+    float sectorStep = 2 * M_PI / sectors;
+    for (unsigned int j = 0; j < sectors; ++j) {
+        float sectorAngle = j * sectorStep;
+        float x = cosf(sectorAngle);
+        float y = sinf(sectorAngle);
+
+        vertices.push_back(x);
+        vertices.push_back(y);
+        vertices.push_back(1.0f);
+
+        // rough side normal (cone gets scaled anyway), light volumes only use positions
+        vertices.push_back(x * 0.7071f);
+        vertices.push_back(y * 0.7071f);
+        vertices.push_back(-0.7071f);
+    }
+
+    for (unsigned int j = 0; j < sectors; ++j) {
+        unsigned int current = 2 + j;
+        unsigned int next = 2 + (j + 1) % sectors;
+        indices.push_back(0);
+        indices.push_back(next);
+        indices.push_back(current);
+
+        indices.push_back(1);
+        indices.push_back(current);
+        indices.push_back(next);
+    }
+}
 Light* CreateLights()
 {
     Light* lights = new Light[6];
@@ -100,23 +139,11 @@ Light* CreateLights()
 
 Object* CubesGenerator()
 {
-    srand(static_cast <unsigned> (time(0)));
+    // fixed seed - same cubes on every run, see SceneGenerator for bigger scenes
     Object* cubes = new Object[100];
-    for (int i = 0; i < 100; i++)
-    {
-        Object cube;
-        cube.color = glm::vec3(1.0f, 1.0f, 1.0f);
-        float LO = -1.0f;
-        float HI = 0.9f;
-
-        float r3 = LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (HI - LO)));
-        float r1 = LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (HI - LO)));
-        float r2 = LO + static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / (HI - LO)));
-        cube.position = glm::vec3(r1, r2, r3);
-        cube.rotation = glm::vec3(r1, r2, r3);
-        cube.scale = 0.1f;
-        cubes[i] = cube;
-    }
+    GeneratorSettings settings = DefaultGeneratorSettings();
+    settings.objectCount = 100;
+    GenerateObjects(settings, cubes);
     return cubes;
 }
 
@@ -164,7 +191,10 @@ Object* CreateCubes()
     cubes[11].rotation = glm::vec3(0.1f, 0.1f, 0.1f);
 
     for (int i = 0; i < 12; i++)
+    {
         cubes[i].scale = 0.1f;
+        cubes[i].material = 0;
+    }
 
     return cubes;
 }
@@ -198,6 +228,9 @@ Object* CreateSpheres()
 
     spheres[2].scale = 6.0f;
 
+    for (int i = 0; i < 3; i++)
+        spheres[i].material = 0;
+
     return spheres;
 }
 
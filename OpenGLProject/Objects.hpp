@@ -35,6 +35,14 @@ struct Object
     glm::vec3 position;
     glm::vec3 rotation;
     float scale;
+    int material; // index into renderer material table, 0 = keyboard controlled one
+};
+
+// Lighting parameters looked up per pixel by material id stored in g-buffer
+struct Material
+{
+    float specPower;
+    bool isBlinn;
 };
 
 struct Camera
@@ -45,6 +53,8 @@ struct Camera
 };
 
 void createSphere(std::vector<float>& vertices, std::vector<unsigned int>& indices, float radius, unsigned int sectors, unsigned int stacks);
+// apex in origin, base circle of radius 1 at z = 1, closed, counter clockwise seen from outside
+void createCone(std::vector<float>& vertices, std::vector<unsigned int>& indices, unsigned int sectors);
 Light* CreateLights();
 Object* CubesGenerator();
 Object* CreateCubes();
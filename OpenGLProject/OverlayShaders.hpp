@@ -0,0 +1,39 @@
+#ifndef OverlayShaders_hpp
+#define OverlayShaders_hpp
+// Vertex shader for the stats overlay, positions are in pixels from top left corner
+const char* overlayVS = R"(
+#version 330 core
+layout(location = 0) in vec2 aPos;
+layout(location = 1) in vec2 aTexCoords;
+layout(location = 2) in vec4 aColor;
+
+uniform vec2 screenSize;
+
+out vec2 TexCoords;
+out vec4 Color;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    Color = aColor;
+    vec2 position = aPos / screenSize * 2.0 - 1.0;
+    gl_Position = vec4(position.x, -position.y, 0.0, 1.0);
+}
+)";
+
+// Fragment shader for the stats overlay, font texture has coverage in red channel
+const char* overlayFS = R"(
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec4 Color;
+
+uniform sampler2D font;
+
+void main()
+{
+    FragColor = vec4(Color.rgb, Color.a * texture(font, TexCoords).r);
+}
+)";
+#endif
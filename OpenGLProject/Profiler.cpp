@@ -0,0 +1,259 @@
+#include "Profiler.hpp"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> profilerEnabled(true);
+
+struct ProfilerThreadBuffer
+{
+    ProfileEvent events[PROFILER_BUFFER_SIZE];
+    std::atomic<uint64_t> writeIndex;
+    uint32_t threadId;
+    uint32_t depth;
+    std::string name;
+    // threadBuffer slot of the writing thread, null once the thread exited
+    ProfilerThreadBuffer** owner;
+};
+
+struct ProfilerTrack
+{
+    std::string name;
+    ProfilerThreadBuffer* buffer;
+};
+
+// registration, shutdown and external tracks only, zones never take this lock
+static std::mutex profilerMutex;
+static std::vector<ProfilerThreadBuffer*> profilerBuffers;
+static std::vector<ProfilerTrack> profilerTracks;
+static thread_local ProfilerThreadBuffer* threadBuffer = nullptr;
+
+// Separate from threadBuffer so zones keep reading a plain pointer (no TLS init guard).
+// Forgets the slot when the thread exits so ProfilerShutdown does not write into freed TLS.
+struct ProfilerThreadExit
+{
+    ~ProfilerThreadExit()
+    {
+        std::lock_guard<std::mutex> lock(profilerMutex);
+        if (threadBuffer)
+            threadBuffer->owner = nullptr;
+    }
+};
+static thread_local ProfilerThreadExit threadExit;
+static const int64_t profilerStart = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+static const int64_t profilerStartTicks = ProfilerTicks();
+
+static ProfilerThreadBuffer* CreateBuffer()
+{
+    ProfilerThreadBuffer* buffer = new ProfilerThreadBuffer();
+    buffer->writeIndex.store(0);
+    buffer->depth = 0;
+    (void)&threadExit;
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    buffer->owner = &threadBuffer;
+    buffer->threadId = (uint32_t)profilerBuffers.size() + 1;
+    buffer->name = "Thread " + std::to_string(buffer->threadId);
+    profilerBuffers.push_back(buffer);
+    return buffer;
+}
+
+static inline ProfilerThreadBuffer* GetThreadBuffer()
+{
+    if (!threadBuffer)
+        threadBuffer = CreateBuffer();
+    return threadBuffer;
+}
+
+static inline void WriteEvent(ProfilerThreadBuffer* buffer, const ProfileEvent& event)
+{
+    uint64_t index = buffer->writeIndex.load(std::memory_order_relaxed);
+    buffer->events[index & (PROFILER_BUFFER_SIZE - 1)] = event;
+    buffer->writeIndex.store(index + 1, std::memory_order_release);
+}
+
+int64_t ProfilerNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() - profilerStart;
+}
+
+void ProfilerSetEnabled(bool enabled)
+{
+    profilerEnabled.store(enabled);
+}
+
+void ProfilerSetThreadName(const char* name)
+{
+    ProfilerThreadBuffer* buffer = GetThreadBuffer();
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    buffer->name = name;
+}
+
+uint32_t ProfilerPushDepth()
+{
+    return GetThreadBuffer()->depth++;
+}
+
+void ProfilerPopDepth()
+{
+    // null when ProfilerShutdown ran while the zone was open
+    if (threadBuffer)
+        threadBuffer->depth--;
+}
+
+void ProfilerRecord(const char* name, int64_t start, int64_t end, uint32_t depth)
+{
+    if (!threadBuffer)
+        return;
+    ProfileEvent event = { name, start, end, depth, 0 };
+    WriteEvent(threadBuffer, event);
+}
+
+uint32_t ProfilerCreateTrack(const char* name)
+{
+    ProfilerThreadBuffer* buffer = new ProfilerThreadBuffer();
+    buffer->writeIndex.store(0);
+    buffer->depth = 0;
+    buffer->name = name;
+    buffer->owner = nullptr;
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    buffer->threadId = 1000 + (uint32_t)profilerTracks.size();
+    ProfilerTrack track = { name, buffer };
+    profilerTracks.push_back(track);
+    return (uint32_t)profilerTracks.size();
+}
+
+void ProfilerRecordExternal(uint32_t track, const char* name, int64_t start, int64_t end)
+{
+    if (track == 0 || !profilerEnabled.load(std::memory_order_relaxed))
+        return;
+    ProfileEvent event = { name, start, end, 0, track };
+    // a few events per frame, the lock keeps ProfilerCreateTrack / ProfilerShutdown from
+    // moving or freeing the track under the writer (one per track, the thread reading GPU queries)
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    if (track > profilerTracks.size())
+        return;
+    WriteEvent(profilerTracks[track - 1].buffer, event);
+}
+
+static void WriteJsonString(std::ostream& out, const char* text)
+{
+    out << '"';
+    for (const char* c = text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            out << '\\';
+        out << *c;
+    }
+    out << '"';
+}
+
+// ticks -> ns since program start, scale measured over whole run
+static double TicksToNs(int64_t ticks, double nsPerTick)
+{
+    return (ticks - profilerStartTicks) * nsPerTick;
+}
+
+static double CalibrateNsPerTick()
+{
+#ifdef PROFILER_USES_TSC
+    int64_t ticks = ProfilerTicks() - profilerStartTicks;
+    int64_t ns = ProfilerNow();
+    return ticks > 0 ? (double)ns / ticks : 1.0;
+#else
+    return 1.0;
+#endif
+}
+
+static void ExportBuffer(std::ostream& out, ProfilerThreadBuffer* buffer, bool isTrack, double nsPerTick, bool& first)
+{
+    out << (first ? "" : ",\n");
+    first = false;
+    out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+    WriteJsonString(out, buffer->name.c_str());
+    out << "}}";
+
+    uint64_t end = buffer->writeIndex.load(std::memory_order_acquire);
+    uint64_t begin = end > PROFILER_BUFFER_SIZE ? end - PROFILER_BUFFER_SIZE : 0;
+    for (uint64_t i = begin; i < end; i++)
+    {
+        const ProfileEvent& event = buffer->events[i & (PROFILER_BUFFER_SIZE - 1)];
+        double start = isTrack ? (double)event.start : TicksToNs(event.start, nsPerTick);
+        double end = isTrack ? (double)event.end : TicksToNs(event.end, nsPerTick);
+        // Chrome trace wants microseconds
+        out << ",\n{\"ph\":\"X\",\"name\":";
+        WriteJsonString(out, event.name);
+        out << ",\"pid\":1,\"tid\":" << buffer->threadId
+            << ",\"ts\":" << start / 1000.0
+            << ",\"dur\":" << (end - start) / 1000.0
+            << ",\"args\":{\"depth\":" << event.depth << "}}";
+    }
+}
+
+bool ProfilerExportChromeTrace(const std::string& path)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Failed to write trace " << path << std::endl;
+        return false;
+    }
+
+    // ns precision in microsecond units
+    out << std::fixed << std::setprecision(3);
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    double nsPerTick = CalibrateNsPerTick();
+    for (size_t i = 0; i < profilerBuffers.size(); i++)
+        ExportBuffer(out, profilerBuffers[i], false, nsPerTick, first);
+    for (size_t i = 0; i < profilerTracks.size(); i++)
+        ExportBuffer(out, profilerTracks[i].buffer, true, nsPerTick, first);
+    out << "\n]}\n";
+    std::cout << "Trace written to " << path << std::endl;
+    return static_cast<bool>(out);
+}
+
+double ProfilerMeasureOverhead(unsigned int iterations)
+{
+    if (iterations == 0 || !profilerEnabled.load())
+        return 0.0;
+
+    // measurement zones go to scratch buffer so they do not flood the trace
+    ProfilerThreadBuffer* saved = GetThreadBuffer();
+    ProfilerThreadBuffer* scratch = new ProfilerThreadBuffer();
+    scratch->writeIndex.store(0);
+    scratch->depth = 0;
+    threadBuffer = scratch;
+
+    int64_t start = ProfilerNow();
+    for (unsigned int i = 0; i < iterations; i++)
+    {
+        PROFILE_ZONE("ProfilerOverhead");
+    }
+    int64_t end = ProfilerNow();
+
+    threadBuffer = saved;
+    delete scratch;
+    return (double)(end - start) / iterations;
+}
+
+void ProfilerShutdown()
+{
+    std::lock_guard<std::mutex> lock(profilerMutex);
+    for (size_t i = 0; i < profilerBuffers.size(); i++)
+    {
+        // threads still alive create a new buffer on their next zone instead of writing into this one
+        if (profilerBuffers[i]->owner)
+            *profilerBuffers[i]->owner = nullptr;
+        delete profilerBuffers[i];
+    }
+    for (size_t i = 0; i < profilerTracks.size(); i++)
+        delete profilerTracks[i].buffer;
+    profilerBuffers.clear();
+    profilerTracks.clear();
+}
@@ -0,0 +1,95 @@
+#ifndef Profiler_hpp
+#define Profiler_hpp
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Hierarchical CPU profiler
+//  PROFILE_ZONE("name") measures enclosing scope, zones nest.
+//  Every thread writes into its own ring buffer (single writer, no locks),
+//  ProfilerExportChromeTrace writes all buffers as Chrome trace event JSON
+//  (open in chrome://tracing or https://ui.perfetto.dev).
+//  Zone names have to be string literals, only the pointer is stored.
+//  Define PROFILER_DISABLED to compile zones out completely.
+
+#define PROFILER_BUFFER_SIZE (1u << 16) // events kept per thread, power of 2
+
+struct ProfileEvent
+{
+    const char* name;
+    int64_t start; // ProfilerTicks for zones, ns for external tracks
+    int64_t end;
+    uint32_t depth;
+    uint32_t track; // 0 = CPU thread, other values = external tracks (GPU)
+};
+
+extern std::atomic<bool> profilerEnabled;
+
+// Raw timestamp for zones - invariant TSC on x86/x64 (few ns to read),
+// converted to ns only on export. Other CPUs fall back to ProfilerNow.
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+inline int64_t ProfilerTicks() { return (int64_t)__rdtsc(); }
+#define PROFILER_USES_TSC
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+inline int64_t ProfilerTicks() { return (int64_t)__rdtsc(); }
+#define PROFILER_USES_TSC
+#else
+int64_t ProfilerNow();
+inline int64_t ProfilerTicks() { return ProfilerNow(); }
+#endif
+
+// ns since program start
+int64_t ProfilerNow();
+void ProfilerSetEnabled(bool enabled);
+void ProfilerSetThreadName(const char* name);
+
+// used by ProfileZone, writes one finished zone into calling thread buffer
+void ProfilerRecord(const char* name, int64_t start, int64_t end, uint32_t depth);
+uint32_t ProfilerPushDepth();
+void ProfilerPopDepth();
+
+// Events measured elsewhere (e.g. GPU timer queries), times in ProfilerNow clock
+uint32_t ProfilerCreateTrack(const char* name);
+void ProfilerRecordExternal(uint32_t track, const char* name, int64_t start, int64_t end);
+
+bool ProfilerExportChromeTrace(const std::string& path);
+// average cost of one empty zone in ns
+double ProfilerMeasureOverhead(unsigned int iterations);
+void ProfilerShutdown();
+
+struct ProfileZone
+{
+    const char* name;
+    int64_t start;
+    uint32_t depth;
+    bool active;
+
+    explicit ProfileZone(const char* zoneName)
+    {
+        active = profilerEnabled.load(std::memory_order_relaxed);
+        if (!active)
+            return;
+        name = zoneName;
+        depth = ProfilerPushDepth();
+        start = ProfilerTicks();
+    }
+    ~ProfileZone()
+    {
+        if (!active)
+            return;
+        ProfilerRecord(name, start, ProfilerTicks(), depth);
+        ProfilerPopDepth();
+    }
+};
+
+#ifdef PROFILER_DISABLED
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
+
+#endif
@@ -0,0 +1,140 @@
+#include "ReducedLighting.hpp"
+#include <algorithm>
+#include <iostream>
+#include "Profiler.hpp"
+#include "Counters.hpp"
+#include "GLTrace.hpp"
+
+const char* LightingResolutionName(int resolution)
+{
+    static const char* names[LIGHTING_RESOLUTION_COUNT] = { "full", "half", "quarter", "checkerboard" };
+    return names[resolution];
+}
+
+bool ParseLightingResolution(const std::string& name, int& resolution)
+{
+    for (int i = 0; i < LIGHTING_RESOLUTION_COUNT; i++)
+        if (name == LightingResolutionName(i))
+        {
+            resolution = i;
+            return true;
+        }
+    return false;
+}
+
+bool UpdateReducedLighting(ReducedLighting& reduced, const Gbuffer& gBuffer, int resolution)
+{
+    if (resolution == LIGHTING_RESOLUTION_FULL)
+        return false;
+    if (reduced.framebuffer != 0 && reduced.resolution == resolution && reduced.gbufferWidth == gBuffer.width && reduced.gbufferHeight == gBuffer.height)
+        return true;
+
+    DestroyReducedLighting(reduced);
+    reduced.resolution = resolution;
+    reduced.gbufferWidth = gBuffer.width;
+    reduced.gbufferHeight = gBuffer.height;
+    reduced.isCheckerboard = resolution == LIGHTING_RESOLUTION_CHECKERBOARD;
+    reduced.stepX = resolution == LIGHTING_RESOLUTION_QUARTER ? 4 : 2;
+    reduced.stepY = resolution == LIGHTING_RESOLUTION_QUARTER ? 4 : reduced.isCheckerboard ? 1 : 2;
+    // rounded up, last column / row of samples may sit on the g-buffer edge (ShadedPixel clamps)
+    reduced.width = (gBuffer.width + reduced.stepX - 1) / reduced.stepX;
+    reduced.height = (gBuffer.height + reduced.stepY - 1) / reduced.stepY;
+
+    glGenTextures(1, &reduced.color);
+    glBindTexture(GL_TEXTURE_2D, reduced.color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, reduced.width, reduced.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &reduced.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, reduced.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, reduced.color, 0);
+    bool isComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!isComplete)
+    {
+        std::cerr << "Reduced lighting framebuffer not complete, lighting stays at full resolution" << std::endl;
+        DestroyReducedLighting(reduced);
+    }
+    return isComplete;
+}
+
+void DestroyReducedLighting(ReducedLighting& reduced)
+{
+    glDeleteFramebuffers(1, &reduced.framebuffer);
+    glDeleteTextures(1, &reduced.color);
+    reduced.framebuffer = 0;
+    reduced.color = 0;
+}
+
+ShadingGridUniforms GetShadingGridUniforms(GLuint shaderProgram)
+{
+    ShadingGridUniforms uniforms;
+    uniforms.shadingGrid = glGetUniformLocation(shaderProgram, "shadingGrid");
+    uniforms.gbufferSize = glGetUniformLocation(shaderProgram, "gbufferSize");
+    return uniforms;
+}
+
+UpsampleUniforms GetUpsampleUniforms(GLuint shaderProgram)
+{
+    UpsampleUniforms uniforms;
+    uniforms.lighting = GetLightingUniforms(shaderProgram);
+    uniforms.grid = GetShadingGridUniforms(shaderProgram);
+
+    glUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "shadedColor"), SHADED_COLOR_UNIT);
+    return uniforms;
+}
+
+static void SetShadingGrid(const ReducedLighting& reduced, const ShadingGridUniforms& uniforms, bool isEnabled)
+{
+    if (isEnabled)
+    {
+        glUniform3i(uniforms.shadingGrid, reduced.stepX, reduced.stepY, reduced.isCheckerboard);
+        glUniform2f(uniforms.gbufferSize, (float)reduced.gbufferWidth, (float)reduced.gbufferHeight);
+    }
+    else
+        glUniform3i(uniforms.shadingGrid, 1, 1, 0);
+    CountersAdd(COUNTER_BYTES_STREAMED, isEnabled ? 5 * sizeof(int) : 3 * sizeof(int));
+}
+
+void BindShadingGrid(const ReducedLighting& reduced, GLuint shaderProgram, const ShadingGridUniforms& uniforms, bool isEnabled)
+{
+    glUseProgram(shaderProgram);
+    SetShadingGrid(reduced, uniforms, isEnabled);
+}
+
+void UpsampleLighting(const ReducedLighting& reduced, VAOStruct quad, GLuint shaderProgram, const UpsampleUniforms& uniforms, const Gbuffer& gBuffer,
+    const glm::mat4& projection)
+{
+    PROFILE_ZONE("Upsample");
+    glUseProgram(shaderProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, gBuffer.gNormal);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, gBuffer.gAlbedo);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, gBuffer.depth);
+    glActiveTexture(GL_TEXTURE0 + SHADED_COLOR_UNIT);
+    glBindTexture(GL_TEXTURE_2D, reduced.color);
+    glActiveTexture(GL_TEXTURE0);
+
+    SetShadingGrid(reduced, uniforms.grid, true);
+    glUniformMatrix4fv(uniforms.lighting.inverseProjection, 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
+    size_t bytes = sizeof(glm::mat4);
+    // location -1 when shader permutation has it compiled in
+    if (uniforms.lighting.isOctahedral >= 0)
+    {
+        glUniform1i(uniforms.lighting.isOctahedral, GetGbufferLayoutInfo(gBuffer.layout).isOctahedral);
+        bytes += sizeof(int);
+    }
+
+    glBindVertexArray(quad.VAO);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+
+    CountersAdd(COUNTER_DRAW_CALLS, 1);
+    CountersAdd(COUNTER_TRIANGLES, 2);
+    CountersAdd(COUNTER_BYTES_STREAMED, bytes);
+}
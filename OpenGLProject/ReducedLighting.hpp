@@ -0,0 +1,73 @@
+#ifndef ReducedLighting_hpp
+#define ReducedLighting_hpp
+#include <GL/glew.h>
+#include <glm.hpp>
+#include <string>
+#include "ShaderSetUp.hpp"
+
+// Reduced resolution lighting - full screen and clustered lighting draw into a smaller target
+// where every fragment shades one g-buffer pixel (ShadedPixel in lightingCommonFS), then the
+// upsample pass rebuilds g-buffer resolution from the full resolution g-buffer, weighting the
+// samples around each pixel by depth / normal / albedo similarity (upsampleMainFS).
+// Half / quarter shade one pixel of each 2x2 / 4x4 block, checkerboard every other pixel of
+// a row (odd rows shifted by one). Light volumes, forward+ and visibility buffer ignore it.
+// texture unit of the reduced lighting output in upsample pass, 7 - 9 are visibility buffer
+#define SHADED_COLOR_UNIT 10
+
+enum LightingResolution
+{
+    LIGHTING_RESOLUTION_FULL = 0,
+    LIGHTING_RESOLUTION_HALF,         // 1 / 4 of the pixels
+    LIGHTING_RESOLUTION_QUARTER,      // 1 / 16 of the pixels
+    LIGHTING_RESOLUTION_CHECKERBOARD, // 1 / 2 of the pixels
+    LIGHTING_RESOLUTION_COUNT
+};
+
+struct ReducedLighting
+{
+    unsigned int framebuffer;
+    // RGBA8 like scene color
+    unsigned int color;
+    int resolution;
+    int width;
+    int height;
+    // g-buffer pixels per texel, checkerboard is 2 x 1
+    int stepX;
+    int stepY;
+    bool isCheckerboard;
+    // g-buffer size the target was made for
+    int gbufferWidth;
+    int gbufferHeight;
+};
+
+// lighting side, in full screen and clustered programs
+struct ShadingGridUniforms
+{
+    GLint shadingGrid;
+    GLint gbufferSize;
+};
+struct UpsampleUniforms
+{
+    // g-buffer samplers, inverseProjection and isOctahedral only
+    LightingUniforms lighting;
+    ShadingGridUniforms grid;
+};
+
+const char* LightingResolutionName(int resolution);
+bool ParseLightingResolution(const std::string& name, int& resolution);
+// Makes the target again when resolution or g-buffer size changed, false (and nothing to draw
+// into) at full resolution or when the framebuffer is not complete.
+bool UpdateReducedLighting(ReducedLighting& reduced, const Gbuffer& gBuffer, int resolution);
+void DestroyReducedLighting(ReducedLighting& reduced);
+ShadingGridUniforms GetShadingGridUniforms(GLuint shaderProgram);
+// also binds g-buffer samplers and shadedColor to SHADED_COLOR_UNIT
+UpsampleUniforms GetUpsampleUniforms(GLuint shaderProgram);
+
+// has to be called before every full screen lighting draw, isEnabled false shades every pixel
+// (uniform state stays with the program). Binds shaderProgram.
+void BindShadingGrid(const ReducedLighting& reduced, GLuint shaderProgram, const ShadingGridUniforms& uniforms, bool isEnabled);
+// g-buffer sized draw into the bound framebuffer, viewport is set by caller
+void UpsampleLighting(const ReducedLighting& reduced, VAOStruct quad, GLuint shaderProgram, const UpsampleUniforms& uniforms, const Gbuffer& gBuffer,
+    const glm::mat4& projection);
+
+#endif
@@ -0,0 +1,358 @@
+#include "Regression.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include "Scene.hpp"
+#include "SceneGenerator.hpp"
+#include "Counters.hpp"
+
+// differences smaller than this are timer noise, never flagged
+#define REGRESSION_MIN_TIME_DELTA 0.05
+
+struct RegressionCase
+{
+    const char* name;
+    unsigned int generatedObjects; // 0 = default scene
+    unsigned int camera;
+    bool isDayLight;
+    bool isFog;
+    bool isBlinn;
+    float specPower;
+    float captureTime; // seconds on the fixed clock
+    bool isDepthPrepass;
+    int lightingMode;
+    bool isVolumetricFog;
+    int lightingResolution;
+    bool isShadows;
+    // last default sphere (the big one around everything) left out, far plane background shows
+    bool isOpen;
+};
+
+// Canonical cases - changing them invalidates stored goldens and baseline
+static const RegressionCase regressionCases[] = {
+    { "default-camera1", 0, 0, false, false, false, 32.0f, 2.0f, false, LIGHTING_FULL_SCREEN, false, LIGHTING_RESOLUTION_FULL, false, false },
+    { "default-camera2", 0, 1, false, false, false, 32.0f, 2.0f, false, LIGHTING_FULL_SCREEN, false, LIGHTING_RESOLUTION_FULL, false, false },
+    { "default-camera3", 0, 2, false, false, false, 32.0f, 2.0f, false, LIGHTING_FULL_SCREEN, false, LIGHTING_RESOLUTION_FULL, false, false },
+    { "default-camera4", 0, 3, false, false, false, 32.0f, 2.0f, false, LIGHTING_FULL_SCREEN, false, LIGHTING_RESOLUTION_FULL, false, false },
+    { "default-day-fog", 0, 0, true, true, false, 32.0f, 3.5f, false, LIGHTING_FULL_SCREEN, false, LIGHTING_RESOLUTION_FULL, false, false },
+    { "default-blinn", 0, 0, false, false, true, 8.0f, 1.0f, false, LIGHTING_FULL_SCREEN, false, LIGHTING_RESOLUTION_FULL, false, false },
+    { "generated-clustered", 20000, 0, false, false, false, 32.0f, 2.0f, false, LIGHTING_FULL_SCREEN, false, LIGHTING_RESOLUTION_FULL, false, false },
+    { "default-depth-prepass", 0, 0, false, false, false, 32.0f, 2.0f, true, LIGHTING_FULL_SCREEN, false, LIGHTING_RESOLUTION_FULL, false, false },
+    { "default-light-volumes", 0, 0, true, true, false, 32.0f, 3.5f, false, LIGHTING_VOLUMES, false, LIGHTING_RESOLUTION_FULL, false, false },
+    { "default-clustered", 0, 0, true, true, false, 32.0f, 3.5f, false, LIGHTING_CLUSTERED, false, LIGHTING_RESOLUTION_FULL, false, false },
+    { "default-volumetric-fog", 0, 0, false, true, false, 32.0f, 3.5f, false, LIGHTING_FULL_SCREEN, true, LIGHTING_RESOLUTION_FULL, false, false },
+    { "default-volumetric-day", 0, 1, true, true, false, 32.0f, 3.5f, false, LIGHTING_FULL_SCREEN, true, LIGHTING_RESOLUTION_FULL, false, false },
+    { "default-forward-plus", 0, 0, true, true, false, 32.0f, 3.5f, false, LIGHTING_FORWARD_PLUS, false, LIGHTING_RESOLUTION_FULL, false, false },
+    { "open-forward-fog", 0, 0, true, true, false, 32.0f, 3.5f, false, LIGHTING_FORWARD_PLUS, false, LIGHTING_RESOLUTION_FULL, false, true },
+    { "open-clustered-fog", 0, 0, true, true, false, 32.0f, 3.5f, false, LIGHTING_CLUSTERED, false, LIGHTING_RESOLUTION_FULL, false, true },
+    { "open-forward-volumetric", 0, 0, true, true, false, 32.0f, 3.5f, false, LIGHTING_FORWARD_PLUS, true, LIGHTING_RESOLUTION_FULL, false, true },
+    { "default-visibility", 0, 0, true, true, false, 32.0f, 3.5f, false, LIGHTING_VISIBILITY, false, LIGHTING_RESOLUTION_FULL, false, false },
+    { "default-clustered-half", 0, 0, true, true, false, 32.0f, 3.5f, false, LIGHTING_CLUSTERED, false, LIGHTING_RESOLUTION_HALF, false, false },
+    { "default-checkerboard", 0, 0, false, false, false, 32.0f, 2.0f, false, LIGHTING_FULL_SCREEN, false, LIGHTING_RESOLUTION_CHECKERBOARD, false, false },
+    { "default-shadows", 0, 0, false, false, false, 32.0f, 2.0f, false, LIGHTING_FULL_SCREEN, false, LIGHTING_RESOLUTION_FULL, true, false },
+    { "default-shadows-day", 0, 1, true, false, false, 32.0f, 3.5f, false, LIGHTING_CLUSTERED, false, LIGHTING_RESOLUTION_FULL, true, false },
+};
+
+RegressionSettings DefaultRegressionSettings()
+{
+    RegressionSettings settings;
+    settings.isUpdate = false;
+    settings.threshold = 0.1;
+    settings.pixelThreshold = 0.1f;
+    settings.maxDifferentPixels = 0.001;
+    return settings;
+}
+
+static void ToYiq(const unsigned char* rgb, float yiq[3])
+{
+    float r = rgb[0], g = rgb[1], b = rgb[2];
+    yiq[0] = r * 0.29889531f + g * 0.58662247f + b * 0.11448223f;
+    yiq[1] = r * 0.59597799f - g * 0.27417610f - b * 0.32180189f;
+    yiq[2] = r * 0.21147017f - g * 0.52261711f + b * 0.31114694f;
+}
+
+ImageDifference CompareImages(const Image& expected, const Image& actual, float pixelThreshold, Image* diff)
+{
+    ImageDifference result = { 0, 1.0, 1.0f };
+    if (expected.width != actual.width || expected.height != actual.height)
+        return result;
+    Image a = ToRgb(expected);
+    Image b = ToRgb(actual);
+
+    // largest possible YIQ delta (black vs white)
+    const float maxDelta = 35215.0f;
+    const float limit = maxDelta * pixelThreshold * pixelThreshold;
+    if (diff)
+    {
+        diff->width = a.width;
+        diff->height = a.height;
+        diff->channels = 3;
+        diff->pixels.resize(a.pixels.size());
+    }
+
+    result.maxDifference = 0.0f;
+    const size_t pixelCount = (size_t)a.width * a.height;
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        float yiqA[3], yiqB[3];
+        ToYiq(&a.pixels[i * 3], yiqA);
+        ToYiq(&b.pixels[i * 3], yiqB);
+        float y = yiqA[0] - yiqB[0], iDelta = yiqA[1] - yiqB[1], q = yiqA[2] - yiqB[2];
+        float delta = 0.5053f * y * y + 0.299f * iDelta * iDelta + 0.1957f * q * q;
+        result.maxDifference = std::max(result.maxDifference, std::sqrt(delta / maxDelta));
+        bool isDifferent = delta > limit;
+        if (isDifferent)
+            result.differentPixels++;
+        if (diff)
+        {
+            // changed pixels red, rest faded gray copy of expected
+            unsigned char gray = (unsigned char)(255 - (255 - yiqA[0]) * 0.25f);
+            diff->pixels[i * 3 + 0] = isDifferent ? 255 : gray;
+            diff->pixels[i * 3 + 1] = isDifferent ? 0 : gray;
+            diff->pixels[i * 3 + 2] = isDifferent ? 0 : gray;
+        }
+    }
+    result.differentFraction = pixelCount > 0 ? (double)result.differentPixels / pixelCount : 0.0;
+    return result;
+}
+
+double ImagePsnr(const Image& expected, const Image& actual)
+{
+    if (expected.width != actual.width || expected.height != actual.height || expected.channels != actual.channels)
+        return 0.0;
+    double squaredError = 0.0;
+    for (size_t i = 0; i < expected.pixels.size(); i++)
+    {
+        double difference = (double)expected.pixels[i] - actual.pixels[i];
+        squaredError += difference * difference;
+    }
+    if (squaredError == 0.0)
+        return REGRESSION_MAX_PSNR;
+    double meanSquaredError = squaredError / expected.pixels.size();
+    return std::min(10.0 * log10(255.0 * 255.0 / meanSquaredError), (double)REGRESSION_MAX_PSNR);
+}
+
+static void SetUpCase(const RegressionCase& testCase, Scene& scene, RenderState& state)
+{
+    FreeScene(scene);
+    InitScene(scene);
+    if (testCase.generatedObjects > 0)
+    {
+        GeneratorSettings generator = DefaultGeneratorSettings();
+        generator.objectCount = testCase.generatedObjects;
+        generator.distribution = DISTRIBUTION_CLUSTERED;
+        generator.lightCount = 16;
+        GenerateScene(generator, scene);
+    }
+    else
+        CreateDefaultScene(scene);
+    if (testCase.isOpen && scene.sphereCount > 0)
+        scene.sphereCount--;
+    scene.weather.isDayLight = testCase.isDayLight;
+    scene.weather.isFog = testCase.isFog;
+
+    state = DefaultRenderState();
+    state.currentCamera = std::min(testCase.camera, scene.cameraCount - 1);
+    state.isBlinn = testCase.isBlinn;
+    state.specPower = testCase.specPower;
+    state.isDepthPrepass = testCase.isDepthPrepass;
+    state.lightingMode = testCase.lightingMode;
+    state.isVolumetricFog = testCase.isVolumetricFog;
+    state.lightingResolution = testCase.lightingResolution;
+    state.isShadows = testCase.isShadows;
+}
+
+Image CaptureFrame(GLFWwindow* window, Renderer& renderer, Scene& scene, const RenderState& state, float time)
+{
+    AnimateScene(scene, time);
+    RenderFrame(renderer, scene, state, time);
+
+    // read before swap, back buffer content is undefined after it
+    Image image;
+    glfwGetFramebufferSize(window, &image.width, &image.height);
+    image.channels = 3;
+    image.pixels.resize((size_t)image.width * image.height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, image.width, image.height, GL_RGB, GL_UNSIGNED_BYTE, image.pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    FlipRows(image);
+    glfwSwapBuffers(window);
+    return image;
+}
+
+// metric name -> value, in the order they are measured
+typedef std::vector<std::pair<std::string, double> > Metrics;
+
+static void CollectMetrics(const BenchmarkResult& result, Metrics& metrics)
+{
+    for (int p = 0; p < PASS_COUNT; p++)
+        metrics.push_back(std::make_pair(std::string("cpu.") + BenchmarkPassName(p) + ".p50", result.passes[p].p50));
+    if (result.gpuFrames > 0)
+        for (int p = 0; p < GPU_PASS_COUNT; p++)
+            if (result.gpuPassFrames[p] > 0)
+                metrics.push_back(std::make_pair(std::string("gpu.") + GpuPassShortName(p) + ".p50", result.gpuPasses[p].p50));
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        metrics.push_back(std::make_pair(std::string("counter.") + CounterName(i), result.countersPerFrame[i]));
+}
+
+static bool IsTimeMetric(const std::string& metric)
+{
+    return metric.compare(0, 4, "cpu.") == 0 || metric.compare(0, 4, "gpu.") == 0;
+}
+
+static bool ReadBaseline(const std::string& path, std::string& renderer, std::map<std::string, double>& values)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.compare(0, 11, "# renderer ") == 0)
+        {
+            renderer = line.substr(11);
+            continue;
+        }
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream stream(line);
+        std::string testCase, metric;
+        double value;
+        if (stream >> testCase >> metric >> value)
+            values[testCase + " " + metric] = value;
+    }
+    return true;
+}
+
+bool RunRegression(GLFWwindow* window, Renderer& renderer, const RegressionSettings& settings, const BenchmarkSettings& benchmark)
+{
+    const std::string rendererName = (const char*)glGetString(GL_RENDERER);
+    const std::string baselinePath = settings.directory + "/baseline.txt";
+    std::string baselineRenderer;
+    std::map<std::string, double> baseline;
+    bool hasBaseline = !settings.isUpdate && ReadBaseline(baselinePath, baselineRenderer, baseline);
+    // a fresh directory or new cases report "new" instead of failing, --update-golden stores them
+    if (!settings.isUpdate && !hasBaseline)
+        std::cerr << "No baseline in " << baselinePath << ", metrics are new (store with --update-golden)" << std::endl;
+    // times from another GPU / driver say nothing, counters and images still do
+    bool isSameRenderer = baselineRenderer == rendererName;
+    if (hasBaseline && !isSameRenderer)
+        std::cerr << "Baseline was recorded on \"" << baselineRenderer << "\", times are not compared" << std::endl;
+
+    std::ostringstream newBaseline;
+    newBaseline << "# renderer " << rendererName << "\n";
+    newBaseline << "# frames " << benchmark.frames << " warmup " << benchmark.warmupFrames << " time step " << benchmark.timeStep << "\n";
+
+    unsigned int failures = 0;
+    unsigned int newGoldens = 0;
+    Scene scene;
+    InitScene(scene);
+    std::cout << std::left << std::setw(24) << "case" << std::setw(30) << "metric" << std::right << std::setw(12) << "baseline"
+        << std::setw(12) << "current" << std::setw(10) << "change" << "  status" << std::endl;
+    for (const RegressionCase& testCase : regressionCases)
+    {
+        RenderState state;
+        SetUpCase(testCase, scene, state);
+        BenchmarkResult result;
+        MeasureFrames(window, renderer, scene, state, benchmark, result);
+        Image image = CaptureFrame(window, renderer, scene, state, testCase.captureTime);
+
+        const std::string goldenPath = settings.directory + "/" + testCase.name + ".png";
+        Metrics metrics;
+        CollectMetrics(result, metrics);
+        for (size_t m = 0; m < metrics.size(); m++)
+            newBaseline << testCase.name << " " << metrics[m].first << " " << metrics[m].second << "\n";
+
+        if (settings.isUpdate)
+        {
+            if (!WritePng(goldenPath, image))
+                failures++;
+            continue;
+        }
+
+        // per pass diff table
+        for (size_t m = 0; m < metrics.size(); m++)
+        {
+            const std::string& metric = metrics[m].first;
+            double current = metrics[m].second;
+            std::map<std::string, double>::const_iterator found = baseline.find(std::string(testCase.name) + " " + metric);
+            std::cout << std::left << std::setw(24) << testCase.name << std::setw(30) << metric << std::right << std::fixed
+                << std::setprecision(3);
+            if (found == baseline.end())
+            {
+                std::cout << std::setw(12) << "-" << std::setw(12) << current << std::setw(10) << "-" << "  new" << std::endl;
+                continue;
+            }
+            double expected = found->second;
+            double change = expected != 0.0 ? (current - expected) / expected : (current != 0.0 ? 1.0 : 0.0);
+            bool isTime = IsTimeMetric(metric);
+            bool isNoise = isTime && std::fabs(current - expected) < REGRESSION_MIN_TIME_DELTA;
+            const char* status = "ok";
+            if (isTime && !isSameRenderer)
+                status = "skipped";
+            else if (!isNoise && change > settings.threshold)
+            {
+                status = "REGRESSION";
+                failures++;
+            }
+            else if (!isNoise && change < -settings.threshold)
+                status = "improved";
+            std::ostringstream percent;
+            percent << std::showpos << std::fixed << std::setprecision(1) << change * 100.0 << "%";
+            std::cout << std::setw(12) << expected << std::setw(12) << current << std::setw(10) << percent.str() << "  " << status << std::endl;
+        }
+
+        // missing golden is a new case, one that does not read is a failure
+        if (!std::ifstream(goldenPath))
+        {
+            std::cout << std::left << std::setw(24) << testCase.name << "image: no golden  new" << std::right << std::endl;
+            WritePng(settings.directory + "/" + testCase.name + ".actual.png", image);
+            newGoldens++;
+            continue;
+        }
+        Image golden;
+        if (!ReadPng(goldenPath, golden))
+        {
+            failures++;
+            continue;
+        }
+        Image diff;
+        ImageDifference difference = CompareImages(golden, image, settings.pixelThreshold, &diff);
+        bool isImageOk = difference.differentFraction <= settings.maxDifferentPixels;
+        std::cout << std::left << std::setw(24) << testCase.name << "image: " << difference.differentPixels << " pixels differ ("
+            << std::setprecision(3) << difference.differentFraction * 100.0 << "%), max difference " << difference.maxDifference
+            << "  " << (isImageOk ? "ok" : "REGRESSION") << std::right << std::endl;
+        if (!isImageOk)
+        {
+            failures++;
+            WritePng(settings.directory + "/" + testCase.name + ".actual.png", image);
+            if (!diff.pixels.empty())
+                WritePng(settings.directory + "/" + testCase.name + ".diff.png", diff);
+        }
+    }
+    FreeScene(scene);
+
+    if (settings.isUpdate)
+    {
+        std::ofstream file(baselinePath);
+        if (!file || !(file << newBaseline.str()))
+        {
+            std::cerr << "Failed to write " << baselinePath << std::endl;
+            return false;
+        }
+        std::cout << "Goldens and baseline written to " << settings.directory << std::endl;
+        return failures == 0;
+    }
+    if (newGoldens > 0)
+        std::cout << newGoldens << " cases without golden (written as .actual.png), store them with --update-golden" << std::endl;
+    if (failures == 0)
+        std::cout << "No regressions" << std::endl;
+    else
+        std::cout << failures << " regressions found" << std::endl;
+    return failures == 0;
+}
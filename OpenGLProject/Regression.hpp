@@ -0,0 +1,49 @@
+#ifndef Regression_hpp
+#define Regression_hpp
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <string>
+#include "Renderer.hpp"
+#include "Benchmark.hpp"
+#include "ImageIO.hpp"
+
+// Golden image + performance regression run.
+// Renders a fixed set of scenes / cameras with the fixed benchmark clock,
+// compares last frame of each case with <directory>/<case>.png and
+// measured times / counters with <directory>/baseline.txt.
+// With isUpdate the current results become the new goldens and baseline.
+
+// PSNR reported for identical images
+#define REGRESSION_MAX_PSNR 100.0
+
+struct RegressionSettings
+{
+    std::string directory;
+    bool isUpdate;
+    double threshold;          // allowed relative growth of times and counters (0.1 = 10%)
+    float pixelThreshold;      // perceptual color difference per pixel, 0..1
+    double maxDifferentPixels; // allowed fraction of pixels over pixelThreshold
+};
+
+struct ImageDifference
+{
+    unsigned int differentPixels;
+    double differentFraction;
+    float maxDifference; // 0..1
+};
+
+RegressionSettings DefaultRegressionSettings();
+
+// YIQ based difference (same idea as pixelmatch), diff image marks changed pixels red
+ImageDifference CompareImages(const Image& expected, const Image& actual, float pixelThreshold, Image* diff);
+
+// Peak signal to noise ratio in dB over every channel, REGRESSION_MAX_PSNR for identical images
+// and 0 when sizes differ
+double ImagePsnr(const Image& expected, const Image& actual);
+// Animates scene to time, renders it and reads the window framebuffer back (RGB, top row first)
+Image CaptureFrame(GLFWwindow* window, Renderer& renderer, Scene& scene, const RenderState& state, float time);
+
+// benchmark.frames / warmupFrames / timeStep are used for every case
+bool RunRegression(GLFWwindow* window, Renderer& renderer, const RegressionSettings& settings, const BenchmarkSettings& benchmark);
+
+#endif
@@ -0,0 +1,814 @@
+#include "Renderer.hpp"
+#include <algorithm>
+#include "GeometryShaders.hpp"
+#include "LightingShaders.hpp"
+#include "Profiler.hpp"
+#include "Counters.hpp"
+#include "GLTrace.hpp"
+
+RenderState DefaultRenderState()
+{
+    RenderState state;
+    state.currentCamera = 0;
+    state.specPower = 32.0f;
+    state.isBlinn = false;
+    state.isOverlayVisible = false;
+    state.isDepthPrepass = false;
+    state.lightingMode = LIGHTING_FULL_SCREEN;
+    state.isClusterHeatmap = false;
+    state.isVolumetricFog = false;
+    state.lightingResolution = LIGHTING_RESOLUTION_FULL;
+    state.isShadows = false;
+    state.isShadowCache = true;
+    return state;
+}
+
+const char* LightingModeName(int mode)
+{
+    static const char* names[LIGHTING_MODE_COUNT] = { "full", "volumes", "clustered", "forward", "visibility" };
+    return names[mode];
+}
+
+bool ParseLightingMode(const std::string& name, int& mode)
+{
+    for (int i = 0; i < LIGHTING_MODE_COUNT; i++)
+        if (name == LightingModeName(i))
+        {
+            mode = i;
+            return true;
+        }
+    return false;
+}
+
+static void RenderSize(const Renderer& renderer, int& width, int& height)
+{
+    width = std::max(1, (int)(renderer.outputWidth * renderer.renderScale + 0.5f));
+    height = std::max(1, (int)(renderer.outputHeight * renderer.renderScale + 0.5f));
+}
+
+static bool SetUpRenderTargets(Renderer& renderer)
+{
+    int width, height;
+    RenderSize(renderer, width, height);
+    renderer.gBuffer = SetUpGbuffer(width, height, renderer.gbufferLayout);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Framebuffer not complete!" << std::endl;
+        return false;
+    }
+
+    glGenFramebuffers(1, &renderer.sceneBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, renderer.sceneBuffer);
+    glGenTextures(1, &renderer.sceneColor);
+    glBindTexture(GL_TEXTURE_2D, renderer.sceneColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, renderer.sceneColor, 0);
+    glGenRenderbuffers(1, &renderer.sceneDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderer.sceneDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderer.sceneDepth);
+    bool isComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!isComplete)
+        std::cerr << "Scene framebuffer not complete!" << std::endl;
+    return isComplete && SetUpVisibilityTarget(renderer.visibility, renderer.gBuffer);
+}
+
+static void DestroyRenderTargets(Renderer& renderer)
+{
+    DestroyGbuffer(renderer.gBuffer);
+    glDeleteFramebuffers(1, &renderer.sceneBuffer);
+    glDeleteTextures(1, &renderer.sceneColor);
+    glDeleteRenderbuffers(1, &renderer.sceneDepth);
+    DestroyVisibilityTarget(renderer.visibility);
+    DestroyReducedLighting(renderer.reducedLighting);
+}
+
+static void SetUpMaterials(Material* materials)
+{
+    // 0 is overwritten from RenderState every frame
+    Material defaults[MAX_MATERIALS] = {
+        { 32.0f, false }, // keyboard
+        { 64.0f, true },  // glossy
+        { 4.0f, false },  // matte
+        { 16.0f, true },  // plastic
+        { 128.0f, true }, // metal like
+        { 8.0f, true },
+        { 2.0f, false },
+        { 32.0f, true }
+    };
+    std::copy(defaults, defaults + MAX_MATERIALS, materials);
+}
+
+void GenerateRendererMeshes(RendererMeshes& meshes)
+{
+    createSphere(meshes.sphereVertices, meshes.sphereIndices, 0.33f, 32, 16);
+    // mesh scaling in GetLightVolume depends on this tessellation
+    createSphere(meshes.lightSphereVertices, meshes.lightSphereIndices, 1.0f, LIGHT_VOLUME_SECTORS, LIGHT_VOLUME_STACKS);
+    createCone(meshes.lightConeVertices, meshes.lightConeIndices, LIGHT_VOLUME_SECTORS);
+}
+
+bool SetUpRenderer(Renderer& renderer, int width, int height, float renderScale, int gbufferLayout)
+{
+    RendererMeshes meshes;
+    GenerateRendererMeshes(meshes);
+    return SetUpRenderer(renderer, width, height, renderScale, gbufferLayout, meshes);
+}
+
+bool SetUpRenderer(Renderer& renderer, int width, int height, float renderScale, int gbufferLayout, const RendererMeshes& meshes)
+{
+    renderer.outputWidth = std::max(1, width);
+    renderer.outputHeight = std::max(1, height);
+    renderer.renderScale = std::min(std::max(renderScale, MIN_RENDER_SCALE), MAX_RENDER_SCALE);
+    renderer.gbufferLayout = gbufferLayout;
+    renderer.isResizePending = false;
+    renderer.resizeRequestTime = 0.0;
+    renderer.lightCutoff = LIGHT_VOLUME_CUTOFF;
+    SetUpMaterials(renderer.materials);
+    renderer.usedMaterials = (1u << MAX_MATERIALS) - 1;
+    // mesh data first, render targets add the id texture to it
+    SetUpVisibilityBuffer(renderer.visibility, meshes.sphereVertices, meshes.sphereIndices);
+    renderer.reducedLighting.framebuffer = 0;
+    renderer.reducedLighting.color = 0;
+    if (!SetUpRenderTargets(renderer))
+        return false;
+
+    renderer.verticesS = meshes.sphereVertices;
+    renderer.indicesS = meshes.sphereIndices;
+
+    // Set up shaders, permutations are compiled on first use
+    SetUpShaderCache(renderer.shaders);
+    SetShaderSources(renderer.shaders, SHADER_GEOMETRY, geometryVS, geometryFS);
+    SetShaderSources(renderer.shaders, SHADER_LIGHTING, lightingVS, std::string(lightingCommonFS) + lightingMainFS);
+    // volumes are placed like any other mesh, depthVS does model / view / projection
+    SetShaderSources(renderer.shaders, SHADER_LIGHT_VOLUME, depthVS, std::string(lightingCommonFS) + lightVolumeMainFS);
+    SetShaderSources(renderer.shaders, SHADER_CLUSTERED, lightingVS, std::string(lightingCommonFS) + clusterCommonFS + clusteredMainFS);
+    SetShaderSources(renderer.shaders, SHADER_FORWARD, forwardVS, std::string(lightingCommonFS) + clusterCommonFS + forwardMainFS);
+    SetShaderSources(renderer.shaders, SHADER_DEPTH, depthVS, depthFS);
+    SetShaderSources(renderer.shaders, SHADER_FOG_VOLUME, lightingVS, std::string(lightingCommonFS) + fogVolumeMainFS);
+    SetShaderSources(renderer.shaders, SHADER_VISIBILITY, visibilityVS, visibilityFS);
+    SetShaderSources(renderer.shaders, SHADER_VISIBILITY_RESOLVE, lightingVS, std::string(lightingCommonFS) + clusterCommonFS + visibilityMainFS);
+    SetShaderSources(renderer.shaders, SHADER_UPSAMPLE, lightingVS, std::string(lightingCommonFS) + upsampleMainFS);
+    SetShaderSources(renderer.shaders, SHADER_BACKGROUND, backgroundVS, std::string(lightingCommonFS) + backgroundMainFS);
+    if (!SetUpLightClusters(renderer.lightClusters, 0))
+        return false;
+    // optional, fog stays analytic without it
+    SetUpVolumetricFog(renderer.fog);
+    // optional, lights stay unshadowed without it
+    SetUpShadowAtlas(renderer.shadows, renderer.verticesS);
+
+    // Set up cube VAO
+    renderer.cubeVAOs = SetUpCubeVAO();
+
+    // Set up Sphere VAO
+    renderer.SphereVAO = SetUpSphereVAO(renderer.verticesS, renderer.indicesS);
+    // Set up quad VAO
+    renderer.quadVAOs = SetUpQuad();
+
+    // Light volumes
+    renderer.lightSphereVAO = SetUpSphereVAO(meshes.lightSphereVertices, meshes.lightSphereIndices);
+    renderer.lightSphereIndexCount = meshes.lightSphereIndices.size();
+    renderer.lightConeVAO = SetUpSphereVAO(meshes.lightConeVertices, meshes.lightConeIndices);
+    renderer.lightConeIndexCount = meshes.lightConeIndices.size();
+    glBindVertexArray(0);
+
+    // GPU timing is optional, pipeline works without it
+    InitGpuTimer(renderer.gpuTimer);
+    SetUpFrameSync(renderer.frameSync, DEFAULT_FRAMES_IN_FLIGHT);
+    renderer.capture.isActive = false;
+    renderer.capture.encoders = nullptr;
+
+    if (!SetUpStatsOverlay(renderer.overlay, renderer.outputWidth, renderer.outputHeight))
+        std::cerr << "Stats overlay not available" << std::endl;
+    return true;
+}
+
+void DestroyRenderer(Renderer& renderer)
+{
+    glDeleteVertexArrays(1, &renderer.cubeVAOs.VAO);
+    glDeleteBuffers(1, &renderer.cubeVAOs.VBO);
+    glDeleteBuffers(1, &renderer.cubeVAOs.EBO);
+
+    glDeleteVertexArrays(1, &renderer.SphereVAO.VAO);
+    glDeleteBuffers(1, &renderer.SphereVAO.VBO);
+    glDeleteBuffers(1, &renderer.SphereVAO.EBO);
+
+    glDeleteVertexArrays(1, &renderer.quadVAOs.VAO);
+    glDeleteBuffers(1, &renderer.quadVAOs.VBO);
+    glDeleteBuffers(1, &renderer.quadVAOs.EBO);
+
+    VAOStruct lightVolumes[2] = { renderer.lightSphereVAO, renderer.lightConeVAO };
+    for (const VAOStruct& volume : lightVolumes)
+    {
+        glDeleteVertexArrays(1, &volume.VAO);
+        glDeleteBuffers(1, &volume.VBO);
+        glDeleteBuffers(1, &volume.EBO);
+    }
+
+    DestroyRenderTargets(renderer);
+
+    DestroyShaderCache(renderer.shaders);
+    DestroyLightClusters(renderer.lightClusters);
+    DestroyVolumetricFog(renderer.fog);
+    DestroyVisibilityBuffer(renderer.visibility);
+    DestroyShadowAtlas(renderer.shadows);
+
+    DestroyGpuTimer(renderer.gpuTimer);
+    DestroyStatsOverlay(renderer.overlay);
+    DestroyFrameSync(renderer.frameSync);
+}
+
+void RequestResize(Renderer& renderer, int width, int height)
+{
+    // minimized window reports 0 x 0, keep old targets
+    if (width <= 0 || height <= 0)
+        return;
+    renderer.outputWidth = width;
+    renderer.outputHeight = height;
+    renderer.isResizePending = true;
+    renderer.resizeRequestTime = glfwGetTime();
+}
+
+void SetRenderScale(Renderer& renderer, float renderScale)
+{
+    renderScale = std::min(std::max(renderScale, MIN_RENDER_SCALE), MAX_RENDER_SCALE);
+    if (renderScale == renderer.renderScale)
+        return;
+    renderer.renderScale = renderScale;
+    renderer.isResizePending = true;
+    renderer.resizeRequestTime = glfwGetTime();
+}
+
+void ApplyPendingResize(Renderer& renderer)
+{
+    if (!renderer.isResizePending || glfwGetTime() - renderer.resizeRequestTime < RESIZE_DEBOUNCE)
+        return;
+    renderer.isResizePending = false;
+
+    int width, height;
+    RenderSize(renderer, width, height);
+    if (width == renderer.gBuffer.width && height == renderer.gBuffer.height)
+        return;
+    RecreateRenderTargets(renderer);
+}
+
+bool RecreateRenderTargets(Renderer& renderer)
+{
+    PROFILE_ZONE("ResizeTargets");
+    renderer.isResizePending = false;
+    DestroyRenderTargets(renderer);
+    return SetUpRenderTargets(renderer);
+}
+
+static void CameraMatrices(const Renderer& renderer, const Camera& camera, glm::mat4& view, glm::mat4& projection)
+{
+    // window aspect, not g-buffer one - they differ while resize is debounced and the blit stretches it back
+    view = glm::lookAt(camera.position, camera.direction, camera.up);
+    projection = glm::perspective(glm::radians(45.0f), (float)renderer.outputWidth / renderer.outputHeight, 0.1f, 100.0f);
+}
+
+// Everything but light counts, LightingPass fills those
+static ShaderPermutation FramePermutation(const Renderer& renderer, const Weather& weather)
+{
+    ShaderPermutation permutation = {};
+    permutation.isFog = weather.isFog;
+    permutation.isDayLight = weather.isDayLight;
+    permutation.isOctahedral = GetGbufferLayoutInfo(renderer.gBuffer.layout).isOctahedral;
+    bool hasPhong = false;
+    bool hasBlinn = false;
+    for (int i = 0; i < MAX_MATERIALS; i++)
+        if (renderer.usedMaterials & (1u << i))
+            (renderer.materials[i].isBlinn ? hasBlinn : hasPhong) = true;
+    permutation.specularModel = hasPhong && hasBlinn ? SPECULAR_PER_MATERIAL : hasBlinn ? SPECULAR_BLINN : SPECULAR_PHONG;
+    return permutation;
+}
+
+// point, then spot, then directional lights (dropped at night) - order specialized programs expect
+// sceneIndices (optional) - where each sorted light is in lights
+static unsigned int SortLightsByType(const Light* lights, unsigned int lightCount, bool isDayLight, Light* sorted, ShaderPermutation& permutation,
+    unsigned int* sceneIndices = nullptr)
+{
+    const int types[3] = { 0, 2, 1 };
+    unsigned int* counts[3] = { &permutation.pointLights, &permutation.spotLights, &permutation.directionalLights };
+    unsigned int sortedCount = 0;
+    for (int t = 0; t < 3; t++)
+    {
+        *counts[t] = 0;
+        if (types[t] == 1 && !isDayLight)
+            continue;
+        for (unsigned int i = 0; i < lightCount; i++)
+            if (lights[i].type == types[t])
+            {
+                if (sceneIndices)
+                    sceneIndices[sortedCount] = i;
+                sorted[sortedCount++] = lights[i];
+                (*counts[t])++;
+            }
+    }
+    return sortedCount;
+}
+
+static const ShaderProgram& DepthProgram(Renderer& renderer)
+{
+    ShaderPermutation none = {};
+    return GetShaderProgram(renderer.shaders, SHADER_DEPTH, none);
+}
+
+// bit per material of scene objects, 0 always (empty pixels read it)
+static unsigned int SceneMaterials(const Scene& scene)
+{
+    unsigned int used = 1;
+    for (unsigned int i = 0; i < scene.cubeCount; i++)
+        used |= 1u << std::min(std::max(scene.cubes[i].material, 0), MAX_MATERIALS - 1);
+    for (unsigned int i = 0; i < scene.sphereCount; i++)
+        used |= 1u << std::min(std::max(scene.spheres[i].material, 0), MAX_MATERIALS - 1);
+    return used;
+}
+
+static bool IsVolumetricFog(const Renderer& renderer, const Weather& weather, const RenderState& state)
+{
+    return state.isVolumetricFog && weather.isFog && renderer.fog.isSetUp;
+}
+
+static bool IsShadows(const Renderer& renderer, const RenderState& state)
+{
+    return state.isShadows && renderer.shadows.isSetUp;
+}
+
+// Light arrays of the lighting programs hold MAX_LIGHTS, printed once per flag like the light
+// cluster / visibility buffer overflow
+static void ReportDroppedLights(bool& isReported, unsigned int count, const char* what)
+{
+    if (isReported || count <= MAX_LIGHTS)
+        return;
+    std::cerr << count << " " << what << ", only the first " << MAX_LIGHTS << " (MAX_LIGHTS) are used, rest is dropped" << std::endl;
+    isReported = true;
+}
+
+// Lights of the full screen quad (forward+ objects) and its permutation - all of them (up to
+// MAX_LIGHTS) in full screen mode, directional ones only when volumes / clusters do the rest
+static ShaderPermutation LightingPermutation(const Renderer& renderer, const Scene& scene, const RenderState& state, Light* lights, unsigned int& lightCount,
+    unsigned int* sceneIndices = nullptr)
+{
+    ShaderPermutation permutation = FramePermutation(renderer, scene.weather);
+    permutation.isVolumetricFog = IsVolumetricFog(renderer, scene.weather, state);
+    if (state.lightingMode == LIGHTING_FULL_SCREEN)
+    {
+        static bool isFullScreenReported = false;
+        ReportDroppedLights(isFullScreenReported, scene.lightCount, "lights with full screen lighting");
+        lightCount = SortLightsByType(scene.lights, std::min(scene.lightCount, (unsigned int)MAX_LIGHTS), scene.weather.isDayLight, lights, permutation, sceneIndices);
+        return permutation;
+    }
+
+    lightCount = 0;
+    if (scene.weather.isDayLight)
+        for (unsigned int i = 0; i < scene.lightCount && lightCount < MAX_LIGHTS; i++)
+            if (scene.lights[i].type == 1)
+            {
+                if (sceneIndices)
+                    sceneIndices[lightCount] = i;
+                lights[lightCount++] = scene.lights[i];
+            }
+    permutation.directionalLights = lightCount;
+    if (lightCount == MAX_LIGHTS)
+    {
+        // volumes / clusters take any number of point and spot lights, directional ones stay in the array
+        unsigned int directional = 0;
+        for (unsigned int i = 0; i < scene.lightCount; i++)
+            directional += scene.lights[i].type == 1;
+        static bool isDirectionalReported = false;
+        ReportDroppedLights(isDirectionalReported, directional, "directional lights");
+    }
+    if (state.lightingMode == LIGHTING_CLUSTERED || state.lightingMode == LIGHTING_FORWARD_PLUS || state.lightingMode == LIGHTING_VISIBILITY)
+        for (unsigned int i = 0; i < scene.lightCount && permutation.spotLights == 0; i++)
+            if (scene.lights[i].type == 2)
+                permutation.spotLights = 1;
+    return permutation;
+}
+
+// only full screen quad lighting can shade a subset of pixels
+static bool IsReducedLighting(const RenderState& state)
+{
+    return state.lightingResolution != LIGHTING_RESOLUTION_FULL
+        && (state.lightingMode == LIGHTING_FULL_SCREEN || state.lightingMode == LIGHTING_CLUSTERED);
+}
+
+void RequestFrameShaders(Renderer& renderer, const Scene& scene, const RenderState& state)
+{
+    PROFILE_ZONE("RequestFrameShaders");
+    renderer.materials[0].specPower = state.specPower;
+    renderer.materials[0].isBlinn = state.isBlinn;
+    renderer.usedMaterials = SceneMaterials(scene);
+    ShaderPermutation none = {};
+    if (state.isDepthPrepass || state.lightingMode == LIGHTING_VOLUMES || state.lightingMode == LIGHTING_FORWARD_PLUS || IsShadows(renderer, state))
+        RequestShaderProgram(renderer.shaders, SHADER_DEPTH, none);
+    if (state.lightingMode == LIGHTING_VISIBILITY)
+        RequestShaderProgram(renderer.shaders, SHADER_VISIBILITY, none);
+    else if (state.lightingMode != LIGHTING_FORWARD_PLUS)
+        RequestShaderProgram(renderer.shaders, SHADER_GEOMETRY, FramePermutation(renderer, scene.weather));
+    if (IsVolumetricFog(renderer, scene.weather, state))
+    {
+        Light lights[MAX_LIGHTS];
+        ShaderPermutation fog = FramePermutation(renderer, scene.weather);
+        SortLightsByType(scene.lights, std::min(scene.lightCount, (unsigned int)MAX_LIGHTS), scene.weather.isDayLight, lights, fog);
+        RequestShaderProgram(renderer.shaders, SHADER_FOG_VOLUME, fog);
+    }
+
+    Light lights[MAX_LIGHTS];
+    unsigned int lightCount;
+    ShaderPermutation permutation = LightingPermutation(renderer, scene, state, lights, lightCount);
+    const int kinds[LIGHTING_MODE_COUNT] = { SHADER_LIGHTING, SHADER_LIGHTING, SHADER_CLUSTERED, SHADER_FORWARD, SHADER_VISIBILITY_RESOLVE };
+    RequestShaderProgram(renderer.shaders, kinds[state.lightingMode], permutation);
+    if (state.lightingMode == LIGHTING_VOLUMES)
+        RequestShaderProgram(renderer.shaders, SHADER_LIGHT_VOLUME, permutation);
+    if (IsReducedLighting(state))
+        RequestShaderProgram(renderer.shaders, SHADER_UPSAMPLE, permutation);
+    if (state.lightingMode == LIGHTING_FORWARD_PLUS && permutation.isFog)
+        RequestShaderProgram(renderer.shaders, SHADER_BACKGROUND, permutation);
+}
+
+static bool IsRenderingToWindow(const Renderer& renderer, const RenderState& state)
+{
+    // light volumes need stencil and a copy of g-buffer depth, forward+ depth of its pre-pass,
+    // window framebuffer may have neither
+    return renderer.gBuffer.width == renderer.outputWidth && renderer.gBuffer.height == renderer.outputHeight
+        && state.lightingMode != LIGHTING_VOLUMES && state.lightingMode != LIGHTING_FORWARD_PLUS;
+}
+
+static void DepthPrepass(Renderer& renderer, Scene& scene, const glm::mat4& view, const glm::mat4& projection, float time)
+{
+    PROFILE_ZONE("DepthPrepass");
+    GpuTimerBeginPass(renderer.gpuTimer, GPU_PASS_DEPTH_PREPASS);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    const ShaderProgram& depth = DepthProgram(renderer);
+    glUseProgram(depth.program);
+    glUniformMatrix4fv(depth.depth.view, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(depth.depth.projection, 1, GL_FALSE, glm::value_ptr(projection));
+    for (unsigned int i = 0; i < scene.cubeCount; i++)
+        DepthPassCube(renderer.cubeVAOs, depth.depth, scene.cubes[i], time);
+    for (unsigned int i = 0; i < scene.sphereCount; i++)
+        DepthPassSphere(renderer.SphereVAO, depth.depth, scene.spheres[i], time, renderer.indicesS);
+    glBindVertexArray(0);
+
+    // g-buffer pass only touches fragments that won, depth is already final
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthFunc(GL_EQUAL);
+    glDepthMask(GL_FALSE);
+    CountersAdd(COUNTER_BYTES_STREAMED, 2 * sizeof(glm::mat4));
+    GpuTimerEndPass(renderer.gpuTimer, GPU_PASS_DEPTH_PREPASS);
+}
+
+static void VisibilityGeometryPass(Renderer& renderer, Scene& scene, const glm::mat4& view, const glm::mat4& projection, float time)
+{
+    GpuTimerBeginPass(renderer.gpuTimer, GPU_PASS_GEOMETRY);
+    glBindFramebuffer(GL_FRAMEBUFFER, renderer.visibility.framebuffer);
+    const GLuint noId[4] = { 0, 0, 0, 0 };
+    glClearBufferuiv(GL_COLOR, 0, noId);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    ShaderPermutation none = {};
+    const ShaderProgram& visibility = GetShaderProgram(renderer.shaders, SHADER_VISIBILITY, none);
+    UpdateVisibilityObjects(renderer.visibility, scene.cubes, scene.cubeCount, scene.spheres, scene.sphereCount, time, view, renderer.frameSync.frame);
+    renderer.usedMaterials = SceneMaterials(scene);
+    VisibilityPass(renderer.visibility, renderer.cubeVAOs, renderer.SphereVAO, renderer.indicesS.size(), visibility.program, visibility.visibility, projection);
+    GpuTimerEndPass(renderer.gpuTimer, GPU_PASS_GEOMETRY);
+}
+
+void GeometryPass(Renderer& renderer, Scene& scene, const RenderState& state, float time)
+{
+    PROFILE_ZONE("GeometryPass");
+    const bool isForward = state.lightingMode == LIGHTING_FORWARD_PLUS;
+    glBindFramebuffer(GL_FRAMEBUFFER, isForward ? renderer.sceneBuffer : renderer.gBuffer.buffer);
+    glViewport(0, 0, renderer.gBuffer.width, renderer.gBuffer.height);
+
+    glm::mat4 view, projection;
+    CameraMatrices(renderer, scene.cameras[state.currentCamera], view, projection);
+    // depth test stays GL_EQUAL for the forward pass in LightingPass
+    if (isForward)
+    {
+        DepthPrepass(renderer, scene, view, projection, time);
+        renderer.usedMaterials = SceneMaterials(scene);
+        return;
+    }
+    // ids only, a depth pre-pass would save nothing here
+    if (state.lightingMode == LIGHTING_VISIBILITY)
+    {
+        VisibilityGeometryPass(renderer, scene, view, projection, time);
+        return;
+    }
+    if (state.isDepthPrepass)
+        DepthPrepass(renderer, scene, view, projection, time);
+
+    GpuTimerBeginPass(renderer.gpuTimer, GPU_PASS_GEOMETRY);
+    if (!state.isDepthPrepass)
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    const ShaderProgram& geometry = GetShaderProgram(renderer.shaders, SHADER_GEOMETRY, FramePermutation(renderer, scene.weather));
+    glUseProgram(geometry.program);
+    if (geometry.geometry.isOctahedral >= 0)
+    {
+        glUniform1i(geometry.geometry.isOctahedral, GetGbufferLayoutInfo(renderer.gBuffer.layout).isOctahedral);
+        CountersAdd(COUNTER_BYTES_STREAMED, sizeof(int));
+    }
+    renderer.usedMaterials = SceneMaterials(scene);
+    for (unsigned int i = 0; i < scene.cubeCount; i++)
+        GeometryPassCube(renderer.cubeVAOs, geometry.program, geometry.geometry, scene.cubes[i], scene.weather, renderer.gBuffer, time, view, projection);
+    for (unsigned int i = 0; i < scene.sphereCount; i++)
+        GeometryPassSphere(renderer.SphereVAO, geometry.program, geometry.geometry, scene.spheres[i], scene.weather, renderer.gBuffer, time, renderer.indicesS, view, projection);
+    if (state.isDepthPrepass)
+    {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+    GpuTimerEndPass(renderer.gpuTimer, GPU_PASS_GEOMETRY);
+}
+
+// shadow value (atlas slot + 1) of scene light for lighting uniforms, 0 with shadows off
+static int LightShadow(const Renderer& renderer, const RenderState& state, unsigned int light)
+{
+    if (!IsShadows(renderer, state) || light >= renderer.shadows.lightShadows.size())
+        return 0;
+    return renderer.shadows.lightShadows[light];
+}
+
+// per scene light for clusters, nullptr - nothing shadowed
+static const int* ClusterShadows(const Renderer& renderer, const Scene& scene, const RenderState& state)
+{
+    if (!IsShadows(renderer, state) || renderer.shadows.lightShadows.size() != scene.lightCount)
+        return nullptr;
+    return renderer.shadows.lightShadows.data();
+}
+
+// lights[] of program come from LightingPermutation, sceneIndices map them back to scene lights
+static void BindShadows(Renderer& renderer, const RenderState& state, GLuint program, const ShadowUniforms& uniforms, const LightingUniforms& lighting,
+    const unsigned int* sceneIndices, unsigned int lightCount, const glm::mat4& view)
+{
+    int shadows[MAX_LIGHTS];
+    for (unsigned int i = 0; i < lightCount; i++)
+        shadows[i] = LightShadow(renderer, state, sceneIndices[i]);
+    BindShadowAtlas(renderer.shadows, program, uniforms, lighting, shadows, lightCount, view, IsShadows(renderer, state));
+}
+
+static void LightVolumesPass(Renderer& renderer, Scene& scene, const RenderState& state, const ShaderProgram& lightVolume, const glm::mat4& view, const glm::mat4& projection)
+{
+    PROFILE_ZONE("LightVolumes");
+    const int width = renderer.gBuffer.width;
+    const int height = renderer.gBuffer.height;
+    // stencil marking tests volume faces against scene depth
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, renderer.gBuffer.buffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, renderer.sceneBuffer);
+
+    const ShaderProgram& depth = DepthProgram(renderer);
+    glUseProgram(depth.program);
+    glUniformMatrix4fv(depth.depth.view, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(depth.depth.projection, 1, GL_FALSE, glm::value_ptr(projection));
+    BeginLightVolumes(lightVolume.program, lightVolume.lightVolume, renderer.gBuffer, scene.weather, view, projection, renderer.materials);
+
+    // back face behind scene surface +1, front face behind it -1, so stencil is non zero
+    // only where the surface is inside the volume (also with camera inside it)
+    glDepthMask(GL_FALSE);
+    glEnable(GL_STENCIL_TEST);
+    glEnable(GL_SCISSOR_TEST);
+    glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+    glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glCullFace(GL_FRONT);
+    CountersAdd(COUNTER_BYTES_STREAMED, 2 * sizeof(glm::mat4));
+
+    for (unsigned int i = 0; i < scene.lightCount; i++)
+    {
+        const Light& light = scene.lights[i];
+        LightVolume volume;
+        int x, y, w, h;
+        if (!GetLightVolume(light, view, renderer.lightCutoff, volume)
+            || !LightVolumeScissor(volume, view, projection, width, height, x, y, w, h))
+            continue;
+        const VAOStruct& mesh = volume.isCone ? renderer.lightConeVAO : renderer.lightSphereVAO;
+        const unsigned int indexCount = volume.isCone ? renderer.lightConeIndexCount : renderer.lightSphereIndexCount;
+
+        glScissor(x, y, w, h);
+        glClear(GL_STENCIL_BUFFER_BIT);
+        glUseProgram(depth.program);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glEnable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_BLEND);
+        glStencilFunc(GL_ALWAYS, 0, 0);
+        StencilPassLightVolume(mesh, indexCount, depth.depth, volume);
+
+        // back faces only, front ones are clipped away when camera is inside
+        glUseProgram(lightVolume.program);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_BLEND);
+        glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+        if (renderer.shadows.isUsed)
+            SetLightShadow(lightVolume.lightVolume.lighting.lights[0], LightShadow(renderer, state, i));
+        LightVolumePass(mesh, indexCount, lightVolume.lightVolume, light, volume, view);
+
+        // upper bound, stencil rejects pixels of the rect outside the volume
+        CountersAdd(COUNTER_LIGHTS_EVALUATED, (uint64_t)w * h);
+    }
+    glBindVertexArray(0);
+
+    glDisable(GL_BLEND);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_STENCIL_TEST);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+}
+
+void ShadowPass(Renderer& renderer, Scene& scene, const RenderState& state, float time)
+{
+    if (!IsShadows(renderer, state))
+        return;
+    PROFILE_ZONE("ShadowPass");
+    GpuTimerBeginPass(renderer.gpuTimer, GPU_PASS_SHADOWS);
+    glm::mat4 view, projection;
+    CameraMatrices(renderer, scene.cameras[state.currentCamera], view, projection);
+    renderer.shadows.isCacheEnabled = state.isShadowCache;
+    const ShaderProgram& depth = DepthProgram(renderer);
+    UpdateShadowAtlas(renderer.shadows, scene, renderer.cubeVAOs, renderer.SphereVAO, renderer.indicesS.size(), depth.program, depth.depth,
+        view, projection, renderer.lightCutoff, time);
+    GpuTimerEndPass(renderer.gpuTimer, GPU_PASS_SHADOWS);
+}
+
+void FogPass(Renderer& renderer, Scene& scene, const RenderState& state, float time)
+{
+    if (!IsVolumetricFog(renderer, scene.weather, state))
+        return;
+    PROFILE_ZONE("FogPass");
+    GpuTimerBeginPass(renderer.gpuTimer, GPU_PASS_FOG_VOLUME);
+    glm::mat4 view, projection;
+    CameraMatrices(renderer, scene.cameras[state.currentCamera], view, projection);
+    // first MAX_LIGHTS lights like full screen lighting, whatever the lighting mode
+    static bool isFogReported = false;
+    ReportDroppedLights(isFogReported, scene.lightCount, "lights in volumetric fog");
+    Light lights[MAX_LIGHTS];
+    ShaderPermutation permutation = FramePermutation(renderer, scene.weather);
+    unsigned int lightCount = SortLightsByType(scene.lights, std::min(scene.lightCount, (unsigned int)MAX_LIGHTS), scene.weather.isDayLight, lights, permutation);
+    const ShaderProgram& fogVolume = GetShaderProgram(renderer.shaders, SHADER_FOG_VOLUME, permutation);
+    UpdateVolumetricFog(renderer.fog, renderer.quadVAOs, fogVolume.program, fogVolume.lighting, fogVolume.fogVolume, lights, lightCount,
+        scene.weather, scene.isFogAnimated, time, view, projection);
+    GpuTimerEndPass(renderer.gpuTimer, GPU_PASS_FOG_VOLUME);
+}
+
+// Forward+ shading, scene framebuffer holds depth of the pre-pass and depth test is GL_EQUAL
+static void ForwardPass(Renderer& renderer, Scene& scene, const RenderState& state, const ShaderPermutation& permutation,
+    const Light* lights, const unsigned int* sceneIndices, unsigned int lightCount, const glm::mat4& view, const glm::mat4& projection, float time)
+{
+    PROFILE_ZONE("ForwardPass");
+    const ShaderProgram& forward = GetShaderProgram(renderer.shaders, SHADER_FORWARD, permutation);
+    AssignLightClusters(renderer.lightClusters, scene.lights, scene.lightCount, view, projection, renderer.lightCutoff, ClusterShadows(renderer, scene, state));
+    UploadLightClusters(renderer.lightClusters, renderer.frameSync.frame);
+    BindLightClusters(renderer.lightClusters, forward.program, forward.cluster, state.isClusterHeatmap);
+    BindVolumetricFog(renderer.fog, forward.program, forward.fog, permutation.isVolumetricFog);
+    BindShadows(renderer, state, forward.program, forward.shadow, forward.forward.lighting, sceneIndices, lightCount, view);
+    BeginForwardPass(forward.program, forward.forward, renderer.gBuffer, lights, lightCount, scene.weather, view, projection, renderer.materials);
+    for (unsigned int i = 0; i < scene.cubeCount; i++)
+        ForwardPassCube(renderer.cubeVAOs, forward.forward, scene.cubes[i], time);
+    for (unsigned int i = 0; i < scene.sphereCount; i++)
+        ForwardPassSphere(renderer.SphereVAO, forward.forward, scene.spheres[i], time, renderer.indicesS);
+    glBindVertexArray(0);
+    // deferred modes fog the background in their full screen quad, forward+ only drew objects
+    if (permutation.isFog)
+    {
+        const ShaderProgram& background = GetShaderProgram(renderer.shaders, SHADER_BACKGROUND, permutation);
+        BindVolumetricFog(renderer.fog, background.program, background.fog, permutation.isVolumetricFog);
+        ForwardBackgroundPass(renderer.quadVAOs, background.program, background.lighting, scene.weather, projection);
+    }
+
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    // pre-pass leaves one fragment per pixel, same bound as clustered full screen quad
+    CountersAdd(COUNTER_LIGHTS_EVALUATED, ClusterLightEvaluations(renderer.lightClusters, renderer.gBuffer.width, renderer.gBuffer.height));
+}
+
+void LightingPass(Renderer& renderer, Scene& scene, const RenderState& state, float time)
+{
+    PROFILE_ZONE("LightingPass");
+    GpuTimerBeginPass(renderer.gpuTimer, GPU_PASS_LIGHTING);
+    const bool isForward = state.lightingMode == LIGHTING_FORWARD_PLUS;
+    const bool isReduced = IsReducedLighting(state) && UpdateReducedLighting(renderer.reducedLighting, renderer.gBuffer, state.lightingResolution);
+    // draw counters of the lighting pass count shaded pixels
+    Gbuffer shaded = renderer.gBuffer;
+    if (isReduced)
+    {
+        shaded.width = renderer.reducedLighting.width;
+        shaded.height = renderer.reducedLighting.height;
+        glBindFramebuffer(GL_FRAMEBUFFER, renderer.reducedLighting.framebuffer);
+    }
+    else
+        glBindFramebuffer(GL_FRAMEBUFFER, IsRenderingToWindow(renderer, state) ? 0 : renderer.sceneBuffer);
+    glViewport(0, 0, shaded.width, shaded.height);
+    // forward+ draws over its pre-pass, color is cleared there
+    if (!isForward)
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    glm::mat4 view, projection;
+    CameraMatrices(renderer, scene.cameras[state.currentCamera], view, projection);
+    renderer.materials[0].specPower = state.specPower;
+    renderer.materials[0].isBlinn = state.isBlinn;
+    Light lights[MAX_LIGHTS];
+    unsigned int sceneIndices[MAX_LIGHTS];
+    unsigned int lightCount;
+    ShaderPermutation permutation = LightingPermutation(renderer, scene, state, lights, lightCount, sceneIndices);
+    if (isForward)
+    {
+        ForwardPass(renderer, scene, state, permutation, lights, sceneIndices, lightCount, view, projection, time);
+        GpuTimerEndPass(renderer.gpuTimer, GPU_PASS_LIGHTING);
+        return;
+    }
+    if (state.lightingMode == LIGHTING_FULL_SCREEN)
+    {
+        const ShaderProgram& lighting = GetShaderProgram(renderer.shaders, SHADER_LIGHTING, permutation);
+        BindVolumetricFog(renderer.fog, lighting.program, lighting.fog, permutation.isVolumetricFog);
+        BindShadingGrid(renderer.reducedLighting, lighting.program, lighting.shadingGrid, isReduced);
+        BindShadows(renderer, state, lighting.program, lighting.shadow, lighting.lighting, sceneIndices, lightCount, view);
+        LightingPassCube(renderer.quadVAOs, lighting.program, lighting.lighting, shaded, lights, lightCount, scene.weather,
+            view, projection, renderer.materials);
+    }
+    // full screen quad keeps ambient, fog and directional lights, the rest comes from volumes / clusters
+    else if (state.lightingMode == LIGHTING_VOLUMES)
+    {
+        const ShaderProgram& lighting = GetShaderProgram(renderer.shaders, SHADER_LIGHTING, permutation);
+        const ShaderProgram& lightVolume = GetShaderProgram(renderer.shaders, SHADER_LIGHT_VOLUME, permutation);
+        BindVolumetricFog(renderer.fog, lighting.program, lighting.fog, permutation.isVolumetricFog);
+        BindShadingGrid(renderer.reducedLighting, lighting.program, lighting.shadingGrid, false);
+        BindShadows(renderer, state, lighting.program, lighting.shadow, lighting.lighting, sceneIndices, lightCount, view);
+        LightingPassCube(renderer.quadVAOs, lighting.program, lighting.lighting, renderer.gBuffer, lights, lightCount, scene.weather,
+            view, projection, renderer.materials);
+        BindVolumetricFog(renderer.fog, lightVolume.program, lightVolume.fog, permutation.isVolumetricFog);
+        // light of each volume gets its slot in LightVolumesPass
+        BindShadows(renderer, state, lightVolume.program, lightVolume.shadow, lightVolume.lightVolume.lighting, sceneIndices, 0, view);
+        LightVolumesPass(renderer, scene, state, lightVolume, view, projection);
+    }
+    else
+    {
+        // visibility resolve shades like clustered, it only gets its attributes elsewhere
+        const bool isVisibility = state.lightingMode == LIGHTING_VISIBILITY;
+        const ShaderProgram& clustered = GetShaderProgram(renderer.shaders, isVisibility ? SHADER_VISIBILITY_RESOLVE : SHADER_CLUSTERED, permutation);
+        AssignLightClusters(renderer.lightClusters, scene.lights, scene.lightCount, view, projection, renderer.lightCutoff, ClusterShadows(renderer, scene, state));
+        UploadLightClusters(renderer.lightClusters, renderer.frameSync.frame);
+        BindLightClusters(renderer.lightClusters, clustered.program, clustered.cluster, state.isClusterHeatmap);
+        BindShadows(renderer, state, clustered.program, clustered.shadow, clustered.lighting, sceneIndices, lightCount, view);
+        if (isVisibility)
+            BindVisibilityBuffer(renderer.visibility, clustered.program, clustered.visibilityResolve);
+        else
+            BindShadingGrid(renderer.reducedLighting, clustered.program, clustered.shadingGrid, isReduced);
+        BindVolumetricFog(renderer.fog, clustered.program, clustered.fog, permutation.isVolumetricFog);
+        LightingPassCube(renderer.quadVAOs, clustered.program, clustered.lighting, shaded, lights, lightCount, scene.weather,
+            view, projection, renderer.materials);
+        CountersAdd(COUNTER_LIGHTS_EVALUATED, ClusterLightEvaluations(renderer.lightClusters, shaded.width, shaded.height));
+    }
+
+    if (isReduced)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, IsRenderingToWindow(renderer, state) ? 0 : renderer.sceneBuffer);
+        glViewport(0, 0, renderer.gBuffer.width, renderer.gBuffer.height);
+        // quad is depth tested like the lighting one, upsample writes every pixel so color can stay
+        glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        const ShaderProgram& upsample = GetShaderProgram(renderer.shaders, SHADER_UPSAMPLE, permutation);
+        UpsampleLighting(renderer.reducedLighting, renderer.quadVAOs, upsample.program, upsample.upsample, renderer.gBuffer, projection);
+    }
+    GpuTimerEndPass(renderer.gpuTimer, GPU_PASS_LIGHTING);
+}
+
+void PresentFrame(Renderer& renderer, const RenderState& state)
+{
+    if (!IsRenderingToWindow(renderer, state))
+    {
+        PROFILE_ZONE("Upscale");
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, renderer.sceneBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, renderer.gBuffer.width, renderer.gBuffer.height, 0, 0, renderer.outputWidth, renderer.outputHeight,
+            GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, renderer.outputWidth, renderer.outputHeight);
+    }
+    if (state.isOverlayVisible)
+    {
+        PROFILE_ZONE("StatsOverlay");
+        renderer.overlay.width = renderer.outputWidth;
+        renderer.overlay.height = renderer.outputHeight;
+        DrawStatsOverlay(renderer.overlay, renderer.gpuTimer.latest, renderer.frameSync.frame);
+    }
+}
+
+void RenderFrame(Renderer& renderer, Scene& scene, const RenderState& state, float time)
+{
+    BeginFrameSync(renderer.frameSync);
+    ApplyPendingResize(renderer);
+    GpuTimerBeginFrame(renderer.gpuTimer);
+    ShadowPass(renderer, scene, state, time);
+    GeometryPass(renderer, scene, state, time);
+    FogPass(renderer, scene, state, time);
+    LightingPass(renderer, scene, state, time);
+    PresentFrame(renderer, state);
+    GpuTimerEndFrame(renderer.gpuTimer);
+    if (renderer.capture.isActive)
+        CaptureReadback(renderer.capture, renderer.outputWidth, renderer.outputHeight);
+    EndFrameSync(renderer.frameSync);
+}
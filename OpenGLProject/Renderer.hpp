@@ -0,0 +1,158 @@
+#ifndef Renderer_hpp
+#define Renderer_hpp
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <vector>
+#include "Objects.hpp"
+#include "Scene.hpp"
+#include "ShaderSetUp.hpp"
+#include "GpuTimer.hpp"
+#include "StatsOverlay.hpp"
+#include "LightClusters.hpp"
+#include "ShaderCache.hpp"
+#include "VolumetricFog.hpp"
+#include "VisibilityBuffer.hpp"
+#include "ReducedLighting.hpp"
+#include "ShadowAtlas.hpp"
+#include "FrameSync.hpp"
+#include "FrameCapture.hpp"
+
+// seconds window size / render scale has to stay the same before targets are reallocated
+#define RESIZE_DEBOUNCE 0.2
+#define MIN_RENDER_SCALE 0.5f
+#define MAX_RENDER_SCALE 2.0f
+
+// How lighting pass handles point / spot lights, ambient, directional lights and fog
+// are always done by one full screen quad - except forward+, which has no g-buffer at all
+enum LightingMode
+{
+    LIGHTING_FULL_SCREEN = 0, // every light for every pixel, up to MAX_LIGHTS
+    LIGHTING_VOLUMES,         // stencil tested sphere / cone per light, additive
+    LIGHTING_CLUSTERED,       // full screen quad loops over lights of pixel cluster
+    LIGHTING_FORWARD_PLUS,    // depth pre-pass, then objects are drawn again and shaded with lights of their cluster
+    LIGHTING_VISIBILITY,      // ids instead of g-buffer, full screen pass rebuilds the triangle and shades like clustered
+    LIGHTING_MODE_COUNT
+};
+
+// CPU side meshes of the renderer, no GL calls - generated on a worker while the context is created
+struct RendererMeshes
+{
+    std::vector<float> sphereVertices;
+    std::vector<unsigned int> sphereIndices;
+    // unit sphere / cone for point / spot light volumes
+    std::vector<float> lightSphereVertices;
+    std::vector<unsigned int> lightSphereIndices;
+    std::vector<float> lightConeVertices;
+    std::vector<unsigned int> lightConeIndices;
+};
+
+// Everything the pipeline owns on GPU side
+struct Renderer
+{
+    Gbuffer gBuffer;
+    // lighting goes here when g-buffer size differs from window or light volumes / forward+
+    // are on, then it is blitted (scaled) to window
+    unsigned int sceneBuffer;
+    unsigned int sceneColor;
+    // depth / stencil for light volumes, g-buffer depth is copied in
+    unsigned int sceneDepth;
+    int outputWidth;
+    int outputHeight;
+    float renderScale;
+    int gbufferLayout;
+    bool isResizePending;
+    double resizeRequestTime;
+    // every program of the pipeline, geometry / lighting ones per feature combination
+    ShaderCache shaders;
+    LightClusters lightClusters;
+    VolumetricFog fog;
+    VisibilityBuffer visibility;
+    // made on first reduced resolution frame
+    ReducedLighting reducedLighting;
+    // spot / directional light shadow maps, optional like volumetric fog
+    ShadowAtlas shadows;
+    // light contribution dropped by light volumes / clusters, LIGHT_VOLUME_CUTOFF by default
+    float lightCutoff;
+    // indexed by Object::material, entry 0 follows RenderState (specPower / isBlinn keys)
+    Material materials[MAX_MATERIALS];
+    // bit per material drawn by last GeometryPass (0 always, empty pixels read it),
+    // lighting skips the per pixel phong / blinn branch when they all agree
+    unsigned int usedMaterials;
+    VAOStruct cubeVAOs;
+    VAOStruct SphereVAO;
+    VAOStruct quadVAOs;
+    // unit sphere / cone for point / spot light volumes
+    VAOStruct lightSphereVAO;
+    VAOStruct lightConeVAO;
+    unsigned int lightSphereIndexCount;
+    unsigned int lightConeIndexCount;
+    std::vector<float> verticesS;
+    std::vector<unsigned int> indicesS;
+    GpuTimer gpuTimer;
+    StatsOverlay overlay;
+    // fences of frames in flight, streamed buffers are written into frameSync.frame set
+    FrameSync frameSync;
+    // --capture, presented frames read back and encoded on worker threads
+    FrameCapture capture;
+};
+
+// Things changed from keyboard that are not part of the scene
+struct RenderState
+{
+    unsigned int currentCamera;
+    float specPower;
+    bool isBlinn;
+    bool isOverlayVisible;
+    // depth only pass first, then g-buffer pass shades just the visible fragments (GL_EQUAL),
+    // forward+ always has it
+    bool isDepthPrepass;
+    // LightingMode
+    int lightingMode;
+    // clustered / forward+ mode tints pixels by light count of their cluster
+    bool isClusterHeatmap;
+    // fog (when weather has it) lit by lights[] from froxel volume
+    bool isVolumetricFog;
+    // LightingResolution of full screen / clustered lighting
+    int lightingResolution;
+    // shadow maps for spot lights and first directional light (ShadowAtlas)
+    bool isShadows;
+    // false - shadow atlas is drawn from scratch every frame, no static depth cache
+    bool isShadowCache;
+};
+
+RenderState DefaultRenderState();
+const char* LightingModeName(int mode);
+bool ParseLightingMode(const std::string& name, int& mode);
+
+void GenerateRendererMeshes(RendererMeshes& meshes);
+// width, height - window framebuffer size, g-buffer is renderScale times that
+bool SetUpRenderer(Renderer& renderer, int width, int height, float renderScale, int gbufferLayout);
+bool SetUpRenderer(Renderer& renderer, int width, int height, float renderScale, int gbufferLayout, const RendererMeshes& meshes);
+void DestroyRenderer(Renderer& renderer);
+// Window size takes effect at once (output is stretched), targets are reallocated
+// only after RESIZE_DEBOUNCE seconds without another change
+void RequestResize(Renderer& renderer, int width, int height);
+void SetRenderScale(Renderer& renderer, float renderScale);
+void ApplyPendingResize(Renderer& renderer);
+// Reallocates targets right away for current size, renderScale and gbufferLayout
+bool RecreateRenderTargets(Renderer& renderer);
+
+// Starts compile of every program a frame of scene in state needs without waiting for any,
+// the driver builds them together (on its threads with GL_KHR_parallel_shader_compile)
+// instead of one by one when each pass asks for its program
+void RequestFrameShaders(Renderer& renderer, const Scene& scene, const RenderState& state);
+// forward+ - depth pre-pass into the scene framebuffer only
+void GeometryPass(Renderer& renderer, Scene& scene, const RenderState& state, float time);
+// shadow atlas, does nothing with shadows off
+void ShadowPass(Renderer& renderer, Scene& scene, const RenderState& state, float time);
+// froxel fog volume, does nothing without fog or with volumetric fog off
+void FogPass(Renderer& renderer, Scene& scene, const RenderState& state, float time);
+// forward+ - light clusters + objects drawn again and shaded (time places them like GeometryPass did)
+void LightingPass(Renderer& renderer, Scene& scene, const RenderState& state, float time);
+// upscale / downscale blit to window (when needed) + stats overlay
+void PresentFrame(Renderer& renderer, const RenderState& state);
+// RenderFrame = frame in flight wait + pending resize + GPU timer frame begin + ShadowPass + GeometryPass + FogPass + LightingPass
+// + PresentFrame + frame end (GPU timer, capture readback, fence)
+void RenderFrame(Renderer& renderer, Scene& scene, const RenderState& state, float time);
+
+#endif
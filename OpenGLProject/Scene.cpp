@@ -0,0 +1,852 @@
+#include "Scene.hpp"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <sys/stat.h>
+#include "Profiler.hpp"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(Object) == 44, "Object layout is part of the binary scene format");
+static_assert(sizeof(Light) == 40, "Light layout is part of the binary scene format");
+static_assert(sizeof(Camera) == 36, "Camera layout is part of the binary scene format");
+static_assert(sizeof(Animation) == 28, "Animation layout is part of the binary scene format");
+
+static const size_t sectionStrides[SECTION_COUNT] = {
+    sizeof(Object), sizeof(Object), sizeof(Light), sizeof(Camera), sizeof(Animation)
+};
+
+struct SceneData
+{
+    std::vector<Object> cubes;
+    std::vector<Object> spheres;
+    std::vector<Light> lights;
+    std::vector<Camera> cameras;
+    std::vector<Animation> animations;
+    Weather weather;
+    bool isFogAnimated;
+};
+
+static void UnmapScene(Scene& scene)
+{
+    if (!scene.mapping)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(scene.mapping);
+    CloseHandle((HANDLE)scene.mappingHandle);
+#else
+    munmap(scene.mapping, scene.mappingSize);
+#endif
+    scene.mapping = nullptr;
+    scene.mappingSize = 0;
+    scene.mappingHandle = nullptr;
+}
+
+void InitScene(Scene& scene)
+{
+    scene.cubes = nullptr;
+    scene.spheres = nullptr;
+    scene.lights = nullptr;
+    scene.cameras = nullptr;
+    scene.animations = nullptr;
+    scene.cubeCount = scene.sphereCount = scene.lightCount = scene.cameraCount = scene.animationCount = 0;
+    scene.weather.isDayLight = false;
+    scene.weather.isFog = false;
+    scene.weather.fogDensity = 0.8f;
+    scene.isFogAnimated = true;
+    scene.mapping = nullptr;
+    scene.mappingSize = 0;
+    scene.mappingHandle = nullptr;
+}
+
+void FreeScene(Scene& scene)
+{
+    UnmapScene(scene);
+    scene.blob.clear();
+    scene.blob.shrink_to_fit();
+    scene.loaded.clear();
+    scene.loaded.shrink_to_fit();
+    InitScene(scene);
+}
+
+static size_t SectionSize(const SceneHeader& header, int section)
+{
+    return (size_t)header.counts[section] * sectionStrides[section];
+}
+
+// Places sections one after another behind the header, offsets are 32 bit in the file
+static bool LayOutSections(SceneHeader& header, size_t& size)
+{
+    size = sizeof(SceneHeader);
+    for (int i = 0; i < SECTION_COUNT; i++)
+    {
+        if (size > UINT32_MAX)
+        {
+            std::cerr << "Scene too large for binary format (" << size << " bytes before section " << i << ")" << std::endl;
+            return false;
+        }
+        header.offsets[i] = (uint32_t)size;
+        size += SectionSize(header, i);
+    }
+    return true;
+}
+
+static bool ValidateBlob(const unsigned char* data, size_t size)
+{
+    if (size < sizeof(SceneHeader))
+        return false;
+    const SceneHeader* header = (const SceneHeader*)data;
+    if (header->magic != SCENE_MAGIC || header->version != SCENE_VERSION)
+        return false;
+    // renderer always reads camera 0, same rule as ParseSceneText
+    if (header->counts[SECTION_CAMERAS] == 0)
+        return false;
+    for (int i = 0; i < SECTION_COUNT; i++)
+    {
+        if (header->offsets[i] % 4 != 0 || header->offsets[i] > size)
+            return false;
+        if (SectionSize(*header, i) > size - header->offsets[i])
+            return false;
+    }
+    return true;
+}
+
+// Points the scene arrays into blob memory
+static void BindBlob(Scene& scene, unsigned char* data)
+{
+    const SceneHeader* header = (const SceneHeader*)data;
+    scene.cubes = (Object*)(data + header->offsets[SECTION_CUBES]);
+    scene.cubeCount = header->counts[SECTION_CUBES];
+    scene.spheres = (Object*)(data + header->offsets[SECTION_SPHERES]);
+    scene.sphereCount = header->counts[SECTION_SPHERES];
+    scene.lights = (Light*)(data + header->offsets[SECTION_LIGHTS]);
+    scene.lightCount = header->counts[SECTION_LIGHTS];
+    scene.cameras = (Camera*)(data + header->offsets[SECTION_CAMERAS]);
+    scene.cameraCount = header->counts[SECTION_CAMERAS];
+    scene.animations = (Animation*)(data + header->offsets[SECTION_ANIMATIONS]);
+    scene.animationCount = header->counts[SECTION_ANIMATIONS];
+    scene.weather.isDayLight = header->isDayLight != 0;
+    scene.weather.isFog = header->isFog != 0;
+    scene.weather.fogDensity = header->fogDensity;
+    scene.isFogAnimated = header->isFogAnimated != 0;
+}
+
+static bool BuildBlob(const SceneData& data, std::vector<unsigned char>& blob)
+{
+    SceneHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SCENE_MAGIC;
+    header.version = SCENE_VERSION;
+    header.counts[SECTION_CUBES] = (uint32_t)data.cubes.size();
+    header.counts[SECTION_SPHERES] = (uint32_t)data.spheres.size();
+    header.counts[SECTION_LIGHTS] = (uint32_t)data.lights.size();
+    header.counts[SECTION_CAMERAS] = (uint32_t)data.cameras.size();
+    header.counts[SECTION_ANIMATIONS] = (uint32_t)data.animations.size();
+    header.isDayLight = data.weather.isDayLight;
+    header.isFog = data.weather.isFog;
+    header.fogDensity = data.weather.fogDensity;
+    header.isFogAnimated = data.isFogAnimated;
+
+    size_t size;
+    if (!LayOutSections(header, size))
+        return false;
+
+    blob.assign(size, 0);
+    memcpy(blob.data(), &header, sizeof(header));
+    const void* sources[SECTION_COUNT] = {
+        data.cubes.data(), data.spheres.data(), data.lights.data(), data.cameras.data(), data.animations.data()
+    };
+    for (int i = 0; i < SECTION_COUNT; i++)
+        if (header.counts[i] > 0)
+            memcpy(blob.data() + header.offsets[i], sources[i], SectionSize(header, i));
+    return true;
+}
+
+static void AdoptBlob(Scene& scene, std::vector<unsigned char>& blob)
+{
+    UnmapScene(scene);
+    scene.blob.swap(blob);
+    BindBlob(scene, scene.blob.data());
+}
+
+static Object DefaultObject()
+{
+    Object object;
+    object.color = glm::vec3(1.0f);
+    object.position = glm::vec3(0.0f);
+    object.rotation = glm::vec3(0.0f);
+    object.scale = 1.0f;
+    object.material = 0;
+    return object;
+}
+
+void CreateDefaultAnimations(Animation* animations)
+{
+    Animation orbit = { ANIMATION_ORBIT, 1, 0, 0.5f, 0.3f, 1.0f, 1.0f };
+    Animation follow = { ANIMATION_FOLLOW, 2, 1, 0.0f, 0.0f, 1.0f, 3.0f };
+    Animation lookAt = { ANIMATION_LOOKAT, 1, 1, 0.0f, 0.0f, 1.0f, 1.0f };
+    Animation attach = { ANIMATION_ATTACH, 3, 1, 0.0f, 0.0f, 1.0f, 1.0f };
+    animations[0] = orbit;
+    animations[1] = follow;
+    animations[2] = lookAt;
+    animations[3] = attach;
+}
+
+void CreateDefaultScene(Scene& scene)
+{
+    SceneData data;
+
+    Light* lights = CreateLights();
+    data.lights.assign(lights, lights + 6);
+    delete[] lights;
+
+    Object* cubes = CubesGenerator();
+    data.cubes.assign(cubes, cubes + 100);
+    delete[] cubes;
+
+    Object* spheres = CreateSpheres();
+    data.spheres.assign(spheres, spheres + 3);
+    delete[] spheres;
+
+    Camera* cameras = CreateCameras();
+    data.cameras.assign(cameras, cameras + 4);
+    delete[] cameras;
+
+    data.animations.resize(DEFAULT_ANIMATION_COUNT);
+    CreateDefaultAnimations(data.animations.data());
+
+    data.weather.isDayLight = false;
+    data.weather.isFog = false;
+    data.weather.fogDensity = 0.8f;
+    data.isFogAnimated = true;
+
+    std::vector<unsigned char> blob;
+    BuildBlob(data, blob);
+    scene.loaded = blob;
+    AdoptBlob(scene, blob);
+    scene.path.clear();
+}
+
+bool AllocateScene(Scene& scene, const unsigned int counts[SECTION_COUNT])
+{
+    SceneHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SCENE_MAGIC;
+    header.version = SCENE_VERSION;
+    header.fogDensity = 0.8f;
+    header.isFogAnimated = 1;
+
+    for (int i = 0; i < SECTION_COUNT; i++)
+        header.counts[i] = counts[i];
+    size_t size;
+    if (!LayOutSections(header, size))
+        return false;
+
+    std::vector<unsigned char> blob(size);
+    memcpy(blob.data(), &header, sizeof(header));
+    scene.loaded.clear();
+    AdoptBlob(scene, blob);
+    scene.path.clear();
+    return true;
+}
+
+static bool ReadVec3(std::istringstream& stream, glm::vec3& v)
+{
+    return static_cast<bool>(stream >> v.x >> v.y >> v.z);
+}
+
+static bool ParseObject(std::istringstream& stream, Object& object)
+{
+    object = DefaultObject();
+    std::string key;
+    while (stream >> key)
+    {
+        bool ok;
+        if (key == "position")
+            ok = ReadVec3(stream, object.position);
+        else if (key == "rotation")
+            ok = ReadVec3(stream, object.rotation);
+        else if (key == "color")
+            ok = ReadVec3(stream, object.color);
+        else if (key == "scale")
+            ok = static_cast<bool>(stream >> object.scale);
+        else if (key == "material")
+            ok = (stream >> object.material) && object.material >= 0;
+        else
+            ok = false;
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+static bool ParseLight(std::istringstream& stream, Light& light)
+{
+    light.position = glm::vec3(0.0f);
+    light.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    light.color = glm::vec3(1.0f);
+    light.type = 0;
+    std::string key;
+    while (stream >> key)
+    {
+        bool ok;
+        if (key == "position")
+            ok = ReadVec3(stream, light.position);
+        else if (key == "direction")
+            ok = ReadVec3(stream, light.direction);
+        else if (key == "color")
+            ok = ReadVec3(stream, light.color);
+        else if (key == "type")
+        {
+            std::string type;
+            ok = static_cast<bool>(stream >> type);
+            if (type == "point")
+                light.type = 0;
+            else if (type == "directional")
+                light.type = 1;
+            else if (type == "spot")
+                light.type = 2;
+            else
+                ok = false;
+        }
+        else
+            ok = false;
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+static bool ParseCamera(std::istringstream& stream, Camera& camera)
+{
+    camera.position = glm::vec3(0.0f, 0.0f, 1.0f);
+    camera.direction = glm::vec3(0.0f);
+    camera.up = glm::vec3(0.0f, 1.0f, 0.0f);
+    std::string key;
+    while (stream >> key)
+    {
+        bool ok;
+        if (key == "position")
+            ok = ReadVec3(stream, camera.position);
+        else if (key == "direction")
+            ok = ReadVec3(stream, camera.direction);
+        else if (key == "up")
+            ok = ReadVec3(stream, camera.up);
+        else
+            ok = false;
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+static bool ParseAnimation(const std::string& kind, std::istringstream& stream, Animation& animation)
+{
+    animation.target = 0;
+    animation.source = 0;
+    animation.radius = 0.0f;
+    animation.height = 0.0f;
+    animation.speed = 1.0f;
+    animation.scale = 1.0f;
+    if (kind == "orbit")
+        animation.type = ANIMATION_ORBIT;
+    else if (kind == "follow")
+        animation.type = ANIMATION_FOLLOW;
+    else if (kind == "lookat")
+        animation.type = ANIMATION_LOOKAT;
+    else
+        animation.type = ANIMATION_ATTACH;
+
+    // first index names the animated entry, sphere index (if any) names the source
+    bool hasTarget = false;
+    std::string key;
+    while (stream >> key)
+    {
+        bool ok;
+        if ((key == "camera" || key == "light") && !hasTarget)
+            ok = hasTarget = static_cast<bool>(stream >> animation.target);
+        else if (key == "sphere" && animation.type == ANIMATION_ORBIT)
+            ok = hasTarget = static_cast<bool>(stream >> animation.target);
+        else if (key == "sphere")
+            ok = static_cast<bool>(stream >> animation.source);
+        else if (key == "radius")
+            ok = static_cast<bool>(stream >> animation.radius);
+        else if (key == "height")
+            ok = static_cast<bool>(stream >> animation.height);
+        else if (key == "speed")
+            ok = static_cast<bool>(stream >> animation.speed);
+        else if (key == "scale")
+            ok = static_cast<bool>(stream >> animation.scale);
+        else
+            ok = false;
+        if (!ok)
+            return false;
+    }
+    return hasTarget;
+}
+
+static bool ParseWeather(std::istringstream& stream, SceneData& data)
+{
+    std::string key;
+    while (stream >> key)
+    {
+        int flag = 0;
+        bool ok;
+        if (key == "daylight")
+        {
+            ok = static_cast<bool>(stream >> flag);
+            data.weather.isDayLight = flag != 0;
+        }
+        else if (key == "fog")
+        {
+            ok = static_cast<bool>(stream >> flag);
+            data.weather.isFog = flag != 0;
+        }
+        else if (key == "density")
+            ok = static_cast<bool>(stream >> data.weather.fogDensity);
+        else if (key == "animated")
+        {
+            ok = static_cast<bool>(stream >> flag);
+            data.isFogAnimated = flag != 0;
+        }
+        else
+            ok = false;
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+static bool ParseSceneText(const std::string& path, std::vector<unsigned char>& blob)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "Failed to open scene file " << path << std::endl;
+        return false;
+    }
+
+    SceneData data;
+    data.weather.isDayLight = false;
+    data.weather.isFog = false;
+    data.weather.fogDensity = 0.8f;
+    data.isFogAnimated = true;
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream stream(line);
+        std::string kind;
+        if (!(stream >> kind))
+            continue;
+
+        bool ok;
+        if (kind == "cube" || kind == "sphere")
+        {
+            Object object;
+            ok = ParseObject(stream, object);
+            (kind == "cube" ? data.cubes : data.spheres).push_back(object);
+        }
+        else if (kind == "light")
+        {
+            Light light;
+            ok = ParseLight(stream, light);
+            data.lights.push_back(light);
+        }
+        else if (kind == "camera")
+        {
+            Camera camera;
+            ok = ParseCamera(stream, camera);
+            data.cameras.push_back(camera);
+        }
+        else if (kind == "orbit" || kind == "follow" || kind == "lookat" || kind == "attach")
+        {
+            Animation animation;
+            ok = ParseAnimation(kind, stream, animation);
+            data.animations.push_back(animation);
+        }
+        else if (kind == "weather")
+            ok = ParseWeather(stream, data);
+        else
+            ok = false;
+
+        if (!ok)
+        {
+            std::cerr << path << ":" << lineNumber << ": invalid scene entry: " << line << std::endl;
+            return false;
+        }
+    }
+
+    if (data.cameras.empty())
+    {
+        std::cerr << path << ": scene needs at least one camera" << std::endl;
+        return false;
+    }
+
+    return BuildBlob(data, blob);
+}
+
+static bool IsBinaryScenePath(const std::string& path)
+{
+    const std::string extension = ".sceneb";
+    return path.size() >= extension.size() &&
+        path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+static bool ReadFileBytes(const std::string& path, std::vector<unsigned char>& bytes)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    std::streamoff size = file.tellg();
+    file.seekg(0);
+    bytes.resize((size_t)size);
+    return size == 0 || static_cast<bool>(file.read((char*)bytes.data(), size));
+}
+
+bool LoadSceneText(Scene& scene, const std::string& path)
+{
+    std::vector<unsigned char> blob;
+    if (!ParseSceneText(path, blob))
+        return false;
+    scene.loaded = blob;
+    AdoptBlob(scene, blob);
+    scene.path = path;
+    return true;
+}
+
+bool LoadSceneBinary(Scene& scene, const std::string& path)
+{
+    void* view = nullptr;
+    size_t size = 0;
+    void* handle = nullptr;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        std::cerr << "Failed to open scene file " << path << std::endl;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size = (size_t)fileSize.QuadPart;
+    HANDLE mapping = size > 0 ? CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+    if (mapping)
+    {
+        // FILE_MAP_COPY - animations write into the scene, never back to the file
+        view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        if (!view)
+            CloseHandle(mapping);
+        handle = mapping;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to open scene file " << path << std::endl;
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size = (size_t)st.st_size;
+    if (size > 0)
+    {
+        // MAP_PRIVATE - animations write into the scene, never back to the file
+        view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED)
+            view = nullptr;
+    }
+    close(fd);
+#endif
+    if (!view)
+    {
+        std::cerr << "Failed to map scene file " << path << std::endl;
+        return false;
+    }
+
+    if (!ValidateBlob((const unsigned char*)view, size))
+    {
+        std::cerr << "Invalid or outdated binary scene " << path << std::endl;
+#ifdef _WIN32
+        UnmapViewOfFile(view);
+        CloseHandle((HANDLE)handle);
+#else
+        munmap(view, size);
+#endif
+        return false;
+    }
+
+    UnmapScene(scene);
+    scene.blob.clear();
+    scene.blob.shrink_to_fit();
+    // copy of the file as loaded, the mapping itself changes as soon as animations or keys run
+    scene.loaded.assign((const unsigned char*)view, (const unsigned char*)view + size);
+    scene.mapping = view;
+    scene.mappingSize = size;
+    scene.mappingHandle = handle;
+    BindBlob(scene, (unsigned char*)view);
+    scene.path = path;
+    return true;
+}
+
+bool LoadScene(Scene& scene, const std::string& path)
+{
+    PROFILE_ZONE("LoadScene");
+    if (IsBinaryScenePath(path))
+        return LoadSceneBinary(scene, path);
+    return LoadSceneText(scene, path);
+}
+
+// Replaces the file in one step, a running instance may have the old one mapped and
+// truncating it in place would pull the pages out from under that mapping.
+static bool ReplaceSceneFile(const std::string& temp, const std::string& path)
+{
+#ifdef _WIN32
+    const bool isRenamed = MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    const bool isRenamed = std::rename(temp.c_str(), path.c_str()) == 0;
+#endif
+    if (!isRenamed)
+    {
+        std::cerr << "Failed to replace scene file " << path << std::endl;
+        std::remove(temp.c_str());
+    }
+    return isRenamed;
+}
+
+static bool WriteBlob(const std::vector<unsigned char>& blob, const std::string& path)
+{
+    const std::string temp = path + ".tmp";
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file.write((const char*)blob.data(), blob.size());
+    file.close();
+    if (!file)
+    {
+        std::cerr << "Failed to write scene file " << path << std::endl;
+        std::remove(temp.c_str());
+        return false;
+    }
+    return ReplaceSceneFile(temp, path);
+}
+
+bool CompileScene(const std::string& textPath, const std::string& binaryPath)
+{
+    std::vector<unsigned char> blob;
+    if (!ParseSceneText(textPath, blob))
+        return false;
+    return WriteBlob(blob, binaryPath);
+}
+
+bool SaveSceneBinary(const Scene& scene, const std::string& path)
+{
+    // written section by section straight from live arrays, big generated scenes are not copied
+    SceneHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SCENE_MAGIC;
+    header.version = SCENE_VERSION;
+    header.counts[SECTION_CUBES] = scene.cubeCount;
+    header.counts[SECTION_SPHERES] = scene.sphereCount;
+    header.counts[SECTION_LIGHTS] = scene.lightCount;
+    header.counts[SECTION_CAMERAS] = scene.cameraCount;
+    header.counts[SECTION_ANIMATIONS] = scene.animationCount;
+    header.isDayLight = scene.weather.isDayLight;
+    header.isFog = scene.weather.isFog;
+    header.fogDensity = scene.weather.fogDensity;
+    header.isFogAnimated = scene.isFogAnimated;
+    size_t size;
+    if (!LayOutSections(header, size))
+    {
+        std::cerr << "Failed to write scene file " << path << std::endl;
+        return false;
+    }
+
+    const void* sources[SECTION_COUNT] = { scene.cubes, scene.spheres, scene.lights, scene.cameras, scene.animations };
+    const std::string temp = path + ".tmp";
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file.write((const char*)&header, sizeof(header));
+    for (int i = 0; i < SECTION_COUNT; i++)
+        if (header.counts[i] > 0)
+            file.write((const char*)sources[i], SectionSize(header, i));
+    file.close();
+    if (!file)
+    {
+        std::cerr << "Failed to write scene file " << path << std::endl;
+        std::remove(temp.c_str());
+        return false;
+    }
+    return ReplaceSceneFile(temp, path);
+}
+
+int ReloadScene(Scene& scene)
+{
+    PROFILE_ZONE("ReloadScene");
+    if (scene.path.empty())
+        return -1;
+
+    std::vector<unsigned char> fresh;
+    if (IsBinaryScenePath(scene.path))
+    {
+        if (!ReadFileBytes(scene.path, fresh) || !ValidateBlob(fresh.data(), fresh.size()))
+        {
+            std::cerr << "Failed to reload scene " << scene.path << std::endl;
+            return -1;
+        }
+    }
+    else if (!ParseSceneText(scene.path, fresh))
+        return -1;
+
+    const SceneHeader* next = (const SceneHeader*)fresh.data();
+    const unsigned char* liveBase = scene.mapping ? (const unsigned char*)scene.mapping : scene.blob.data();
+    const SceneHeader* live = (const SceneHeader*)liveBase;
+
+    bool sameShape = memcmp(next->counts, live->counts, sizeof(next->counts)) == 0;
+    if (!sameShape)
+    {
+        // entries were added or removed, swap whole scene
+        scene.loaded = fresh;
+        AdoptBlob(scene, fresh);
+        return (int)(scene.cubeCount + scene.sphereCount + scene.lightCount + scene.cameraCount + scene.animationCount);
+    }
+
+    // diff against what was loaded last time, so runtime changes (keys, animations)
+    // survive for entries the edit did not touch
+    const bool hasSnapshot = scene.loaded.size() == fresh.size();
+    const unsigned char* previous = hasSnapshot ? scene.loaded.data() : liveBase;
+    const SceneHeader* previousHeader = (const SceneHeader*)previous;
+
+    unsigned char* targets[SECTION_COUNT] = {
+        (unsigned char*)scene.cubes, (unsigned char*)scene.spheres, (unsigned char*)scene.lights,
+        (unsigned char*)scene.cameras, (unsigned char*)scene.animations
+    };
+
+    int changed = 0;
+    for (int s = 0; s < SECTION_COUNT; s++)
+    {
+        const size_t stride = sectionStrides[s];
+        const unsigned char* oldEntries = previous + previousHeader->offsets[s];
+        const unsigned char* newEntries = fresh.data() + next->offsets[s];
+        for (uint32_t i = 0; i < next->counts[s]; i++)
+        {
+            if (memcmp(oldEntries + i * stride, newEntries + i * stride, stride) != 0)
+            {
+                memcpy(targets[s] + i * stride, newEntries + i * stride, stride);
+                changed++;
+            }
+        }
+    }
+
+    if (next->isDayLight != previousHeader->isDayLight || next->isFog != previousHeader->isFog ||
+        next->fogDensity != previousHeader->fogDensity || next->isFogAnimated != previousHeader->isFogAnimated)
+    {
+        scene.weather.isDayLight = next->isDayLight != 0;
+        scene.weather.isFog = next->isFog != 0;
+        scene.weather.fogDensity = next->fogDensity;
+        scene.isFogAnimated = next->isFogAnimated != 0;
+        changed++;
+    }
+
+    scene.loaded.swap(fresh);
+    return changed;
+}
+
+void AnimateScene(Scene& scene, float time)
+{
+    if (scene.isFogAnimated)
+        scene.weather.fogDensity = CalculateFogDensity(time);
+
+    for (unsigned int i = 0; i < scene.animationCount; i++)
+    {
+        const Animation& animation = scene.animations[i];
+        const unsigned int target = (unsigned int)animation.target;
+        const unsigned int source = (unsigned int)animation.source;
+        switch (animation.type)
+        {
+        case ANIMATION_ORBIT:
+            if (target < scene.sphereCount)
+            {
+                float angle = time * animation.speed;
+                scene.spheres[target].position = glm::vec3(sin(angle) * animation.radius, cos(angle) * animation.radius, animation.height);
+            }
+            break;
+        case ANIMATION_FOLLOW:
+            if (target < scene.cameraCount && source < scene.sphereCount)
+                scene.cameras[target].position = animation.scale * scene.spheres[source].position;
+            break;
+        case ANIMATION_LOOKAT:
+            if (target < scene.cameraCount && source < scene.sphereCount)
+                scene.cameras[target].direction = scene.spheres[source].position;
+            break;
+        case ANIMATION_ATTACH:
+            if (target < scene.lightCount && source < scene.sphereCount)
+                scene.lights[target].position = scene.spheres[source].position;
+            break;
+        }
+    }
+}
+
+// Modification time in nanoseconds (100 ns ticks on Windows) and size. Seconds alone miss
+// an editor saving twice within the same second, size catches most of what is left.
+static bool FileStamp(const std::string& path, long long& writeTime, long long& size)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes))
+        return false;
+    writeTime = ((long long)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+    size = ((long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+#ifdef __APPLE__
+    writeTime = (long long)st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    writeTime = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    size = (long long)st.st_size;
+#endif
+    return true;
+}
+
+SceneWatcher CreateSceneWatcher(const std::string& path, double interval)
+{
+    SceneWatcher watcher;
+    watcher.path = path;
+    if (!FileStamp(path, watcher.lastWriteTime, watcher.lastSize))
+        watcher.lastWriteTime = watcher.lastSize = -1;
+    watcher.lastCheck = 0.0;
+    watcher.interval = interval;
+    return watcher;
+}
+
+bool PollSceneWatcher(SceneWatcher& watcher, double now)
+{
+    if (watcher.path.empty() || now - watcher.lastCheck < watcher.interval)
+        return false;
+    watcher.lastCheck = now;
+
+    long long writeTime, size;
+    if (!FileStamp(watcher.path, writeTime, size))
+        return false;
+    if (writeTime == watcher.lastWriteTime && size == watcher.lastSize)
+        return false;
+    watcher.lastWriteTime = writeTime;
+    watcher.lastSize = size;
+    return true;
+}
@@ -0,0 +1,126 @@
+#ifndef Scene_hpp
+#define Scene_hpp
+#include <glm.hpp>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "Objects.hpp"
+
+// Scene description
+//  text form  (*.scene)  - one entry per line, see Documentation.txt
+//  binary form (*.sceneb) - SceneHeader followed by raw arrays of
+//                           Object / Light / Camera / Animation,
+//                           loaded by mapping the file into memory
+//
+// Both forms end up in the same blob layout, so the live scene always
+// points straight into one block of memory (no per object allocations).
+
+#define SCENE_MAGIC 0x424E4353u // "SCNB"
+#define SCENE_VERSION 2u
+
+enum AnimationType
+{
+    ANIMATION_ORBIT = 0,  // sphere[target] circles around z axis
+    ANIMATION_FOLLOW = 1, // camera[target] position = scale * sphere[source]
+    ANIMATION_LOOKAT = 2, // camera[target] looks at sphere[source]
+    ANIMATION_ATTACH = 3  // light[target] position = sphere[source]
+};
+
+struct Animation
+{
+    int type;
+    int target;
+    int source;
+    float radius;
+    float height;
+    float speed;
+    float scale;
+};
+
+enum SceneSection
+{
+    SECTION_CUBES = 0,
+    SECTION_SPHERES,
+    SECTION_LIGHTS,
+    SECTION_CAMERAS,
+    SECTION_ANIMATIONS,
+    SECTION_COUNT
+};
+
+struct SceneHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t counts[SECTION_COUNT];
+    uint32_t offsets[SECTION_COUNT];
+    uint32_t isDayLight;
+    uint32_t isFog;
+    float fogDensity;
+    uint32_t isFogAnimated;
+};
+
+struct Scene
+{
+    Object* cubes;
+    unsigned int cubeCount;
+    Object* spheres;
+    unsigned int sphereCount;
+    Light* lights;
+    unsigned int lightCount;
+    Camera* cameras;
+    unsigned int cameraCount;
+    Animation* animations;
+    unsigned int animationCount;
+    Weather weather;
+    bool isFogAnimated;
+
+    // storage - either an owned blob or a private (copy on write) file mapping
+    std::vector<unsigned char> blob;
+    void* mapping;
+    size_t mappingSize;
+    void* mappingHandle;
+
+    // last loaded file contents, used to compute diffs on reload
+    std::vector<unsigned char> loaded;
+    std::string path;
+};
+
+struct SceneWatcher
+{
+    std::string path;
+    long long lastWriteTime;
+    long long lastSize;
+    double lastCheck;
+    double interval;
+};
+
+void InitScene(Scene& scene);
+void FreeScene(Scene& scene);
+
+// Builds the scene that used to be hardcoded in main (CreateLights, CubesGenerator...)
+void CreateDefaultScene(Scene& scene);
+// Orbiting sphere 1 with cameras 1, 2 and light 3 tied to it
+#define DEFAULT_ANIMATION_COUNT 4
+void CreateDefaultAnimations(Animation* animations);
+// Allocates one zeroed blob for given entry counts (SceneSection order) and binds scene to it,
+// fails when the blob would not fit 32 bit section offsets
+bool AllocateScene(Scene& scene, const unsigned int counts[SECTION_COUNT]);
+
+bool LoadScene(Scene& scene, const std::string& path);
+bool LoadSceneText(Scene& scene, const std::string& path);
+bool LoadSceneBinary(Scene& scene, const std::string& path);
+bool CompileScene(const std::string& textPath, const std::string& binaryPath);
+bool SaveSceneBinary(const Scene& scene, const std::string& path);
+
+// Re-reads scene file and copies only changed entries into the live scene.
+// Returns number of entries that changed, -1 on error.
+int ReloadScene(Scene& scene);
+
+void AnimateScene(Scene& scene, float time);
+
+SceneWatcher CreateSceneWatcher(const std::string& path, double interval);
+// true when watched file was modified since last call
+bool PollSceneWatcher(SceneWatcher& watcher, double now);
+
+#endif
@@ -0,0 +1,235 @@
+#include "SceneGenerator.hpp"
+#include <thread>
+#include <algorithm>
+#include <vector>
+#include <sstream>
+#include "Profiler.hpp"
+
+// random streams, keep values fixed or generated scenes change
+#define STREAM_OBJECTS 0
+#define STREAM_CLUSTER_CENTERS 1
+#define STREAM_CLUSTERS 2
+#define STREAM_LIGHTS 3
+
+GeneratorSettings DefaultGeneratorSettings()
+{
+    // matches what CubesGenerator used to produce
+    GeneratorSettings settings;
+    settings.objectCount = 100;
+    settings.distribution = DISTRIBUTION_UNIFORM;
+    settings.clusterCount = 8;
+    settings.clusterRadius = 0.2f;
+    settings.boxMin = glm::vec3(-1.0f);
+    settings.boxMax = glm::vec3(0.9f);
+    settings.objectScale = 0.1f;
+    settings.lightCount = 6;
+    settings.lightTypes = LIGHT_TYPE_POINT | LIGHT_TYPE_DIRECTIONAL | LIGHT_TYPE_SPOT;
+    settings.seed = 1;
+    settings.threads = 0;
+    settings.staticFraction = 0.0f;
+    return settings;
+}
+
+static inline uint64_t Mix64(uint64_t z)
+{
+    // splitmix64 finalizer
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+uint64_t CounterRandom(uint64_t seed, uint64_t stream, uint64_t counter)
+{
+    uint64_t key = Mix64(seed ^ (stream * 0xd1b54a32d192ed03ULL));
+    return Mix64(key + counter * 0x9e3779b97f4a7c15ULL);
+}
+
+float CounterRandomFloat(uint64_t seed, uint64_t stream, uint64_t counter)
+{
+    // top 24 bits -> [0, 1), exact in float
+    return (float)(CounterRandom(seed, stream, counter) >> 40) * (1.0f / 16777216.0f);
+}
+
+static inline glm::vec3 RandomInBox(uint64_t seed, uint64_t stream, uint64_t counter, glm::vec3 boxMin, glm::vec3 boxMax)
+{
+    glm::vec3 t(CounterRandomFloat(seed, stream, counter),
+        CounterRandomFloat(seed, stream, counter + 1),
+        CounterRandomFloat(seed, stream, counter + 2));
+    return boxMin + t * (boxMax - boxMin);
+}
+
+template <typename Function>
+static void ParallelFor(unsigned int count, unsigned int threads, Function function)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned int minChunk = 16384;
+    threads = std::min(threads, std::max(1u, count / minChunk));
+    if (threads <= 1)
+    {
+        function(0u, count);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    const unsigned int chunk = (count + threads - 1) / threads;
+    for (unsigned int t = 1; t < threads; t++)
+    {
+        unsigned int begin = std::min(count, t * chunk);
+        unsigned int end = std::min(count, begin + chunk);
+        workers.push_back(std::thread(function, begin, end));
+    }
+    function(0u, std::min(count, chunk));
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void GenerateObjects(const GeneratorSettings& settings, Object* objects)
+{
+    const uint64_t seed = settings.seed;
+    const unsigned int clusterCount = std::max(1u, settings.clusterCount);
+
+    std::vector<glm::vec3> centers;
+    if (settings.distribution == DISTRIBUTION_CLUSTERED)
+        for (unsigned int c = 0; c < clusterCount; c++)
+            centers.push_back(RandomInBox(seed, STREAM_CLUSTER_CENTERS, (uint64_t)c * 4, settings.boxMin, settings.boxMax));
+
+    unsigned int gridSide = 1;
+    while ((uint64_t)gridSide * gridSide * gridSide < settings.objectCount)
+        gridSide++;
+    const glm::vec3 cell = (settings.boxMax - settings.boxMin) / (float)gridSide;
+
+    ParallelFor(settings.objectCount, settings.threads, [&](unsigned int begin, unsigned int end)
+    {
+        PROFILE_ZONE("GenerateObjects");
+        for (unsigned int i = begin; i < end; i++)
+        {
+            const uint64_t counter = (uint64_t)i * 8;
+            Object object;
+            object.color = glm::vec3(1.0f, 1.0f, 1.0f);
+            object.scale = settings.objectScale;
+            object.material = 0;
+            object.rotation = RandomInBox(seed, STREAM_OBJECTS, counter + 3, glm::vec3(-1.0f), glm::vec3(1.0f));
+            // own counter, rotations of the other objects stay what they were
+            if (CounterRandomFloat(seed, STREAM_OBJECTS, counter + 6) < settings.staticFraction)
+                object.rotation = glm::vec3(0.0f);
+
+            switch (settings.distribution)
+            {
+            case DISTRIBUTION_CLUSTERED:
+            {
+                const glm::vec3& center = centers[CounterRandom(seed, STREAM_CLUSTERS, counter) % clusterCount];
+                // sum of two uniforms - denser near cluster center
+                glm::vec3 a = RandomInBox(seed, STREAM_CLUSTERS, counter + 1, glm::vec3(-0.5f), glm::vec3(0.5f));
+                glm::vec3 b = RandomInBox(seed, STREAM_CLUSTERS, counter + 4, glm::vec3(-0.5f), glm::vec3(0.5f));
+                object.position = center + (a + b) * settings.clusterRadius;
+                break;
+            }
+            case DISTRIBUTION_GRID:
+            {
+                unsigned int x = i % gridSide;
+                unsigned int y = (i / gridSide) % gridSide;
+                unsigned int z = i / (gridSide * gridSide);
+                object.position = settings.boxMin + (glm::vec3((float)x, (float)y, (float)z) + 0.5f) * cell;
+                break;
+            }
+            default:
+                object.position = RandomInBox(seed, STREAM_OBJECTS, counter, settings.boxMin, settings.boxMax);
+                break;
+            }
+            objects[i] = object;
+        }
+    });
+}
+
+void GenerateLights(const GeneratorSettings& settings, Light* lights)
+{
+    int types[3];
+    int typeCount = 0;
+    if (settings.lightTypes & LIGHT_TYPE_POINT)
+        types[typeCount++] = 0;
+    if (settings.lightTypes & LIGHT_TYPE_DIRECTIONAL)
+        types[typeCount++] = 1;
+    if (settings.lightTypes & LIGHT_TYPE_SPOT)
+        types[typeCount++] = 2;
+    if (typeCount == 0)
+        types[typeCount++] = 0;
+
+    const uint64_t seed = settings.seed;
+    ParallelFor(settings.lightCount, settings.threads, [&](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int i = begin; i < end; i++)
+        {
+            const uint64_t counter = (uint64_t)i * 16;
+            Light light;
+            light.type = types[CounterRandom(seed, STREAM_LIGHTS, counter) % typeCount];
+            light.position = RandomInBox(seed, STREAM_LIGHTS, counter + 1, settings.boxMin, settings.boxMax);
+            light.color = RandomInBox(seed, STREAM_LIGHTS, counter + 4, glm::vec3(0.2f), glm::vec3(1.0f));
+            glm::vec3 direction = RandomInBox(seed, STREAM_LIGHTS, counter + 7, glm::vec3(-0.5f), glm::vec3(0.5f));
+            // spots point down like the one on moving sphere, sun shines from above
+            direction.z = light.type == 1 ? 1.0f : -1.0f;
+            light.direction = glm::normalize(direction);
+            lights[i] = light;
+        }
+    });
+}
+
+bool GenerateScene(const GeneratorSettings& settings, Scene& scene)
+{
+    PROFILE_ZONE("GenerateScene");
+    unsigned int counts[SECTION_COUNT];
+    counts[SECTION_CUBES] = settings.objectCount;
+    counts[SECTION_SPHERES] = 3;
+    counts[SECTION_LIGHTS] = settings.lightCount;
+    counts[SECTION_CAMERAS] = 4;
+    counts[SECTION_ANIMATIONS] = DEFAULT_ANIMATION_COUNT;
+    if (!AllocateScene(scene, counts))
+        return false;
+
+    GenerateObjects(settings, scene.cubes);
+    GenerateLights(settings, scene.lights);
+
+    Object* spheres = CreateSpheres();
+    std::copy(spheres, spheres + 3, scene.spheres);
+    delete[] spheres;
+
+    Camera* cameras = CreateCameras();
+    std::copy(cameras, cameras + 4, scene.cameras);
+    delete[] cameras;
+
+    CreateDefaultAnimations(scene.animations);
+    return true;
+}
+
+bool ParseDistribution(const std::string& name, int& distribution)
+{
+    if (name == "uniform")
+        distribution = DISTRIBUTION_UNIFORM;
+    else if (name == "clustered")
+        distribution = DISTRIBUTION_CLUSTERED;
+    else if (name == "grid")
+        distribution = DISTRIBUTION_GRID;
+    else
+        return false;
+    return true;
+}
+
+bool ParseLightTypes(const std::string& names, unsigned int& types)
+{
+    // comma separated list, e.g. "point,spot"
+    types = 0;
+    std::istringstream stream(names);
+    std::string name;
+    while (std::getline(stream, name, ','))
+    {
+        if (name == "point")
+            types |= LIGHT_TYPE_POINT;
+        else if (name == "directional")
+            types |= LIGHT_TYPE_DIRECTIONAL;
+        else if (name == "spot")
+            types |= LIGHT_TYPE_SPOT;
+        else
+            return false;
+    }
+    return types != 0;
+}
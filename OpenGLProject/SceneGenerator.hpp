@@ -0,0 +1,55 @@
+#ifndef SceneGenerator_hpp
+#define SceneGenerator_hpp
+#include <glm.hpp>
+#include <cstdint>
+#include "Objects.hpp"
+#include "Scene.hpp"
+
+// Deterministic scene generator for stress tests.
+// Every value is a pure function of (seed, index), so output is bit identical
+// for any thread count and between runs.
+
+enum Distribution
+{
+    DISTRIBUTION_UNIFORM = 0,
+    DISTRIBUTION_CLUSTERED = 1,
+    DISTRIBUTION_GRID = 2
+};
+
+// bit mask of Light::type values generator may use
+#define LIGHT_TYPE_POINT (1u << 0)
+#define LIGHT_TYPE_DIRECTIONAL (1u << 1)
+#define LIGHT_TYPE_SPOT (1u << 2)
+
+struct GeneratorSettings
+{
+    unsigned int objectCount;
+    int distribution;
+    unsigned int clusterCount;
+    float clusterRadius;
+    glm::vec3 boxMin;
+    glm::vec3 boxMax;
+    float objectScale;
+    unsigned int lightCount;
+    unsigned int lightTypes;
+    uint64_t seed;
+    unsigned int threads; // 0 = hardware concurrency
+    // share of objects generated without rotation, they count as static for shadow caching
+    float staticFraction;
+};
+
+GeneratorSettings DefaultGeneratorSettings();
+
+// counter based generator - n-th random number of given seed and stream
+uint64_t CounterRandom(uint64_t seed, uint64_t stream, uint64_t counter);
+float CounterRandomFloat(uint64_t seed, uint64_t stream, uint64_t counter);
+
+void GenerateObjects(const GeneratorSettings& settings, Object* objects);
+void GenerateLights(const GeneratorSettings& settings, Light* lights);
+// objects become cubes, spheres / cameras / animations are the default ones
+bool GenerateScene(const GeneratorSettings& settings, Scene& scene);
+
+bool ParseDistribution(const std::string& name, int& distribution);
+bool ParseLightTypes(const std::string& names, unsigned int& types);
+
+#endif
@@ -0,0 +1,427 @@
+#include "Settings.hpp"
+#include <iostream>
+#include <sstream>
+#include <type_traits>
+
+template <typename T>
+static bool ParseNumber(const std::string& text, T& value)
+{
+    // stream >> unsigned accepts "-1" and wraps it to the maximum value
+    if (std::is_unsigned<T>::value && text.find('-') != std::string::npos)
+        return false;
+    std::istringstream stream(text);
+    return (stream >> value) && stream.eof();
+}
+
+void PrintUsage()
+{
+    std::cerr << "Usage: OpenGLProject [scene file] [options]\n"
+        << "  --compile in.scene out.sceneb   compile text scene to binary and exit\n"
+        << "  --save out.sceneb               save loaded or generated scene and exit\n"
+        << "  --objects N                     generate scene with N cubes\n"
+        << "  --distribution uniform|clustered|grid\n"
+        << "  --clusters N                    cluster count for clustered distribution\n"
+        << "  --lights N                      generated light count\n"
+        << "  --light-types point,directional,spot\n"
+        << "  --seed N                        generator seed\n"
+        << "  --static-objects F              fraction of generated cubes that do not spin (default 0)\n"
+        << "  --threads N                     generator threads (0 = all cores)\n"
+        << "  --render-scale S                internal resolution scale, 0.5 - 2 (default 1)\n"
+        << "  --gbuffer-layout rgb16f|rg16|rgb10a2  normal format in g-buffer (default rg16)\n"
+        << "  --depth-prepass                 depth only pass before g-buffer pass\n"
+        << "  --lighting full|volumes|clustered|forward|visibility  how point / spot lights are shaded (default full)\n"
+        << "  --light-volumes                 same as --lighting volumes\n"
+        << "  --lighting-resolution full|half|quarter|checkerboard  pixels full screen / clustered lighting shades (default full)\n"
+        << "  --volumetric-fog                fog lit by scene lights from a froxel volume\n"
+        << "  --shadows                       shadow maps for spot lights and cascades for the sun\n"
+        << "  --no-shadow-cache               draw static shadow casters every frame too\n"
+        << "  --light-cutoff F                light contribution ignored by volumes / clusters (default 1/256)\n"
+        << "  --cluster-threads N             threads assigning lights to clusters (0 = all cores)\n"
+        << "  --no-shader-permutations        uber shaders with runtime branches instead of specialized programs\n"
+        << "  --shader-cache dir              program binary cache directory (default shader_cache)\n"
+        << "  --no-shader-cache               always compile shaders from source\n"
+        << "  --vsync driver|off|on|adaptive  swap interval (default driver, benchmark / regression too)\n"
+        << "  --fps-limit N                   frame limiter, 0 = off (default)\n"
+        << "  --low-latency                   wait before sampling input instead of after it, drain GPU every frame\n"
+        << "  --latency-log file.csv          per frame input / present times, one row per frame\n"
+        << "  --frames-in-flight N            frames recorded before GPU finished them, 1 - 3 (default 2)\n"
+        << "  --capture dir|file.y4m          record presented frames as PNG files in dir or a Y4M video\n"
+        << "  --capture-fps N                 frame rate written in Y4M header (default 60)\n"
+        << "  --capture-threads N             capture encoder threads (default half the cores)\n"
+        << "  --headless                      render offscreen, no window\n"
+        << "  --benchmark N                   render N frames with fixed clock, print JSON report\n"
+        << "  --benchmark-output file.json    write report to file\n"
+        << "  --warmup N                      frames rendered before measuring (default 30)\n"
+        << "  --time-step S                   simulated seconds per frame (default 1/60)\n"
+        << "  --gbuffer-compare               with --benchmark, measure every g-buffer layout at 4 render scales\n"
+        << "  --prepass-compare               with --benchmark, measure scene with and without depth pre-pass\n"
+        << "  --forward-compare               with --benchmark, deferred vs forward+ over object / light counts and render scales\n"
+        << "  --lighting-resolution-compare   with --benchmark, lighting time and PSNR of every lighting resolution\n"
+        << "  --frames-in-flight-compare      with --benchmark, pipelined frame time and fence stalls for 1 - 3 frames in flight\n"
+        << "  --budget draw=N,sync=0          GL calls allowed per benchmark frame, fails when exceeded\n"
+        << "  --regress dir                   render canonical scenes, compare with goldens and baseline in dir\n"
+        << "  --update-golden                 with --regress, store current images and times as new goldens\n"
+        << "  --regress-threshold R           allowed relative growth of times / counters (default 0.1)\n"
+        << "  --pixel-threshold T             perceptual color difference of a pixel, 0..1 (default 0.1)\n"
+        << "  --max-diff-pixels F             allowed fraction of differing pixels (default 0.001)\n"
+        << "  --trace file.json               write Chrome trace of profiler zones on exit\n"
+        << "  --no-profiler                   disable profiler zones\n"
+        << "  --metrics file.prom|file.csv    export render counters (Prometheus text or CSV)\n"
+        << "  --metrics-interval S            seconds between exports (default 1)" << std::endl;
+}
+
+bool ParseSettings(int argc, char** argv, AppSettings& settings)
+{
+    settings.isGenerated = false;
+    settings.generator = DefaultGeneratorSettings();
+    settings.isHeadless = false;
+    settings.renderScale = 1.0f;
+    settings.gbufferLayout = GBUFFER_LAYOUT_RG16;
+    settings.isDepthPrepass = false;
+    settings.lightingMode = LIGHTING_FULL_SCREEN;
+    settings.isVolumetricFog = false;
+    settings.isShadows = false;
+    settings.isShadowCache = true;
+    settings.lightingResolution = LIGHTING_RESOLUTION_FULL;
+    settings.clusterThreads = 0;
+    settings.isShaderPermutations = true;
+    settings.shaderCacheDirectory = "shader_cache";
+    settings.lightCutoff = LIGHT_VOLUME_CUTOFF;
+    settings.isProfilerEnabled = true;
+    settings.benchmark = DefaultBenchmarkSettings();
+    settings.metricsInterval = 1.0;
+    settings.regression = DefaultRegressionSettings();
+    settings.pacing = DefaultPacingSettings();
+    settings.framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+    settings.capture = DefaultCaptureSettings();
+    bool hasFrames = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        std::string value = hasValue ? argv[i + 1] : "";
+        bool ok = hasValue;
+
+        if (arg == "--compile")
+        {
+            ok = i + 2 < argc;
+            if (ok)
+            {
+                settings.compileInput = argv[i + 1];
+                settings.compileOutput = argv[i + 2];
+                i += 2;
+            }
+        }
+        else if (arg == "--save")
+        {
+            settings.savePath = value;
+            i++;
+        }
+        else if (arg == "--objects")
+        {
+            ok = ok && ParseNumber(value, settings.generator.objectCount);
+            settings.isGenerated = true;
+            i++;
+        }
+        else if (arg == "--distribution")
+        {
+            ok = ok && ParseDistribution(value, settings.generator.distribution);
+            settings.isGenerated = true;
+            i++;
+        }
+        else if (arg == "--clusters")
+        {
+            ok = ok && ParseNumber(value, settings.generator.clusterCount);
+            settings.isGenerated = true;
+            i++;
+        }
+        else if (arg == "--lights")
+        {
+            ok = ok && ParseNumber(value, settings.generator.lightCount);
+            settings.isGenerated = true;
+            i++;
+        }
+        else if (arg == "--light-types")
+        {
+            ok = ok && ParseLightTypes(value, settings.generator.lightTypes);
+            settings.isGenerated = true;
+            i++;
+        }
+        else if (arg == "--seed")
+        {
+            ok = ok && ParseNumber(value, settings.generator.seed);
+            settings.isGenerated = true;
+            i++;
+        }
+        else if (arg == "--static-objects")
+        {
+            ok = ok && ParseNumber(value, settings.generator.staticFraction) && settings.generator.staticFraction >= 0.0f && settings.generator.staticFraction <= 1.0f;
+            settings.isGenerated = true;
+            i++;
+        }
+        else if (arg == "--threads")
+        {
+            ok = ok && ParseNumber(value, settings.generator.threads);
+            i++;
+        }
+        else if (arg == "--render-scale")
+        {
+            ok = ok && ParseNumber(value, settings.renderScale) && settings.renderScale >= MIN_RENDER_SCALE && settings.renderScale <= MAX_RENDER_SCALE;
+            i++;
+        }
+        else if (arg == "--gbuffer-layout")
+        {
+            ok = ok && ParseGbufferLayout(value, settings.gbufferLayout);
+            i++;
+        }
+        else if (arg == "--depth-prepass")
+        {
+            settings.isDepthPrepass = true;
+            ok = true;
+        }
+        else if (arg == "--lighting")
+        {
+            ok = ok && ParseLightingMode(value, settings.lightingMode);
+            i++;
+        }
+        else if (arg == "--lighting-resolution")
+        {
+            ok = ok && ParseLightingResolution(value, settings.lightingResolution);
+            i++;
+        }
+        else if (arg == "--light-volumes")
+        {
+            settings.lightingMode = LIGHTING_VOLUMES;
+            ok = true;
+        }
+        else if (arg == "--volumetric-fog")
+        {
+            settings.isVolumetricFog = true;
+            ok = true;
+        }
+        else if (arg == "--shadows")
+        {
+            settings.isShadows = true;
+            ok = true;
+        }
+        else if (arg == "--no-shadow-cache")
+        {
+            settings.isShadowCache = false;
+            ok = true;
+        }
+        else if (arg == "--cluster-threads")
+        {
+            ok = ok && ParseNumber(value, settings.clusterThreads);
+            i++;
+        }
+        else if (arg == "--no-shader-permutations")
+        {
+            settings.isShaderPermutations = false;
+            ok = true;
+        }
+        else if (arg == "--shader-cache")
+        {
+            ok = ok && !value.empty();
+            settings.shaderCacheDirectory = value;
+            i++;
+        }
+        else if (arg == "--no-shader-cache")
+        {
+            settings.shaderCacheDirectory.clear();
+            ok = true;
+        }
+        else if (arg == "--light-cutoff")
+        {
+            ok = ok && ParseNumber(value, settings.lightCutoff) && settings.lightCutoff > 0.0f;
+            i++;
+        }
+        else if (arg == "--prepass-compare")
+        {
+            settings.benchmark.isDepthPrepassComparison = true;
+            ok = true;
+        }
+        else if (arg == "--forward-compare")
+        {
+            settings.benchmark.isForwardComparison = true;
+            ok = true;
+        }
+        else if (arg == "--lighting-resolution-compare")
+        {
+            settings.benchmark.isLightingResolutionComparison = true;
+            ok = true;
+        }
+        else if (arg == "--vsync")
+        {
+            ok = ok && ParseVsyncMode(value, settings.pacing.vsync);
+            i++;
+        }
+        else if (arg == "--fps-limit")
+        {
+            ok = ok && ParseNumber(value, settings.pacing.fpsLimit) && settings.pacing.fpsLimit >= 0.0;
+            i++;
+        }
+        else if (arg == "--low-latency")
+        {
+            settings.pacing.isLowLatency = true;
+            ok = true;
+        }
+        else if (arg == "--latency-log")
+        {
+            settings.pacing.latencyLogPath = value;
+            i++;
+        }
+        else if (arg == "--frames-in-flight")
+        {
+            ok = ok && ParseNumber(value, settings.framesInFlight) && settings.framesInFlight >= 1 && settings.framesInFlight <= MAX_FRAMES_IN_FLIGHT;
+            i++;
+        }
+        else if (arg == "--capture")
+        {
+            settings.capture.path = value;
+            i++;
+        }
+        else if (arg == "--capture-fps")
+        {
+            ok = ok && ParseNumber(value, settings.capture.fps) && settings.capture.fps > 0;
+            i++;
+        }
+        else if (arg == "--capture-threads")
+        {
+            ok = ok && ParseNumber(value, settings.capture.threads);
+            i++;
+        }
+        else if (arg == "--frames-in-flight-compare")
+        {
+            settings.benchmark.isFramesInFlightComparison = true;
+            ok = true;
+        }
+        else if (arg == "--headless")
+        {
+            settings.isHeadless = true;
+            ok = true;
+        }
+        else if (arg == "--gbuffer-compare")
+        {
+            settings.benchmark.isGbufferComparison = true;
+            ok = true;
+        }
+        else if (arg == "--budget")
+        {
+            ok = ok && ParseGLCallBudget(value, settings.benchmark.budget);
+            i++;
+        }
+        else if (arg == "--regress")
+        {
+            settings.regression.directory = value;
+            i++;
+        }
+        else if (arg == "--update-golden")
+        {
+            settings.regression.isUpdate = true;
+            ok = true;
+        }
+        else if (arg == "--regress-threshold")
+        {
+            ok = ok && ParseNumber(value, settings.regression.threshold);
+            i++;
+        }
+        else if (arg == "--pixel-threshold")
+        {
+            ok = ok && ParseNumber(value, settings.regression.pixelThreshold);
+            i++;
+        }
+        else if (arg == "--max-diff-pixels")
+        {
+            ok = ok && ParseNumber(value, settings.regression.maxDifferentPixels);
+            i++;
+        }
+        else if (arg == "--trace")
+        {
+            settings.tracePath = value;
+            i++;
+        }
+        else if (arg == "--no-profiler")
+        {
+            settings.isProfilerEnabled = false;
+            ok = true;
+        }
+        else if (arg == "--benchmark")
+        {
+            ok = ok && ParseNumber(value, settings.benchmark.frames);
+            hasFrames = true;
+            i++;
+        }
+        else if (arg == "--benchmark-output")
+        {
+            settings.benchmark.outputPath = value;
+            i++;
+        }
+        else if (arg == "--warmup")
+        {
+            ok = ok && ParseNumber(value, settings.benchmark.warmupFrames);
+            i++;
+        }
+        else if (arg == "--time-step")
+        {
+            ok = ok && ParseNumber(value, settings.benchmark.timeStep);
+            i++;
+        }
+        else if (arg == "--metrics")
+        {
+            settings.metricsPath = value;
+            i++;
+        }
+        else if (arg == "--metrics-interval")
+        {
+            ok = ok && ParseNumber(value, settings.metricsInterval);
+            i++;
+        }
+        else if (arg.compare(0, 2, "--") != 0 && settings.scenePath.empty())
+        {
+            settings.scenePath = arg;
+            ok = true;
+        }
+        else
+            ok = false;
+
+        if (!ok)
+        {
+            std::cerr << "Invalid argument: " << arg << std::endl;
+            PrintUsage();
+            return false;
+        }
+    }
+
+    if (settings.isGenerated && !settings.scenePath.empty())
+    {
+        std::cerr << "Scene file and generator options can not be used together" << std::endl;
+        return false;
+    }
+    bool isRegression = !settings.regression.directory.empty();
+    if (settings.regression.isUpdate && !isRegression)
+    {
+        std::cerr << "--update-golden needs --regress" << std::endl;
+        return false;
+    }
+    // regression cases are short benchmarks, 120 frames unless --benchmark says otherwise
+    if (isRegression && !hasFrames)
+        settings.benchmark.frames = 120;
+    if (settings.isHeadless && settings.benchmark.frames == 0)
+    {
+        std::cerr << "--headless needs --benchmark or --regress, there is no window to close" << std::endl;
+        return false;
+    }
+    if ((settings.benchmark.isGbufferComparison || settings.benchmark.isDepthPrepassComparison || settings.benchmark.isForwardComparison
+        || settings.benchmark.isLightingResolutionComparison || settings.benchmark.isFramesInFlightComparison) && settings.benchmark.frames == 0)
+    {
+        std::cerr << "--gbuffer-compare, --prepass-compare, --forward-compare, --lighting-resolution-compare and --frames-in-flight-compare need --benchmark" << std::endl;
+        return false;
+    }
+    if (settings.benchmark.budget.isSet && settings.benchmark.frames == 0)
+    {
+        std::cerr << "--budget needs --benchmark" << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+#ifndef Settings_hpp
+#define Settings_hpp
+#include <string>
+#include "SceneGenerator.hpp"
+#include "Benchmark.hpp"
+#include "Regression.hpp"
+#include "FramePacing.hpp"
+#include "FrameCapture.hpp"
+
+// Command line options, see Documentation.txt
+struct AppSettings
+{
+    std::string scenePath;
+
+    // --compile in.scene out.sceneb
+    std::string compileInput;
+    std::string compileOutput;
+
+    // --objects / --distribution / --lights ... switch to generated scene
+    bool isGenerated;
+    GeneratorSettings generator;
+    // --save out.sceneb writes loaded / generated scene and exits
+    std::string savePath;
+
+    // --render-scale S, g-buffer size relative to window (0.5 - 2)
+    float renderScale;
+    // --gbuffer-layout rgb16f|rg16|rgb10a2, normal storage
+    int gbufferLayout;
+    // --depth-prepass starts with depth pre-pass on (KEY_K / KEY_L)
+    bool isDepthPrepass;
+    // --lighting full|volumes|clustered|forward|visibility (KEY_C / KEY_V / KEY_M / KEY_R / KEY_T), --light-volumes = --lighting volumes
+    int lightingMode;
+    // --lighting-resolution full|half|quarter|checkerboard (KEY_Q / KEY_W / KEY_E / KEY_A)
+    int lightingResolution;
+    // --volumetric-fog, fog from froxel volume instead of exp(-density * distance) (KEY_U / KEY_Y)
+    bool isVolumetricFog;
+    // --shadows, shadow atlas for spot / directional lights (KEY_5 / KEY_6)
+    bool isShadows;
+    // --no-shadow-cache, static caster depth is drawn again every frame
+    bool isShadowCache;
+    // --light-cutoff F, light contribution ignored by volumes / clusters
+    float lightCutoff;
+    // --cluster-threads N, light cluster workers (0 = all cores)
+    unsigned int clusterThreads;
+    // --no-shader-permutations, one program per pass with runtime branches instead
+    bool isShaderPermutations;
+    // --shader-cache dir, program binaries kept between launches, --no-shader-cache = empty
+    std::string shaderCacheDirectory;
+
+    // --vsync driver|off|on|adaptive, --fps-limit N, --low-latency, --latency-log file.csv
+    PacingSettings pacing;
+    // --frames-in-flight N, frames the CPU may record ahead of the GPU (1 - 3)
+    unsigned int framesInFlight;
+    // --capture dir|file.y4m, --capture-fps N, --capture-threads N
+    CaptureSettings capture;
+
+    // --headless renders offscreen (GLFW null platform + OSMesa)
+    bool isHeadless;
+    // --benchmark N renders N frames with fixed clock and reports frame times
+    BenchmarkSettings benchmark;
+    // --regress dir compares canonical scenes with goldens / baseline in dir
+    RegressionSettings regression;
+
+    // --trace file.json writes Chrome trace on exit, --no-profiler turns zones off
+    std::string tracePath;
+    bool isProfilerEnabled;
+
+    // --metrics file.prom|file.csv exports render counters every --metrics-interval seconds
+    std::string metricsPath;
+    double metricsInterval;
+};
+
+bool ParseSettings(int argc, char** argv, AppSettings& settings);
+void PrintUsage();
+
+#endif
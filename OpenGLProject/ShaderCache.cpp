@@ -0,0 +1,440 @@
+#include "ShaderCache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <vector>
+#include "Profiler.hpp"
+#ifdef _WIN32
+#include <direct.h>
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+#include "GLTrace.hpp"
+
+#define PROGRAM_BINARY_MAGIC 0x42504C47u // "GLPB"
+// bump when header or hashed data changes
+#define PROGRAM_BINARY_VERSION 1u
+
+struct ProgramBinaryHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash;
+    uint32_t format;
+    uint32_t size;
+};
+
+void SetUpShaderCache(ShaderCache& cache)
+{
+    cache.isEnabled = true;
+    cache.programs.clear();
+    cache.pending.clear();
+    cache.binaryDirectory.clear();
+    cache.compiledCount = 0;
+    cache.loadedCount = 0;
+    cache.rejectedCount = 0;
+    cache.compileMs = 0.0;
+    cache.loadMs = 0.0;
+
+    // driver picks thread count, without the extension links still overlap with whatever
+    // drivers do in background, but there is no way to ask whether one is done
+    if (GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+    else if (GLEW_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+    cache.isParallelCompile = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+
+    GLint formats = 0;
+    if (GLEW_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    cache.isBinarySupported = formats > 0;
+    // driver update changes the hash, old binaries are simply not found any more
+    cache.driver = std::string((const char*)glGetString(GL_VENDOR)) + "\n" + (const char*)glGetString(GL_RENDERER)
+        + "\n" + (const char*)glGetString(GL_VERSION);
+}
+
+void SetShaderSources(ShaderCache& cache, int kind, const std::string& vertexSource, const std::string& fragmentSource)
+{
+    cache.vertexSources[kind] = vertexSource;
+    cache.fragmentSources[kind] = fragmentSource;
+}
+
+void DestroyShaderCache(ShaderCache& cache)
+{
+    FinishShaderPrograms(cache);
+    for (std::map<uint64_t, ShaderProgram>::iterator it = cache.programs.begin(); it != cache.programs.end(); ++it)
+        glDeleteProgram(it->second.program);
+    cache.programs.clear();
+}
+
+// clears what kind does not use, so equal programs get equal keys
+static ShaderPermutation NormalizePermutation(int kind, const ShaderPermutation& permutation)
+{
+    ShaderPermutation normalized = permutation;
+    normalized.pointLights = std::min(normalized.pointLights, (unsigned int)MAX_LIGHTS);
+    normalized.spotLights = std::min(normalized.spotLights, (unsigned int)MAX_LIGHTS);
+    normalized.directionalLights = normalized.isDayLight ? std::min(normalized.directionalLights, (unsigned int)MAX_LIGHTS) : 0;
+    if (kind == SHADER_DEPTH || kind == SHADER_VISIBILITY)
+    {
+        ShaderPermutation none = {};
+        return none;
+    }
+    normalized.isVolumetricFog = normalized.isFog && normalized.isVolumetricFog;
+    if (kind == SHADER_GEOMETRY || kind == SHADER_FOG_VOLUME || kind == SHADER_UPSAMPLE)
+    {
+        normalized.isFog = false;
+        normalized.isVolumetricFog = false;
+        normalized.specularModel = SPECULAR_PER_MATERIAL;
+    }
+    // fog volume keeps it, day / night ambient and sun in-scattering
+    if (kind == SHADER_GEOMETRY || kind == SHADER_UPSAMPLE)
+        normalized.isDayLight = false;
+    if (kind == SHADER_BACKGROUND)
+    {
+        normalized.isDayLight = false;
+        normalized.specularModel = SPECULAR_PER_MATERIAL;
+        normalized.pointLights = 0;
+        normalized.spotLights = 0;
+        normalized.directionalLights = 0;
+    }
+    // no g-buffer read
+    if (kind == SHADER_FOG_VOLUME || kind == SHADER_FORWARD || kind == SHADER_VISIBILITY_RESOLVE || kind == SHADER_BACKGROUND)
+        normalized.isOctahedral = false;
+    if (kind == SHADER_GEOMETRY || kind == SHADER_LIGHT_VOLUME || kind == SHADER_UPSAMPLE)
+    {
+        normalized.pointLights = 0;
+        normalized.spotLights = 0;
+        normalized.directionalLights = 0;
+    }
+    if (kind == SHADER_LIGHT_VOLUME)
+        normalized.isDayLight = false;
+    if (kind == SHADER_CLUSTERED || kind == SHADER_FORWARD || kind == SHADER_VISIBILITY_RESOLVE)
+    {
+        // cluster lists are not limited by count, only "any spot light" matters
+        normalized.pointLights = 0;
+        normalized.spotLights = std::min(normalized.spotLights, 1u);
+    }
+    return normalized;
+}
+
+static uint64_t PermutationKey(const ShaderCache& cache, int kind, const ShaderPermutation& permutation)
+{
+    if (!cache.isEnabled)
+        return (uint64_t)kind | (1ull << 63);
+    ShaderPermutation normalized = NormalizePermutation(kind, permutation);
+    // kind 4 bits, flags 3 bits, specular model 2 bits, light counts 5 bits each, volumetric fog 1 bit
+    return (uint64_t)kind
+        | (uint64_t)normalized.isFog << 4
+        | (uint64_t)normalized.isDayLight << 5
+        | (uint64_t)normalized.isOctahedral << 6
+        | (uint64_t)normalized.specularModel << 7
+        | (uint64_t)normalized.pointLights << 9
+        | (uint64_t)normalized.spotLights << 14
+        | (uint64_t)normalized.directionalLights << 19
+        | (uint64_t)normalized.isVolumetricFog << 24;
+}
+
+std::string PermutationDefines(const ShaderCache& cache, int kind, const ShaderPermutation& permutation)
+{
+    if (!cache.isEnabled)
+        return std::string();
+    ShaderPermutation normalized = NormalizePermutation(kind, permutation);
+    std::ostringstream defines;
+    defines << "#define PERMUTATION\n"
+        << "#define FOG " << (normalized.isFog ? "true" : "false") << "\n"
+        << "#define DAY_LIGHT " << (normalized.isDayLight ? "true" : "false") << "\n"
+        << "#define OCTAHEDRAL " << (normalized.isOctahedral ? "true" : "false") << "\n"
+        << "#define VOLUMETRIC_FOG " << (normalized.isVolumetricFog ? "true" : "false") << "\n"
+        << "#define SPECULAR_MODEL " << normalized.specularModel << "\n"
+        << "#define POINT_LIGHTS " << normalized.pointLights << "\n"
+        << "#define SPOT_LIGHTS " << normalized.spotLights << "\n"
+        << "#define DIRECTIONAL_LIGHTS " << normalized.directionalLights << "\n";
+    return defines.str();
+}
+
+// #version has to stay the first statement
+static std::string InjectDefines(const std::string& source, const std::string& defines)
+{
+    size_t version = source.find("#version");
+    if (defines.empty() || version == std::string::npos)
+        return source;
+    size_t lineEnd = source.find('\n', version);
+    if (lineEnd == std::string::npos)
+        return source + "\n" + defines;
+    return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+// FNV-1a, strings are separated by their length so "ab" + "c" != "a" + "bc"
+static uint64_t HashString(uint64_t hash, const std::string& text)
+{
+    uint64_t length = text.size();
+    for (int i = 0; i < 8; i++)
+        hash = (hash ^ ((length >> (8 * i)) & 0xFF)) * 1099511628211ull;
+    for (size_t i = 0; i < text.size(); i++)
+        hash = (hash ^ (unsigned char)text[i]) * 1099511628211ull;
+    return hash;
+}
+
+static std::string BinaryPath(const ShaderCache& cache, uint64_t hash)
+{
+    std::ostringstream path;
+    path << cache.binaryDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+    return path.str();
+}
+
+// 0 when the file is missing, damaged, from another source / driver or rejected by the driver
+static GLuint LoadProgramBinary(ShaderCache& cache, uint64_t hash)
+{
+    std::ifstream file(BinaryPath(cache, hash), std::ios::binary);
+    if (!file)
+        return 0;
+    ProgramBinaryHeader header;
+    if (!file.read((char*)&header, sizeof(header)) || header.magic != PROGRAM_BINARY_MAGIC
+        || header.version != PROGRAM_BINARY_VERSION || header.hash != hash || header.size == 0 || header.size > (64u << 20))
+        return 0;
+    std::vector<char> binary(header.size);
+    if (!file.read(binary.data(), header.size))
+        return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), header.size);
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        // driver changed in a way its version string does not show, file is overwritten below
+        glDeleteProgram(program);
+        cache.rejectedCount++;
+        return 0;
+    }
+    return program;
+}
+
+static void StoreProgramBinary(const ShaderCache& cache, uint64_t hash, GLuint program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0)
+        return;
+
+#ifdef _WIN32
+    _mkdir(cache.binaryDirectory.c_str());
+#else
+    mkdir(cache.binaryDirectory.c_str(), 0755);
+#endif
+    ProgramBinaryHeader header = { PROGRAM_BINARY_MAGIC, PROGRAM_BINARY_VERSION, hash, format, (uint32_t)written };
+    // Written to temp file and renamed over the old one in a single step, another instance
+    // loading the same binary sees either the old or the new file, never a missing or partial one.
+    std::string path = BinaryPath(cache, hash);
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), written);
+        file.close();
+        if (!file)
+        {
+            std::cerr << "Failed to write shader binary " << temp << std::endl;
+            std::remove(temp.c_str());
+            return;
+        }
+    }
+#ifdef _WIN32
+    // std::rename fails on Windows when the target exists
+    const bool isRenamed = MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    // POSIX rename replaces the target atomically
+    const bool isRenamed = std::rename(temp.c_str(), path.c_str()) == 0;
+#endif
+    if (!isRenamed)
+    {
+        std::cerr << "Failed to store shader binary " << path << std::endl;
+        std::remove(temp.c_str());
+    }
+}
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static ShaderProgram ProgramWithUniforms(int kind, GLuint shaderProgram)
+{
+    ShaderProgram program = {};
+    program.program = shaderProgram;
+    switch (kind)
+    {
+    case SHADER_GEOMETRY:
+        program.geometry = GetGeometryUniforms(shaderProgram);
+        break;
+    case SHADER_LIGHTING:
+        program.lighting = GetLightingUniforms(shaderProgram);
+        program.fog = GetFogUniforms(shaderProgram);
+        program.shadingGrid = GetShadingGridUniforms(shaderProgram);
+        program.shadow = GetShadowUniforms(shaderProgram);
+        break;
+    case SHADER_LIGHT_VOLUME:
+        program.lightVolume = GetLightVolumeUniforms(shaderProgram);
+        program.fog = GetFogUniforms(shaderProgram);
+        program.shadow = GetShadowUniforms(shaderProgram);
+        break;
+    case SHADER_CLUSTERED:
+        program.lighting = GetLightingUniforms(shaderProgram);
+        program.cluster = GetClusterUniforms(shaderProgram);
+        program.fog = GetFogUniforms(shaderProgram);
+        program.shadingGrid = GetShadingGridUniforms(shaderProgram);
+        program.shadow = GetShadowUniforms(shaderProgram);
+        break;
+    case SHADER_FOG_VOLUME:
+        program.lighting = GetLightingUniforms(shaderProgram);
+        program.fogVolume = GetFogVolumeUniforms(shaderProgram);
+        break;
+    case SHADER_FORWARD:
+        program.forward = GetForwardUniforms(shaderProgram);
+        program.cluster = GetClusterUniforms(shaderProgram);
+        program.fog = GetFogUniforms(shaderProgram);
+        program.shadow = GetShadowUniforms(shaderProgram);
+        break;
+    case SHADER_DEPTH:
+        program.depth = GetDepthUniforms(shaderProgram);
+        break;
+    case SHADER_VISIBILITY:
+        program.visibility = GetVisibilityUniforms(shaderProgram);
+        break;
+    case SHADER_VISIBILITY_RESOLVE:
+        program.lighting = GetLightingUniforms(shaderProgram);
+        program.cluster = GetClusterUniforms(shaderProgram);
+        program.fog = GetFogUniforms(shaderProgram);
+        program.visibilityResolve = GetVisibilityResolveUniforms(shaderProgram);
+        program.shadow = GetShadowUniforms(shaderProgram);
+        break;
+    case SHADER_UPSAMPLE:
+        program.upsample = GetUpsampleUniforms(shaderProgram);
+        break;
+    case SHADER_BACKGROUND:
+        program.lighting = GetLightingUniforms(shaderProgram);
+        program.fog = GetFogUniforms(shaderProgram);
+        break;
+    }
+    return program;
+}
+
+// loads binary or starts compile, false when program was already there / started
+static bool StartProgram(ShaderCache& cache, int kind, const ShaderPermutation& permutation, uint64_t key)
+{
+    if (cache.programs.count(key) != 0 || cache.pending.count(key) != 0)
+        return false;
+    PROFILE_ZONE("CompilePermutation");
+    std::string defines = PermutationDefines(cache, kind, permutation);
+    std::string vertexSource = InjectDefines(cache.vertexSources[kind], defines);
+    std::string fragmentSource = InjectDefines(cache.fragmentSources[kind], defines);
+
+    PendingProgram pending = {};
+    pending.kind = kind;
+    pending.isBinaryCache = cache.isBinarySupported && !cache.binaryDirectory.empty();
+    pending.hash = 14695981039346656037ull;
+    if (pending.isBinaryCache)
+    {
+        pending.hash = HashString(pending.hash, std::to_string(PROGRAM_BINARY_VERSION));
+        pending.hash = HashString(pending.hash, cache.driver);
+        pending.hash = HashString(pending.hash, vertexSource);
+        pending.hash = HashString(pending.hash, fragmentSource);
+        auto loadStart = std::chrono::steady_clock::now();
+        GLuint program = LoadProgramBinary(cache, pending.hash);
+        if (program != 0)
+        {
+            cache.programs[key] = ProgramWithUniforms(kind, program);
+            cache.loadedCount++;
+            cache.loadMs += MillisecondsSince(loadStart);
+            return true;
+        }
+    }
+
+    auto compileStart = std::chrono::steady_clock::now();
+    pending.shaders = StartShaderProgram(vertexSource.c_str(), fragmentSource.c_str(), pending.isBinaryCache);
+    cache.pending[key] = pending;
+    cache.compileMs += MillisecondsSince(compileStart);
+    return true;
+}
+
+// waits for link when it is still running
+static ShaderProgram& FinishProgram(ShaderCache& cache, std::map<uint64_t, PendingProgram>::iterator pending)
+{
+    PROFILE_ZONE("FinishPermutation");
+    auto finishStart = std::chrono::steady_clock::now();
+    GLuint program = FinishShaderProgram(pending->second.shaders);
+    if (pending->second.isBinaryCache)
+        StoreProgramBinary(cache, pending->second.hash, program);
+    ShaderProgram& finished = cache.programs[pending->first] = ProgramWithUniforms(pending->second.kind, program);
+    cache.pending.erase(pending);
+    cache.compiledCount++;
+    cache.compileMs += MillisecondsSince(finishStart);
+    return finished;
+}
+
+void RequestShaderProgram(ShaderCache& cache, int kind, const ShaderPermutation& permutation)
+{
+    StartProgram(cache, kind, permutation, PermutationKey(cache, kind, permutation));
+}
+
+unsigned int PollShaderPrograms(ShaderCache& cache)
+{
+    if (!cache.isParallelCompile)
+        return (unsigned int)cache.pending.size();
+    for (std::map<uint64_t, PendingProgram>::iterator it = cache.pending.begin(); it != cache.pending.end();)
+    {
+        std::map<uint64_t, PendingProgram>::iterator next = std::next(it);
+        if (IsShaderProgramLinked(it->second.shaders))
+            FinishProgram(cache, it);
+        it = next;
+    }
+    return (unsigned int)cache.pending.size();
+}
+
+void FinishShaderPrograms(ShaderCache& cache)
+{
+    while (!cache.pending.empty())
+        FinishProgram(cache, cache.pending.begin());
+}
+
+const ShaderProgram& GetShaderProgram(ShaderCache& cache, int kind, const ShaderPermutation& permutation)
+{
+    uint64_t key = PermutationKey(cache, kind, permutation);
+    std::map<uint64_t, ShaderProgram>::iterator found = cache.programs.find(key);
+    if (found != cache.programs.end())
+        return found->second;
+
+    StartProgram(cache, kind, permutation, key);
+    std::map<uint64_t, PendingProgram>::iterator pending = cache.pending.find(key);
+    if (pending != cache.pending.end())
+        return FinishProgram(cache, pending);
+    // loaded from binary cache
+    return cache.programs[key];
+}
+
+std::string ShaderCacheSummary(const ShaderCache& cache)
+{
+    std::ostringstream summary;
+    summary << cache.programs.size() << " programs: " << cache.compiledCount << " compiled (" << cache.compileMs << " ms), "
+        << cache.loadedCount << " from binary cache (" << cache.loadMs << " ms)";
+    if (cache.rejectedCount > 0)
+        summary << ", " << cache.rejectedCount << " binaries rejected";
+    if (cache.isParallelCompile)
+        summary << ", parallel compile";
+    if (!cache.binaryDirectory.empty() && !cache.isBinarySupported)
+        summary << ", driver has no program binary format";
+    return summary.str();
+}
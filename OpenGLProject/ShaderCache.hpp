@@ -0,0 +1,135 @@
+#ifndef ShaderCache_hpp
+#define ShaderCache_hpp
+#include <GL/glew.h>
+#include <map>
+#include <string>
+#include <cstdint>
+#include "ShaderSetUp.hpp"
+#include "LightClusters.hpp"
+#include "VolumetricFog.hpp"
+#include "VisibilityBuffer.hpp"
+#include "ReducedLighting.hpp"
+#include "ShadowAtlas.hpp"
+
+// Programs of the deferred pipeline, all compiled through ShaderCache
+enum ShaderKind
+{
+    SHADER_GEOMETRY = 0,
+    SHADER_LIGHTING,     // full screen pass
+    SHADER_LIGHT_VOLUME,
+    SHADER_CLUSTERED,
+    SHADER_DEPTH,        // pre-pass and light volume stencil, no permutations
+    SHADER_FOG_VOLUME,   // froxel slices, only light counts and isDayLight matter
+    SHADER_FORWARD,      // forward+ objects, permutations like clustered
+    SHADER_VISIBILITY,   // visibility buffer ids, no permutations
+    SHADER_VISIBILITY_RESOLVE, // shades visibility buffer, permutations like clustered
+    SHADER_UPSAMPLE,     // reduced resolution lighting to g-buffer size, only isOctahedral matters
+    SHADER_BACKGROUND,   // forward+ pixels without objects, only fog flags matter
+    SHADER_KIND_COUNT
+};
+
+// Specular model shared by every material in use, SPECULAR_MODEL in lightingCommonFS
+enum SpecularModel
+{
+    SPECULAR_PER_MATERIAL = 0, // materialIsBlinn lookup per pixel
+    SPECULAR_PHONG,
+    SPECULAR_BLINN
+};
+
+// What a program is specialized for, turned into #defines in front of both stages.
+// Fields a kind does not use are ignored (geometry only looks at isOctahedral).
+struct ShaderPermutation
+{
+    bool isFog;
+    bool isDayLight;
+    bool isOctahedral;
+    // fog read from froxel volume, only with isFog
+    bool isVolumetricFog;
+    int specularModel;
+    // lights[] has to be sorted point, spot, directional - loops get constant bounds
+    // and no type branch. Clustered / forward only look at spotLights == 0 and directionalLights.
+    unsigned int pointLights;
+    unsigned int spotLights;
+    unsigned int directionalLights;
+};
+
+struct ShaderProgram
+{
+    GLuint program;
+    // only the ones of program kind are filled
+    GeometryUniforms geometry;
+    DepthUniforms depth;
+    LightingUniforms lighting;
+    LightVolumeUniforms lightVolume;
+    ClusterUniforms cluster;
+    FogUniforms fog;
+    FogVolumeUniforms fogVolume;
+    ForwardUniforms forward;
+    VisibilityUniforms visibility;
+    VisibilityResolveUniforms visibilityResolve;
+    ShadingGridUniforms shadingGrid;
+    UpsampleUniforms upsample;
+    ShadowUniforms shadow;
+};
+
+// compile / link issued, status not asked for yet
+struct PendingProgram
+{
+    PendingShaderProgram shaders;
+    int kind;
+    // binary cache file, stored once link is done
+    uint64_t hash;
+    bool isBinaryCache;
+};
+
+// Programs compiled on first use, one per kind + permutation.
+// With binaryDirectory set, linked programs are also stored there (glGetProgramBinary) and the
+// next launch loads them instead of compiling. File name is a hash of both stages (defines
+// included) and GL vendor / renderer / version, a binary the driver rejects is compiled again.
+struct ShaderCache
+{
+    std::string vertexSources[SHADER_KIND_COUNT];
+    std::string fragmentSources[SHADER_KIND_COUNT];
+    // false - one program per kind, features stay uniforms (isFog, lightCount ...) and branches
+    bool isEnabled;
+    std::map<uint64_t, ShaderProgram> programs;
+    // RequestShaderProgram ones still linking, same keys as programs
+    std::map<uint64_t, PendingProgram> pending;
+    // GL_KHR / ARB_parallel_shader_compile, driver links on its own threads and pending
+    // programs can be polled without waiting
+    bool isParallelCompile;
+
+    // empty - no disk cache
+    std::string binaryDirectory;
+    // GL_ARB_get_program_binary with at least one binary format
+    bool isBinarySupported;
+    std::string driver;
+
+    // since SetUpShaderCache
+    unsigned int compiledCount;
+    unsigned int loadedCount;
+    unsigned int rejectedCount;
+    // time spent in calls, not time the driver worked in background
+    double compileMs;
+    double loadMs;
+};
+
+// GL context has to be current (driver strings, binary formats)
+void SetUpShaderCache(ShaderCache& cache);
+void SetShaderSources(ShaderCache& cache, int kind, const std::string& vertexSource, const std::string& fragmentSource);
+void DestroyShaderCache(ShaderCache& cache);
+// compiles the program when it is not in cache yet, reference stays valid until DestroyShaderCache
+const ShaderProgram& GetShaderProgram(ShaderCache& cache, int kind, const ShaderPermutation& permutation);
+// Starts compile + link (or loads binary) and returns at once, GetShaderProgram / FinishShaderPrograms
+// pick the result up. Used at startup to have the driver build every program of the first frame at once.
+void RequestShaderProgram(ShaderCache& cache, int kind, const ShaderPermutation& permutation);
+// moves finished links to programs without waiting, returns how many are still pending
+// (all of them without parallel compile, asking would wait)
+unsigned int PollShaderPrograms(ShaderCache& cache);
+void FinishShaderPrograms(ShaderCache& cache);
+// #defines put after #version line, empty when permutations are off
+std::string PermutationDefines(const ShaderCache& cache, int kind, const ShaderPermutation& permutation);
+// "3 programs: 0 compiled (0 ms), 3 from binary cache (1.2 ms), parallel compile"
+std::string ShaderCacheSummary(const ShaderCache& cache);
+
+#endif
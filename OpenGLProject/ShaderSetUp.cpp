@@ -1,4 +1,6 @@
 #include "ShaderSetUp.hpp"
+#include "Counters.hpp"
+#include "GLTrace.hpp"
 
 unsigned int compileShader(const char* source, GLenum type) {
     unsigned int shader = glCreateShader(type);
@@ -16,70 +18,229 @@ unsigned int compileShader(const char* source, GLenum type) {
     return shader;
 }
 
-unsigned int createShaderProgram(const char* vsSource, const char* fsSource) {
-    unsigned int vs = compileShader(vsSource, GL_VERTEX_SHADER);
-    unsigned int fs = compileShader(fsSource, GL_FRAGMENT_SHADER);
+// no status query, it would wait for the compile to finish
+static unsigned int StartCompileShader(const char* source, GLenum type)
+{
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    return shader;
+}
+
+static void PrintCompileErrors(unsigned int shader)
+{
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+        std::cerr << "Shader compilation failed: " << infoLog << std::endl;
+    }
+}
+
+PendingShaderProgram StartShaderProgram(const char* vsSource, const char* fsSource, bool isBinaryRetrievable)
+{
+    PendingShaderProgram pending;
+    pending.vertexShader = StartCompileShader(vsSource, GL_VERTEX_SHADER);
+    pending.fragmentShader = StartCompileShader(fsSource, GL_FRAGMENT_SHADER);
+
+    pending.program = glCreateProgram();
+    glAttachShader(pending.program, pending.vertexShader);
+    glAttachShader(pending.program, pending.fragmentShader);
+    if (isBinaryRetrievable)
+        glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(pending.program);
+    return pending;
+}
 
-    unsigned int program = glCreateProgram();
-    glAttachShader(program, vs);
-    glAttachShader(program, fs);
-    glLinkProgram(program);
+bool IsShaderProgramLinked(const PendingShaderProgram& pending)
+{
+    int isDone = GL_FALSE;
+    glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &isDone);
+    return isDone != GL_FALSE;
+}
 
+unsigned int FinishShaderProgram(const PendingShaderProgram& pending)
+{
     int success;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    glGetProgramiv(pending.program, GL_LINK_STATUS, &success);
     if (!success) {
+        // compile log says more than "fragment shader not compiled"
+        PrintCompileErrors(pending.vertexShader);
+        PrintCompileErrors(pending.fragmentShader);
         char infoLog[512];
-        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        glGetProgramInfoLog(pending.program, 512, nullptr, infoLog);
         std::cerr << "Shader program linking failed: " << infoLog << std::endl;
     }
 
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+    glDeleteShader(pending.vertexShader);
+    glDeleteShader(pending.fragmentShader);
+
+    return pending.program;
+}
+
+unsigned int createShaderProgram(const char* vsSource, const char* fsSource, bool isBinaryRetrievable) {
+    return FinishShaderProgram(StartShaderProgram(vsSource, fsSource, isBinaryRetrievable));
+}
+
+GeometryUniforms GetGeometryUniforms(GLuint shaderProgram)
+{
+    GeometryUniforms uniforms;
+    uniforms.model = glGetUniformLocation(shaderProgram, "model");
+    uniforms.view = glGetUniformLocation(shaderProgram, "view");
+    uniforms.projection = glGetUniformLocation(shaderProgram, "projection");
+    uniforms.isFog = glGetUniformLocation(shaderProgram, "isFog");
+    uniforms.fogDensity = glGetUniformLocation(shaderProgram, "fogDensity");
+    uniforms.isDayLight = glGetUniformLocation(shaderProgram, "isDayLight");
+    uniforms.objColor = glGetUniformLocation(shaderProgram, "objColor");
+    uniforms.material = glGetUniformLocation(shaderProgram, "material");
+    uniforms.isOctahedral = glGetUniformLocation(shaderProgram, "isOctahedral");
+    return uniforms;
+}
+
+DepthUniforms GetDepthUniforms(GLuint shaderProgram)
+{
+    DepthUniforms uniforms;
+    uniforms.model = glGetUniformLocation(shaderProgram, "model");
+    uniforms.view = glGetUniformLocation(shaderProgram, "view");
+    uniforms.projection = glGetUniformLocation(shaderProgram, "projection");
+    return uniforms;
+}
+
+LightingUniforms GetLightingUniforms(GLuint shaderProgram)
+{
+    LightingUniforms uniforms;
+    std::string uniform;
+    for (unsigned int i = 0; i < MAX_LIGHTS; i++)
+    {
+        uniform = "lights[" + std::to_string(i) + "].";
+        uniforms.lights[i].position = glGetUniformLocation(shaderProgram, (uniform + "position").c_str());
+        uniforms.lights[i].direction = glGetUniformLocation(shaderProgram, (uniform + "direction").c_str());
+        uniforms.lights[i].color = glGetUniformLocation(shaderProgram, (uniform + "color").c_str());
+        uniforms.lights[i].type = glGetUniformLocation(shaderProgram, (uniform + "type").c_str());
+        uniforms.lights[i].shadow = glGetUniformLocation(shaderProgram, (uniform + "shadow").c_str());
+    }
+    uniforms.lightCount = glGetUniformLocation(shaderProgram, "lightCount");
+    uniforms.inverseProjection = glGetUniformLocation(shaderProgram, "inverseProjection");
+    uniforms.isOctahedral = glGetUniformLocation(shaderProgram, "isOctahedral");
+    uniforms.materialSpecPower = glGetUniformLocation(shaderProgram, "materialSpecPower");
+    uniforms.materialIsBlinn = glGetUniformLocation(shaderProgram, "materialIsBlinn");
+    uniforms.isDayLight = glGetUniformLocation(shaderProgram, "isDayLight");
+    uniforms.isFog = glGetUniformLocation(shaderProgram, "isFog");
+    uniforms.fogDensity = glGetUniformLocation(shaderProgram, "fogDensity");
+
+    // samplers never change, no need to set them every frame
+    glUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "gNormal"), 0);
+    glUniform1i(glGetUniformLocation(shaderProgram, "gAlbedo"), 1);
+    glUniform1i(glGetUniformLocation(shaderProgram, "gDepth"), 2);
+    return uniforms;
+}
+
+LightVolumeUniforms GetLightVolumeUniforms(GLuint shaderProgram)
+{
+    LightVolumeUniforms uniforms;
+    uniforms.lighting = GetLightingUniforms(shaderProgram);
+    uniforms.model = glGetUniformLocation(shaderProgram, "model");
+    uniforms.view = glGetUniformLocation(shaderProgram, "view");
+    uniforms.projection = glGetUniformLocation(shaderProgram, "projection");
+    uniforms.screenSize = glGetUniformLocation(shaderProgram, "screenSize");
+    return uniforms;
+}
+
+ForwardUniforms GetForwardUniforms(GLuint shaderProgram)
+{
+    ForwardUniforms uniforms;
+    uniforms.lighting = GetLightingUniforms(shaderProgram);
+    uniforms.model = glGetUniformLocation(shaderProgram, "model");
+    uniforms.view = glGetUniformLocation(shaderProgram, "view");
+    uniforms.projection = glGetUniformLocation(shaderProgram, "projection");
+    uniforms.objColor = glGetUniformLocation(shaderProgram, "objColor");
+    uniforms.material = glGetUniformLocation(shaderProgram, "material");
+    uniforms.screenSize = glGetUniformLocation(shaderProgram, "screenSize");
+    return uniforms;
+}
 
-    return program;
+const GbufferLayoutInfo& GetGbufferLayoutInfo(int layout)
+{
+    static const GbufferLayoutInfo layouts[GBUFFER_LAYOUT_COUNT] = {
+        { "rgb16f", GL_RGB16F, false, 8, 4, 4 },
+        { "rg16", GL_RG16, true, 4, 4, 4 },
+        { "rgb10a2", GL_RGB10_A2, true, 4, 4, 4 }
+    };
+    return layouts[layout];
 }
 
-Gbuffer SetUpGbuffer()
+bool ParseGbufferLayout(const std::string& name, int& layout)
 {
+    for (int i = 0; i < GBUFFER_LAYOUT_COUNT; i++)
+        if (name == GetGbufferLayoutInfo(i).name)
+        {
+            layout = i;
+            return true;
+        }
+    return false;
+}
+
+double GbufferBytesWritten(int layout, double overdraw)
+{
+    const GbufferLayoutInfo& info = GetGbufferLayoutInfo(layout);
+    return overdraw * (info.normalBytes + info.albedoBytes + info.depthBytes) + 4.0;
+}
+
+double GbufferBytesRead(int layout, double overdraw)
+{
+    const GbufferLayoutInfo& info = GetGbufferLayoutInfo(layout);
+    return overdraw * info.depthBytes + info.normalBytes + info.albedoBytes + info.depthBytes;
+}
+
+Gbuffer SetUpGbuffer(int width, int height, int layout)
+{
+    const GbufferLayoutInfo& info = GetGbufferLayoutInfo(layout);
     Gbuffer gBuffer;
-    //  unsigned int gBuffer;
+    gBuffer.width = width;
+    gBuffer.height = height;
+    gBuffer.layout = layout;
     glGenFramebuffers(1, &gBuffer.buffer);
     glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.buffer);
 
-    unsigned int gPosition, gNormal, gAlbedo;
-    glGenTextures(1, &gBuffer.gPosition);
     glGenTextures(1, &gBuffer.gNormal);
     glGenTextures(1, &gBuffer.gAlbedo);
-
-    glBindTexture(GL_TEXTURE_2D, gBuffer.gPosition);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 800, 600, 0, GL_RGB, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gBuffer.gPosition, 0);
+    glGenTextures(1, &gBuffer.depth);
 
     glBindTexture(GL_TEXTURE_2D, gBuffer.gNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, 800, 600, 0, GL_RGB, GL_FLOAT, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, info.normalFormat, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gBuffer.gNormal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gBuffer.gNormal, 0);
 
     glBindTexture(GL_TEXTURE_2D, gBuffer.gAlbedo);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 800, 600, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gBuffer.gAlbedo, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gBuffer.gAlbedo, 0);
 
-    unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-    glDrawBuffers(3, attachments);
+    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
 
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, 800, 600);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    // depth is sampled in lighting pass, so texture instead of renderbuffer,
+    // same format as scene target depth / stencil so light volumes can blit it there
+    glBindTexture(GL_TEXTURE_2D, gBuffer.depth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, gBuffer.depth, 0);
     return gBuffer;
 }
 
+void DestroyGbuffer(Gbuffer& gBuffer)
+{
+    glDeleteFramebuffers(1, &gBuffer.buffer);
+    glDeleteTextures(1, &gBuffer.gNormal);
+    glDeleteTextures(1, &gBuffer.gAlbedo);
+    glDeleteTextures(1, &gBuffer.depth);
+}
+
 VAOStruct SetUpSphereVAO(std::vector<float> verticesS, std::vector<unsigned int> indicesS)
 {
     // Create and bind VAOs and 
@@ -150,111 +311,381 @@ VAOStruct SetUpQuad()
     return vStruct;
 }
 
-void GeometryPassCube(VAOStruct buffers, GLuint shaderProgram, Object cube, Weather weather, Gbuffer gBuffer, float time, Camera camera)
+glm::mat4 CubeModelMatrix(const Object& cube, float time)
 {
-
-    glUseProgram(shaderProgram);
-
     glm::mat4 model = glm::mat4(1.0f);
 
     model = glm::translate(model, cube.position);
+    model = glm::scale(model, glm::vec3(cube.scale));
+    // rotate around a zero axis gives NaN
     if (glm::length(cube.rotation) > 0.0f)
-        model = glm::scale(model, glm::vec3(cube.scale));
-    model = glm::rotate(model, time * 0.5f, cube.rotation);
+        model = glm::rotate(model, time * 0.5f, cube.rotation);
+    return model;
+}
 
-    glm::mat4 view = glm::lookAt(camera.position, camera.direction, camera.up);
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+glm::mat4 SphereModelMatrix(const Object& sphere, float time)
+{
+    glm::mat4 model = glm::mat4(1.0f);
 
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    model = glm::translate(model, sphere.position);
+    model = glm::scale(model, glm::vec3(sphere.scale));
+    if (glm::length(sphere.rotation) > 0.0f)
+        model = glm::rotate(model, time * 0.5f, sphere.rotation);
+    return model;
+}
+
+void DepthPassCube(VAOStruct buffers, const DepthUniforms& uniforms, const Object& cube, float time)
+{
+    glm::mat4 model = CubeModelMatrix(cube, time);
+    glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(model));
+
+    glBindVertexArray(buffers.VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
 
-    glUniform1i(glGetUniformLocation(shaderProgram, "isFog"), weather.isFog);
-    glUniform1f(glGetUniformLocation(shaderProgram, "fogDensity"), weather.fogDensity);
-    glUniform1i(glGetUniformLocation(shaderProgram, "isDayLight"), weather.isDayLight);
+    CountersAdd(COUNTER_DRAW_CALLS, 1);
+    CountersAdd(COUNTER_PREPASS_TRIANGLES, 12);
+    CountersAdd(COUNTER_BYTES_STREAMED, sizeof(glm::mat4));
+}
 
-    glUniform3fv(glGetUniformLocation(shaderProgram, "objColor"), 1, glm::value_ptr(cube.color));
+void DepthPassSphere(VAOStruct buffers, const DepthUniforms& uniforms, const Object& sphere, float time, std::vector<unsigned int>& indices)
+{
+    glm::mat4 model = SphereModelMatrix(sphere, time);
+    glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(model));
+
+    glBindVertexArray(buffers.VAO);
+    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+
+    CountersAdd(COUNTER_DRAW_CALLS, 1);
+    CountersAdd(COUNTER_PREPASS_TRIANGLES, indices.size() / 3);
+    CountersAdd(COUNTER_BYTES_STREAMED, sizeof(glm::mat4));
+}
+
+void GeometryPassCube(VAOStruct buffers, GLuint shaderProgram, const GeometryUniforms& uniforms, Object cube, Weather weather, Gbuffer gBuffer, float time, const glm::mat4& view, const glm::mat4& projection)
+{
+
+    glUseProgram(shaderProgram);
+
+    glm::mat4 model = CubeModelMatrix(cube, time);
+
+    glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix4fv(uniforms.view, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(uniforms.projection, 1, GL_FALSE, glm::value_ptr(projection));
+
+    glUniform1i(uniforms.isFog, weather.isFog);
+    glUniform1f(uniforms.fogDensity, weather.fogDensity);
+    glUniform1i(uniforms.isDayLight, weather.isDayLight);
+
+    glUniform3fv(uniforms.objColor, 1, glm::value_ptr(cube.color));
+    glUniform1i(uniforms.material, std::min(std::max(cube.material, 0), MAX_MATERIALS - 1));
 
     glBindVertexArray(buffers.VAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
     //glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
+
+    // 3 matrices + fog / light flags + color + material
+    CountersAdd(COUNTER_DRAW_CALLS, 1);
+    CountersAdd(COUNTER_TRIANGLES, 12);
+    CountersAdd(COUNTER_BYTES_STREAMED, 3 * sizeof(glm::mat4) + 4 * sizeof(int) + sizeof(glm::vec3));
 }
 
-void GeometryPassSphere(VAOStruct buffers, GLuint shaderProgram, Object sphere, Weather weather, Gbuffer gBuffer, float time, std::vector<unsigned int>& indices, Camera camera)
+void GeometryPassSphere(VAOStruct buffers, GLuint shaderProgram, const GeometryUniforms& uniforms, Object sphere, Weather weather, Gbuffer gBuffer, float time, std::vector<unsigned int>& indices, const glm::mat4& view, const glm::mat4& projection)
 {
 
     glUseProgram(shaderProgram);
 
-    glm::mat4 model = glm::mat4(1.0f);
-
-    model = glm::translate(model, sphere.position);
-    model = glm::scale(model, glm::vec3(sphere.scale));
-    if (glm::length(sphere.rotation) > 0.0f)
-        model = glm::rotate(model, time * 0.5f, sphere.rotation);
+    glm::mat4 model = SphereModelMatrix(sphere, time);
 
-    glm::mat4 view = glm::lookAt(camera.position, camera.direction, camera.up);
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix4fv(uniforms.view, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(uniforms.projection, 1, GL_FALSE, glm::value_ptr(projection));
 
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    glUniform1i(uniforms.isFog, weather.isFog);
+    glUniform1f(uniforms.fogDensity, weather.fogDensity);
+    glUniform1i(uniforms.isDayLight, weather.isDayLight);
 
-    glUniform1i(glGetUniformLocation(shaderProgram, "isFog"), weather.isFog);
-    glUniform1f(glGetUniformLocation(shaderProgram, "fogDensity"), weather.fogDensity);
-    glUniform1i(glGetUniformLocation(shaderProgram, "isDayLight"), weather.isDayLight);
-
-    glUniform3fv(glGetUniformLocation(shaderProgram, "objColor"), 1, glm::value_ptr(sphere.color));
+    glUniform3fv(uniforms.objColor, 1, glm::value_ptr(sphere.color));
+    glUniform1i(uniforms.material, std::min(std::max(sphere.material, 0), MAX_MATERIALS - 1));
 
     glBindVertexArray(buffers.VAO);
     glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
 
     glBindVertexArray(0);
+
+    CountersAdd(COUNTER_DRAW_CALLS, 1);
+    CountersAdd(COUNTER_TRIANGLES, indices.size() / 3);
+    CountersAdd(COUNTER_BYTES_STREAMED, 3 * sizeof(glm::mat4) + 4 * sizeof(int) + sizeof(glm::vec3));
 }
 
 
-void LightingPassCube(VAOStruct buffers, GLuint shaderProgram, Gbuffer gBuffer, Light* lights, Weather weather, Camera camera, float specPower, bool isBlinn)
+static void BindGbufferTextures(const Gbuffer& gBuffer)
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram(shaderProgram);
-
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, gBuffer.gPosition);
-    glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, gBuffer.gNormal);
-    glActiveTexture(GL_TEXTURE2);
+    glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, gBuffer.gAlbedo);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, gBuffer.depth);
+}
 
-    glm::mat4 view = glm::lookAt(camera.position, camera.direction, camera.up);
+// Shader permutations compile flags in as constants, their location is -1 then and nothing is sent
+static void SetFlagUniform(GLint location, int value, size_t& bytes)
+{
+    if (location < 0)
+        return;
+    glUniform1i(location, value);
+    bytes += sizeof(int);
+}
 
-    glUniform1i(glGetUniformLocation(shaderProgram, "gPosition"), 0);
-    glUniform1i(glGetUniformLocation(shaderProgram, "gNormal"), 1);
-    glUniform1i(glGetUniformLocation(shaderProgram, "gAlbedo"), 2);
-    std::string uniform;
-    for (int i = 0; i < 6; i++)
+static void SetFogUniforms(const LightingUniforms& uniforms, const Weather& weather, size_t& bytes)
+{
+    SetFlagUniform(uniforms.isFog, weather.isFog, bytes);
+    if (uniforms.fogDensity < 0)
+        return;
+    glUniform1f(uniforms.fogDensity, weather.fogDensity);
+    bytes += sizeof(float);
+}
+
+static void SetMaterialUniforms(const LightingUniforms& uniforms, const Material* materials, const Gbuffer& gBuffer, size_t& bytes)
+{
+    float specPowers[MAX_MATERIALS];
+    int isBlinn[MAX_MATERIALS];
+    for (int i = 0; i < MAX_MATERIALS; i++)
+    {
+        specPowers[i] = materials[i].specPower;
+        isBlinn[i] = materials[i].isBlinn;
+    }
+    glUniform1fv(uniforms.materialSpecPower, MAX_MATERIALS, specPowers);
+    bytes += sizeof(specPowers);
+    if (uniforms.materialIsBlinn >= 0)
+    {
+        glUniform1iv(uniforms.materialIsBlinn, MAX_MATERIALS, isBlinn);
+        bytes += sizeof(isBlinn);
+    }
+    SetFlagUniform(uniforms.isOctahedral, GetGbufferLayoutInfo(gBuffer.layout).isOctahedral, bytes);
+}
+
+void SetLightUniforms(const LightingUniforms& uniforms, const Light* lights, unsigned int lightCount, const glm::mat4& view, size_t& bytes)
+{
+    bytes += lightCount * 3 * sizeof(glm::vec3);
+    SetFlagUniform(uniforms.lightCount, lightCount, bytes);
+    for (unsigned int i = 0; i < lightCount; i++)
+    {
+        glUniform3fv(uniforms.lights[i].position, 1, glm::value_ptr(glm::vec3(view * glm::vec4(lights[i].position, 1.0))));
+        glUniform3fv(uniforms.lights[i].direction, 1, glm::value_ptr(glm::vec3(view * glm::vec4(lights[i].direction, 1.0))));
+        glUniform3fv(uniforms.lights[i].color, 1, glm::value_ptr(lights[i].color));
+        SetFlagUniform(uniforms.lights[i].type, lights[i].type, bytes);
+    }
+}
+
+void LightingPassCube(VAOStruct buffers, GLuint shaderProgram, const LightingUniforms& uniforms, Gbuffer gBuffer, Light* lights, unsigned int lightCount, Weather weather, const glm::mat4& view, const glm::mat4& projection, const Material* materials)
+{
+    glUseProgram(shaderProgram);
+    BindGbufferTextures(gBuffer);
+
+    lightCount = std::min(lightCount, (unsigned int)MAX_LIGHTS);
+    size_t bytes = sizeof(glm::mat4);
+    SetLightUniforms(uniforms, lights, lightCount, view, bytes);
+    // inverted once here instead of for every pixel
+    glUniformMatrix4fv(uniforms.inverseProjection, 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
+
+    SetMaterialUniforms(uniforms, materials, gBuffer, bytes);
+
+    SetFlagUniform(uniforms.isDayLight, weather.isDayLight, bytes);
+    SetFogUniforms(uniforms, weather, bytes);
+
+
+    glBindVertexArray(buffers.VAO);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+
+    CountersAdd(COUNTER_DRAW_CALLS, 1);
+    CountersAdd(COUNTER_TRIANGLES, 2);
+    CountersAdd(COUNTER_BYTES_STREAMED, bytes);
+    // every light runs for every pixel of the full screen quad
+    CountersAdd(COUNTER_LIGHTS_EVALUATED, (uint64_t)lightCount * gBuffer.width * gBuffer.height);
+}
+
+float LightRange(const Light& light, float cutoff)
+{
+    float brightest = std::max(light.color.r, std::max(light.color.g, light.color.b));
+    // 2 * brightest * attenuation(d) = cutoff, solved for d
+    float c = 1.0f - 2.0f * brightest / cutoff;
+    if (c >= 0.0f)
+        return 0.0f;
+    float a = LIGHT_ATTENUATION_QUADRATIC;
+    float b = LIGHT_ATTENUATION_LINEAR;
+    return (-b + sqrtf(b * b - 4.0f * a * c)) / (2.0f * a);
+}
+
+bool GetLightVolume(const Light& light, const glm::mat4& view, float cutoff, LightVolume& volume)
+{
+    if (light.type == 1)
+        return false;
+    float range = LightRange(light, cutoff);
+    if (range <= 0.0f)
+        return false;
+
+    // low poly mesh lies inside the shape it approximates, scale it up so it covers it
+    const float ringScale = 1.0f / cosf(M_PI / LIGHT_VOLUME_SECTORS);
+    volume.isCone = light.type == 2;
+    if (!volume.isCone)
+    {
+        float radius = range * ringScale / cosf(M_PI / (2 * LIGHT_VOLUME_STACKS));
+        volume.model = glm::scale(glm::translate(glm::mat4(1.0f), light.position), glm::vec3(radius));
+        volume.center = light.position;
+        volume.radius = radius;
+        return true;
+    }
+
+    // spot axis the way lightingFS sees it, LightingPassCube sends view * vec4(direction, 1.0)
+    glm::vec3 axisView = glm::normalize(glm::vec3(view * glm::vec4(light.direction, 1.0f)));
+    glm::vec3 axis = glm::transpose(glm::mat3(view)) * axisView;
+    glm::vec3 up = fabsf(axis.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 side = glm::normalize(glm::cross(up, axis));
+    up = glm::cross(axis, side);
+    float baseRadius = range * tanf(acosf(SPOT_LIGHT_CUT_OFF)) * ringScale;
+    glm::mat4 rotation(glm::vec4(side, 0.0f), glm::vec4(up, 0.0f), glm::vec4(axis, 0.0f), glm::vec4(light.position, 1.0f));
+    volume.model = glm::scale(rotation, glm::vec3(baseRadius, baseRadius, range));
+    volume.center = light.position + axis * (range * 0.5f);
+    volume.radius = sqrtf(range * range * 0.25f + baseRadius * baseRadius);
+    return true;
+}
+
+bool LightVolumeScissor(const LightVolume& volume, const glm::mat4& view, const glm::mat4& projection, int width, int height, int& x, int& y, int& w, int& h)
+{
+    x = 0;
+    y = 0;
+    w = width;
+    h = height;
+    glm::vec3 center = glm::vec3(view * glm::vec4(volume.center, 1.0f));
+    float r = volume.radius;
+    float minX = 1.0f, minY = 1.0f, maxX = -1.0f, maxY = -1.0f;
+    for (int i = 0; i < 8; i++)
     {
-        uniform = "lights[" + std::to_string(i) + "].position";
-        glUniform3fv(glGetUniformLocation(shaderProgram, uniform.c_str()), 1, glm::value_ptr(glm::vec3(view * glm::vec4(lights[i].position, 1.0))));
-        uniform = "lights[" + std::to_string(i) + "].direction";
-        glUniform3fv(glGetUniformLocation(shaderProgram, uniform.c_str()), 1, glm::value_ptr(glm::vec3(view * glm::vec4(lights[i].direction, 1.0))));
-        uniform = "lights[" + std::to_string(i) + "].color";
-        glUniform3fv(glGetUniformLocation(shaderProgram, uniform.c_str()), 1, glm::value_ptr(lights[i].color));
-        uniform = "lights[" + std::to_string(i) + "].type";
-        glUniform1i(glGetUniformLocation(shaderProgram, uniform.c_str()), lights[i].type);
+        glm::vec3 corner = center + glm::vec3(i & 1 ? r : -r, i & 2 ? r : -r, i & 4 ? r : -r);
+        glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+        // box reaches behind camera, projection of it is meaningless
+        if (clip.w <= 0.0f)
+            return true;
+        minX = std::min(minX, clip.x / clip.w);
+        minY = std::min(minY, clip.y / clip.w);
+        maxX = std::max(maxX, clip.x / clip.w);
+        maxY = std::max(maxY, clip.y / clip.w);
     }
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(view));
+    if (maxX <= -1.0f || maxY <= -1.0f || minX >= 1.0f || minY >= 1.0f)
+        return false;
+
+    x = (int)floorf((std::max(minX, -1.0f) * 0.5f + 0.5f) * width);
+    y = (int)floorf((std::max(minY, -1.0f) * 0.5f + 0.5f) * height);
+    w = (int)ceilf((std::min(maxX, 1.0f) * 0.5f + 0.5f) * width) - x;
+    h = (int)ceilf((std::min(maxY, 1.0f) * 0.5f + 0.5f) * height) - y;
+    return w > 0 && h > 0;
+}
+
+void BeginLightVolumes(GLuint shaderProgram, const LightVolumeUniforms& uniforms, Gbuffer gBuffer, Weather weather, const glm::mat4& view, const glm::mat4& projection, const Material* materials)
+{
+    glUseProgram(shaderProgram);
+    BindGbufferTextures(gBuffer);
+
+    glUniformMatrix4fv(uniforms.view, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(uniforms.projection, 1, GL_FALSE, glm::value_ptr(projection));
+    glUniformMatrix4fv(uniforms.lighting.inverseProjection, 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
+    glUniform2f(uniforms.screenSize, (float)gBuffer.width, (float)gBuffer.height);
+    size_t bytes = 3 * sizeof(glm::mat4) + 2 * sizeof(float);
+    SetMaterialUniforms(uniforms.lighting, materials, gBuffer, bytes);
+    SetFogUniforms(uniforms.lighting, weather, bytes);
+
+    CountersAdd(COUNTER_BYTES_STREAMED, bytes);
+}
 
-    glUniform1f(glGetUniformLocation(shaderProgram, "specPower"), specPower);
+void StencilPassLightVolume(VAOStruct buffers, unsigned int indexCount, const DepthUniforms& uniforms, const LightVolume& volume)
+{
+    glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(volume.model));
 
-    glUniform1i(glGetUniformLocation(shaderProgram, "isDayLight"), weather.isDayLight);
-    glUniform1i(glGetUniformLocation(shaderProgram, "isFog"), weather.isFog);
-    glUniform1f(glGetUniformLocation(shaderProgram, "fogDensity"), weather.fogDensity);
+    glBindVertexArray(buffers.VAO);
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
 
-    glUniform1i(glGetUniformLocation(shaderProgram, "isBlinn"), isBlinn);
+    CountersAdd(COUNTER_DRAW_CALLS, 1);
+    CountersAdd(COUNTER_TRIANGLES, indexCount / 3);
+    CountersAdd(COUNTER_BYTES_STREAMED, sizeof(glm::mat4));
+}
 
+void LightVolumePass(VAOStruct buffers, unsigned int indexCount, const LightVolumeUniforms& uniforms, const Light& light, const LightVolume& volume, const glm::mat4& view)
+{
+    const LightUniforms& lightUniforms = uniforms.lighting.lights[0];
+    glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(volume.model));
+    glUniform3fv(lightUniforms.position, 1, glm::value_ptr(glm::vec3(view * glm::vec4(light.position, 1.0))));
+    glUniform3fv(lightUniforms.direction, 1, glm::value_ptr(glm::vec3(view * glm::vec4(light.direction, 1.0))));
+    glUniform3fv(lightUniforms.color, 1, glm::value_ptr(light.color));
+    glUniform1i(lightUniforms.type, light.type);
 
     glBindVertexArray(buffers.VAO);
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+
+    CountersAdd(COUNTER_DRAW_CALLS, 1);
+    CountersAdd(COUNTER_TRIANGLES, indexCount / 3);
+    CountersAdd(COUNTER_BYTES_STREAMED, sizeof(glm::mat4) + 3 * sizeof(glm::vec3) + sizeof(int));
+}
+
+void BeginForwardPass(GLuint shaderProgram, const ForwardUniforms& uniforms, Gbuffer gBuffer, const Light* lights, unsigned int lightCount, Weather weather, const glm::mat4& view, const glm::mat4& projection, const Material* materials)
+{
+    glUseProgram(shaderProgram);
+
+    glUniformMatrix4fv(uniforms.view, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(uniforms.projection, 1, GL_FALSE, glm::value_ptr(projection));
+    glUniform2f(uniforms.screenSize, (float)gBuffer.width, (float)gBuffer.height);
+    size_t bytes = 2 * sizeof(glm::mat4) + 2 * sizeof(float);
+    SetLightUniforms(uniforms.lighting, lights, std::min(lightCount, (unsigned int)MAX_LIGHTS), view, bytes);
+    SetMaterialUniforms(uniforms.lighting, materials, gBuffer, bytes);
+    SetFlagUniform(uniforms.lighting.isDayLight, weather.isDayLight, bytes);
+    SetFogUniforms(uniforms.lighting, weather, bytes);
+
+    CountersAdd(COUNTER_BYTES_STREAMED, bytes);
+}
+
+void ForwardPassCube(VAOStruct buffers, const ForwardUniforms& uniforms, const Object& cube, float time)
+{
+    glm::mat4 model = CubeModelMatrix(cube, time);
+    glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(model));
+    glUniform3fv(uniforms.objColor, 1, glm::value_ptr(cube.color));
+    glUniform1i(uniforms.material, std::min(std::max(cube.material, 0), MAX_MATERIALS - 1));
+
+    glBindVertexArray(buffers.VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+
+    CountersAdd(COUNTER_DRAW_CALLS, 1);
+    CountersAdd(COUNTER_TRIANGLES, 12);
+    CountersAdd(COUNTER_BYTES_STREAMED, sizeof(glm::mat4) + sizeof(glm::vec3) + sizeof(int));
+}
+
+void ForwardPassSphere(VAOStruct buffers, const ForwardUniforms& uniforms, const Object& sphere, float time, std::vector<unsigned int>& indices)
+{
+    glm::mat4 model = SphereModelMatrix(sphere, time);
+    glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(model));
+    glUniform3fv(uniforms.objColor, 1, glm::value_ptr(sphere.color));
+    glUniform1i(uniforms.material, std::min(std::max(sphere.material, 0), MAX_MATERIALS - 1));
+
+    glBindVertexArray(buffers.VAO);
+    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+
+    CountersAdd(COUNTER_DRAW_CALLS, 1);
+    CountersAdd(COUNTER_TRIANGLES, indices.size() / 3);
+    CountersAdd(COUNTER_BYTES_STREAMED, sizeof(glm::mat4) + sizeof(glm::vec3) + sizeof(int));
+}
+
+void ForwardBackgroundPass(VAOStruct quad, GLuint shaderProgram, const LightingUniforms& uniforms, Weather weather, const glm::mat4& projection)
+{
+    glUseProgram(shaderProgram);
+    size_t bytes = sizeof(glm::mat4);
+    glUniformMatrix4fv(uniforms.inverseProjection, 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
+    SetFogUniforms(uniforms, weather, bytes);
+
+    glBindVertexArray(quad.VAO);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
+
+    CountersAdd(COUNTER_DRAW_CALLS, 1);
+    CountersAdd(COUNTER_TRIANGLES, 2);
+    CountersAdd(COUNTER_BYTES_STREAMED, bytes);
 }
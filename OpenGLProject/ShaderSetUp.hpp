@@ -11,13 +11,52 @@
 #include <string>
 #include "Objects.hpp"
 
+// has to match size of lights array in lightingFS
+#define MAX_LIGHTS 16
+// has to match size of material arrays in lightingFS
+#define MAX_MATERIALS 8
+// has to match attenuation() in lightingFS, 1 / (1 + linear * d + quadratic * d * d)
+#define LIGHT_ATTENUATION_LINEAR 0.9f
+#define LIGHT_ATTENUATION_QUADRATIC 0.62f
+// calculateSpotLight gives nothing when cos of angle to spot axis is not above cutOff
+#define SPOT_LIGHT_CUT_OFF 0.91f
+// light contribution under this is dropped by light volumes (one step of 8 bit output)
+#define LIGHT_VOLUME_CUTOFF (1.0f / 256.0f)
+// tessellation of light volume sphere / cone
+#define LIGHT_VOLUME_SECTORS 16
+#define LIGHT_VOLUME_STACKS 8
+
+// How the view space normal is stored, albedo + material id is RGBA8 and depth 24 bit (+ 8 bit stencil) in all of them
+enum GbufferLayout
+{
+    GBUFFER_LAYOUT_RGB16F = 0, // plain xyz, 3 x half float
+    GBUFFER_LAYOUT_RG16,       // octahedral, 2 x 16 bit unorm
+    GBUFFER_LAYOUT_RGB10A2,    // octahedral in r, g (10 bit each)
+    GBUFFER_LAYOUT_COUNT
+};
+
+struct GbufferLayoutInfo
+{
+    const char* name;
+    GLenum normalFormat;
+    bool isOctahedral;
+    // bytes per pixel as allocated - drivers pad 3 channel formats to 4
+    unsigned int normalBytes;
+    unsigned int albedoBytes;
+    unsigned int depthBytes;
+};
 
 struct Gbuffer
 {
     unsigned int buffer;
-    unsigned int gPosition;
+    // view space normal, position is rebuilt from depth in lighting pass
     unsigned int gNormal;
+    // rgb albedo, alpha material id
     unsigned int gAlbedo;
+    unsigned int depth;
+    int width;
+    int height;
+    int layout;
 };
 struct VAOStruct
 {
@@ -26,27 +65,162 @@ struct VAOStruct
     unsigned int EBO;
 };
 
+// Uniform locations, looked up once after linking (glGetUniformLocation waits for the driver)
+struct GeometryUniforms
+{
+    GLint model;
+    GLint view;
+    GLint projection;
+    GLint isFog;
+    GLint fogDensity;
+    GLint isDayLight;
+    GLint objColor;
+    GLint material;
+    GLint isOctahedral;
+};
+struct DepthUniforms
+{
+    GLint model;
+    GLint view;
+    GLint projection;
+};
+struct LightUniforms
+{
+    GLint position;
+    GLint direction;
+    GLint color;
+    GLint type;
+    // shadow atlas slot + 1, set by BindShadowAtlas / SetLightShadow
+    GLint shadow;
+};
+struct LightingUniforms
+{
+    LightUniforms lights[MAX_LIGHTS];
+    GLint lightCount;
+    GLint inverseProjection;
+    GLint isOctahedral;
+    GLint materialSpecPower;
+    GLint materialIsBlinn;
+    GLint isDayLight;
+    GLint isFog;
+    GLint fogDensity;
+};
+struct LightVolumeUniforms
+{
+    // only lights[0] is used, one light per draw
+    LightingUniforms lighting;
+    GLint model;
+    GLint view;
+    GLint projection;
+    GLint screenSize;
+};
+struct ForwardUniforms
+{
+    // lights[] holds directional lights only, point / spot ones come from light clusters
+    LightingUniforms lighting;
+    GLint model;
+    GLint view;
+    GLint projection;
+    GLint objColor;
+    GLint material;
+    GLint screenSize;
+};
+
+// Mesh bounding the pixels one point / spot light can reach
+struct LightVolume
+{
+    // unit sphere (point) or unit cone (spot) to world
+    glm::mat4 model;
+    // sphere around the volume in world space, for scissor rect
+    glm::vec3 center;
+    float radius;
+    bool isCone;
+};
+
 
 
 // Function to compile shaders
 unsigned int compileShader(const char* source, GLenum type);
-// Function to link shaders into a program
-unsigned int createShaderProgram(const char* vsSource, const char* fsSource);
+// Function to link shaders into a program, isBinaryRetrievable - glGetProgramBinary is called on it
+// later (needs GL_ARB_get_program_binary)
+unsigned int createShaderProgram(const char* vsSource, const char* fsSource, bool isBinaryRetrievable = false);
 
-
-Gbuffer SetUpGbuffer();
+// Program that may still be compiling / linking in the driver
+struct PendingShaderProgram
+{
+    unsigned int program;
+    unsigned int vertexShader;
+    unsigned int fragmentShader;
+};
+// createShaderProgram in two halves - Start issues compile + link without any status query,
+// so the driver (on its own threads with GL_KHR_parallel_shader_compile) works on it while
+// caller does other things. Finish waits for the link, prints errors and deletes the shaders.
+PendingShaderProgram StartShaderProgram(const char* vsSource, const char* fsSource, bool isBinaryRetrievable = false);
+// GL_COMPLETION_STATUS_KHR, does not wait - only valid with GL_KHR / ARB_parallel_shader_compile
+bool IsShaderProgramLinked(const PendingShaderProgram& pending);
+unsigned int FinishShaderProgram(const PendingShaderProgram& pending);
+GeometryUniforms GetGeometryUniforms(GLuint shaderProgram);
+DepthUniforms GetDepthUniforms(GLuint shaderProgram);
+// also binds g-buffer samplers (normal, albedo, depth) to texture units 0, 1, 2
+LightingUniforms GetLightingUniforms(GLuint shaderProgram);
+LightVolumeUniforms GetLightVolumeUniforms(GLuint shaderProgram);
+ForwardUniforms GetForwardUniforms(GLuint shaderProgram);
+
+
+const GbufferLayoutInfo& GetGbufferLayoutInfo(int layout);
+bool ParseGbufferLayout(const std::string& name, int& layout);
+// Bandwidth model per covered pixel, overdraw = geometry fragments / pixels.
+// Geometry pass tests depth and writes all attachments for every fragment,
+// lighting pass reads every attachment once and writes RGBA8 output.
+double GbufferBytesWritten(int layout, double overdraw);
+double GbufferBytesRead(int layout, double overdraw);
+
+Gbuffer SetUpGbuffer(int width, int height, int layout);
+void DestroyGbuffer(Gbuffer& gBuffer);
 
 
 VAOStruct SetUpCubeVAO();
 
 VAOStruct SetUpSphereVAO(std::vector<float> verticesS, std::vector<unsigned int> indicesS);
 VAOStruct SetUpQuad();
-void GeometryPassCube(VAOStruct buffers, GLuint shaderProgram, Object cube, Weather weather, Gbuffer gBuffer, float time, Camera camera);
-
-void GeometryPassSphere(VAOStruct buffers, GLuint shaderProgram, Object sphere, Weather weather, Gbuffer gBuffer, float time, std::vector<unsigned int>& indices, Camera camera);
-
-
-void LightingPassCube(VAOStruct buffers, GLuint shaderProgram, Gbuffer gBuffer, Light* lights, Weather weather, Camera camera, float specPower, bool isBlinn);
+// shared by depth pre-pass and geometry pass, both have to produce identical positions
+glm::mat4 CubeModelMatrix(const Object& cube, float time);
+glm::mat4 SphereModelMatrix(const Object& sphere, float time);
+
+// depth only, program and view / projection are set once by caller
+void DepthPassCube(VAOStruct buffers, const DepthUniforms& uniforms, const Object& cube, float time);
+void DepthPassSphere(VAOStruct buffers, const DepthUniforms& uniforms, const Object& sphere, float time, std::vector<unsigned int>& indices);
+
+void GeometryPassCube(VAOStruct buffers, GLuint shaderProgram, const GeometryUniforms& uniforms, Object cube, Weather weather, Gbuffer gBuffer, float time, const glm::mat4& view, const glm::mat4& projection);
+
+void GeometryPassSphere(VAOStruct buffers, GLuint shaderProgram, const GeometryUniforms& uniforms, Object sphere, Weather weather, Gbuffer gBuffer, float time, std::vector<unsigned int>& indices, const glm::mat4& view, const glm::mat4& projection);
+
+
+// lights[] (view space) and lightCount of a lighting program in use, adds what it sent to bytes
+void SetLightUniforms(const LightingUniforms& uniforms, const Light* lights, unsigned int lightCount, const glm::mat4& view, size_t& bytes);
+void LightingPassCube(VAOStruct buffers, GLuint shaderProgram, const LightingUniforms& uniforms, Gbuffer gBuffer, Light* lights, unsigned int lightCount, Weather weather, const glm::mat4& view, const glm::mat4& projection, const Material* materials);
+
+// Distance at which diffuse + specular of light (each at most light color) falls under cutoff
+float LightRange(const Light& light, float cutoff);
+// false for directional lights and lights too dark to ever reach cutoff
+bool GetLightVolume(const Light& light, const glm::mat4& view, float cutoff, LightVolume& volume);
+// pixel rect covered by volume in width x height viewport, false when volume is off screen
+bool LightVolumeScissor(const LightVolume& volume, const glm::mat4& view, const glm::mat4& projection, int width, int height, int& x, int& y, int& w, int& h);
+// program, g-buffer textures and uniforms shared by all volumes of the frame
+void BeginLightVolumes(GLuint shaderProgram, const LightVolumeUniforms& uniforms, Gbuffer gBuffer, Weather weather, const glm::mat4& view, const glm::mat4& projection, const Material* materials);
+// depth only draw that marks pixels inside volume in stencil, depth program and view / projection are set by caller
+void StencilPassLightVolume(VAOStruct buffers, unsigned int indexCount, const DepthUniforms& uniforms, const LightVolume& volume);
+// shades marked pixels, program is set by BeginLightVolumes
+void LightVolumePass(VAOStruct buffers, unsigned int indexCount, const LightVolumeUniforms& uniforms, const Light& light, const LightVolume& volume, const glm::mat4& view);
+
+// Forward+ - program and uniforms shared by every object of the frame, gBuffer only gives the
+// target size (forward pass renders at g-buffer resolution without touching the g-buffer)
+void BeginForwardPass(GLuint shaderProgram, const ForwardUniforms& uniforms, Gbuffer gBuffer, const Light* lights, unsigned int lightCount, Weather weather, const glm::mat4& view, const glm::mat4& projection, const Material* materials);
+// shades one object, model matrix is the one of depth pre-pass (GL_EQUAL)
+void ForwardPassCube(VAOStruct buffers, const ForwardUniforms& uniforms, const Object& cube, float time);
+void ForwardPassSphere(VAOStruct buffers, const ForwardUniforms& uniforms, const Object& sphere, float time, std::vector<unsigned int>& indices);
+// fog over pixels no object covers, depth test of the forward pass (GL_EQUAL) still set
+void ForwardBackgroundPass(VAOStruct quad, GLuint shaderProgram, const LightingUniforms& uniforms, Weather weather, const glm::mat4& projection);
 
 
 
@@ -0,0 +1,456 @@
+#include "ShadowAtlas.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "Profiler.hpp"
+#include "Counters.hpp"
+#include "GLTrace.hpp"
+
+static bool SetUpDepthTarget(unsigned int& framebuffer, unsigned int& texture, bool isCompare)
+{
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    // linear + compare gives 2x2 PCF per lookup
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, isCompare ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, isCompare ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (isCompare)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+    // depth only, GL 3.3 wants no color buffer named either
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    bool isComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return isComplete;
+}
+
+bool SetUpShadowAtlas(ShadowAtlas& atlas, const std::vector<float>& sphereVertices)
+{
+    atlas.sphereRadius = sphereVertices.size() >= 3 ? glm::length(glm::vec3(sphereVertices[0], sphereVertices[1], sphereVertices[2])) : 1.0f;
+    atlas.isCacheEnabled = true;
+    atlas.isUsed = false;
+    for (ShadowSlot& slot : atlas.slots)
+    {
+        slot.light = -1;
+        slot.isStaticValid = false;
+        slot.isStaticOnly = false;
+    }
+    for (int i = 0; i < SHADOW_CASCADES; i++)
+        atlas.cascadeEnds[i] = 0.0f;
+    atlas.shadowedLights = 0;
+    atlas.staticRedraws = 0;
+    atlas.tileCopies = 0;
+    atlas.staticCasters = 0;
+    atlas.dynamicCasters = 0;
+
+    bool isComplete = SetUpDepthTarget(atlas.framebuffer, atlas.texture, true)
+        && SetUpDepthTarget(atlas.staticFramebuffer, atlas.staticTexture, false);
+    if (!isComplete)
+        std::cerr << "Shadow atlas framebuffer not complete, shadows disabled" << std::endl;
+    atlas.isSetUp = isComplete;
+    return isComplete;
+}
+
+void DestroyShadowAtlas(ShadowAtlas& atlas)
+{
+    glDeleteFramebuffers(1, &atlas.framebuffer);
+    glDeleteFramebuffers(1, &atlas.staticFramebuffer);
+    glDeleteTextures(1, &atlas.texture);
+    glDeleteTextures(1, &atlas.staticTexture);
+    atlas.isSetUp = false;
+}
+
+ShadowUniforms GetShadowUniforms(GLuint shaderProgram)
+{
+    ShadowUniforms uniforms;
+    uniforms.shadowMatrices = glGetUniformLocation(shaderProgram, "shadowMatrices");
+    uniforms.shadowTiles = glGetUniformLocation(shaderProgram, "shadowTiles");
+    uniforms.shadowTexels = glGetUniformLocation(shaderProgram, "shadowTexels");
+    uniforms.cascadeEnds = glGetUniformLocation(shaderProgram, "cascadeEnds");
+
+    glUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "shadowAtlas"), SHADOW_ATLAS_UNIT);
+    return uniforms;
+}
+
+// Lighting puts light.direction through view * vec4(direction, 1.0) like a position
+// (SetLightUniforms), world direction of what actually gets lit is that turned back
+static glm::vec3 LitDirection(const Light& light, const glm::mat4& view)
+{
+    glm::vec3 viewDirection = glm::vec3(view * glm::vec4(light.direction, 1.0f));
+    return glm::transpose(glm::mat3(view)) * viewDirection;
+}
+
+static glm::vec3 UpVector(const glm::vec3& direction)
+{
+    return fabsf(direction.y) < 0.99f * glm::length(direction) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+}
+
+static bool SpotShadow(ShadowSlot& slot, const Light& light, const glm::mat4& view, float cutoff)
+{
+    glm::vec3 axis = LitDirection(light, view);
+    float range = LightRange(light, cutoff);
+    if (glm::length(axis) < 1e-6f || range <= SHADOW_NEAR_PLANE)
+        return false;
+    axis = glm::normalize(axis);
+    // cone of calculateSpotLight and a bit more, PCF reads next to its edge
+    const float fov = 2.0f * acosf(SPOT_LIGHT_CUT_OFF) * 1.1f;
+    glm::mat4 lightView = glm::lookAt(light.position, light.position + axis, UpVector(axis));
+    slot.viewProjection = glm::perspective(fov, 1.0f, SHADOW_NEAR_PLANE, range) * lightView;
+    slot.isOrthographic = false;
+    slot.texelSize = 2.0f * tanf(fov * 0.5f) / SHADOW_TILE_SIZE;
+    return true;
+}
+
+// Cascade is a square around the bounding sphere of its slice of the camera frustum - size does
+// not change with camera rotation, and moving the square in whole texels keeps edges from crawling
+static void CascadeShadow(ShadowSlot& slot, const glm::vec3& toLight, const glm::mat4& view, const glm::mat4& projection, float nearDepth, float farDepth)
+{
+    glm::mat4 inverseView = glm::inverse(view);
+    glm::mat4 inverseProjection = glm::inverse(projection);
+    glm::vec3 corners[8];
+    glm::vec3 center(0.0f);
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec4 farCorner = inverseProjection * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, 1.0f, 1.0f);
+        glm::vec3 ray = glm::vec3(farCorner) / farCorner.w;
+        float depth = i & 4 ? farDepth : nearDepth;
+        corners[i] = glm::vec3(inverseView * glm::vec4(ray * (depth / -ray.z), 1.0f));
+        center += corners[i] * 0.125f;
+    }
+    float radius = 0.0f;
+    for (int i = 0; i < 8; i++)
+        radius = std::max(radius, glm::length(corners[i] - center));
+    // 1 / 16 steps, float noise in the corners would change the size every frame
+    radius = ceilf(radius * 16.0f) / 16.0f;
+
+    const float texel = 2.0f * radius / SHADOW_TILE_SIZE;
+    glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), -toLight, UpVector(toLight));
+    glm::vec3 lightCenter = glm::vec3(lightRotation * glm::vec4(center, 1.0f));
+    lightCenter.x = floorf(lightCenter.x / texel) * texel;
+    lightCenter.y = floorf(lightCenter.y / texel) * texel;
+    center = glm::vec3(glm::inverse(lightRotation) * glm::vec4(lightCenter, 1.0f));
+
+    // casters between light and near plane are clamped onto it (GL_DEPTH_CLAMP)
+    glm::mat4 lightView = glm::lookAt(center + toLight * radius, center, UpVector(toLight));
+    slot.viewProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius) * lightView;
+    slot.isOrthographic = true;
+    slot.texelSize = texel;
+}
+
+// Picks lights and fits matrices, returns false when no slot is used
+static bool AssignShadowSlots(ShadowAtlas& atlas, const Scene& scene, const glm::mat4& view, const glm::mat4& projection, float cutoff)
+{
+    for (ShadowSlot& slot : atlas.slots)
+        slot.light = -1;
+    atlas.lightShadows.assign(scene.lightCount, 0);
+    atlas.shadowedLights = 0;
+
+    // cascades take the last slots, spot light slots do not move when day light changes
+    const int firstCascade = SHADOW_SLOTS - SHADOW_CASCADES;
+    int spotSlots = SHADOW_SLOTS;
+    for (unsigned int i = 0; i < scene.lightCount && scene.weather.isDayLight; i++)
+    {
+        glm::vec3 toLight = LitDirection(scene.lights[i], view);
+        if (scene.lights[i].type != 1 || glm::length(toLight) < 1e-6f)
+            continue;
+        toLight = glm::normalize(toLight);
+        // cascades start at the camera near plane, their ends grow half log, half linear
+        const float nearDepth = projection[3][2] / (projection[2][2] - 1.0f);
+        float previous = nearDepth;
+        for (int c = 0; c < SHADOW_CASCADES; c++)
+        {
+            float t = (float)(c + 1) / SHADOW_CASCADES;
+            float logEnd = nearDepth * powf(SHADOW_DISTANCE / nearDepth, t);
+            float linearEnd = nearDepth + (SHADOW_DISTANCE - nearDepth) * t;
+            atlas.cascadeEnds[c] = SHADOW_CASCADE_SPLIT_LAMBDA * logEnd + (1.0f - SHADOW_CASCADE_SPLIT_LAMBDA) * linearEnd;
+            ShadowSlot& slot = atlas.slots[firstCascade + c];
+            CascadeShadow(slot, toLight, view, projection, previous, atlas.cascadeEnds[c]);
+            slot.light = (int)i;
+            previous = atlas.cascadeEnds[c];
+        }
+        atlas.lightShadows[i] = firstCascade + 1;
+        atlas.shadowedLights++;
+        spotSlots = firstCascade;
+        break;
+    }
+
+    int nextSlot = 0;
+    for (unsigned int i = 0; i < scene.lightCount && nextSlot < spotSlots; i++)
+    {
+        if (scene.lights[i].type != 2 || !SpotShadow(atlas.slots[nextSlot], scene.lights[i], view, cutoff))
+            continue;
+        atlas.slots[nextSlot].light = (int)i;
+        atlas.lightShadows[i] = nextSlot + 1;
+        atlas.shadowedLights++;
+        nextSlot++;
+    }
+    return atlas.shadowedLights > 0;
+}
+
+static void CollectCasters(ShadowAtlas& atlas, const Scene& scene, float time)
+{
+    atlas.casters.clear();
+    for (unsigned int i = 0; i < scene.cubeCount; i++)
+    {
+        const Object& cube = scene.cubes[i];
+        ShadowCaster caster;
+        caster.model = CubeModelMatrix(cube, time);
+        caster.center = cube.position;
+        // unit cube, half diagonal
+        caster.radius = cube.scale * 0.866f;
+        caster.isSphere = false;
+        caster.isStatic = glm::length(cube.rotation) == 0.0f;
+        atlas.casters.push_back(caster);
+    }
+    for (unsigned int i = 0; i < scene.sphereCount; i++)
+    {
+        const Object& sphere = scene.spheres[i];
+        ShadowCaster caster;
+        caster.model = SphereModelMatrix(sphere, time);
+        caster.center = sphere.position;
+        caster.radius = sphere.scale * atlas.sphereRadius;
+        caster.isSphere = true;
+        caster.isStatic = glm::length(sphere.rotation) == 0.0f;
+        for (unsigned int a = 0; a < scene.animationCount; a++)
+            if (scene.animations[a].type == ANIMATION_ORBIT && scene.animations[a].target == (int)i)
+                caster.isStatic = false;
+        atlas.casters.push_back(caster);
+    }
+}
+
+// FNV-1a over static caster matrices, any static object moving changes it
+static uint64_t StaticCastersHash(const ShadowAtlas& atlas)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const ShadowCaster& caster : atlas.casters)
+    {
+        if (!caster.isStatic)
+            continue;
+        const unsigned char* bytes = (const unsigned char*)glm::value_ptr(caster.model);
+        for (size_t b = 0; b < sizeof(glm::mat4); b++)
+            hash = (hash ^ bytes[b]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Bounding sphere against light frustum planes (rows of the matrix, Gribb / Hartmann),
+// ortho cascades skip the near plane, depth clamp keeps casters behind it
+static void CullCasters(ShadowAtlas& atlas, const ShadowSlot& slot, const glm::vec3& lightPosition)
+{
+    const glm::mat4& m = slot.viewProjection;
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++)
+        rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+    glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] - rows[2], rows[3] + rows[2] };
+    const int planeCount = slot.isOrthographic ? 5 : 6;
+    for (int p = 0; p < planeCount; p++)
+        planes[p] /= glm::length(glm::vec3(planes[p]));
+
+    atlas.visible.clear();
+    for (unsigned int i = 0; i < atlas.casters.size(); i++)
+    {
+        const ShadowCaster& caster = atlas.casters[i];
+        // object the spot light sits in (light attached to a sphere) would shadow everything
+        if (!slot.isOrthographic && glm::length(lightPosition - caster.center) < caster.radius)
+            continue;
+        bool isInside = true;
+        for (int p = 0; p < planeCount && isInside; p++)
+            isInside = glm::dot(glm::vec3(planes[p]), caster.center) + planes[p].w >= -caster.radius;
+        if (isInside)
+            atlas.visible.push_back(i);
+        else
+            CountersAdd(COUNTER_OBJECTS_CULLED, 1);
+    }
+}
+
+static void SetTile(int slot)
+{
+    const int x = (slot % SHADOW_TILES_PER_ROW) * SHADOW_TILE_SIZE;
+    const int y = (slot / SHADOW_TILES_PER_ROW) * SHADOW_TILE_SIZE;
+    glViewport(x, y, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE);
+    glScissor(x, y, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE);
+}
+
+// visible casters with isStatic == drawStatic, both when drawAll
+static unsigned int DrawCasters(const ShadowAtlas& atlas, const ShadowSlot& slot, VAOStruct cube, VAOStruct sphere, unsigned int sphereIndexCount,
+    const DepthUniforms& uniforms, bool drawAll, bool drawStatic)
+{
+    glUniformMatrix4fv(uniforms.projection, 1, GL_FALSE, glm::value_ptr(slot.viewProjection));
+    if (slot.isOrthographic)
+        glEnable(GL_DEPTH_CLAMP);
+    unsigned int drawn = 0;
+    // cubes first, their winding is mixed so no culling; spheres drop faces towards the light
+    for (int isSphere = 0; isSphere < 2; isSphere++)
+    {
+        bool isBound = false;
+        for (unsigned int i : atlas.visible)
+        {
+            const ShadowCaster& caster = atlas.casters[i];
+            if (caster.isSphere != (isSphere == 1) || (!drawAll && caster.isStatic != drawStatic))
+                continue;
+            if (!isBound)
+            {
+                glBindVertexArray(isSphere ? sphere.VAO : cube.VAO);
+                if (isSphere)
+                    glEnable(GL_CULL_FACE);
+                isBound = true;
+            }
+            glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, glm::value_ptr(caster.model));
+            if (isSphere)
+                glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0);
+            else
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            CountersAdd(COUNTER_SHADOW_TRIANGLES, isSphere ? sphereIndexCount / 3 : 12);
+            drawn++;
+        }
+    }
+    glDisable(GL_CULL_FACE);
+    if (slot.isOrthographic)
+        glDisable(GL_DEPTH_CLAMP);
+    CountersAdd(COUNTER_DRAW_CALLS, drawn);
+    CountersAdd(COUNTER_BYTES_STREAMED, (drawn + 1) * sizeof(glm::mat4));
+    return drawn;
+}
+
+void UpdateShadowAtlas(ShadowAtlas& atlas, const Scene& scene, VAOStruct cube, VAOStruct sphere, unsigned int sphereIndexCount,
+    GLuint depthProgram, const DepthUniforms& depthUniforms, const glm::mat4& view, const glm::mat4& projection, float cutoff, float time)
+{
+    PROFILE_ZONE("UpdateShadowAtlas");
+    atlas.isUsed = true;
+    atlas.staticRedraws = 0;
+    atlas.tileCopies = 0;
+    if (!AssignShadowSlots(atlas, scene, view, projection, cutoff))
+        return;
+
+    CollectCasters(atlas, scene, time);
+    const uint64_t staticHash = StaticCastersHash(atlas);
+    atlas.staticCasters = 0;
+    for (const ShadowCaster& caster : atlas.casters)
+        atlas.staticCasters += caster.isStatic;
+    atlas.dynamicCasters = (unsigned int)atlas.casters.size() - atlas.staticCasters;
+
+    glUseProgram(depthProgram);
+    const glm::mat4 identity(1.0f);
+    glUniformMatrix4fv(depthUniforms.view, 1, GL_FALSE, glm::value_ptr(identity));
+    glEnable(GL_SCISSOR_TEST);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    glCullFace(GL_FRONT);
+    // slope scaled, steep faces seen by the light need more bias than the normal offset gives
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    CountersAdd(COUNTER_BYTES_STREAMED, sizeof(glm::mat4));
+
+    for (int s = 0; s < SHADOW_SLOTS; s++)
+    {
+        ShadowSlot& slot = atlas.slots[s];
+        if (slot.light < 0)
+            continue;
+        CullCasters(atlas, slot, scene.lights[slot.light].position);
+        SetTile(s);
+
+        if (!atlas.isCacheEnabled)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, atlas.framebuffer);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            DrawCasters(atlas, slot, cube, sphere, sphereIndexCount, depthUniforms, true, false);
+            slot.isStaticValid = false;
+            slot.isStaticOnly = false;
+            continue;
+        }
+
+        bool isDynamic = false;
+        for (unsigned int i : atlas.visible)
+            isDynamic = isDynamic || !atlas.casters[i].isStatic;
+        bool isStaticDirty = !slot.isStaticValid || slot.staticHash != staticHash
+            || memcmp(&slot.staticViewProjection, &slot.viewProjection, sizeof(glm::mat4)) != 0;
+        if (isStaticDirty)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, atlas.staticFramebuffer);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            DrawCasters(atlas, slot, cube, sphere, sphereIndexCount, depthUniforms, false, true);
+            slot.isStaticValid = true;
+            slot.staticViewProjection = slot.viewProjection;
+            slot.staticHash = staticHash;
+            atlas.staticRedraws++;
+        }
+        // tile that still holds exactly the static depth needs no copy
+        if (isStaticDirty || isDynamic || !slot.isStaticOnly)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, atlas.staticFramebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, atlas.framebuffer);
+            const int x = (s % SHADOW_TILES_PER_ROW) * SHADOW_TILE_SIZE;
+            const int y = (s / SHADOW_TILES_PER_ROW) * SHADOW_TILE_SIZE;
+            glBlitFramebuffer(x, y, x + SHADOW_TILE_SIZE, y + SHADOW_TILE_SIZE, x, y, x + SHADOW_TILE_SIZE, y + SHADOW_TILE_SIZE, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            atlas.tileCopies++;
+        }
+        if (isDynamic)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, atlas.framebuffer);
+            DrawCasters(atlas, slot, cube, sphere, sphereIndexCount, depthUniforms, false, false);
+        }
+        slot.isStaticOnly = !isDynamic;
+    }
+
+    glBindVertexArray(0);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void SetLightShadow(const LightUniforms& light, int shadow)
+{
+    glUniform1i(light.shadow, shadow);
+    CountersAdd(COUNTER_BYTES_STREAMED, sizeof(int));
+}
+
+void BindShadowAtlas(const ShadowAtlas& atlas, GLuint shaderProgram, const ShadowUniforms& uniforms, const LightingUniforms& lighting,
+    const int* lightShadows, unsigned int lightCount, const glm::mat4& view, bool isEnabled)
+{
+    // slots left 0 since link
+    if (!isEnabled && !atlas.isUsed)
+        return;
+    glUseProgram(shaderProgram);
+    for (unsigned int i = 0; i < lightCount; i++)
+        SetLightShadow(lighting.lights[i], isEnabled ? lightShadows[i] : 0);
+    if (!isEnabled)
+        return;
+
+    // view space position -> tile texture coordinates and depth
+    const glm::mat4 inverseView = glm::inverse(view);
+    const glm::mat4 bias = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)), glm::vec3(0.5f));
+    const float tile = (float)SHADOW_TILE_SIZE / SHADOW_ATLAS_SIZE;
+    glm::mat4 matrices[SHADOW_SLOTS];
+    glm::vec4 tiles[SHADOW_SLOTS];
+    float texels[SHADOW_SLOTS];
+    for (int s = 0; s < SHADOW_SLOTS; s++)
+    {
+        matrices[s] = bias * atlas.slots[s].viewProjection * inverseView;
+        tiles[s] = glm::vec4((s % SHADOW_TILES_PER_ROW) * tile, (s / SHADOW_TILES_PER_ROW) * tile, tile, tile);
+        texels[s] = atlas.slots[s].texelSize;
+    }
+    glUniformMatrix4fv(uniforms.shadowMatrices, SHADOW_SLOTS, GL_FALSE, glm::value_ptr(matrices[0]));
+    glUniform4fv(uniforms.shadowTiles, SHADOW_SLOTS, glm::value_ptr(tiles[0]));
+    glUniform1fv(uniforms.shadowTexels, SHADOW_SLOTS, texels);
+    glUniform3fv(uniforms.cascadeEnds, 1, atlas.cascadeEnds);
+
+    glActiveTexture(GL_TEXTURE0 + SHADOW_ATLAS_UNIT);
+    glBindTexture(GL_TEXTURE_2D, atlas.texture);
+    glActiveTexture(GL_TEXTURE0);
+    CountersAdd(COUNTER_BYTES_STREAMED, SHADOW_SLOTS * (sizeof(glm::mat4) + sizeof(glm::vec4) + sizeof(float)) + 3 * sizeof(float));
+}
@@ -0,0 +1,116 @@
+#ifndef ShadowAtlas_hpp
+#define ShadowAtlas_hpp
+#include <GL/glew.h>
+#include <glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "Objects.hpp"
+#include "Scene.hpp"
+#include "ShaderSetUp.hpp"
+
+// Shadow atlas - every shadow map of the frame is a tile of one depth texture: a perspective
+// map per spot light and SHADOW_CASCADES orthographic ones for the first directional light.
+// Point lights cast no shadows.
+// Depth of static casters (no spin, no orbit animation) is kept per tile in a second atlas and
+// drawn again only when the light or a static object moves; each frame the tile is copied from
+// it and dynamic casters are drawn on top, a tile nothing dynamic touches is left as it is.
+// Slot / cascade counts have to match the uniform arrays in lightingCommonFS.
+#define SHADOW_ATLAS_SIZE 2048
+#define SHADOW_TILE_SIZE 512
+#define SHADOW_TILES_PER_ROW (SHADOW_ATLAS_SIZE / SHADOW_TILE_SIZE)
+#define SHADOW_SLOTS (SHADOW_TILES_PER_ROW * SHADOW_TILES_PER_ROW)
+#define SHADOW_CASCADES 3
+// view depth covered by the cascades, split between them log / linear half and half
+#define SHADOW_DISTANCE 12.0f
+#define SHADOW_CASCADE_SPLIT_LAMBDA 0.5f
+#define SHADOW_NEAR_PLANE 0.02f
+// texture unit of the atlas, 10 is reduced lighting output
+#define SHADOW_ATLAS_UNIT 11
+
+// One tile of the atlas
+struct ShadowSlot
+{
+    // scene light index, -1 - slot not used this frame
+    int light;
+    // world -> light clip space
+    glm::mat4 viewProjection;
+    bool isOrthographic;
+    // world size of a texel, at distance 1 from the light for spot lights
+    float texelSize;
+    // static depth of the tile was drawn with this matrix and static scene
+    bool isStaticValid;
+    glm::mat4 staticViewProjection;
+    uint64_t staticHash;
+    // atlas tile holds only the static depth (no dynamic caster drawn over it since the copy)
+    bool isStaticOnly;
+};
+
+// object of the frame, bounding sphere for light frustum culling
+struct ShadowCaster
+{
+    glm::mat4 model;
+    glm::vec3 center;
+    float radius;
+    bool isSphere;
+    bool isStatic;
+};
+
+struct ShadowAtlas
+{
+    bool isSetUp;
+    // shadows were on once, lighting programs may still hold slots of lights
+    bool isUsed;
+    // depth read by lighting, compare mode on
+    unsigned int framebuffer;
+    unsigned int texture;
+    // static casters only, copied into the atlas tile by tile
+    unsigned int staticFramebuffer;
+    unsigned int staticTexture;
+    ShadowSlot slots[SHADOW_SLOTS];
+    // per scene light, shadow slot + 1 (0 - no shadow), directional light gets its first cascade
+    std::vector<int> lightShadows;
+    // view depth where each cascade ends
+    float cascadeEnds[SHADOW_CASCADES];
+    // radius of the sphere mesh, caster bounds
+    float sphereRadius;
+    // scratch, rebuilt every update
+    std::vector<ShadowCaster> casters;
+    std::vector<unsigned int> visible;
+    // false - every caster is drawn into the atlas every frame (--no-shadow-cache)
+    bool isCacheEnabled;
+
+    // last UpdateShadowAtlas
+    unsigned int shadowedLights;
+    unsigned int staticRedraws;
+    unsigned int tileCopies;
+    unsigned int staticCasters;
+    unsigned int dynamicCasters;
+};
+
+// lighting side, in every lighting program (light shadow slots are lights[i].shadow)
+struct ShadowUniforms
+{
+    GLint shadowMatrices;
+    GLint shadowTiles;
+    GLint shadowTexels;
+    GLint cascadeEnds;
+};
+
+bool SetUpShadowAtlas(ShadowAtlas& atlas, const std::vector<float>& sphereVertices);
+void DestroyShadowAtlas(ShadowAtlas& atlas);
+// also binds shadowAtlas sampler to SHADOW_ATLAS_UNIT
+ShadowUniforms GetShadowUniforms(GLuint shaderProgram);
+
+// Picks the lights that get a tile, fits their matrices (cascades to the camera frustum) and
+// draws what changed. Depth program comes from caller (model / view / projection uniforms),
+// cutoff limits spot light range like for light volumes.
+void UpdateShadowAtlas(ShadowAtlas& atlas, const Scene& scene, VAOStruct cube, VAOStruct sphere, unsigned int sphereIndexCount,
+    GLuint depthProgram, const DepthUniforms& depthUniforms, const glm::mat4& view, const glm::mat4& projection, float cutoff, float time);
+// Atlas texture and matrices (view space of this frame) for shaderProgram, binds it. lightShadows
+// are shadow values of lights[] of the program - isEnabled false clears them, lights stay unshadowed.
+void BindShadowAtlas(const ShadowAtlas& atlas, GLuint shaderProgram, const ShadowUniforms& uniforms, const LightingUniforms& lighting,
+    const int* lightShadows, unsigned int lightCount, const glm::mat4& view, bool isEnabled);
+// one light uniform, light volumes set lights[0] per volume
+void SetLightShadow(const LightUniforms& light, int shadow);
+
+#endif
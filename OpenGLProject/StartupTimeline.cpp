@@ -0,0 +1,85 @@
+#include "StartupTimeline.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct StartupPhase
+{
+    std::string name;
+    std::string thread;
+    double startMs;
+    double endMs;
+};
+
+static std::mutex startupMutex;
+static std::vector<StartupPhase> startupPhases;
+static double startupFirstFrameMs = -1.0;
+static thread_local const char* startupThreadName = "Thread";
+
+void StartupSetThreadName(const char* name)
+{
+    startupThreadName = name;
+    ProfilerSetThreadName(name);
+}
+
+double StartupMilliseconds()
+{
+    return ProfilerNow() / 1000000.0;
+}
+
+void RecordStartupPhase(const char* name, double startMs, double endMs)
+{
+    StartupPhase phase = { name, startupThreadName, startMs, endMs };
+    std::lock_guard<std::mutex> lock(startupMutex);
+    startupPhases.push_back(phase);
+}
+
+void StartupFirstFrame()
+{
+    std::lock_guard<std::mutex> lock(startupMutex);
+    if (startupFirstFrameMs < 0.0)
+        startupFirstFrameMs = StartupMilliseconds();
+}
+
+double StartupFirstFrameMilliseconds()
+{
+    std::lock_guard<std::mutex> lock(startupMutex);
+    return startupFirstFrameMs;
+}
+
+void PrintStartupTimeline(std::ostream& out)
+{
+    std::lock_guard<std::mutex> lock(startupMutex);
+    std::vector<StartupPhase> phases = startupPhases;
+    std::stable_sort(phases.begin(), phases.end(),
+        [](const StartupPhase& a, const StartupPhase& b) { return a.startMs < b.startMs; });
+    double total = startupFirstFrameMs;
+    for (const StartupPhase& phase : phases)
+        total = std::max(total, phase.endMs);
+    if (phases.empty() || total <= 0.0)
+        return;
+
+    const int barWidth = 40;
+    size_t nameWidth = 0;
+    size_t threadWidth = 0;
+    for (const StartupPhase& phase : phases)
+    {
+        nameWidth = std::max(nameWidth, phase.name.size());
+        threadWidth = std::max(threadWidth, phase.thread.size());
+    }
+    std::ios::fmtflags flags = out.flags();
+    out << "Startup timeline (ms since start):" << std::endl << std::fixed << std::setprecision(1);
+    for (const StartupPhase& phase : phases)
+    {
+        int first = std::min((int)(phase.startMs / total * barWidth), barWidth - 1);
+        int last = std::max(std::min((int)(phase.endMs / total * barWidth), barWidth - 1), first);
+        out << "  " << std::left << std::setw(threadWidth) << phase.thread << "  " << std::setw(nameWidth) << phase.name
+            << std::right << std::setw(9) << phase.startMs << std::setw(9) << phase.endMs << "  |"
+            << std::string(first, ' ') << std::string(last - first + 1, '#') << std::string(barWidth - last - 1, ' ') << "|" << std::endl;
+    }
+    if (startupFirstFrameMs >= 0.0)
+        out << "  first frame at " << startupFirstFrameMs << " ms" << std::endl;
+    out.flags(flags);
+}
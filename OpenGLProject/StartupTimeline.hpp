@@ -0,0 +1,42 @@
+#ifndef StartupTimeline_hpp
+#define StartupTimeline_hpp
+#include <ostream>
+#include "Profiler.hpp"
+
+// What startup spends its time on and on which thread, to keep time to first frame in check.
+// Phases can be recorded from any thread, times are ms since program start (ProfilerNow clock).
+// Recording takes a mutex, meant for startup only and not per frame work.
+
+// label of calling thread in the timeline, also sets profiler thread name
+void StartupSetThreadName(const char* name);
+double StartupMilliseconds();
+void RecordStartupPhase(const char* name, double startMs, double endMs);
+// first call marks the first presented frame, later calls do nothing
+void StartupFirstFrame();
+// negative before StartupFirstFrame
+double StartupFirstFrameMilliseconds();
+// one line per phase, sorted by start, with a bar scaled to first frame (or last phase end)
+void PrintStartupTimeline(std::ostream& out);
+
+struct StartupPhaseScope
+{
+    const char* name;
+    double startMs;
+
+    explicit StartupPhaseScope(const char* phaseName)
+    {
+        name = phaseName;
+        startMs = StartupMilliseconds();
+    }
+    ~StartupPhaseScope()
+    {
+        RecordStartupPhase(name, startMs, StartupMilliseconds());
+    }
+};
+
+// timeline phase for rest of scope, shows up as profiler zone too
+#define STARTUP_CONCAT_INNER(a, b) a##b
+#define STARTUP_CONCAT(a, b) STARTUP_CONCAT_INNER(a, b)
+#define STARTUP_PHASE(name) PROFILE_ZONE(name); StartupPhaseScope STARTUP_CONCAT(startupPhase, __LINE__)(name)
+
+#endif
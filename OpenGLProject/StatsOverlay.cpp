@@ -0,0 +1,275 @@
+#include "StatsOverlay.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include "ShaderSetUp.hpp"
+#include "OverlayShaders.hpp"
+#include "Counters.hpp"
+#include "GLTrace.hpp"
+
+// 5x7 glyphs, one byte per row (top first), bit 4 = leftmost pixel
+#define GLYPH_WIDTH 5
+#define GLYPH_HEIGHT 7
+#define GLYPH_CELL_WIDTH 6
+#define GLYPH_CELL_HEIGHT 8
+#define OVERLAY_SCALE 2.0f
+
+static const char glyphChars[] = " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.:-/%";
+#define GLYPH_COUNT (sizeof(glyphChars) - 1)
+// extra fully lit glyph after the characters, used for graph bars and background
+#define GLYPH_SOLID GLYPH_COUNT
+
+static const unsigned char glyphs[GLYPH_COUNT + 1][GLYPH_HEIGHT] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // space
+    { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, // 0
+    { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },
+    { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },
+    { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },
+    { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },
+    { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },
+    { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },
+    { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C }, // 9
+    { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // A
+    { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E },
+    { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },
+    { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 },
+    { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F },
+    { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },
+    { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C },
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },
+    { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 },
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },
+    { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },
+    { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 },
+    { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D },
+    { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 },
+    { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E },
+    { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 },
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A },
+    { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 },
+    { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 },
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, // Z
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C }, // .
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }, // :
+    { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 }, // -
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // /
+    { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // %
+    { 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F }  // solid
+};
+
+static GLuint CreateFontTexture()
+{
+    const int atlasWidth = (int)(GLYPH_COUNT + 1) * GLYPH_CELL_WIDTH;
+    std::vector<unsigned char> pixels(atlasWidth * GLYPH_CELL_HEIGHT, 0);
+    for (unsigned int g = 0; g <= GLYPH_COUNT; g++)
+        for (int y = 0; y < GLYPH_HEIGHT; y++)
+            for (int x = 0; x < GLYPH_WIDTH; x++)
+                if (glyphs[g][y] & (0x10 >> x))
+                    pixels[y * atlasWidth + g * GLYPH_CELL_WIDTH + x] = 255;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, GLYPH_CELL_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+bool SetUpStatsOverlay(StatsOverlay& overlay, int width, int height)
+{
+    overlay.shader = createShaderProgram(overlayVS, overlayFS);
+    overlay.font = CreateFontTexture();
+    overlay.width = width;
+    overlay.height = height;
+
+    // locations looked up once, overlay draw does not ask the driver anything
+    glUseProgram(overlay.shader);
+    glUniform1i(glGetUniformLocation(overlay.shader, "font"), 0);
+    overlay.screenSizeLocation = glGetUniformLocation(overlay.shader, "screenSize");
+
+    SetUpStreamBuffer(overlay.vertexBuffer, GL_ARRAY_BUFFER, 0, 4096 * sizeof(OverlayVertex));
+    glGenVertexArrays(MAX_FRAMES_IN_FLIGHT, overlay.VAOs);
+    for (unsigned int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        glBindVertexArray(overlay.VAOs[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, overlay.vertexBuffer.buffers[i]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, x));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, u));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(OverlayVertex), (void*)offsetof(OverlayVertex, r));
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return overlay.shader != 0;
+}
+
+void DestroyStatsOverlay(StatsOverlay& overlay)
+{
+    glDeleteVertexArrays(MAX_FRAMES_IN_FLIGHT, overlay.VAOs);
+    DestroyStreamBuffer(overlay.vertexBuffer);
+    glDeleteTextures(1, &overlay.font);
+    glDeleteProgram(overlay.shader);
+}
+
+static void AddQuad(StatsOverlay& overlay, float x, float y, float w, float h, unsigned int glyph, const float color[4])
+{
+    const float atlasWidth = (float)((GLYPH_COUNT + 1) * GLYPH_CELL_WIDTH);
+    float u0 = glyph * GLYPH_CELL_WIDTH / atlasWidth;
+    float u1 = (glyph * GLYPH_CELL_WIDTH + GLYPH_WIDTH) / atlasWidth;
+    float v0 = 0.0f;
+    float v1 = (float)GLYPH_HEIGHT / GLYPH_CELL_HEIGHT;
+    if (glyph == GLYPH_SOLID)
+    {
+        // sample middle of solid glyph, any size of quad stays fully lit
+        u0 = u1 = (glyph * GLYPH_CELL_WIDTH + 2.5f) / atlasWidth;
+        v0 = v1 = 3.5f / GLYPH_CELL_HEIGHT;
+    }
+
+    OverlayVertex corners[4] = {
+        { x, y, u0, v0, color[0], color[1], color[2], color[3] },
+        { x + w, y, u1, v0, color[0], color[1], color[2], color[3] },
+        { x + w, y + h, u1, v1, color[0], color[1], color[2], color[3] },
+        { x, y + h, u0, v1, color[0], color[1], color[2], color[3] }
+    };
+    static const int order[6] = { 0, 1, 2, 0, 2, 3 };
+    for (int i = 0; i < 6; i++)
+        overlay.vertices.push_back(corners[order[i]]);
+}
+
+static void AddText(StatsOverlay& overlay, float x, float y, const std::string& text, const float color[4])
+{
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        const char* found = strchr(glyphChars, toupper((unsigned char)text[i]));
+        unsigned int glyph = found && *found ? (unsigned int)(found - glyphChars) : 0;
+        if (glyph != 0)
+            AddQuad(overlay, x, y, GLYPH_WIDTH * OVERLAY_SCALE, GLYPH_HEIGHT * OVERLAY_SCALE, glyph, color);
+        x += GLYPH_CELL_WIDTH * OVERLAY_SCALE;
+    }
+}
+
+// 1234567 -> "1.23 M"
+static std::string ShortNumber(uint64_t value)
+{
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2);
+    if (value >= 1000000)
+        text << value / 1000000.0 << " M";
+    else if (value >= 10000)
+        text << value / 1000.0 << " K";
+    else
+        text << value;
+    return text.str();
+}
+
+void DrawStatsOverlay(StatsOverlay& overlay, const GpuFrameTimings& gpu, unsigned int frame)
+{
+    static const float background[4] = { 0.0f, 0.0f, 0.0f, 0.6f };
+    static const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    static const float green[4] = { 0.3f, 1.0f, 0.3f, 0.9f };
+    static const float red[4] = { 1.0f, 0.3f, 0.3f, 0.9f };
+    static const float yellow[4] = { 1.0f, 1.0f, 0.3f, 0.8f };
+
+    std::vector<std::string> lines;
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2);
+    float frameMs = CountersAverageFrameTime(30);
+    line << "FRAME " << frameMs << " MS  FPS " << (frameMs > 0.0f ? 1000.0f / frameMs : 0.0f);
+    lines.push_back(line.str());
+    if (gpu.isValid)
+    {
+        line.str("");
+        line << "GPU GEOMETRY " << gpu.passMs[GPU_PASS_GEOMETRY] << " LIGHTING " << gpu.passMs[GPU_PASS_LIGHTING] << " MS";
+        lines.push_back(line.str());
+        if (gpu.isPassValid[GPU_PASS_DEPTH_PREPASS])
+        {
+            line.str("");
+            line << "GPU DEPTH PREPASS " << gpu.passMs[GPU_PASS_DEPTH_PREPASS] << " MS";
+            lines.push_back(line.str());
+        }
+        if (gpu.isPassValid[GPU_PASS_FOG_VOLUME])
+        {
+            line.str("");
+            line << "GPU FOG VOLUME " << gpu.passMs[GPU_PASS_FOG_VOLUME] << " MS";
+            lines.push_back(line.str());
+        }
+        if (gpu.isPassValid[GPU_PASS_SHADOWS])
+        {
+            line.str("");
+            line << "GPU SHADOWS " << gpu.passMs[GPU_PASS_SHADOWS] << " MS";
+            lines.push_back(line.str());
+        }
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++)
+    {
+        std::string name = CounterName(i);
+        std::replace(name.begin(), name.end(), '_', ' ');
+        lines.push_back(name + " " + ShortNumber(counterLastFrame[i]));
+    }
+
+    overlay.vertices.clear();
+    const float margin = 8.0f;
+    const float lineHeight = GLYPH_CELL_HEIGHT * OVERLAY_SCALE + 2.0f;
+    const float graphHeight = 64.0f;
+    const float barWidth = 2.0f;
+    const float panelWidth = COUNTER_HISTORY * barWidth;
+    const float panelHeight = lines.size() * lineHeight + graphHeight + margin;
+    AddQuad(overlay, margin - 4.0f, margin - 4.0f, panelWidth + 8.0f, panelHeight + 8.0f, GLYPH_SOLID, background);
+
+    float y = margin;
+    for (size_t i = 0; i < lines.size(); i++, y += lineHeight)
+        AddText(overlay, margin, y, lines[i], white);
+
+    // frame time graph, oldest on the left, 33 ms = full height, line at 16.6 ms
+    y += margin;
+    const float msToPixels = graphHeight / 33.3f;
+    const unsigned int frames = std::min(counterFrame, (unsigned int)COUNTER_HISTORY);
+    for (unsigned int i = 0; i < frames; i++)
+    {
+        float ms = counterFrameTimes[(counterFrame - frames + i) % COUNTER_HISTORY];
+        float h = std::min(ms * msToPixels, graphHeight);
+        AddQuad(overlay, margin + (COUNTER_HISTORY - frames + i) * barWidth, y + graphHeight - h, barWidth, h, GLYPH_SOLID,
+            ms > 16.7f ? red : green);
+    }
+    AddQuad(overlay, margin, y + graphHeight - 16.6f * msToPixels, panelWidth, 1.0f, GLYPH_SOLID, yellow);
+
+    // stream whole overlay into the set of this frame, GPU may still draw the other ones
+    size_t bytes = overlay.vertices.size() * sizeof(OverlayVertex);
+    UploadStreamBuffer(overlay.vertexBuffer, frame, overlay.vertices.data(), bytes);
+
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(overlay.shader);
+    glUniform2f(overlay.screenSizeLocation, (float)overlay.width, (float)overlay.height);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, overlay.font);
+    glBindVertexArray(overlay.VAOs[frame]);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)overlay.vertices.size());
+    glBindVertexArray(0);
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+
+    // overlay itself is counted too
+    CountersAdd(COUNTER_DRAW_CALLS, 1);
+    CountersAdd(COUNTER_TRIANGLES, overlay.vertices.size() / 3);
+    CountersAdd(COUNTER_BYTES_STREAMED, 2 * sizeof(float));
+}
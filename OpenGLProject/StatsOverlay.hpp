@@ -0,0 +1,38 @@
+#ifndef StatsOverlay_hpp
+#define StatsOverlay_hpp
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+#include "GpuTimer.hpp"
+#include "FrameSync.hpp"
+
+// Counters + frame time graph drawn on top of the lighting pass.
+// Text (built in 5x7 bitmap font) and graph bars go into one vertex buffer,
+// whole overlay is a single draw call.
+
+struct OverlayVertex
+{
+    float x, y;
+    float u, v;
+    float r, g, b, a;
+};
+
+struct StatsOverlay
+{
+    GLuint shader;
+    GLuint font;
+    // VAO per frame in flight, each reads its own set of the vertex stream
+    GLuint VAOs[MAX_FRAMES_IN_FLIGHT];
+    StreamBuffer vertexBuffer;
+    GLint screenSizeLocation;
+    int width;
+    int height;
+    std::vector<OverlayVertex> vertices;
+};
+
+bool SetUpStatsOverlay(StatsOverlay& overlay, int width, int height);
+void DestroyStatsOverlay(StatsOverlay& overlay);
+// shows counters of last finished frame and (when valid) GPU pass times, vertices go to set frame
+void DrawStatsOverlay(StatsOverlay& overlay, const GpuFrameTimings& gpu, unsigned int frame);
+
+#endif
@@ -0,0 +1,195 @@
+#include "VisibilityBuffer.hpp"
+#include <algorithm>
+#include <iostream>
+#include "Profiler.hpp"
+#include "Counters.hpp"
+#include "GLTrace.hpp"
+
+static void SetUpTextureBuffer(unsigned int& buffer, unsigned int& texture, const void* data, size_t size)
+{
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STATIC_DRAW);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+}
+
+// vertices are position + normal, 6 floats
+static void AddTriangle(std::vector<glm::vec4>& mesh, const float* a, const float* b, const float* c)
+{
+    const float* corners[3] = { a, b, c };
+    for (const float* corner : corners)
+        mesh.push_back(glm::vec4(corner[0], corner[1], corner[2], 1.0f));
+    for (const float* corner : corners)
+        mesh.push_back(glm::vec4(corner[3], corner[4], corner[5], 0.0f));
+}
+
+bool SetUpVisibilityBuffer(VisibilityBuffer& visibility, const std::vector<float>& sphereVertices, const std::vector<unsigned int>& sphereIndices)
+{
+    // same triangle order as the draws, gl_PrimitiveID indexes it directly
+    std::vector<glm::vec4> mesh;
+    const unsigned int cubeTriangles = sizeof(cubeVertices) / sizeof(float) / 18;
+    for (unsigned int i = 0; i < cubeTriangles; i++)
+        AddTriangle(mesh, cubeVertices + i * 18, cubeVertices + i * 18 + 6, cubeVertices + i * 18 + 12);
+    visibility.sphereFirstTriangle = cubeTriangles;
+    for (size_t i = 0; i + 2 < sphereIndices.size(); i += 3)
+        AddTriangle(mesh, &sphereVertices[sphereIndices[i] * 6], &sphereVertices[sphereIndices[i + 1] * 6], &sphereVertices[sphereIndices[i + 2] * 6]);
+    if (sphereIndices.size() / 3 > (1u << VISIBILITY_TRIANGLE_BITS))
+        std::cerr << "Sphere mesh has more triangles than visibility ids can hold" << std::endl;
+
+    // 65536 is the GL 3.3 minimum, objectData of 8192 objects
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    visibility.maxObjects = std::min((unsigned int)std::max(maxTexels, 65536) / VISIBILITY_OBJECT_TEXELS, VISIBILITY_MAX_OBJECTS);
+
+    SetUpTextureBuffer(visibility.meshBuffer, visibility.meshTexture, mesh.data(), mesh.size() * sizeof(glm::vec4));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    SetUpStreamBuffer(visibility.objectBuffer, GL_TEXTURE_BUFFER, GL_RGBA32F, 1024 * VISIBILITY_OBJECT_TEXELS * sizeof(glm::vec4));
+    visibility.framebuffer = 0;
+    visibility.ids = 0;
+    visibility.cubeCount = 0;
+    visibility.firstSphere = 0;
+    visibility.objectCount = 0;
+    return true;
+}
+
+void DestroyVisibilityBuffer(VisibilityBuffer& visibility)
+{
+    DestroyVisibilityTarget(visibility);
+    glDeleteBuffers(1, &visibility.meshBuffer);
+    glDeleteTextures(1, &visibility.meshTexture);
+    DestroyStreamBuffer(visibility.objectBuffer);
+}
+
+bool SetUpVisibilityTarget(VisibilityBuffer& visibility, const Gbuffer& gBuffer)
+{
+    glGenTextures(1, &visibility.ids);
+    glBindTexture(GL_TEXTURE_2D, visibility.ids);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, gBuffer.width, gBuffer.height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &visibility.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, visibility.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, visibility.ids, 0);
+    // resolve reads depth where nothing was drawn, same texture as deferred lighting reads
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, gBuffer.depth, 0);
+    bool isComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!isComplete)
+        std::cerr << "Visibility framebuffer not complete!" << std::endl;
+    return isComplete;
+}
+
+void DestroyVisibilityTarget(VisibilityBuffer& visibility)
+{
+    glDeleteFramebuffers(1, &visibility.framebuffer);
+    glDeleteTextures(1, &visibility.ids);
+    visibility.framebuffer = 0;
+    visibility.ids = 0;
+}
+
+VisibilityUniforms GetVisibilityUniforms(GLuint shaderProgram)
+{
+    VisibilityUniforms uniforms;
+    uniforms.objectId = glGetUniformLocation(shaderProgram, "objectId");
+    uniforms.projection = glGetUniformLocation(shaderProgram, "projection");
+
+    glUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "objectData"), VISIBILITY_OBJECT_UNIT);
+    return uniforms;
+}
+
+VisibilityResolveUniforms GetVisibilityResolveUniforms(GLuint shaderProgram)
+{
+    VisibilityResolveUniforms uniforms;
+    uniforms.firstSphere = glGetUniformLocation(shaderProgram, "firstSphere");
+    uniforms.sphereFirstTriangle = glGetUniformLocation(shaderProgram, "sphereFirstTriangle");
+
+    glUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "visibilityIds"), VISIBILITY_ID_UNIT);
+    glUniform1i(glGetUniformLocation(shaderProgram, "meshData"), VISIBILITY_MESH_UNIT);
+    glUniform1i(glGetUniformLocation(shaderProgram, "objectData"), VISIBILITY_OBJECT_UNIT);
+    return uniforms;
+}
+
+static void AddObject(std::vector<glm::vec4>& data, const glm::mat4& modelView, const Object& object)
+{
+    // modelView is rotation + translation + uniform scale, but inverse transpose costs nothing here
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelView)));
+    for (int i = 0; i < 4; i++)
+        data.push_back(modelView[i]);
+    for (int i = 0; i < 3; i++)
+        data.push_back(glm::vec4(normalMatrix[i], 0.0f));
+    data.push_back(glm::vec4(object.color, (float)std::min(std::max(object.material, 0), MAX_MATERIALS - 1)));
+}
+
+void UpdateVisibilityObjects(VisibilityBuffer& visibility, const Object* cubes, unsigned int cubeCount, const Object* spheres, unsigned int sphereCount,
+    float time, const glm::mat4& view, unsigned int frame)
+{
+    PROFILE_ZONE("VisibilityObjects");
+    visibility.cubeCount = std::min(cubeCount, visibility.maxObjects);
+    visibility.firstSphere = visibility.cubeCount;
+    visibility.objectCount = std::min(visibility.cubeCount + sphereCount, visibility.maxObjects);
+
+    static bool isTruncationReported = false;
+    if (visibility.objectCount < cubeCount + sphereCount && !isTruncationReported)
+    {
+        std::cerr << "Visibility buffer: more objects than it can hold (" << visibility.maxObjects << ", texture buffer / ids), rest is dropped" << std::endl;
+        isTruncationReported = true;
+    }
+    visibility.objectData.clear();
+    visibility.objectData.reserve(visibility.objectCount * VISIBILITY_OBJECT_TEXELS);
+    for (unsigned int i = 0; i < visibility.cubeCount; i++)
+        AddObject(visibility.objectData, view * CubeModelMatrix(cubes[i], time), cubes[i]);
+    for (unsigned int i = visibility.firstSphere; i < visibility.objectCount; i++)
+        AddObject(visibility.objectData, view * SphereModelMatrix(spheres[i - visibility.firstSphere], time), spheres[i - visibility.firstSphere]);
+
+    UploadStreamBuffer(visibility.objectBuffer, frame, visibility.objectData.data(), visibility.objectData.size() * sizeof(glm::vec4));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void VisibilityPass(const VisibilityBuffer& visibility, VAOStruct cube, VAOStruct sphere, unsigned int sphereIndexCount, GLuint shaderProgram,
+    const VisibilityUniforms& uniforms, const glm::mat4& projection)
+{
+    glUseProgram(shaderProgram);
+    glActiveTexture(GL_TEXTURE0 + VISIBILITY_OBJECT_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, StreamTexture(visibility.objectBuffer));
+    glUniformMatrix4fv(uniforms.projection, 1, GL_FALSE, glm::value_ptr(projection));
+
+    glBindVertexArray(cube.VAO);
+    for (unsigned int i = 0; i < visibility.cubeCount; i++)
+    {
+        glUniform1i(uniforms.objectId, i);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+    }
+    glBindVertexArray(sphere.VAO);
+    for (unsigned int i = visibility.firstSphere; i < visibility.objectCount; i++)
+    {
+        glUniform1i(uniforms.objectId, i);
+        glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0);
+    }
+    glBindVertexArray(0);
+
+    const unsigned int spheres = visibility.objectCount - visibility.firstSphere;
+    CountersAdd(COUNTER_DRAW_CALLS, visibility.objectCount);
+    CountersAdd(COUNTER_TRIANGLES, (uint64_t)visibility.cubeCount * 12 + (uint64_t)spheres * (sphereIndexCount / 3));
+    CountersAdd(COUNTER_BYTES_STREAMED, sizeof(glm::mat4) + visibility.objectCount * sizeof(int));
+}
+
+void BindVisibilityBuffer(const VisibilityBuffer& visibility, GLuint shaderProgram, const VisibilityResolveUniforms& uniforms)
+{
+    glUseProgram(shaderProgram);
+    glActiveTexture(GL_TEXTURE0 + VISIBILITY_ID_UNIT);
+    glBindTexture(GL_TEXTURE_2D, visibility.ids);
+    glActiveTexture(GL_TEXTURE0 + VISIBILITY_MESH_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, visibility.meshTexture);
+    glActiveTexture(GL_TEXTURE0 + VISIBILITY_OBJECT_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, StreamTexture(visibility.objectBuffer));
+    glUniform1i(uniforms.firstSphere, visibility.firstSphere);
+    glUniform1i(uniforms.sphereFirstTriangle, visibility.sphereFirstTriangle);
+    CountersAdd(COUNTER_BYTES_STREAMED, 2 * sizeof(int));
+}
@@ -0,0 +1,82 @@
+#ifndef VisibilityBuffer_hpp
+#define VisibilityBuffer_hpp
+#include <GL/glew.h>
+#include <glm.hpp>
+#include <vector>
+#include "Objects.hpp"
+#include "ShaderSetUp.hpp"
+#include "FrameSync.hpp"
+
+// Visibility buffer - geometry pass writes depth and one 32 bit id per pixel, (object + 1) in
+// the high bits and gl_PrimitiveID in the low ones, nothing else. Resolve pass fetches that
+// triangle from meshData, puts it into view space with objectData of the object and intersects
+// the pixel ray with it for barycentrics, normal and position are interpolated with them.
+// Geometry pass bandwidth does not depend on attributes and shading runs once per pixel
+// whatever the overdraw.
+// Bit split and texel counts have to match visibilityVS / visibilityFS / visibilityMainFS.
+#define VISIBILITY_TRIANGLE_BITS 12
+// id 0 is "nothing drawn"
+#define VISIBILITY_MAX_OBJECTS ((1u << (32 - VISIBILITY_TRIANGLE_BITS)) - 1)
+// meshData texels per triangle: 3 positions, 3 normals (object space)
+#define VISIBILITY_TRIANGLE_TEXELS 6
+// objectData texels per object: model view matrix (4 columns), normal matrix (3), color + material
+#define VISIBILITY_OBJECT_TEXELS 8
+// texture units, g-buffer takes 0 - 2 (depth is shared), clusters 3 - 5, fog volume 6
+#define VISIBILITY_ID_UNIT 7
+#define VISIBILITY_MESH_UNIT 8
+#define VISIBILITY_OBJECT_UNIT 9
+
+struct VisibilityBuffer
+{
+    // R32UI ids + g-buffer depth texture, remade with render targets
+    unsigned int framebuffer;
+    unsigned int ids;
+    // cube triangles, then sphere ones - RGBA32F texture buffer, written once
+    unsigned int meshBuffer;
+    unsigned int meshTexture;
+    unsigned int sphereFirstTriangle;
+    // RGBA32F texture buffer, rewritten every frame (set per frame in flight)
+    StreamBuffer objectBuffer;
+    std::vector<glm::vec4> objectData;
+    // ids and GL_MAX_TEXTURE_BUFFER_SIZE / VISIBILITY_OBJECT_TEXELS, objects over it are dropped
+    unsigned int maxObjects;
+    // cubes first, spheres from firstSphere, capped at maxObjects
+    unsigned int cubeCount;
+    unsigned int firstSphere;
+    unsigned int objectCount;
+};
+
+// id pass, objectData sampler is bound to VISIBILITY_OBJECT_UNIT
+struct VisibilityUniforms
+{
+    GLint objectId;
+    GLint projection;
+};
+// resolve pass, lights / materials / fog come from LightingUniforms and clusters
+struct VisibilityResolveUniforms
+{
+    GLint firstSphere;
+    GLint sphereFirstTriangle;
+};
+
+// sphere mesh is the one objects are drawn with, cube comes from cubeVertices
+bool SetUpVisibilityBuffer(VisibilityBuffer& visibility, const std::vector<float>& sphereVertices, const std::vector<unsigned int>& sphereIndices);
+void DestroyVisibilityBuffer(VisibilityBuffer& visibility);
+// id target of g-buffer size, depth attachment is gBuffer.depth
+bool SetUpVisibilityTarget(VisibilityBuffer& visibility, const Gbuffer& gBuffer);
+void DestroyVisibilityTarget(VisibilityBuffer& visibility);
+VisibilityUniforms GetVisibilityUniforms(GLuint shaderProgram);
+// also binds visibilityIds / meshData / objectData samplers to VISIBILITY_*_UNIT
+VisibilityResolveUniforms GetVisibilityResolveUniforms(GLuint shaderProgram);
+
+// Model view matrix, normal matrix, color and material of every object for this frame, uploaded
+// into resource set frame (FrameSync::frame).
+void UpdateVisibilityObjects(VisibilityBuffer& visibility, const Object* cubes, unsigned int cubeCount, const Object* spheres, unsigned int sphereCount,
+    float time, const glm::mat4& view, unsigned int frame);
+// Draws every object into the bound id framebuffer, a draw only sends the object index.
+void VisibilityPass(const VisibilityBuffer& visibility, VAOStruct cube, VAOStruct sphere, unsigned int sphereIndexCount, GLuint shaderProgram,
+    const VisibilityUniforms& uniforms, const glm::mat4& projection);
+// ids, mesh and objects for the resolve program, binds shaderProgram
+void BindVisibilityBuffer(const VisibilityBuffer& visibility, GLuint shaderProgram, const VisibilityResolveUniforms& uniforms);
+
+#endif
@@ -0,0 +1,150 @@
+#include "VolumetricFog.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "Profiler.hpp"
+#include "Counters.hpp"
+#include "GLTrace.hpp"
+
+static void SetUpFogTexture(unsigned int& texture, GLenum target)
+{
+    glGenTextures(1, &texture);
+    glBindTexture(target, texture);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (target == GL_TEXTURE_3D)
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+
+bool SetUpVolumetricFog(VolumetricFog& fog)
+{
+    SetUpFogTexture(fog.volume, GL_TEXTURE_3D);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, FOG_FROXELS_X, FOG_FROXELS_Y, FOG_FROXELS_Z, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    for (int i = 0; i < 2; i++)
+    {
+        // transmittance is multiplied up over 64 slices, half floats would drift
+        SetUpFogTexture(fog.carry[i], GL_TEXTURE_2D);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, FOG_FROXELS_X, FOG_FROXELS_Y, 0, GL_RGBA, GL_FLOAT, nullptr);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &fog.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, fog.framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, fog.volume, 0, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, fog.carry[0], 0);
+    const GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+    fog.isSetUp = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    fog.nearPlane = 0.1f;
+    fog.farPlane = 100.0f;
+    if (!fog.isSetUp)
+        std::cerr << "Fog volume framebuffer not complete, volumetric fog not available" << std::endl;
+    return fog.isSetUp;
+}
+
+void DestroyVolumetricFog(VolumetricFog& fog)
+{
+    glDeleteFramebuffers(1, &fog.framebuffer);
+    glDeleteTextures(1, &fog.volume);
+    glDeleteTextures(2, fog.carry);
+    fog.isSetUp = false;
+}
+
+FogVolumeUniforms GetFogVolumeUniforms(GLuint shaderProgram)
+{
+    FogVolumeUniforms uniforms;
+    uniforms.slice = glGetUniformLocation(shaderProgram, "fogSlice");
+    uniforms.depthRange = glGetUniformLocation(shaderProgram, "fogDepthRange");
+    uniforms.inverseView = glGetUniformLocation(shaderProgram, "inverseView");
+    uniforms.time = glGetUniformLocation(shaderProgram, "fogTime");
+    uniforms.isFogAnimated = glGetUniformLocation(shaderProgram, "isFogAnimated");
+
+    glUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "previousSlice"), 0);
+    return uniforms;
+}
+
+FogUniforms GetFogUniforms(GLuint shaderProgram)
+{
+    FogUniforms uniforms;
+    uniforms.isVolumetricFog = glGetUniformLocation(shaderProgram, "isVolumetricFog");
+    uniforms.fogVolumeDepth = glGetUniformLocation(shaderProgram, "fogVolumeDepth");
+
+    glUseProgram(shaderProgram);
+    glUniform1i(glGetUniformLocation(shaderProgram, "fogVolume"), FOG_VOLUME_UNIT);
+    return uniforms;
+}
+
+void UpdateVolumetricFog(VolumetricFog& fog, VAOStruct quad, GLuint shaderProgram, const LightingUniforms& lighting, const FogVolumeUniforms& uniforms,
+    const Light* lights, unsigned int lightCount, const Weather& weather, bool isAnimated, float time, const glm::mat4& view, const glm::mat4& projection)
+{
+    PROFILE_ZONE("VolumetricFog");
+    // glm::perspective, depth -1..1
+    fog.nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+    fog.farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fog.framebuffer);
+    glViewport(0, 0, FOG_FROXELS_X, FOG_FROXELS_Y);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(shaderProgram);
+    size_t bytes = 2 * sizeof(glm::mat4) + 3 * sizeof(float);
+    lightCount = std::min(lightCount, (unsigned int)MAX_LIGHTS);
+    SetLightUniforms(lighting, lights, lightCount, view, bytes);
+    glUniformMatrix4fv(lighting.inverseProjection, 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
+    glUniformMatrix4fv(uniforms.inverseView, 1, GL_FALSE, glm::value_ptr(glm::inverse(view)));
+    glUniform2f(uniforms.depthRange, fog.nearPlane, fog.farPlane);
+    glUniform1f(uniforms.time, time);
+    glUniform1f(lighting.fogDensity, weather.fogDensity);
+    glUniform1i(uniforms.isFogAnimated, isAnimated);
+    if (lighting.isDayLight >= 0)
+    {
+        glUniform1i(lighting.isDayLight, weather.isDayLight);
+        bytes += sizeof(int);
+    }
+    glBindVertexArray(quad.VAO);
+    glActiveTexture(GL_TEXTURE0);
+
+    for (int slice = 0; slice < FOG_FROXELS_Z; slice++)
+    {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, fog.volume, 0, slice);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, fog.carry[slice % 2], 0);
+        glBindTexture(GL_TEXTURE_2D, fog.carry[(slice + 1) % 2]);
+        glUniform1i(uniforms.slice, slice);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+
+    CountersAdd(COUNTER_DRAW_CALLS, FOG_FROXELS_Z);
+    CountersAdd(COUNTER_TRIANGLES, 2 * FOG_FROXELS_Z);
+    CountersAdd(COUNTER_BYTES_STREAMED, bytes + FOG_FROXELS_Z * sizeof(int));
+    CountersAdd(COUNTER_LIGHTS_EVALUATED, (uint64_t)lightCount * FOG_FROXELS_X * FOG_FROXELS_Y * FOG_FROXELS_Z);
+}
+
+void BindVolumetricFog(const VolumetricFog& fog, GLuint shaderProgram, const FogUniforms& uniforms, bool isEnabled)
+{
+    glUseProgram(shaderProgram);
+    size_t bytes = 0;
+    // location -1 when shader permutation has it compiled in
+    if (uniforms.isVolumetricFog >= 0)
+    {
+        glUniform1i(uniforms.isVolumetricFog, isEnabled);
+        bytes += sizeof(int);
+    }
+    if (isEnabled)
+    {
+        glActiveTexture(GL_TEXTURE0 + FOG_VOLUME_UNIT);
+        glBindTexture(GL_TEXTURE_3D, fog.volume);
+        glActiveTexture(GL_TEXTURE0);
+        // slice coordinate = log(distance) * x - y, texel centers are at slice centers
+        const float logRatio = logf(fog.farPlane / fog.nearPlane);
+        glUniform2f(uniforms.fogVolumeDepth, 1.0f / logRatio, logf(fog.nearPlane) / logRatio);
+        bytes += 2 * sizeof(float);
+    }
+    CountersAdd(COUNTER_BYTES_STREAMED, bytes);
+}
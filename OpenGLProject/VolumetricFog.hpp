@@ -0,0 +1,67 @@
+#ifndef VolumetricFog_hpp
+#define VolumetricFog_hpp
+#include <GL/glew.h>
+#include <glm.hpp>
+#include "Objects.hpp"
+#include "ShaderSetUp.hpp"
+
+// Froxel volumetric fog - view frustum is cut into screen cells x exponential depth slices
+// (same spacing as light clusters). Every frame one small draw per slice scatters light of
+// lights[] at the slice and adds it front to back onto the slices before it, lighting pass
+// then reads the volume trilinearly instead of exp(-density * distance).
+// Cost depends on froxel count and light count only, not on render resolution.
+// Slice count has to match fogSlices in fogVolumeMainFS.
+#define FOG_FROXELS_X 160
+#define FOG_FROXELS_Y 90
+#define FOG_FROXELS_Z 64
+// texture unit of the volume in lighting shaders, g-buffer takes 0 - 2, clusters 3 - 5
+#define FOG_VOLUME_UNIT 6
+
+struct VolumetricFog
+{
+    unsigned int framebuffer;
+    // RGBA16F, rgb light scattered towards camera and a transmittance, both from camera
+    // up to center of the slice
+    unsigned int volume;
+    // running total of slices done so far (RGBA32F, one layer), slice reads one and writes the
+    // other - reading a layer of volume while rendering into it would be a feedback loop
+    unsigned int carry[2];
+    // froxel depth range, taken from projection
+    float nearPlane;
+    float farPlane;
+    // false when render targets could not be made, lighting keeps analytic fog then
+    bool isSetUp;
+};
+
+// update pass, lights / isDayLight / fogDensity / inverseProjection come from LightingUniforms
+struct FogVolumeUniforms
+{
+    GLint slice;
+    GLint depthRange;
+    GLint inverseView;
+    GLint time;
+    GLint isFogAnimated;
+};
+// read side, in every lighting program
+struct FogUniforms
+{
+    GLint isVolumetricFog;
+    GLint fogVolumeDepth;
+};
+
+bool SetUpVolumetricFog(VolumetricFog& fog);
+void DestroyVolumetricFog(VolumetricFog& fog);
+FogVolumeUniforms GetFogVolumeUniforms(GLuint shaderProgram);
+// also binds fogVolume sampler to FOG_VOLUME_UNIT
+FogUniforms GetFogUniforms(GLuint shaderProgram);
+
+// Renders every slice of the volume, leaves its own framebuffer and viewport bound.
+// lights - sorted point, spot, directional like for full screen lighting.
+// isAnimated - density drifts with time instead of weather.fogDensity (CalculateFogDensity)
+void UpdateVolumetricFog(VolumetricFog& fog, VAOStruct quad, GLuint shaderProgram, const LightingUniforms& lighting, const FogVolumeUniforms& uniforms,
+    const Light* lights, unsigned int lightCount, const Weather& weather, bool isAnimated, float time, const glm::mat4& view, const glm::mat4& projection);
+// has to be called for every lighting program draw, isEnabled false switches it back to analytic fog
+// (uniform state stays with the program). Binds shaderProgram.
+void BindVolumetricFog(const VolumetricFog& fog, GLuint shaderProgram, const FogUniforms& uniforms, bool isEnabled);
+
+#endif
@@ -0,0 +1,64 @@
+#include "Window.hpp"
+#include <iostream>
+#include "GLTrace.hpp"
+
+GLFWwindow* CreateAppWindow(int width, int height, bool headless)
+{
+    if (headless)
+    {
+        // must be set before glfwInit
+        if (glfwPlatformSupported(GLFW_PLATFORM_NULL))
+            glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+        else
+            std::cerr << "GLFW null platform not available, using hidden window" << std::endl;
+    }
+
+    // Initialize GLFW and create a window
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return nullptr;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (headless)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        if (glfwGetPlatform() == GLFW_PLATFORM_NULL)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    }
+
+    GLFWwindow* window = glfwCreateWindow(width, height, "Deferred Shading", nullptr, nullptr);
+    if (!window) {
+        std::cerr << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return nullptr;
+    }
+
+    glfwMakeContextCurrent(window);
+    glewExperimental = GL_TRUE;
+    GLenum glewStatus = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GL entry points are already loaded at this point, only GLX extensions are missing
+    // (expected with OSMesa, GLEW has to be built with GLEW_OSMESA for headless runs)
+    if (headless && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY)
+        glewStatus = GLEW_OK;
+#endif
+    if (glewStatus != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW" << std::endl;
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return nullptr;
+    }
+
+    if (headless)
+        std::cout << "Headless renderer: " << glGetString(GL_RENDERER) << std::endl;
+    return window;
+}
+
+void DestroyAppWindow(GLFWwindow* window)
+{
+    glfwDestroyWindow(window);
+    glfwTerminate();
+}
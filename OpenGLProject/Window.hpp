@@ -0,0 +1,13 @@
+#ifndef Window_hpp
+#define Window_hpp
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+// Creates window with GL 3.3 core context and loads GL functions.
+// headless - GLFW null platform with OSMesa context, renders offscreen
+// (Mesa llvmpipe on Linux servers, no display needed).
+// Returns nullptr on failure (GLFW is terminated then).
+GLFWwindow* CreateAppWindow(int width, int height, bool headless);
+void DestroyAppWindow(GLFWwindow* window);
+
+#endif
@@ -0,0 +1,72 @@
+#include "WorkerPool.hpp"
+#include <algorithm>
+#include "Profiler.hpp"
+
+static void WorkerLoop(WorkerPool* pool, unsigned int worker)
+{
+    ProfilerSetThreadName("Worker");
+    unsigned int generation = 0;
+    while (true)
+    {
+        std::function<void(unsigned int)> task;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->wake.wait(lock, [&] { return pool->isStopping || pool->generation != generation; });
+            if (pool->isStopping)
+                return;
+            generation = pool->generation;
+            task = pool->task;
+        }
+        task(worker);
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (--pool->pending == 0)
+            pool->done.notify_one();
+    }
+}
+
+void StartWorkerPool(WorkerPool& pool, unsigned int threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    pool.generation = 0;
+    pool.pending = 0;
+    pool.isStopping = false;
+    for (unsigned int i = 1; i < threads; i++)
+        pool.threads.push_back(std::thread(WorkerLoop, &pool, i));
+}
+
+void StopWorkerPool(WorkerPool& pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.isStopping = true;
+    }
+    pool.wake.notify_all();
+    for (size_t i = 0; i < pool.threads.size(); i++)
+        pool.threads[i].join();
+    pool.threads.clear();
+}
+
+unsigned int WorkerCount(const WorkerPool& pool)
+{
+    return (unsigned int)pool.threads.size() + 1;
+}
+
+void RunOnWorkers(WorkerPool& pool, const std::function<void(unsigned int)>& task)
+{
+    if (pool.threads.empty())
+    {
+        task(0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.task = task;
+        pool.pending = (unsigned int)pool.threads.size();
+        pool.generation++;
+    }
+    pool.wake.notify_all();
+    task(0);
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.done.wait(lock, [&] { return pool.pending == 0; });
+}
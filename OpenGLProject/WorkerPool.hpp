@@ -0,0 +1,31 @@
+#ifndef WorkerPool_hpp
+#define WorkerPool_hpp
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+// Threads started once and reused every frame (starting std::thread per frame costs
+// tens of microseconds each). Calling thread works too, it is worker 0.
+struct WorkerPool
+{
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void(unsigned int)> task;
+    // bumped for every RunOnWorkers, workers wait for a new one
+    unsigned int generation;
+    unsigned int pending;
+    bool isStopping;
+};
+
+// threads = 0 -> hardware concurrency, pool has threads - 1 extra threads
+void StartWorkerPool(WorkerPool& pool, unsigned int threads);
+void StopWorkerPool(WorkerPool& pool);
+unsigned int WorkerCount(const WorkerPool& pool);
+// runs task(worker) once on every worker including caller, returns when all are finished
+void RunOnWorkers(WorkerPool& pool, const std::function<void(unsigned int)>& task);
+
+#endif
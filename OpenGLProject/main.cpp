@@ -7,167 +7,343 @@
 #include <vector>
 #include <cmath>
 #include <string>
+#include <chrono>
+#include <thread>
 #include "Objects.hpp"
-#include "ShaderSetUp.hpp"
-#include "GeometryShaders.hpp"
-#include "LightingShaders.hpp"
-// Vertex shader for the geometry pass
+#include "Scene.hpp"
+#include "Settings.hpp"
+#include "Renderer.hpp"
+#include "Window.hpp"
+#include "Benchmark.hpp"
+#include "Profiler.hpp"
+#include "Counters.hpp"
+#include "Regression.hpp"
+#include "StartupTimeline.hpp"
+#include "FramePacing.hpp"
 
 
 
 
-int main() {
-    // Initialize GLFW and create a window
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
-        return -1;
-    }
+static void OnFramebufferSize(GLFWwindow* window, int width, int height)
+{
+    Renderer* renderer = (Renderer*)glfwGetWindowUserPointer(window);
+    RequestResize(*renderer, width, height);
+}
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Deferred Shading", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+int main(int argc, char** argv) {
+    AppSettings settings;
+    if (!ParseSettings(argc, argv, settings))
         return -1;
-    }
 
-    glfwMakeContextCurrent(window);
-    glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK) {
-        std::cerr << "Failed to initialize GLEW" << std::endl;
-        return -1;
+    ProfilerSetEnabled(settings.isProfilerEnabled);
+    StartupSetThreadName("Main");
+    if (settings.isProfilerEnabled)
+        std::cout << "Profiler zone overhead: " << ProfilerMeasureOverhead(100000) << " ns" << std::endl;
+
+    // Scene compiler: OpenGLProject --compile scene.scene scene.sceneb
+    if (!settings.compileInput.empty())
+        return CompileScene(settings.compileInput, settings.compileOutput) ? 0 : -1;
+
+    // Scene file (text or compiled) can be given as first argument
+    Scene scene;
+    InitScene(scene);
+    bool isSceneLoaded = false;
+    auto loadScene = [&]()
+    {
+        STARTUP_PHASE("Scene");
+        auto loadStart = std::chrono::steady_clock::now();
+        if (settings.isGenerated)
+        {
+            if (!GenerateScene(settings.generator, scene))
+                return;
+        }
+        else if (!settings.scenePath.empty())
+        {
+            if (!LoadScene(scene, settings.scenePath))
+                return;
+        }
+        else
+            CreateDefaultScene(scene);
+        isSceneLoaded = true;
+        std::cout << "Scene " << (settings.isGenerated ? "generated" : "loaded") << " in "
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count()
+            << " ms (" << scene.cubeCount << " cubes, " << scene.sphereCount << " spheres, " << scene.lightCount << " lights)" << std::endl;
+    };
+
+    if (!settings.savePath.empty())
+    {
+        loadScene();
+        bool saved = isSceneLoaded && SaveSceneBinary(scene, settings.savePath);
+        FreeScene(scene);
+        return saved ? 0 : -1;
     }
 
-    Gbuffer gBuffer;
-    gBuffer = SetUpGbuffer();
-
-
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Framebuffer not complete!" << std::endl;
+    // Scene and meshes do not touch GL, they are built on workers while the window and context are created
+    std::thread sceneThread([&]()
+    {
+        StartupSetThreadName("Scene");
+        loadScene();
+    });
+    RendererMeshes meshes;
+    std::thread meshThread([&]()
+    {
+        StartupSetThreadName("Meshes");
+        STARTUP_PHASE("Meshes");
+        GenerateRendererMeshes(meshes);
+    });
+
+    GLFWwindow* window;
+    {
+        STARTUP_PHASE("Window");
+        window = CreateAppWindow(800, 600, settings.isHeadless);
+    }
+    Renderer renderer;
+    bool isRendererSetUp = false;
+    if (window)
+    {
+        meshThread.join();
+        STARTUP_PHASE("SetUpRenderer");
+        // framebuffer can be bigger than window on high DPI screens
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        isRendererSetUp = SetUpRenderer(renderer, width, height, settings.renderScale, settings.gbufferLayout, meshes);
+    }
+    else
+        meshThread.join();
+    {
+        STARTUP_PHASE("WaitScene");
+        sceneThread.join();
+    }
+    if (!window || !isRendererSetUp || !isSceneLoaded)
+    {
+        if (isRendererSetUp)
+            DestroyRenderer(renderer);
+        if (window)
+            DestroyAppWindow(window);
+        FreeScene(scene);
         return -1;
     }
+    SceneWatcher sceneWatcher = CreateSceneWatcher(scene.path, 0.5);
+
+    renderer.lightCutoff = settings.lightCutoff;
+    renderer.shaders.isEnabled = settings.isShaderPermutations;
+    renderer.shaders.binaryDirectory = settings.shaderCacheDirectory;
+    if (settings.clusterThreads != 0)
+        SetLightClusterThreads(renderer.lightClusters, settings.clusterThreads);
+    glfwSetWindowUserPointer(window, &renderer);
+    glfwSetFramebufferSizeCallback(window, OnFramebufferSize);
+    ApplyVsync(window, settings.pacing.vsync);
+    SetFramesInFlight(renderer.frameSync, settings.framesInFlight);
+
+    if (!settings.regression.directory.empty())
+    {
+        bool ok = RunRegression(window, renderer, settings.regression, settings.benchmark);
+        DestroyRenderer(renderer);
+        FreeScene(scene);
+        DestroyAppWindow(window);
+        ProfilerShutdown();
+        return ok ? 0 : -1;
+    }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    std::vector<float> verticesS;
-    std::vector<unsigned int> indicesS;
-    createSphere(verticesS, indicesS, 0.33f, 32, 16);
-
-    // Set up shaders
-    unsigned int geometryShader = createShaderProgram(geometryVS, geometryFS);
-    unsigned int lightingShader = createShaderProgram(lightingVS, lightingFS);
-
-    // Set up cube VAO
-    VAOStruct cubeVAOs = SetUpCubeVAO();
-
-    // Set up Sphere VAO
-    VAOStruct SphereVAO = SetUpSphereVAO(verticesS, indicesS);
-    // Set up quad VAO
-    VAOStruct quadVAOs = SetUpQuad();
+    RenderState state = DefaultRenderState();
+    state.isDepthPrepass = settings.isDepthPrepass;
+    state.lightingMode = settings.lightingMode;
+    state.isVolumetricFog = settings.isVolumetricFog;
+    state.isShadows = settings.isShadows;
+    state.isShadowCache = settings.isShadowCache;
+    state.lightingResolution = settings.lightingResolution;
+    {
+        // every program of first frame is compiling at once, passes pick them up when they need them
+        STARTUP_PHASE("RequestShaders");
+        RequestFrameShaders(renderer, scene, state);
+    }
+    // regression captures its own images, recording covers benchmark and interactive runs
+    if (!settings.capture.path.empty() && !StartFrameCapture(renderer.capture, settings.capture))
+        std::cerr << "Frame capture not available" << std::endl;
+
+    if (settings.benchmark.frames > 0)
+    {
+        bool ok;
+        if (settings.benchmark.isGbufferComparison)
+            ok = RunGbufferComparison(window, renderer, scene, state, settings.benchmark);
+        else if (settings.benchmark.isDepthPrepassComparison)
+            ok = RunDepthPrepassComparison(window, renderer, scene, state, settings.benchmark);
+        else if (settings.benchmark.isForwardComparison)
+            ok = RunForwardComparison(window, renderer, scene, state, settings.benchmark);
+        else if (settings.benchmark.isLightingResolutionComparison)
+            ok = RunLightingResolutionComparison(window, renderer, scene, state, settings.benchmark);
+        else if (settings.benchmark.isFramesInFlightComparison)
+            ok = RunFramesInFlightComparison(window, renderer, scene, state, settings.benchmark);
+        else
+            ok = RunBenchmark(window, renderer, scene, state, settings.benchmark);
+        StopFrameCapture(renderer.capture, std::cout);
+        std::cout << "Shaders: " << ShaderCacheSummary(renderer.shaders) << std::endl;
+        PrintStartupTimeline(std::cout);
+        if (!settings.tracePath.empty())
+            ProfilerExportChromeTrace(settings.tracePath);
+        DestroyRenderer(renderer);
+        FreeScene(scene);
+        DestroyAppWindow(window);
+        ProfilerShutdown();
+        return ok ? 0 : -1;
+    }
 
     // set up other 
-    Weather weather;
-	weather.fogDensity = 0.8f;
-	weather.isFog = false;
-    weather.isDayLight = false;
-    unsigned int currentCamera = 0;
-    Light* lights = CreateLights(); 
-    Object* cubes = CubesGenerator();
-    Object* spheres = CreateSpheres();
-    Camera* cameras = CreateCameras();
-	float specPower = 32.0f;
-
-	bool isBlinn = false;
+    Weather& weather = scene.weather;
+    unsigned int& currentCamera = state.currentCamera;
+	float& specPower = state.specPower;
+	bool& isBlinn = state.isBlinn;
+    MetricsExporter metrics = CreateMetricsExporter(settings.metricsPath, settings.metricsInterval);
+    FramePacer pacer;
+    SetUpFramePacer(pacer, window, settings.pacing);
+    double lastFrameTime = glfwGetTime();
+    // programs requested above finish during first frame - cold start compiles them, warm one loads binaries
+    bool isStartupReported = false;
     // Main loop
     while (!glfwWindowShouldClose(window)) {
-        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.buffer); 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); 
-
+       PROFILE_ZONE("Frame");
        float time = glfwGetTime();
-	   float radius = 0.5f;
-	   weather.fogDensity = CalculateFogDensity(time);
-
-	   spheres[1].position = glm::vec3(sin(time) * radius,cos(time) * radius, 0.3f);
-	   cameras[2].position = 3.0f * spheres[1].position;
-	   cameras[1].direction = spheres[1].position;
-	   lights[3].position = spheres[1].position;
-        // Geometry pass
-	   for (int i = 0; i < 100; i++)
-		   GeometryPassCube(cubeVAOs, geometryShader, cubes[i], weather, gBuffer, time, cameras[currentCamera]);
-	   for (int i = 0; i < 3; i++)
-           GeometryPassSphere(SphereVAO, geometryShader, spheres[i], weather, gBuffer, time, indicesS, cameras[currentCamera]);
-
-        // Lighting pass
-        LightingPassCube(quadVAOs, lightingShader, gBuffer, lights, weather, cameras[currentCamera],specPower, isBlinn);
-
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
+       {
+           PROFILE_ZONE("Simulation");
+           if (PollSceneWatcher(sceneWatcher, time))
+           {
+               int changed = ReloadScene(scene);
+               if (changed >= 0)
+                   std::cout << "Scene reloaded, " << changed << " entries changed" << std::endl;
+               if (currentCamera >= scene.cameraCount)
+                   currentCamera = 0;
+           }
+           AnimateScene(scene, time);
+       }
+
+        // Geometry pass and lighting pass
+        RenderFrame(renderer, scene, state, time);
+
+        // keys that came during CPU work get their time now instead of at next sample
         glfwPollEvents();
 
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        // Swap buffers and poll events
+        {
+            PROFILE_ZONE("Swap");
+            glfwSwapBuffers(window);
+        }
+        RecordPresent(pacer);
+        if (!isStartupReported)
+        {
+            StartupFirstFrame();
+            std::cout << "First frame after " << StartupFirstFrameMilliseconds()
+                << " ms, shaders: " << ShaderCacheSummary(renderer.shaders) << std::endl;
+            isStartupReported = true;
+        }
+        WaitForFrame(pacer, true);
+        SampleInput(pacer);
+
+        double now = glfwGetTime();
+        CountersEndFrame((float)((now - lastFrameTime) * 1000.0));
+        GLCallsEndFrame();
+        lastFrameTime = now;
+        PollMetricsExporter(metrics, now, renderer.gpuTimer.latest);
+
+        if (IsKeyDown(pacer, GLFW_KEY_ESCAPE))
             glfwSetWindowShouldClose(window, true);
 
-        if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
+        if (IsKeyDown(pacer, GLFW_KEY_1))
             currentCamera = 0;
 
-        if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
+        if (IsKeyDown(pacer, GLFW_KEY_2) && scene.cameraCount > 1)
             currentCamera = 1;
 
-        if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
+        if (IsKeyDown(pacer, GLFW_KEY_3) && scene.cameraCount > 2)
             currentCamera = 2;
 
-        if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS)
+        if (IsKeyDown(pacer, GLFW_KEY_4) && scene.cameraCount > 3)
             currentCamera = 3;
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        if (IsKeyDown(pacer, GLFW_KEY_D))
             weather.isDayLight = true;
-		if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS)
+		if (IsKeyDown(pacer, GLFW_KEY_N))
 			weather.isDayLight = false;
-        if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
+        if (IsKeyDown(pacer, GLFW_KEY_F))
 			weather.isFog = true;
-		if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS)
+		if (IsKeyDown(pacer, GLFW_KEY_G))
 			weather.isFog = false;
-		if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-			lights[3].direction.y += 0.01f;
-		if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-			lights[3].direction.y -= 0.01f;
-		if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-			lights[3].direction.x -= 0.01f;
-		if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-			lights[3].direction.x += 0.01f;
-        if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS)
+		if (IsKeyDown(pacer, GLFW_KEY_UP) && scene.lightCount > 3)
+			scene.lights[3].direction.y += 0.01f;
+		if (IsKeyDown(pacer, GLFW_KEY_DOWN) && scene.lightCount > 3)
+			scene.lights[3].direction.y -= 0.01f;
+		if (IsKeyDown(pacer, GLFW_KEY_LEFT) && scene.lightCount > 3)
+			scene.lights[3].direction.x -= 0.01f;
+		if (IsKeyDown(pacer, GLFW_KEY_RIGHT) && scene.lightCount > 3)
+			scene.lights[3].direction.x += 0.01f;
+        if (IsKeyDown(pacer, GLFW_KEY_Z))
 			specPower = std::max(specPower - 1.0f, 1.0f);
-        if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS)
+        if (IsKeyDown(pacer, GLFW_KEY_X))
             specPower = std::min(specPower + 1.0f, 64.0f);
-        if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
+        if (IsKeyDown(pacer, GLFW_KEY_P))
 			isBlinn = false;
-        if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
+        if (IsKeyDown(pacer, GLFW_KEY_B))
 			isBlinn = true;
+        if (IsKeyDown(pacer, GLFW_KEY_I))
+            state.isOverlayVisible = true;
+        if (IsKeyDown(pacer, GLFW_KEY_O))
+            state.isOverlayVisible = false;
+        if (IsKeyDown(pacer, GLFW_KEY_K))
+            state.isDepthPrepass = true;
+        if (IsKeyDown(pacer, GLFW_KEY_L))
+            state.isDepthPrepass = false;
+        if (IsKeyDown(pacer, GLFW_KEY_C))
+            state.lightingMode = LIGHTING_FULL_SCREEN;
+        if (IsKeyDown(pacer, GLFW_KEY_V))
+            state.lightingMode = LIGHTING_VOLUMES;
+        if (IsKeyDown(pacer, GLFW_KEY_M))
+            state.lightingMode = LIGHTING_CLUSTERED;
+        if (IsKeyDown(pacer, GLFW_KEY_R))
+            state.lightingMode = LIGHTING_FORWARD_PLUS;
+        if (IsKeyDown(pacer, GLFW_KEY_T))
+            state.lightingMode = LIGHTING_VISIBILITY;
+        if (IsKeyDown(pacer, GLFW_KEY_Q))
+            state.lightingResolution = LIGHTING_RESOLUTION_FULL;
+        if (IsKeyDown(pacer, GLFW_KEY_W))
+            state.lightingResolution = LIGHTING_RESOLUTION_HALF;
+        if (IsKeyDown(pacer, GLFW_KEY_E))
+            state.lightingResolution = LIGHTING_RESOLUTION_QUARTER;
+        if (IsKeyDown(pacer, GLFW_KEY_A))
+            state.lightingResolution = LIGHTING_RESOLUTION_CHECKERBOARD;
+        if (IsKeyDown(pacer, GLFW_KEY_H))
+            state.isClusterHeatmap = true;
+        if (IsKeyDown(pacer, GLFW_KEY_J))
+            state.isClusterHeatmap = false;
+        if (IsKeyDown(pacer, GLFW_KEY_U))
+            state.isVolumetricFog = true;
+        if (IsKeyDown(pacer, GLFW_KEY_Y))
+            state.isVolumetricFog = false;
+        if (IsKeyDown(pacer, GLFW_KEY_5))
+            state.isShadows = true;
+        if (IsKeyDown(pacer, GLFW_KEY_6))
+            state.isShadows = false;
+        if (IsKeyDown(pacer, GLFW_KEY_9))
+            SetRenderScale(renderer, renderer.renderScale - 0.01f);
+        if (IsKeyDown(pacer, GLFW_KEY_0))
+            SetRenderScale(renderer, renderer.renderScale + 0.01f);
+
+        WaitForFrame(pacer, false);
     }
 
-    // Clean up
-    glDeleteVertexArrays(1, &cubeVAOs.VAO);
-    glDeleteBuffers(1, &cubeVAOs.VBO);
-    glDeleteBuffers(1, &cubeVAOs.EBO);
-
-    glDeleteVertexArrays(1, &SphereVAO.VAO); 
-    glDeleteBuffers(1, &SphereVAO.VBO); 
-    glDeleteBuffers(1, &SphereVAO.EBO); 
-
-    glDeleteVertexArrays(1, &quadVAOs.VAO);
-    glDeleteBuffers(1, &quadVAOs.VBO); 
-    glDeleteBuffers(1, &quadVAOs.EBO); 
+    StopFrameCapture(renderer.capture, std::cout);
+    PrintStartupTimeline(std::cout);
+    PrintFramePacing(pacer, std::cout);
+    const FrameSync& sync = renderer.frameSync;
+    std::cout << "Frames in flight " << sync.framesInFlight << ": CPU waited for the GPU in " << sync.stalledFrames << " of " << sync.frames
+        << " frames, " << (sync.frames > 0 ? sync.totalStallMs / sync.frames : 0.0) << " ms per frame, longest " << sync.maxStallMs << " ms" << std::endl;
+    CloseLatencyLog(pacer);
+    if (!settings.tracePath.empty())
+        ProfilerExportChromeTrace(settings.tracePath);
 
-    glDeleteFramebuffers(1, &gBuffer.buffer);
-    glDeleteTextures(1, &gBuffer.gPosition);
-    glDeleteTextures(1, &gBuffer.gNormal);
-    glDeleteTextures(1, &gBuffer.gAlbedo);
+    // Clean up
+    DestroyRenderer(renderer);
 
-    glDeleteProgram(geometryShader);
-    glDeleteProgram(lightingShader);
+    FreeScene(scene);
 
-    glfwTerminate();
+    DestroyAppWindow(window);
+    ProfilerShutdown();
     return 0;
 }
\ No newline at end of file